@@ -0,0 +1,725 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+}
+
+#include <glog/logging.h>
+
+#include "audio.h"
+#include "buffer.h"
+#include "buffer_contents.h"
+#include "buffer_variables.h"
+#include "buffer_words_index.h"
+#include "char_buffer.h"
+#include "completion_index.h"
+#include "cursors.h"
+#include "editor.h"
+#include "event_loop.h"
+#include "file_link_mode.h"
+#include "file_predictor_worker.h"
+#include "line.h"
+#include "line_marks.h"
+#include "line_marks_resolver.h"
+#include "list_buffers_command.h"
+#include "path_index.h"
+#include "undo_journal.h"
+#include "wstring.h"
+
+using namespace afc::editor;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+std::unique_ptr<BufferContents> NewContents(size_t lines, size_t columns) {
+  auto contents = std::make_unique<BufferContents>();
+  for (size_t i = 0; i < lines; i++) {
+    wstring line;
+    for (size_t j = 0; j < columns; j++) {
+      line.push_back(L'a' + (i + j) % 26);
+    }
+    contents->push_back(line);
+  }
+  return contents;
+}
+
+// Reads every character in contents (through ForEach and Line::get), like the
+// parsers do. Returns the number of characters read.
+size_t ReadAllCharacters(const BufferContents& contents, size_t* checksum) {
+  size_t characters = 0;
+  contents.ForEach([&](const Line& line) {
+    for (size_t i = 0; i < line.size(); i++) {
+      *checksum += line.get(i);
+    }
+    characters += line.size();
+  });
+  return characters;
+}
+
+// Measures the throughput of ForEach + Line::get. If concurrent_reader is
+// true, another thread (simulating the background parser) reads a copy of the
+// contents at the same time.
+void BenchmarkLineReads(bool concurrent_reader) {
+  auto contents = NewContents(10000, 80);
+  std::atomic<bool> done(false);
+  std::thread reader;
+  if (concurrent_reader) {
+    std::shared_ptr<BufferContents> copy = contents->copy();
+    reader = std::thread([copy, &done]() {
+      size_t checksum = 0;
+      while (!done) {
+        ReadAllCharacters(*copy, &checksum);
+      }
+      VLOG(5) << "Checksum: " << checksum;
+    });
+  }
+
+  size_t checksum = 0;
+  size_t characters = 0;
+  auto start = Clock::now();
+  for (int i = 0; i < 20; i++) {
+    characters += ReadAllCharacters(*contents, &checksum);
+  }
+  double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  done = true;
+  if (reader.joinable()) {
+    reader.join();
+  }
+  std::cout << "LineReads (concurrent reader: "
+            << (concurrent_reader ? "yes" : "no")
+            << "): " << characters / seconds / 1e6 << " M characters/s"
+            << " (checksum: " << checksum << ")" << std::endl;
+}
+
+// Measures CursorsTracker::ApplyTransformationToCursors with one cursor in each
+// of many lines. The callback emits the transformations that BufferContents
+// would emit for inserting a character (if !insert_line) or a new line.
+void BenchmarkMultipleCursors(bool insert_line) {
+  const size_t kCursors = 10000;
+  CursorsTracker tracker;
+  auto cursors = tracker.FindOrCreateCursors(L"");
+  cursors->clear();
+  for (size_t i = 0; i < kCursors; i++) {
+    cursors->insert(LineColumn(i, 5));
+  }
+  tracker.SetCurrentCursor(cursors, LineColumn(0, 5));
+
+  auto start = Clock::now();
+  tracker.ApplyTransformationToCursors(
+      cursors, [&tracker, insert_line](LineColumn position) {
+        if (insert_line) {
+          tracker.AdjustCursors(CursorsTracker::Transformation()
+                                    .WithBegin(LineColumn(position.line))
+                                    .AddToLine(1));
+          return LineColumn(position.line + 1, position.column);
+        }
+        tracker.AdjustCursors(CursorsTracker::Transformation()
+                                  .WithBegin(position)
+                                  .WithEnd(LineColumn(position.line + 1))
+                                  .AddToColumn(1));
+        return LineColumn(position.line, position.column + 1);
+      });
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << "MultipleCursors (" << kCursors << " cursors, "
+            << (insert_line ? "insert line" : "insert character")
+            << "): " << seconds * 1000 << " ms" << std::endl;
+}
+
+// Measures inserting lines near the top of the buffer with many cursors (in a
+// set other than the active one) below.
+void BenchmarkCursorsSetAdjust() {
+  const size_t kCursors = 100000;
+  const size_t kEdits = 1000;
+  CursorsTracker tracker;
+  auto cursors = tracker.FindOrCreateCursors(L"marks");
+  for (size_t i = 0; i < kCursors; i++) {
+    cursors->insert(LineColumn(i + 10, 5));
+  }
+
+  auto start = Clock::now();
+  for (size_t i = 0; i < kEdits; i++) {
+    tracker.AdjustCursors(
+        CursorsTracker::Transformation().WithBegin(LineColumn(i)).AddToLine(1));
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << "CursorsSetAdjust (" << kCursors << " cursors, " << kEdits
+            << " edits): " << seconds * 1000 << " ms (first: "
+            << *cursors->begin() << ")" << std::endl;
+}
+
+// Measures writing an undo journal with many entries (each modifying one line)
+// and loading it back.
+void BenchmarkUndoJournal() {
+  const size_t kEntries = 10000;
+  char directory[] = "/tmp/edge_benchmark_XXXXXX";
+  CHECK(mkdtemp(directory) != nullptr);
+  const wstring path = FromByteString(directory) + L"/.edge_undo";
+  auto contents = NewContents(1, 80);
+
+  auto start = Clock::now();
+  {
+    UndoJournal journal(path);
+    for (size_t i = 0; i < kEntries; i++) {
+      UndoEntry entry;
+      BufferContents::Delta delta;
+      delta.first = 0;
+      delta.old_lines.push_back(contents->at(0));
+      delta.new_lines.push_back(contents->at(0));
+      entry.deltas.push_back(std::move(delta));
+      journal.Push(entry);
+    }
+    journal.Saved(ContentsChecksum(*contents));
+  }
+  double write_seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  start = Clock::now();
+  UndoJournal journal(path);
+  std::vector<UndoEntry> entries;
+  CHECK(journal.Load(ContentsChecksum(*contents), &entries));
+  double load_seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << "UndoJournal (" << entries.size()
+            << " entries): write: " << write_seconds * 1000
+            << " ms, load: " << load_seconds * 1000 << " ms" << std::endl;
+  unlink(ToByteString(path).c_str());
+  rmdir(directory);
+}
+
+// Measures waking up for a single chatty file descriptor among many idle ones
+// (e.g., buffers with subprocesses that aren't producing output), comparing
+// the event loop with building and scanning a pollfd array on each wake up.
+void BenchmarkEventLoop() {
+  const size_t kIdle = 1000;
+  const size_t kWakeUps = 10000;
+  std::vector<std::pair<int, int>> pipes(kIdle + 1);
+  for (auto& fds : pipes) {
+    int output[2];
+    CHECK_NE(pipe2(output, O_NONBLOCK), -1) << "pipe2: " << strerror(errno);
+    fds = {output[0], output[1]};
+  }
+  int chatty = pipes.back().first;
+  auto wake_up = [&pipes]() {
+    CHECK_EQ(write(pipes.back().second, "x", 1), 1);
+  };
+  auto drain = [chatty]() {
+    char buffer[64];
+    while (read(chatty, buffer, sizeof(buffer)) > 0) continue;
+  };
+
+  auto start = Clock::now();
+  size_t ready = 0;
+  for (size_t i = 0; i < kWakeUps; i++) {
+    wake_up();
+    std::vector<struct pollfd> fds(pipes.size());
+    for (size_t j = 0; j < pipes.size(); j++) {
+      fds[j].fd = pipes[j].first;
+      fds[j].events = POLLIN | POLLPRI;
+    }
+    CHECK_EQ(poll(fds.data(), fds.size(), 1000), 1);
+    for (auto& fd : fds) {
+      if (fd.revents & (POLLIN | POLLPRI | POLLHUP)) {
+        drain();
+        ready++;
+      }
+    }
+  }
+  double poll_seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  CHECK_EQ(ready, kWakeUps);
+
+  EventLoop loop;
+  std::vector<std::unique_ptr<EventLoop::Registration>> registrations;
+  for (auto& fds : pipes) {
+    registrations.push_back(loop.Register(
+        fds.first, fds.first == chatty ? std::function<void()>(drain)
+                                       : []() { LOG(FATAL) << "Idle."; }));
+  }
+  start = Clock::now();
+  for (size_t i = 0; i < kWakeUps; i++) {
+    wake_up();
+    CHECK_EQ(loop.Wait(1000), 1);
+  }
+  double loop_seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  registrations.clear();
+  for (auto& fds : pipes) {
+    close(fds.first);
+    close(fds.second);
+  }
+  std::cout << "EventLoop (" << kIdle << " idle, " << kWakeUps
+            << " wake ups): poll: " << poll_seconds * 1000
+            << " ms, event loop: " << loop_seconds * 1000 << " ms"
+            << std::endl;
+}
+
+// Measures refreshing the list of buffers while one of many buffers receives
+// output (so that only its row changes between refreshes).
+void BenchmarkBuffersList() {
+  const size_t kBuffers = 500;
+  const size_t kRefreshes = 200;
+  auto audio_player = NewNullAudioPlayer();
+  EditorState editor_state(audio_player.get());
+  std::vector<std::shared_ptr<OpenBuffer>> buffers;
+  for (size_t i = 0; i < kBuffers; i++) {
+    auto name = L"buffer_" + std::to_wstring(i);
+    auto buffer = std::make_shared<OpenBuffer>(&editor_state, name);
+    buffer->set_int_variable(buffer_variables::buffer_list_context_lines(), 3);
+    for (size_t line = 0; line < 100; line++) {
+      buffer->AppendLine(&editor_state,
+                         NewCopyString(L"Some output: " + std::to_wstring(line)));
+    }
+    editor_state.buffers()->insert({name, buffer});
+    buffers.push_back(buffer);
+  }
+  NewListBuffersCommand()->ProcessInput(0, &editor_state);
+  auto list = editor_state.current_buffer()->second;
+
+  auto start = Clock::now();
+  for (size_t i = 0; i < kRefreshes; i++) {
+    buffers[0]->AppendLine(&editor_state,
+                           NewCopyString(L"More output: " + std::to_wstring(i)));
+    buffers[0]->set_current_position_line(buffers[0]->lines_size() - 1);
+    list->Reload(&editor_state);
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << "BuffersList (" << kBuffers << " buffers, " << kRefreshes
+            << " refreshes): " << seconds * 1000 << " ms (lines: "
+            << list->lines_size() << ")" << std::endl;
+}
+
+// Measures a build that emits many marks (e.g., compiler warnings) into a few
+// target buffers, while the screen shows one of them (reading its marks after
+// every batch).
+void BenchmarkLineMarks() {
+  const size_t kMarks = 50000;
+  const size_t kTargets = 10;
+  const size_t kMarksPerFrame = 100;
+  auto audio_player = NewNullAudioPlayer();
+  EditorState editor_state(audio_player.get());
+  auto source = std::make_shared<OpenBuffer>(&editor_state, L"build");
+  auto target = std::make_shared<OpenBuffer>(&editor_state, L"file_0.cc");
+  auto marks = editor_state.line_marks();
+
+  auto start = Clock::now();
+  size_t checksum = 0;
+  for (size_t i = 0; i < kMarks; i++) {
+    LineMarks::Mark mark;
+    mark.source = L"build";
+    mark.source_line = i;
+    mark.target_buffer = L"file_" + std::to_wstring(i % kTargets) + L".cc";
+    mark.target = LineColumn(i % 1000);
+    marks->AddMark(mark);
+    if (i % kMarksPerFrame == 0) {
+      checksum += target->GetLineMarks(editor_state)->size();
+      checksum += target->GetLineMarksText(editor_state).size();
+    }
+  }
+  marks->ExpireMarksFromSource(*source, L"build");
+  checksum += target->GetLineMarksText(editor_state).size();
+  marks->RemoveExpiredMarksFromSource(L"build");
+  checksum += target->GetLineMarks(editor_state)->size();
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << "LineMarks (" << kMarks << " marks): " << seconds * 1000
+            << " ms (checksum: " << checksum << ")" << std::endl;
+}
+
+// Measures finding marks in the output of a build (with lines that mention a
+// few files repeatedly, mixed with lines that mention no files), given in
+// chunks (as read from the process). If synchronous, stats every candidate
+// path in the main thread (as StartNewLine used to do).
+void BenchmarkLineMarksResolution(bool synchronous) {
+  const size_t kLines = 100000;
+  const size_t kLinesPerChunk = 1000;
+  const std::vector<wstring> search_paths = {L"", L"/usr/include", L"/tmp"};
+  std::vector<LineMarksResolver::Line> lines;
+  for (size_t i = 0; i < kLines; i++) {
+    lines.push_back(
+        {i, i % 3 == 0 ? L"In function: Foo" + std::to_wstring(i)
+                       : L"src/" +
+                             std::wstring(i % 2 ? L"buffer" : L"editor") +
+                             L".cc:" + std::to_wstring(i % 500) +
+                             L": warning: unused variable"});
+  }
+
+  LineMarks marks;
+  LineMarksResolver resolver([]() {});
+  auto start = Clock::now();
+  std::chrono::duration<double> main_thread(0);
+  for (size_t i = 0; i < kLines; i += kLinesPerChunk) {
+    auto chunk_start = Clock::now();
+    std::vector<LineMarksResolver::Line> chunk(
+        lines.begin() + i, lines.begin() + i + kLinesPerChunk);
+    if (synchronous) {
+      for (auto& line : chunk) {
+        LineMarks::Mark mark;
+        mark.source = L"build";
+        mark.source_line = line.source_line;
+        if (FindPathInSearchPaths(
+                search_paths, line.contents,
+                [](const wstring& path) -> wstring {
+                  struct stat dummy;
+                  if (stat(ToByteString(path).c_str(), &dummy) == -1) {
+                    return L"";
+                  }
+                  char* result = realpath(ToByteString(path).c_str(), nullptr);
+                  wstring output = FromByteString(result);
+                  free(result);
+                  return output;
+                },
+                &mark.target_buffer, &mark.target, nullptr)) {
+          marks.AddMark(std::move(mark));
+        }
+      }
+    } else {
+      resolver.Resolve(L"build", search_paths, std::move(chunk));
+      resolver.Publish(&marks);
+    }
+    main_thread += Clock::now() - chunk_start;
+  }
+  resolver.WaitForIdle();
+  resolver.Publish(&marks);
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  char* target = realpath("src/buffer.cc", nullptr);
+  size_t target_marks =
+      target == nullptr
+          ? 0
+          : marks.GetMarksForTargetBuffer(FromByteString(target)).size();
+  free(target);
+  std::cout << "LineMarksResolution (" << (synchronous ? "sync" : "async")
+            << ", " << kLines << " lines): " << seconds * 1000
+            << " ms, main thread: " << main_thread.count() * 1000
+            << " ms (marks: " << target_marks << ")" << std::endl;
+}
+
+// Measures showing a filtered buffer: sets the filter and then scrolls through
+// the buffer, looking for the lines shown in the screen at each position.
+void BenchmarkFilter(const std::string& name, const wstring& code) {
+  const size_t kLines = 200000;
+  const size_t kScreenLines = 50;
+  const size_t kScrollStep = 5000;
+  auto audio_player = NewNullAudioPlayer();
+  EditorState editor_state(audio_player.get());
+  auto buffer = std::make_shared<OpenBuffer>(&editor_state, L"benchmark");
+  for (size_t i = 0; i < kLines; i++) {
+    buffer->AppendLine(&editor_state,
+                       NewCopyString(L"Request " + std::to_wstring(i * 7919) +
+                                     L": served in some milliseconds"));
+  }
+
+  auto start = Clock::now();
+  CHECK(buffer->EvaluateString(&editor_state, code,
+                               [](std::unique_ptr<afc::vm::Value>) {}));
+  size_t shown = 0;
+  for (size_t view = 0; view < kLines; view += kScrollStep) {
+    size_t screen = 0;
+    for (size_t line = view; line < kLines && screen < kScreenLines; line++) {
+      if (buffer->IsLineFiltered(line)) {
+        screen++;
+      }
+    }
+    shown += screen;
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << "Filter (" << name << "): " << seconds * 1000
+            << " ms (shown: " << shown << ")" << std::endl;
+}
+
+// Measures building the index of a dictionary and looking up completions of
+// many prefixes in it.
+void BenchmarkCompletion() {
+  const size_t kWords = 500000;
+  const size_t kLookups = 10000;
+  auto word = [](size_t i) {
+    wstring output;
+    size_t value = i * 2654435761u;
+    for (size_t length = 3 + i % 8; length > 0; length--) {
+      output.push_back(L"abcdefghijklmnopqrstuvwxyzABC"[value % 29]);
+      value /= 29;
+    }
+    return output;
+  };
+  std::vector<CompletionIndex::Entry> entries;
+  for (size_t i = 0; i < kWords; i++) {
+    CompletionIndex::Entry entry;
+    entry.word = word(i);
+    entry.frequency = 1 + i % 100;
+    entries.push_back(std::move(entry));
+  }
+
+  auto start = Clock::now();
+  CompletionIndex index(std::move(entries));
+  double build_seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  start = Clock::now();
+  size_t matches = 0;
+  for (size_t i = 0; i < kLookups; i++) {
+    matches += index.Find(word(i * 31).substr(0, 1 + i % 3), 10).size();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << "Completion: build: " << build_seconds * 1000
+            << " ms, lookups: " << seconds * 1000 << " ms (matches: " << matches
+            << ")" << std::endl;
+}
+
+// Measures the words index of many buffers: reporting the words of all
+// buffers, reporting a buffer again after a small change, and looking up
+// completions.
+void BenchmarkBufferWords() {
+  const size_t kBuffers = 200;
+  const size_t kWordsPerBuffer = 5000;
+  const size_t kVocabulary = 50000;
+  const size_t kLookups = 10000;
+  auto word = [](size_t i) {
+    wstring output;
+    size_t value = i * 2654435761u % kVocabulary;
+    for (size_t length = 3 + i % 8; length > 0; length--) {
+      output.push_back(L"abcdefghijklmnopqrstuvwxyzABC"[value % 29]);
+      value /= 29;
+    }
+    return output;
+  };
+  std::vector<BufferWordsIndex::WordCounts> buffers(kBuffers);
+  for (size_t buffer = 0; buffer < kBuffers; buffer++) {
+    for (size_t i = 0; i < kWordsPerBuffer; i++) {
+      buffers[buffer][word(buffer * 7 + i * i)]++;
+    }
+  }
+
+  BufferWordsIndex index;
+  auto start = Clock::now();
+  for (size_t buffer = 0; buffer < kBuffers; buffer++) {
+    index.Update(buffer, buffers[buffer]);
+  }
+  double build_seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  buffers[0][L"someNewWord"]++;
+  start = Clock::now();
+  index.Update(0, buffers[0]);
+  double update_seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  start = Clock::now();
+  size_t matches = 0;
+  for (size_t i = 0; i < kLookups; i++) {
+    matches += index.Find(word(i * 31).substr(0, 1 + i % 3), 10).size();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << "Buffer words: build: " << build_seconds * 1000
+            << " ms, update: " << update_seconds * 1000
+            << " ms, lookups: " << seconds * 1000 << " ms (words: "
+            << index.size() << ", matches: " << matches << ")" << std::endl;
+}
+
+// Measures predicting files in a directory with many entries: the time the
+// main thread is blocked and the time until the predictions are available,
+// both the first time and once the listing is cached.
+void BenchmarkFilePredictions() {
+  const size_t kFiles = 20000;
+  const size_t kRepetitions = 20;
+  char directory[] = "/tmp/edge_benchmark_XXXXXX";
+  CHECK(mkdtemp(directory) != nullptr);
+  auto file = [&directory](size_t i) {
+    return std::string(directory) + "/file_" + std::to_string(i);
+  };
+  for (size_t i = 0; i < kFiles; i++) {
+    int fd = open(file(i).c_str(), O_CREAT | O_WRONLY, 0600);
+    CHECK_NE(fd, -1);
+    close(fd);
+  }
+  // Old enough for its listing to be trusted.
+  struct timeval times[2];
+  gettimeofday(&times[0], nullptr);
+  times[0].tv_sec -= 100;
+  times[1] = times[0];
+  CHECK_NE(utimes(directory, times), -1);
+
+  FilePredictorWorker::Query query;
+  query.directory = FromByteString(directory);
+  query.prefix = L"file_1";
+  query.output_prefix = query.directory + L"/";
+  FilePredictorWorker worker([]() {});
+  for (size_t round = 0; round < 2; round++) {
+    double blocked_seconds = 0;
+    double total_seconds = 0;
+    size_t predictions = 0;
+    for (size_t i = 0; i < (round == 0 ? 1 : kRepetitions); i++) {
+      auto start = Clock::now();
+      worker.Predict({query}, [&predictions](std::vector<wstring> output) {
+        predictions = output.size();
+      });
+      blocked_seconds +=
+          std::chrono::duration<double>(Clock::now() - start).count();
+      worker.WaitForIdle();
+      CHECK(worker.Publish());
+      total_seconds +=
+          std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    size_t repetitions = round == 0 ? 1 : kRepetitions;
+    std::cout << "FilePredictions (" << (round == 0 ? "uncached" : "cached")
+              << "): blocked: " << blocked_seconds * 1000 / repetitions
+              << " ms, total: " << total_seconds * 1000 / repetitions
+              << " ms (predictions: " << predictions << ")" << std::endl;
+  }
+
+  for (size_t i = 0; i < kFiles; i++) {
+    unlink(file(i).c_str());
+  }
+  rmdir(directory);
+}
+
+// Builds a path index for a large tree and measures fuzzy searches in it, as
+// done by the fuzzy file finder as each character of a query is typed.
+void BenchmarkFuzzyFinder() {
+  const size_t kPaths = 200000;
+  auto word = [](size_t i) {
+    wstring output;
+    size_t value = i * 2654435761u;
+    for (size_t length = 3 + i % 7; length > 0; length--) {
+      output.push_back(L"abcdefghijklmnopqrstuvwxyz"[value % 26]);
+      value /= 26;
+    }
+    return output;
+  };
+  std::vector<wstring> paths;
+  for (size_t i = 0; i < kPaths; i++) {
+    wstring path;
+    size_t value = i;
+    for (size_t depth = 0; depth < 3 + i % 6; depth++) {
+      path += word(value % (20 << depth)) + L"/";
+      value = value * 31 + 7;
+    }
+    path += word(kPaths + i) + (i % 4 == 0 ? L"_test" : L"") +
+            (i % 3 == 0 ? L".h" : L".cc");
+    paths.push_back(path);
+  }
+
+  auto start = Clock::now();
+  PathIndex index(std::move(paths));
+  double build_seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  const std::vector<wstring> kQueries = {L"b",      L"abcdef",     L"testcc",
+                                         L"xq/zz",  L"lineprompt", L"srcbuf",
+                                         L"aaavvc", L"ftmh"};
+  double max_seconds = 0;
+  double total_seconds = 0;
+  size_t searches = 0;
+  size_t matches = 0;
+  for (const auto& query : kQueries) {
+    for (size_t length = 1; length <= query.size(); length++) {
+      start = Clock::now();
+      matches += index.Find(query.substr(0, length), 100).size();
+      double seconds =
+          std::chrono::duration<double>(Clock::now() - start).count();
+      max_seconds = std::max(max_seconds, seconds);
+      total_seconds += seconds;
+      searches++;
+    }
+  }
+  std::cout << "Fuzzy finder: build: " << build_seconds * 1000
+            << " ms, search: " << total_seconds * 1000 / searches
+            << " ms average, " << max_seconds * 1000 << " ms max (paths: "
+            << index.size() << ", matches: " << matches << ")" << std::endl;
+}
+
+// Compiles code in the environment of a buffer with the given number of lines
+// and measures its evaluation.
+void BenchmarkVm(const std::string& name, const wstring& code,
+                 size_t lines = 100) {
+  auto audio_player = NewNullAudioPlayer();
+  EditorState editor_state(audio_player.get());
+  auto buffer = std::make_shared<OpenBuffer>(&editor_state, L"benchmark");
+  for (size_t i = 0; i < lines; i++) {
+    buffer->AppendLine(&editor_state,
+                       NewCopyString(L"#include \"line_" + std::to_wstring(i) +
+                                     L".h\"  // Some line."));
+  }
+
+  wstring error_description;
+  std::shared_ptr<afc::vm::Expression> expression =
+      buffer->CompileString(&editor_state, code, &error_description);
+  CHECK(expression != nullptr) << error_description;
+
+  auto start = Clock::now();
+  bool done = false;
+  buffer->EvaluateExpression(&editor_state, expression.get(),
+                             [&done](std::unique_ptr<afc::vm::Value>) {
+                               done = true;
+                             });
+  CHECK(done);
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << "Vm (" << name << "): " << seconds * 1000 << " ms" << std::endl;
+}
+}  // namespace
+
+int main(int, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  BenchmarkLineReads(false);
+  BenchmarkLineReads(true);
+  BenchmarkMultipleCursors(false);
+  BenchmarkMultipleCursors(true);
+  BenchmarkCursorsSetAdjust();
+  BenchmarkUndoJournal();
+  BenchmarkEventLoop();
+  BenchmarkBuffersList();
+  BenchmarkLineMarks();
+  BenchmarkLineMarksResolution(true);
+  BenchmarkLineMarksResolution(false);
+  BenchmarkFilter("vm",
+                  L"bool F(string s) { return s.find(\"777\", 0) != -1; }"
+                  L"buffer.Filter(F);");
+  BenchmarkFilter("regex", L"buffer.FilterRegex(\"777\");");
+  BenchmarkCompletion();
+  BenchmarkBufferWords();
+  BenchmarkFilePredictions();
+  BenchmarkFuzzyFinder();
+  BenchmarkVm("loop",
+              L"int i = 0; int s = 0;"
+              L"while (i < 100000) { s = s + i * 2; i = i + 1; }");
+  BenchmarkVm("string ops",
+              L"int i = 0; string s = \"\";"
+              L"while (i < 20000) {"
+              L"  s = s + \"x\";"
+              L"  if (s.size() > 100) { s = s.substr(0, 10); }"
+              L"  i = i + 1;"
+              L"}");
+  BenchmarkVm("buffer calls",
+              L"int i = 0; int j = 0; int s = 0;"
+              L"while (i < 20000) {"
+              L"  s = s + buffer.line_count() + buffer.line(j).size();"
+              L"  j = j + 1;"
+              L"  if (j == 100) { j = 0; }"
+              L"  i = i + 1;"
+              L"}");
+  BenchmarkVm("map lines (old)",
+              L"string F(string s) { return s.substr(0, 10); }"
+              L"buffer.Map(F);",
+              2000);
+  BenchmarkVm("map lines",
+              L"string F(string s) { return s.substr(0, 10); }"
+              L"buffer.MapLines(0, -1, F);",
+              100000);
+  BenchmarkVm("replace regex",
+              L"buffer.ReplaceRegex(0, -1, \"line_([0-9]+)\", \"$1\");",
+              100000);
+  BenchmarkVm("keep lines matching",
+              L"buffer.KeepLinesMatching(0, -1, \"_[0-9]*7[.]h\");",
+              100000);
+  return 0;
+}
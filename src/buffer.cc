@@ -1,9 +1,11 @@
 #include "buffer.h"
 
+#include <atomic>
 #include <condition_variable>
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <regex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -22,7 +24,6 @@ extern "C" {
 #include "char_buffer.h"
 #include "command_with_modifiers.h"
 #include "cpp_parse_tree.h"
-#include "cursors_transformation.h"
 #include "dirname.h"
 #include "editor.h"
 #include "file_link_mode.h"
@@ -37,6 +38,8 @@ extern "C" {
 #include "substring.h"
 #include "transformation.h"
 #include "transformation_delete.h"
+#include "transformation_map.h"
+#include "undo_journal.h"
 #include "vm/public/callbacks.h"
 #include "vm/public/constant_expression.h"
 #include "vm/public/function_call.h"
@@ -50,7 +53,7 @@ namespace vm {
 template <>
 struct VMTypeMapper<editor::OpenBuffer*> {
   static editor::OpenBuffer* get(Value* value) {
-    return static_cast<editor::OpenBuffer*>(value->user_value.get());
+    return static_cast<editor::OpenBuffer*>(value->user_value().get());
   }
 
   static const VMType vmtype;
@@ -62,7 +65,7 @@ const VMType VMTypeMapper<editor::OpenBuffer*>::vmtype =
 template <>
 struct VMTypeMapper<editor::LineColumn> {
   static editor::LineColumn get(Value* value) {
-    return *static_cast<editor::LineColumn*>(value->user_value.get());
+    return *static_cast<editor::LineColumn*>(value->user_value().get());
   }
 
   static Value::Ptr New(editor::LineColumn value) {
@@ -120,11 +123,63 @@ void RegisterBufferFields(
             })));
   }
 }
+
+// Maps the lines in the range [args[1], args[2]) of the buffer in args[0]. A
+// negative end stands for the end of the buffer.
+void MapLines(const vector<Value::Ptr>& args,
+              std::function<bool(wstring*)> map, bool parallel) {
+  CHECK_GE(args.size(), 3u);
+  auto buffer = static_cast<OpenBuffer*>(args[0]->user_value().get());
+  CHECK(buffer != nullptr);
+  MapLinesOptions options;
+  options.first = max(args[1]->integer(), 0);
+  if (args[2]->integer() >= 0) {
+    options.last = args[2]->integer();
+  }
+  options.map = std::move(map);
+  options.parallel = parallel;
+  buffer->ApplyToCursors(NewMapLinesTransformation(std::move(options)),
+                         Modifiers::AFFECT_ONLY_CURRENT_CURSOR);
+}
+
+// Calls a function (from an extension) on the contents of a line. Since the
+// lines are mapped natively, the function must return synchronously; if it
+// doesn't, returns nullptr (and the result is ignored).
+Value::Ptr CallOnLine(Value* callback, const wstring& line) {
+  auto output = std::make_shared<Value::Ptr>();
+  vector<Value::Ptr> args;
+  args.push_back(Value::NewString(line));
+  Call(callback, std::move(args),
+       [output](Value::Ptr value) { *output = std::move(value); });
+  if (*output == nullptr) {
+    LOG(WARNING) << "Function mapping lines didn't return synchronously.";
+  }
+  return std::move(*output);
+}
+
+// Returns nullptr (and sets the status) if the pattern is invalid.
+std::shared_ptr<const std::wregex> CompileRegex(EditorState* editor_state,
+                                                const wstring& pattern) {
+  try {
+    return std::make_shared<std::wregex>(pattern);
+  } catch (const std::regex_error& error) {
+    editor_state->SetWarningStatus(L"Invalid regular expression: " + pattern +
+                                   L": " + FromByteString(error.what()));
+    return nullptr;
+  }
+}
 }  // namespace
 
 using namespace afc::vm;
 using std::to_wstring;
 
+namespace {
+size_t NextBufferId() {
+  static std::atomic<size_t> next_id(0);
+  return next_id++;
+}
+}  // namespace
+
 /* static */ const wstring OpenBuffer::kBuffersName = L"- buffers";
 /* static */ const wstring OpenBuffer::kPasteBuffer = L"- paste buffer";
 
@@ -134,7 +189,8 @@ void OpenBuffer::EvaluateMap(EditorState* editor, OpenBuffer* buffer,
                              TransformationStack* transformation,
                              Trampoline* trampoline) {
   if (line + 1 >= buffer->contents()->size()) {
-    buffer->Apply(editor, std::unique_ptr<Transformation>(transformation));
+    buffer->ApplyToLastUndoEntry(
+        std::unique_ptr<Transformation>(transformation));
     trampoline->Return(Value::NewVoid());
     return;
   }
@@ -152,13 +208,14 @@ void OpenBuffer::EvaluateMap(EditorState* editor, OpenBuffer* buffer,
   Evaluate(map_line.get(), trampoline->environment(),
            [editor, buffer, line, map_callback, transformation, trampoline,
             current_line, map_line](Value::Ptr value) {
-             if (value->str != current_line) {
+             if (value->str() != current_line) {
                DeleteOptions options;
                options.copy_to_paste_buffer = false;
                transformation->PushBack(NewDeleteLinesTransformation(options));
                auto buffer_to_insert =
                    std::make_shared<OpenBuffer>(editor, L"tmp buffer");
-               buffer_to_insert->AppendLine(editor, NewCopyString(value->str));
+               buffer_to_insert->AppendLine(editor,
+                                            NewCopyString(value->str()));
                transformation->PushBack(
                    NewInsertBufferTransformation(buffer_to_insert, 1, END));
              }
@@ -189,6 +246,12 @@ void OpenBuffer::EvaluateMap(EditorState* editor, OpenBuffer* buffer,
       vm::NewCallback(std::function<int(OpenBuffer*)>(
           [](OpenBuffer* buffer) { return int(buffer->contents()->size()); })));
 
+  buffer->AddField(L"undo_memory_usage",
+                   vm::NewCallback(std::function<int(OpenBuffer*)>(
+                       [](OpenBuffer* buffer) {
+                         return int(buffer->undo_memory_usage());
+                       })));
+
   buffer->AddField(L"set_position",
                    vm::NewCallback(std::function<void(OpenBuffer*, LineColumn)>(
                        [](OpenBuffer* buffer, LineColumn position) {
@@ -218,12 +281,91 @@ void OpenBuffer::EvaluateMap(EditorState* editor, OpenBuffer* buffer,
                     CHECK_EQ(args[0]->type, VMType::OBJECT_TYPE);
                     EvaluateMap(
                         editor_state,
-                        static_cast<OpenBuffer*>(args[0]->user_value.get()), 0,
-                        args[1]->callback,
+                        static_cast<OpenBuffer*>(args[0]->user_value().get()),
+                        0, args[1]->callback(),
                         std::make_unique<TransformationStack>().release(),
                         evaluation);
                   }));
 
+  // Bulk operations over a range of lines (see NewMapLinesTransformation).
+  // Those based on regular expressions run in parallel.
+  buffer->AddField(
+      L"MapLines",
+      Value::NewFunction(
+          {VMType::Void(), VMType::ObjectType(buffer.get()), VMType::Integer(),
+           VMType::Integer(),
+           VMType::Function({VMType::String(), VMType::String()})},
+          [](vector<Value::Ptr> args) {
+            CHECK_EQ(args.size(), 4u);
+            std::shared_ptr<Value> callback = std::move(args[3]);
+            MapLines(args,
+                     [callback](wstring* line) {
+                       auto value = CallOnLine(callback.get(), *line);
+                       if (value != nullptr) {
+                         *line = value->str();
+                       }
+                       return true;
+                     },
+                     false);
+            return Value::NewVoid();
+          }));
+
+  buffer->AddField(
+      L"KeepLines",
+      Value::NewFunction(
+          {VMType::Void(), VMType::ObjectType(buffer.get()), VMType::Integer(),
+           VMType::Integer(),
+           VMType::Function({VMType::Bool(), VMType::String()})},
+          [](vector<Value::Ptr> args) {
+            CHECK_EQ(args.size(), 4u);
+            std::shared_ptr<Value> callback = std::move(args[3]);
+            MapLines(args,
+                     [callback](wstring* line) {
+                       auto value = CallOnLine(callback.get(), *line);
+                       return value == nullptr || value->boolean();
+                     },
+                     false);
+            return Value::NewVoid();
+          }));
+
+  buffer->AddField(
+      L"KeepLinesMatching",
+      Value::NewFunction(
+          {VMType::Void(), VMType::ObjectType(buffer.get()), VMType::Integer(),
+           VMType::Integer(), VMType::String()},
+          [editor_state](vector<Value::Ptr> args) {
+            CHECK_EQ(args.size(), 4u);
+            auto regex = CompileRegex(editor_state, args[3]->str());
+            if (regex != nullptr) {
+              MapLines(args,
+                       [regex](wstring* line) {
+                         return std::regex_search(*line, *regex);
+                       },
+                       true);
+            }
+            return Value::NewVoid();
+          }));
+
+  buffer->AddField(
+      L"ReplaceRegex",
+      Value::NewFunction(
+          {VMType::Void(), VMType::ObjectType(buffer.get()), VMType::Integer(),
+           VMType::Integer(), VMType::String(), VMType::String()},
+          [editor_state](vector<Value::Ptr> args) {
+            CHECK_EQ(args.size(), 5u);
+            auto regex = CompileRegex(editor_state, args[3]->str());
+            if (regex != nullptr) {
+              wstring replacement = args[4]->str();
+              MapLines(args,
+                       [regex, replacement](wstring* line) {
+                         *line = std::regex_replace(*line, *regex, replacement);
+                         return true;
+                       },
+                       true);
+            }
+            return Value::NewVoid();
+          }));
+
   buffer->AddField(
       L"GetRegion",
       Value::NewFunction(
@@ -235,10 +377,10 @@ void OpenBuffer::EvaluateMap(EditorState* editor, OpenBuffer* buffer,
             CHECK_EQ(args[1]->type, VMType::VM_STRING);
             // TODO: Don't ignore the buffer! Apply it to it!
             // auto buffer =
-            // static_cast<OpenBuffer*>(args[0]->user_value.get());
+            // static_cast<OpenBuffer*>(args[0]->user_value().get());
             auto resume = trampoline->Interrupt();
             NewCommandWithModifiers(
-                args[1]->str, L"Selects a region",
+                args[1]->str(), L"Selects a region",
                 [resume](EditorState*, OpenBuffer* buffer,
                          CommandApplyMode mode, Modifiers modifiers) {
                   // TODO: Apply this to all cursors. That's tricky, because we
@@ -275,7 +417,8 @@ void OpenBuffer::EvaluateMap(EditorState* editor, OpenBuffer* buffer,
           [editor_state](vector<unique_ptr<Value>> args) {
             CHECK_EQ(args.size(), size_t(2));
             CHECK_EQ(args[0]->type, VMType::OBJECT_TYPE);
-            auto buffer = static_cast<OpenBuffer*>(args[0]->user_value.get());
+            auto buffer =
+                static_cast<OpenBuffer*>(args[0]->user_value().get());
             CHECK(buffer != nullptr);
             return Value::NewBool(buffer->AddKeyboardTextTransformer(
                 editor_state, std::move(args[1])));
@@ -288,14 +431,40 @@ void OpenBuffer::EvaluateMap(EditorState* editor, OpenBuffer* buffer,
                      [editor_state](vector<unique_ptr<Value>> args) {
                        CHECK_EQ(args.size(), size_t(2));
                        CHECK_EQ(args[0]->type, VMType::OBJECT_TYPE);
-                       auto buffer =
-                           static_cast<OpenBuffer*>(args[0]->user_value.get());
+                       auto buffer = static_cast<OpenBuffer*>(
+                           args[0]->user_value().get());
                        CHECK(buffer != nullptr);
                        buffer->set_filter(std::move(args[1]));
                        editor_state->ScheduleRedraw();
                        return Value::NewVoid();
                      }));
 
+  buffer->AddField(
+      L"FilterRegex",
+      Value::NewFunction(
+          {VMType::Void(), VMType::ObjectType(buffer.get()), VMType::String()},
+          [editor_state](vector<Value::Ptr> args) {
+            CHECK_EQ(args.size(), 2u);
+            auto buffer = static_cast<OpenBuffer*>(args[0]->user_value().get());
+            CHECK(buffer != nullptr);
+            auto regex = CompileRegex(editor_state, args[1]->str());
+            if (regex != nullptr) {
+              buffer->set_native_filter([regex](const wstring& line) {
+                return std::regex_search(line, *regex);
+              });
+              editor_state->ScheduleRedraw();
+            }
+            return Value::NewVoid();
+          }));
+
+  buffer->AddField(
+      L"ClearFilter",
+      vm::NewCallback(std::function<void(OpenBuffer*)>(
+          [editor_state](OpenBuffer* buffer) {
+            buffer->set_filter(nullptr);
+            editor_state->ScheduleRedraw();
+          })));
+
   buffer->AddField(
       L"DeleteCharacters",
       vm::NewCallback(std::function<void(OpenBuffer*, int)>(
@@ -358,9 +527,10 @@ void OpenBuffer::EvaluateMap(EditorState* editor, OpenBuffer* buffer,
             CHECK_EQ(args.size(), 3u);
             CHECK_EQ(args[0]->type, VMType::OBJECT_TYPE);
             CHECK_EQ(args[1]->type, VMType::VM_STRING);
-            auto buffer = static_cast<OpenBuffer*>(args[0]->user_value.get());
+            auto buffer =
+                static_cast<OpenBuffer*>(args[0]->user_value().get());
             CHECK(buffer != nullptr);
-            buffer->default_commands_->Add(args[1]->str, std::move(args[2]),
+            buffer->default_commands_->Add(args[1]->str(), std::move(args[2]),
                                            &buffer->environment_);
             return Value::NewVoid();
           }));
@@ -413,6 +583,7 @@ void OpenBuffer::BackgroundThread() {
     CHECK(contents_to_parse_ == nullptr);
     auto parser = tree_parser_;
     size_t lines_for_zoomed_out_tree = lines_for_zoomed_out_tree_;
+    wstring word_characters = word_characters_to_parse_;
     lock.unlock();
 
     if (contents == nullptr) {
@@ -433,7 +604,15 @@ void OpenBuffer::BackgroundThread() {
           *simplified_parse_tree, contents->size(), lines_for_zoomed_out_tree));
     }
 
+    auto words =
+        BufferWordsIndex::CountWords(*contents, *parse_tree, word_characters);
+
     std::unique_lock<std::mutex> final_lock(mutex_);
+    // If the parser was disabled while we were parsing, ResetParseTree has
+    // already removed the buffer from the index.
+    if (!TreeParser::IsNull(tree_parser_.get())) {
+      editor_->buffer_words_index()->Update(id_, std::move(words));
+    }
     parse_tree_ = parse_tree;
     simplified_parse_tree_ = simplified_parse_tree;
     zoomed_out_tree_ = zoomed_out_tree;
@@ -447,6 +626,7 @@ void OpenBuffer::BackgroundThread() {
 OpenBuffer::OpenBuffer(EditorState* editor_state, const wstring& name)
     : editor_(editor_state),
       name_(name),
+      id_(NextBufferId()),
       child_pid_(-1),
       child_exit_status_(0),
       position_pts_(LineColumn(0, 0)),
@@ -457,7 +637,6 @@ OpenBuffer::OpenBuffer(EditorState* editor_state, const wstring& name)
       int_variables_(buffer_variables::IntStruct()->NewInstance()),
       double_variables_(buffer_variables::DoubleStruct()->NewInstance()),
       environment_(editor_state->environment()),
-      filter_version_(0),
       last_transformation_(NewNoopTransformation()),
       parse_tree_(std::make_shared<ParseTree>()),
       tree_parser_(NewNullTreeParser()),
@@ -470,6 +649,10 @@ OpenBuffer::OpenBuffer(EditorState* editor_state, const wstring& name)
         time(&last_action_);
         cursors_tracker_.AdjustCursors(transformation);
       });
+  contents_.AddLinesListener(
+      [this](size_t first, size_t old_count, size_t new_count) {
+        filter_.LinesReplaced(first, old_count, new_count);
+      });
   UpdateTreeParser();
 
   environment_.Define(
@@ -492,6 +675,7 @@ OpenBuffer::~OpenBuffer() {
   LOG(INFO) << "Buffer deleted: " << name_;
   editor_->UnscheduleParseTreeUpdate(this);
   DestroyThreadIf([]() { return true; });
+  editor_->buffer_words_index()->RemoveBuffer(id_);
 }
 
 bool OpenBuffer::PrepareToClose(EditorState* editor_state) {
@@ -556,6 +740,8 @@ bool OpenBuffer::PersistState() const { return true; }
 
 void OpenBuffer::ClearContents(EditorState* editor_state) {
   VLOG(5) << "Clear contents of buffer: " << name_;
+  editor_state->line_marks_resolver()->Cancel(name_);
+  lines_to_resolve_.clear();
   editor_state->line_marks()->RemoveExpiredMarksFromSource(name_);
   editor_state->line_marks()->ExpireMarksFromSource(*this, name_);
   editor_state->ScheduleRedraw();
@@ -563,8 +749,8 @@ void OpenBuffer::ClearContents(EditorState* editor_state) {
   position_pts_ = LineColumn();
   last_transformation_ = NewNoopTransformation();
   last_transformation_stack_.clear();
-  transformations_past_.clear();
-  transformations_future_.clear();
+  undo_history_.Clear(UndoHistory::PAST);
+  undo_history_.Clear(UndoHistory::FUTURE);
   AppendEmptyLine(editor_state);
 }
 
@@ -585,9 +771,13 @@ void OpenBuffer::EndOfFile(EditorState* editor_state) {
     }
   }
 
-  // We can remove expired marks now. We know that the set of fresh marks is now
-  // complete.
-  editor_state->line_marks()->RemoveExpiredMarksFromSource(name_);
+  // We can remove expired marks once the set of fresh marks is complete (which,
+  // if lines are still being resolved, will only happen later).
+  if (Read(buffer_variables::contains_line_marks())) {
+    editor_state->line_marks_resolver()->EndOfSource(name_);
+  } else {
+    editor_state->line_marks()->RemoveExpiredMarksFromSource(name_);
+  }
   editor_state->ScheduleRedraw();
 
   child_pid_ = -1;
@@ -610,11 +800,7 @@ void OpenBuffer::EndOfFile(EditorState* editor_state) {
       editor_state->CloseBuffer(it);
     }
   }
-
-  if (editor_state->has_current_buffer() &&
-      editor_state->current_buffer()->first == kBuffersName) {
-    editor_state->current_buffer()->second->Reload(editor_state);
-  }
+  editor_state->ScheduleRedraw();
 }
 
 void OpenBuffer::MaybeFollowToEndOfFile() {
@@ -775,14 +961,13 @@ void OpenBuffer::Input::ReadData(EditorState* editor_state,
       target->AppendToLastLine(editor_state, line,
                                ModifiersVector(modifiers, line->size()));
     }
+    target->ResolveLineMarks(editor_state);
   }
   if (!previous_modified) {
     target->ClearModified();  // These changes don't count.
   }
-  if (editor_state->has_current_buffer() &&
-      editor_state->current_buffer()->first == kBuffersName) {
-    editor_state->current_buffer()->second->Reload(editor_state);
-  }
+  // If the list of buffers is shown, it will be refreshed when the screen is
+  // redrawn (it's reloaded on display).
   editor_state->ScheduleRedraw();
 }
 
@@ -823,9 +1008,13 @@ void OpenBuffer::ResetParseTree() {
   {
     std::unique_lock<std::mutex> lock(mutex_);
     if (TreeParser::IsNull(tree_parser_.get())) {
+      // Under mutex_, so that a parse that is finishing in the background
+      // thread doesn't add the buffer back (see BackgroundThread).
+      editor_->buffer_words_index()->RemoveBuffer(id_);
       return;
     }
     contents_to_parse_ = contents_.copy();
+    word_characters_to_parse_ = Read(buffer_variables::word_characters());
   }
 
   {
@@ -862,29 +1051,26 @@ void OpenBuffer::StartNewLine(EditorState* editor_state) {
     DVLOG(5) << "Line is completed: " << contents_.back()->ToString();
 
     if (Read(buffer_variables::contains_line_marks())) {
-      wstring path;
-      LineColumn position;
-      wstring pattern;
-      ResolvePathOptions options;
-      options.editor_state = editor_state;
-      options.path = contents_.back()->ToString();
-      options.output_path = &path;
-      options.output_position = &position;
-      options.output_pattern = &pattern;
-      if (ResolvePath(options)) {
-        LineMarks::Mark mark;
-        mark.source = name_;
-        mark.source_line = contents_.size() - 1;
-        mark.target_buffer = path;
-        mark.target = position;
-        LOG(INFO) << "Found a mark: " << mark;
-        editor_state->line_marks()->AddMark(mark);
-      }
+      lines_to_resolve_.push_back(
+          {contents_.size() - 1,
+           editor_state->expand_path(contents_.back()->ToString())});
     }
   }
   contents_.push_back(std::make_shared<Line>());
 }
 
+void OpenBuffer::ResolveLineMarks(EditorState* editor_state) {
+  if (lines_to_resolve_.empty()) {
+    return;
+  }
+  // The search paths are read once for all the lines.
+  vector<wstring> search_paths;
+  GetSearchPaths(editor_state, &search_paths);
+  editor_state->line_marks_resolver()->Resolve(
+      name_, std::move(search_paths), std::move(lines_to_resolve_));
+  lines_to_resolve_.clear();
+}
+
 void OpenBuffer::Reload(EditorState* editor_state) {
   if (child_pid_ != -1) {
     LOG(INFO) << "Sending SIGTERM.";
@@ -954,6 +1140,12 @@ void OpenBuffer::InsertLine(size_t line_position, shared_ptr<Line> line) {
   contents_.insert_line(line_position, line);
 }
 
+void OpenBuffer::ReplaceLines(size_t first, size_t count,
+                              const vector<shared_ptr<const Line>>& lines) {
+  contents_.ReplaceLines(first, count, lines);
+  CHECK_LE(position().line, lines_size());
+}
+
 void OpenBuffer::AppendLine(EditorState* editor_state,
                             shared_ptr<LazyString> str) {
   CHECK(str != nullptr);
@@ -1317,7 +1509,8 @@ bool OpenBuffer::EvaluateFile(EditorState* editor_state, const wstring& path) {
   wstring error_description;
   // TODO: Use unique_ptr and capture by value.
   std::shared_ptr<Expression> expression =
-      CompileFile(ToByteString(path), &environment_, &error_description);
+      editor_state->compilation_cache()->CompileFile(
+          ToByteString(path), &environment_, &error_description);
   if (expression == nullptr) {
     editor_state->SetStatus(path + L": error: " + error_description);
     return false;
@@ -1848,7 +2041,7 @@ std::shared_ptr<OpenBuffer> OpenBuffer::GetBufferFromCurrentLine() {
       target->type.object_type != L"Buffer") {
     return nullptr;
   }
-  return std::static_pointer_cast<OpenBuffer>(target->user_value);
+  return std::static_pointer_cast<OpenBuffer>(target->user_value());
 }
 
 wstring OpenBuffer::ToString() const { return contents_.ToString(); }
@@ -1885,7 +2078,7 @@ wstring OpenBuffer::TransformKeyboardText(wstring input) {
     vector<Value::Ptr> args;
     args.push_back(Value::NewString(std::move(input)));
     Call(t.get(), std::move(args),
-         [&input](Value::Ptr value) { input = std::move(value->str); });
+         [&input](Value::Ptr value) { input = std::move(value->str()); });
   }
   return input;
 }
@@ -1911,6 +2104,7 @@ void OpenBuffer::Input::Reset() {
 }
 
 void OpenBuffer::Input::Close() {
+  registration = nullptr;
   if (fd != -1) {
     close(fd);
     fd = -1;
@@ -1929,15 +2123,30 @@ void OpenBuffer::SetInputFiles(EditorState* editor_state, int input_fd,
 
   fd_.Close();
   fd_.fd = input_fd;
+  if (fd_.fd != -1) {
+    fd_.registration = editor_state->event_loop()->Register(
+        fd_.fd, [this, editor_state]() {
+          LOG(INFO) << "Reading (normal): " << name_;
+          ReadData(editor_state);
+        });
+  }
 
   fd_error_.Close();
   fd_error_.fd = input_error_fd;
   fd_error_.modifiers.clear();
   fd_error_.modifiers.insert(LineModifier::RED);
+  if (fd_error_.fd != -1) {
+    fd_error_.registration = editor_state->event_loop()->Register(
+        fd_error_.fd, [this, editor_state]() {
+          LOG(INFO) << "Reading (error): " << name_;
+          ReadErrorData(editor_state);
+        });
+  }
 
   CHECK_EQ(child_pid_, -1);
   fd_is_terminal_ = fd_is_terminal;
   child_pid_ = child_pid;
+  editor_state->ScheduleProgressRedraw();
 }
 
 size_t OpenBuffer::current_position_line() const { return position().line; }
@@ -2057,6 +2266,21 @@ void OpenBuffer::ApplyToCursors(unique_ptr<Transformation> transformation) {
 
 void OpenBuffer::ApplyToCursors(unique_ptr<Transformation> transformation,
                                 Modifiers::CursorsAffected cursors_affected) {
+  ApplyAndRecordUndo(std::move(transformation), cursors_affected);
+}
+
+void OpenBuffer::ApplyKeystroke(unique_ptr<Transformation> transformation) {
+  if (ApplyAndRecordUndo(std::move(transformation),
+                         Read(buffer_variables::multiple_cursors())
+                             ? Modifiers::AFFECT_ALL_CURSORS
+                             : Modifiers::AFFECT_ONLY_CURRENT_CURSOR)) {
+    undo_history_.CoalesceKeystroke(position());
+  }
+}
+
+bool OpenBuffer::ApplyAndRecordUndo(
+    unique_ptr<Transformation> transformation,
+    Modifiers::CursorsAffected cursors_affected) {
   CHECK(transformation != nullptr);
 
   if (!last_transformation_stack_.empty()) {
@@ -2064,52 +2288,78 @@ void OpenBuffer::ApplyToCursors(unique_ptr<Transformation> transformation,
     last_transformation_stack_.back()->PushBack(transformation->Clone());
   }
 
-  transformations_past_.push_back(
-      std::make_unique<Transformation::Result>(editor_));
-
-  transformations_past_.back()->undo_stack->PushFront(
-      NewSetCursorsTransformation(*active_cursors(), position()));
+  UndoEntry undo_entry = NewUndoEntry();
+  // Nested applications (from within a transformation) are recorded as part of
+  // the outer one.
+  auto outer_deltas = contents_.RecordDeltas(nullptr);
+  contents_.RecordDeltas(outer_deltas != nullptr ? outer_deltas
+                                                 : &undo_entry.deltas);
 
+  Transformation::Result result(editor_);
   for (auto& position : *active_cursors()) {
     CHECK_LE(position.line, contents_.size());
   }
 
   if (cursors_affected == Modifiers::AFFECT_ALL_CURSORS) {
-    CursorsSet single_cursor;
     CursorsSet* cursors = active_cursors();
     CHECK(cursors != nullptr);
     cursors_tracker_.ApplyTransformationToCursors(
-        cursors, [this, &transformation](LineColumn old_position) {
-          transformations_past_.back()->cursor = old_position;
-          auto new_position = Apply(editor_, transformation->Clone());
+        cursors, [this, &transformation, &result](LineColumn old_position) {
+          result.cursor = old_position;
+          auto new_position = Apply(editor_, transformation->Clone(), &result);
           CHECK_LE(new_position.line, contents_.size());
           return new_position;
         });
     CHECK_LE(position().line, lines_size());
   } else {
-    transformations_past_.back()->cursor = position();
-    auto new_position = Apply(editor_, transformation->Clone());
+    result.cursor = position();
+    auto new_position = Apply(editor_, transformation->Clone(), &result);
     VLOG(6) << "Adjusting default cursor (!multiple_cursors).";
     cursors_tracker_.MoveCurrentCursor(active_cursors(), new_position);
     CHECK_LE(position().line, lines_size());
   }
 
-  transformations_future_.clear();
-  if (transformations_past_.back()->modified_buffer) {
+  contents_.RecordDeltas(outer_deltas);
+  if (outer_deltas == nullptr) {
+    undo_entry.modified_buffer = result.modified_buffer;
+    undo_history_.Clear(UndoHistory::FUTURE);
+    SetUndoMemoryLimit();
+    undo_history_.Push(UndoHistory::PAST, std::move(undo_entry));
+  }
+  if (result.modified_buffer) {
     editor_->StartHandlingInterrupts();
     last_transformation_ = std::move(transformation);
   }
+  return outer_deltas == nullptr;
+}
+
+void OpenBuffer::ApplyToLastUndoEntry(
+    unique_ptr<Transformation> transformation) {
+  CHECK(transformation != nullptr);
+  UndoEntry undo_entry = NewUndoEntry();
+  auto outer_deltas = contents_.RecordDeltas(nullptr);
+  contents_.RecordDeltas(outer_deltas != nullptr ? outer_deltas
+                                                 : &undo_entry.deltas);
+  Transformation::Result result(editor_);
+  result.cursor = position();
+  Apply(editor_, std::move(transformation), &result);
+  contents_.RecordDeltas(outer_deltas);
+  if (outer_deltas == nullptr && !undo_entry.deltas.empty()) {
+    undo_entry.modified_buffer = result.modified_buffer;
+    SetUndoMemoryLimit();
+    undo_history_.MergeIntoLast(std::move(undo_entry));
+  }
 }
 
 LineColumn OpenBuffer::Apply(EditorState* editor_state,
-                             unique_ptr<Transformation> transformation) {
+                             unique_ptr<Transformation> transformation,
+                             Transformation::Result* result) {
   CHECK(transformation != nullptr);
-  CHECK(!transformations_past_.empty());
+  CHECK(result != nullptr);
 
-  transformation->Apply(editor_state, this, transformations_past_.back().get());
-  CHECK(!transformations_past_.empty());
+  transformation->Apply(editor_state, this, result);
 
-  auto delete_buffer = transformations_past_.back()->delete_buffer;
+  auto delete_buffer = result->delete_buffer;
   CHECK(delete_buffer != nullptr);
   if ((delete_buffer->contents()->size() > 1 ||
        delete_buffer->LineAt(0)->size() > 0) &&
@@ -2121,7 +2371,45 @@ LineColumn OpenBuffer::Apply(EditorState* editor_state,
     }
   }
 
-  return transformations_past_.back()->cursor;
+  return result->cursor;
+}
+
+UndoEntry OpenBuffer::NewUndoEntry() {
+  UndoEntry entry;
+  entry.active_cursor = position();
+  auto cursors = active_cursors();
+  if (cursors->size() > 1) {
+    if (last_cursors_snapshot_ == nullptr ||
+        last_cursors_snapshot_->size() != cursors->size() ||
+        !std::equal(cursors->begin(), cursors->end(),
+                    last_cursors_snapshot_->begin())) {
+      last_cursors_snapshot_ = std::make_shared<std::vector<LineColumn>>(
+          cursors->begin(), cursors->end());
+    }
+    entry.cursors = last_cursors_snapshot_;
+  }
+  return entry;
+}
+
+void OpenBuffer::RestoreCursors(const UndoEntry& entry) {
+  vector<LineColumn> positions = {entry.active_cursor};
+  if (entry.cursors != nullptr) {
+    bool skipped = false;
+    for (auto& cursor : *entry.cursors) {
+      if (!skipped && cursor == entry.active_cursor) {
+        skipped = true;
+      } else {
+        positions.push_back(cursor);
+      }
+    }
+  }
+  set_active_cursors(positions);
+}
+
+void OpenBuffer::SetUndoMemoryLimit() {
+  undo_history_.set_memory_limit(
+      static_cast<size_t>(max(0, Read(buffer_variables::undo_memory_limit()))) *
+      1024);
 }
 
 void OpenBuffer::RepeatLastTransformation() {
@@ -2149,84 +2437,121 @@ void OpenBuffer::Undo(EditorState* editor_state) {
 };
 
 void OpenBuffer::Undo(EditorState* editor_state, UndoMode undo_mode) {
-  list<unique_ptr<Transformation::Result>>* source;
-  list<unique_ptr<Transformation::Result>>* target;
+  UndoHistory::Stack source;
+  UndoHistory::Stack target;
   if (editor_state->direction() == FORWARDS) {
-    source = &transformations_past_;
-    target = &transformations_future_;
+    source = UndoHistory::PAST;
+    target = UndoHistory::FUTURE;
   } else {
-    source = &transformations_future_;
-    target = &transformations_past_;
+    source = UndoHistory::FUTURE;
+    target = UndoHistory::PAST;
   }
+  SetUndoMemoryLimit();
   for (size_t i = 0; i < editor_state->repetitions(); i++) {
     bool modified_buffer = false;
-    while (!modified_buffer && !source->empty()) {
-      target->emplace_back(
-          std::make_unique<Transformation::Result>(editor_state));
-      source->back()->undo_stack->Apply(editor_state, this,
-                                        target->back().get());
-      source->pop_back();
+    while (!modified_buffer && HasUndoEntries(source)) {
+      UndoEntry entry = undo_history_.Pop(source);
+      // Reverting the deltas records the deltas to redo them.
+      UndoEntry redo_entry = NewUndoEntry();
+      redo_entry.modified_buffer = entry.modified_buffer;
+      auto outer_deltas = contents_.RecordDeltas(&redo_entry.deltas);
+      bool reverted = true;
+      for (auto it = entry.deltas.rbegin();
+           reverted && it != entry.deltas.rend(); ++it) {
+        reverted = contents_.RevertDelta(*it);
+      }
+      if (!reverted) {
+        // Restore the lines already reverted, so that the entry still applies
+        // to the contents, and keep it.
+        contents_.RecordDeltas(nullptr);
+        for (auto it = redo_entry.deltas.rbegin();
+             it != redo_entry.deltas.rend(); ++it) {
+          CHECK(contents_.RevertDelta(*it));
+        }
+        contents_.RecordDeltas(outer_deltas);
+        undo_history_.Push(source, std::move(entry));
+        editor_state->SetWarningStatus(
+            L"Unable to undo: the undo history doesn't match the buffer.");
+        return;
+      }
+      contents_.RecordDeltas(outer_deltas);
+      RestoreCursors(entry);
+      undo_history_.Push(target, std::move(redo_entry));
       modified_buffer =
-          target->back()->modified_buffer || undo_mode == ONLY_UNDO_THE_LAST;
+          entry.modified_buffer || undo_mode == ONLY_UNDO_THE_LAST;
     }
-    if (source->empty()) {
+    if (undo_history_.empty(source)) {
       return;
     }
   }
 }
 
-void OpenBuffer::set_filter(unique_ptr<Value> filter) {
-  filter_ = std::move(filter);
-  filter_version_++;
+void OpenBuffer::SetUndoJournal(std::unique_ptr<UndoJournal> journal) {
+  undo_history_.set_journal(std::move(journal));
+  SetUndoMemoryLimit();
 }
 
-bool OpenBuffer::IsLineFiltered(size_t line_number) {
-  if (line_number >= contents_.size()) {
+void OpenBuffer::UndoJournalSaved() {
+  if (undo_history_.journal() != nullptr) {
+    undo_history_.journal()->Saved(ContentsChecksum(contents_));
+  }
+}
+
+bool OpenBuffer::HasUndoEntries(UndoHistory::Stack stack) {
+  if (!undo_history_.empty(stack)) {
     return true;
   }
-  const auto& old_line = *LineAt(line_number);
-  if (old_line.filter_version() >= filter_version_) {
-    return old_line.filtered();
+  // The journal can't be matched against the contents until they have been
+  // read completely; we'll try again on the next attempt.
+  if (stack != UndoHistory::PAST || fd_.fd != -1 || fd_error_.fd != -1 ||
+      !undo_history_.LoadJournal(ContentsChecksum(contents_))) {
+    return false;
   }
+  editor_->SetStatus(L"Undo history loaded from journal: " +
+                     std::to_wstring(undo_history_.size(stack)) + L" entries.");
+  return true;
+}
 
-  bool filtered;
-  vector<Value::Ptr> args;
-  args.push_back(Value::NewString(old_line.ToString()));
-  Call(filter_.get(), std::move(args),
-       [&filtered](Value::Ptr value) { filtered = value->boolean; });
+void OpenBuffer::set_filter(unique_ptr<Value> filter) {
+  if (filter == nullptr) {
+    filter_.Clear();
+    return;
+  }
+  std::shared_ptr<Value> function = std::move(filter);
+  filter_.Set(
+      [function](const wstring& line) {
+        bool shown = false;
+        vector<Value::Ptr> args;
+        args.push_back(Value::NewString(line));
+        Call(function.get(), std::move(args),
+             [&shown](Value::Ptr value) { shown = value->boolean(); });
+        return shown;
+      },
+      false);
+}
 
-  auto new_line = std::make_shared<Line>(old_line);
-  new_line->set_filtered(filtered, filter_version_);
-  contents_.set_line(line_number, new_line);
-  return filtered;
+void OpenBuffer::set_native_filter(LineFilter::Predicate predicate) {
+  filter_.Set(std::move(predicate), true);
+}
+
+bool OpenBuffer::IsLineFiltered(size_t line_number) {
+  if (line_number >= contents_.size()) {
+    return true;
+  }
+  return filter_.IsShown(contents_, line_number);
 }
 
 const multimap<size_t, LineMarks::Mark>* OpenBuffer::GetLineMarks(
     const EditorState& editor_state) const {
-  auto marks = editor_state.line_marks();
-  if (marks->updates > line_marks_last_updates_) {
-    LOG(INFO) << name_ << ": Updating marks.";
-    line_marks_.clear();
-    auto relevant_marks = marks->GetMarksForTargetBuffer(name_);
-    for (auto& mark : relevant_marks) {
-      line_marks_.insert(make_pair(mark.target.line, mark));
-    }
-    line_marks_last_updates_ = marks->updates;
-  }
-  VLOG(10) << "Returning multimap with size: " << line_marks_.size();
-  return &line_marks_;
+  return &editor_state.line_marks()->GetMarksForTargetBuffer(name_);
 }
 
 wstring OpenBuffer::GetLineMarksText(const EditorState& editor_state) const {
   const auto* marks = GetLineMarks(editor_state);
   wstring output;
   if (!marks->empty()) {
-    size_t expired_marks = 0;
-    for (const auto& mark : *marks) {
-      if (mark.second.IsExpired()) {
-        expired_marks++;
-      }
-    }
+    size_t expired_marks =
+        editor_state.line_marks()->GetExpiredMarksCount(name_);
     CHECK_LE(expired_marks, marks->size());
     output = L"marks:" + to_wstring(marks->size() - expired_marks);
     if (expired_marks > 0) {
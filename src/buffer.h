@@ -13,15 +13,19 @@
 
 #include "buffer_contents.h"
 #include "cursors.h"
+#include "event_loop.h"
 #include "lazy_string.h"
 #include "line.h"
 #include "line_column.h"
+#include "line_filter.h"
 #include "line_marks.h"
+#include "line_marks_resolver.h"
 #include "map_mode.h"
 #include "parse_tree.h"
 #include "substring.h"
 #include "transformation.h"
 #include "tree.h"
+#include "undo_history.h"
 #include "variables.h"
 #include "vm/public/environment.h"
 #include "vm/public/value.h"
@@ -82,7 +86,7 @@ class OpenBuffer {
   virtual bool ShouldDisplayProgress() const;
   void RegisterProgress();
 
-  void ReadData(EditorState* editor_state);
+  virtual void ReadData(EditorState* editor_state);
   void ReadErrorData(EditorState* editor_state);
 
   void Reload(EditorState* editor_state);
@@ -116,6 +120,10 @@ class OpenBuffer {
   // Inserts a new line into the buffer at a given position.
   void InsertLine(size_t line_position, shared_ptr<Line> line);
 
+  // Replaces the count lines starting at first with lines.
+  void ReplaceLines(size_t first, size_t count,
+                    const vector<shared_ptr<const Line>>& lines);
+
   void AppendLazyString(EditorState* editor_state,
                         shared_ptr<LazyString> input);
   void AppendLine(EditorState* editor_state, shared_ptr<LazyString> line);
@@ -143,6 +151,9 @@ class OpenBuffer {
   bool EvaluateFile(EditorState* editor_state, const wstring& path);
 
   const wstring& name() const { return name_; }
+  // Unique among all the buffers created by the process (never reused, even
+  // after the buffer is deleted). Unlike the name, never changes.
+  size_t id() const { return id_; }
 
   void DeleteRange(const Range& range);
 
@@ -174,7 +185,7 @@ class OpenBuffer {
   void PushActiveCursors();
   void PopActiveCursors();
   // Replaces the set of active cursors with one cursor in every position with
-  // a mark (based on line_marks_).
+  // a mark (based on GetLineMarks).
   void SetActiveCursorsToMarks();
 
   void set_current_cursor(CursorsSet::value_type new_cursor);
@@ -353,6 +364,9 @@ class OpenBuffer {
   void ApplyToCursors(unique_ptr<Transformation> transformation);
   void ApplyToCursors(unique_ptr<Transformation> transformation,
                       Modifiers::CursorsAffected cursors_affected);
+  // Like ApplyToCursors, for the transformations produced by keystrokes in
+  // insert mode: consecutive keystrokes are undone together.
+  void ApplyKeystroke(unique_ptr<Transformation> transformation);
   void RepeatLastTransformation();
 
   void PushTransformationStack();
@@ -369,8 +383,20 @@ class OpenBuffer {
   };
   void Undo(EditorState* editor_state);
   void Undo(EditorState* editor_state, UndoMode undo_mode);
-
+  // Persists the undo history in journal (see UndoJournal). Should be called
+  // when the contents are (re)loaded from the file.
+  void SetUndoJournal(std::unique_ptr<UndoJournal> journal);
+  // Records in the undo journal (if any) that the contents were saved.
+  void UndoJournalSaved();
+  // Estimate of the memory (in bytes) retained by the undo history.
+  size_t undo_memory_usage() const { return undo_history_.memory_usage(); }
+
+  // Sets the filter: a VM function that receives a line and returns true if
+  // it should be shown. If filter is nullptr, all lines are shown.
   void set_filter(unique_ptr<Value> filter);
+  // Like set_filter, but with a native (thread-safe) predicate.
+  void set_native_filter(LineFilter::Predicate predicate);
+  // Returns true if the line should be shown (i.e., it passes the filter).
   bool IsLineFiltered(size_t line);
 
   pid_t child_pid() const { return child_pid_; }
@@ -382,7 +408,8 @@ class OpenBuffer {
   }
 
   // Returns a multimap with all the marks for the current buffer, indexed by
-  // the line they refer to. Each call may update the map.
+  // the line they refer to. The pointer is owned by the editor's LineMarks and
+  // is only valid until the next mark is added.
   const multimap<size_t, LineMarks::Mark>* GetLineMarks(
       const EditorState& editor_state) const;
   wstring GetLineMarksText(const EditorState& editor_state) const;
@@ -422,6 +449,7 @@ class OpenBuffer {
   EditorState* editor_;
 
   wstring name_;
+  const size_t id_;
 
   struct Input {
     void Close();
@@ -430,6 +458,8 @@ class OpenBuffer {
 
     // -1 means "no file descriptor" (i.e. not currently loading this).
     int fd = -1;
+    // Set while fd is registered in the event loop of the editor.
+    std::unique_ptr<EventLoop::Registration> registration;
 
     // We read directly into low_buffer_ and then drain from that into
     // contents_. It's possible that not all bytes read can be converted (for
@@ -471,20 +501,19 @@ class OpenBuffer {
   EdgeStructInstance<int> int_variables_;
   EdgeStructInstance<double> double_variables_;
 
-  // When a transformation is done, we append its result to
-  // transformations_past_, so that it can be undone.
-  list<unique_ptr<Transformation::Result>> transformations_past_;
-  list<unique_ptr<Transformation::Result>> transformations_future_;
+  // When a transformation is done, we record the changes it did to contents_
+  // (and the cursors before it) in undo_history_, so that it can be undone.
+  UndoHistory undo_history_;
+  // The last snapshot of multiple cursors taken for undo_history_, which we
+  // reuse while the cursors don't change.
+  std::shared_ptr<const std::vector<LineColumn>> last_cursors_snapshot_;
 
   list<unique_ptr<Value>> keyboard_text_transformers_;
   Environment environment_;
 
-  // A function that receives a string and returns a boolean. The function will
-  // be evaluated on every line, to compute whether or not the line should be
-  // shown.  This does not remove any lines: it merely hides them (by setting
-  // the Line::filtered field).
-  unique_ptr<Value> filter_;
-  size_t filter_version_;
+  // Computes whether or not each line should be shown. This does not remove
+  // any lines: it merely hides them.
+  LineFilter filter_;
 
  private:
   static void EvaluateMap(EditorState* editor, OpenBuffer* buffer, size_t line,
@@ -492,7 +521,23 @@ class OpenBuffer {
                           TransformationStack* transformation,
                           Trampoline* trampoline);
   LineColumn Apply(EditorState* editor_state,
-                   unique_ptr<Transformation> transformation);
+                   unique_ptr<Transformation> transformation,
+                   Transformation::Result* result);
+  // Implements ApplyToCursors. Returns true if it added an entry to the undo
+  // history (nested applications are recorded in the outer one instead).
+  bool ApplyAndRecordUndo(unique_ptr<Transformation> transformation,
+                          Modifiers::CursorsAffected cursors_affected);
+  // Applies transformation at the current position without adjusting the
+  // cursors, last_transformation_ or the FUTURE undo stack. Its changes are
+  // undone along with the last entry in the undo history.
+  void ApplyToLastUndoEntry(unique_ptr<Transformation> transformation);
+  // Returns an (empty) undo entry with the current cursors.
+  UndoEntry NewUndoEntry();
+  void RestoreCursors(const UndoEntry& entry);
+  void SetUndoMemoryLimit();
+  // Returns true if stack has entries, loading them from the undo journal if
+  // needed.
+  bool HasUndoEntries(UndoHistory::Stack stack);
   void BackgroundThread();
   // Destroys the background thread if it's running and if a given predicate
   // returns true. The predicate is evaluated with mutex_ held.
@@ -502,6 +547,8 @@ class OpenBuffer {
   // Adds a new line. If there's a previous line, notifies various things about
   // it.
   void StartNewLine(EditorState* editor_state);
+  // Hands the lines collected by StartNewLine to the line marks resolver.
+  void ResolveLineMarks(EditorState* editor_state);
   void ProcessCommandInput(EditorState* editor_state,
                            shared_ptr<LazyString> str);
 
@@ -514,6 +561,9 @@ class OpenBuffer {
   // value out (and reset it to null). Once it's done, it'll update the parse
   // tree.
   std::unique_ptr<const BufferContents> contents_to_parse_;
+  // The value of buffer_variables::word_characters when contents_to_parse_ was
+  // set, used to extract the words of the buffer from its parse tree.
+  wstring word_characters_to_parse_;
 
   unique_ptr<Transformation> last_transformation_;
 
@@ -529,18 +579,12 @@ class OpenBuffer {
   // was highlighted.
   size_t last_highlighted_line_ = 0;
 
-  // Index of the marks for the current buffer (i.e. Mark::target_buffer is the
-  // current buffer). The key is the line (i.e. Mark::line).
-  //
-  // mutable because GetLineMarks will always update it if needed.
-  mutable multimap<size_t, LineMarks::Mark> line_marks_;
-  // The value that EditorState::marks_::updates had when we last computed
-  // line_marks_. This allows us to avoid recomputing line_marks_ when no new
-  // marks have been added.
-  mutable size_t line_marks_last_updates_ = 0;
-
   CursorsTracker cursors_tracker_;
 
+  // Lines completed (if contains_line_marks is set) that haven't yet been given
+  // to the line marks resolver.
+  std::vector<LineMarksResolver::Line> lines_to_resolve_;
+
   // If we get a request to open a buffer and jump to a given line, we store
   // that value here. Once we've read enough, we stay at this position. It can
   // be set to LineColumn::Max to signify "no desired position".
@@ -1,6 +1,7 @@
 #include "buffer_contents.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <iostream>
 #include <unordered_set>
@@ -17,9 +18,15 @@ namespace editor {
 std::unique_ptr<BufferContents> BufferContents::copy() const {
   auto output = std::make_unique<BufferContents>();
   output->lines_ = lines_;
+  output->version_ = version_;
   return output;
 }
 
+/* static */ size_t BufferContents::NewVersion() {
+  static std::atomic<size_t> next_version(0);
+  return next_version++;
+}
+
 wint_t BufferContents::character_at(const LineColumn& position) const {
   CHECK_LT(position.line, size());
   auto line = at(position.line);
@@ -46,12 +53,13 @@ void BufferContents::insert(size_t position_line, const BufferContents& source,
   auto insert_position = lines_.begin() + position_line;
   for (auto line : source.lines_) {
     if (modifiers != nullptr) {
-      auto replacement = std::make_shared<Line>(*line);
-      replacement->SetAllModifiers(*modifiers);
-      line = replacement;
+      LineBuilder replacement(*line);
+      replacement.SetAllModifiers(*modifiers);
+      line = replacement.Build();
     }
     lines_.insert(insert_position, line);
   }
+  AddDelta(position_line, 0, {}, source.size());
   NotifyUpdateListeners(CursorsTracker::Transformation()
                             .WithBegin(LineColumn(position_line))
                             .AddToLine(source.size()));
@@ -96,6 +104,7 @@ void BufferContents::insert_line(size_t line_position,
                                  shared_ptr<const Line> line) {
   LOG(INFO) << "Inserting line at position: " << line_position;
   lines_.insert(lines_.begin() + line_position, line);
+  AddDelta(line_position, 0, {}, 1);
   NotifyUpdateListeners(CursorsTracker::Transformation()
                             .WithBegin(LineColumn(line_position))
                             .AddToLine(1));
@@ -108,9 +117,9 @@ void BufferContents::DeleteCharactersFromLine(size_t line, size_t column,
   }
   CHECK_LE(column + amount, at(line)->size());
 
-  auto new_line = std::make_shared<Line>(*at(line));
-  new_line->DeleteCharacters(column, amount);
-  set_line(line, new_line);
+  LineBuilder new_line(*at(line));
+  new_line.DeleteCharacters(column, amount);
+  set_line(line, new_line.Build());
 
   NotifyUpdateListeners(CursorsTracker::Transformation()
                             .WithBegin(LineColumn(line, column))
@@ -126,16 +135,16 @@ void BufferContents::DeleteCharactersFromLine(size_t line, size_t column) {
 void BufferContents::SetCharacter(
     size_t line, size_t column, int c,
     std::unordered_set<LineModifier, hash<int>> modifiers) {
-  auto new_line = std::make_shared<Line>(*at(line));
-  new_line->SetCharacter(column, c, modifiers);
-  set_line(line, new_line);
+  LineBuilder new_line(*at(line));
+  new_line.SetCharacter(column, c, modifiers);
+  set_line(line, new_line.Build());
   NotifyUpdateListeners(CursorsTracker::Transformation());
 }
 
 void BufferContents::InsertCharacter(size_t line, size_t column) {
-  auto new_line = std::make_shared<Line>(*at(line));
-  new_line->InsertCharacterAtPosition(column);
-  set_line(line, new_line);
+  LineBuilder new_line(*at(line));
+  new_line.InsertCharacterAtPosition(column);
+  set_line(line, new_line.Build());
   NotifyUpdateListeners(CursorsTracker::Transformation());
 }
 
@@ -145,9 +154,9 @@ void BufferContents::AppendToLine(size_t position, const Line& line_to_append) {
   }
   CHECK(!lines_.empty());
   position = min(position, size() - 1);
-  auto line = std::make_shared<Line>(*at(position));
-  line->Append(line_to_append);
-  set_line(position, line);
+  LineBuilder line(*at(position));
+  line.Append(line_to_append);
+  set_line(position, line.Build());
   NotifyUpdateListeners(CursorsTracker::Transformation());
 }
 
@@ -158,7 +167,9 @@ void BufferContents::EraseLines(size_t first, size_t last) {
   CHECK_LE(first, last);
   CHECK_LE(last, size());
   LOG(INFO) << "Erasing lines in range [" << first << ", " << last << ").";
+  auto old_lines = LinesForDelta(first, last - first);
   lines_.erase(lines_.begin() + first, lines_.begin() + last);
+  AddDelta(first, last - first, std::move(old_lines), 0);
   NotifyUpdateListeners(CursorsTracker::Transformation()
                             .WithBegin(LineColumn(first))
                             .AddToLine(first - last)
@@ -166,10 +177,10 @@ void BufferContents::EraseLines(size_t first, size_t last) {
 }
 
 void BufferContents::SplitLine(LineColumn position) {
-  auto tail = std::make_shared<Line>(*at(position.line));
-  tail->DeleteCharacters(0, position.column);
+  LineBuilder tail(*at(position.line));
+  tail.DeleteCharacters(0, position.column);
   // TODO: Can maybe combine this with next for fewer updates.
-  insert_line(position.line + 1, tail);
+  insert_line(position.line + 1, tail.Build());
   NotifyUpdateListeners(CursorsTracker::Transformation()
                             .WithBegin(position)
                             .WithEnd(LineColumn(position.line + 1, 0))
@@ -202,6 +213,66 @@ void BufferContents::AddUpdateListener(
   update_listeners_.push_back(listener);
 }
 
+void BufferContents::AddLinesListener(
+    std::function<void(size_t, size_t, size_t)> listener) {
+  CHECK(listener);
+  lines_listeners_.push_back(listener);
+}
+
+vector<BufferContents::Delta>* BufferContents::RecordDeltas(
+    vector<Delta>* output) {
+  auto previous = deltas_;
+  deltas_ = output;
+  return previous;
+}
+
+bool BufferContents::RevertDelta(const Delta& delta) {
+  if (delta.first + delta.new_lines.size() > size()) {
+    LOG(WARNING) << "Unable to revert delta, buffer is too short: "
+                 << delta.first << " + " << delta.new_lines.size() << " > "
+                 << size();
+    return false;
+  }
+  for (size_t i = 0; i < delta.new_lines.size(); i++) {
+    const auto& line = lines_[delta.first + i];
+    // Entries loaded from the undo journal don't share the lines with the
+    // buffer, so we fall back to comparing the contents.
+    if (line != delta.new_lines[i] &&
+        line->ToString() != delta.new_lines[i]->ToString()) {
+      LOG(WARNING) << "Unable to revert delta, line " << delta.first + i
+                   << " doesn't match.";
+      return false;
+    }
+  }
+  ReplaceLines(delta.first, delta.new_lines.size(), delta.old_lines);
+  return true;
+}
+
+void BufferContents::ReplaceLines(
+    size_t first, size_t count,
+    const vector<shared_ptr<const Line>>& new_lines) {
+  CHECK_LE(first + count, size());
+  size_t inserted = new_lines.size();
+  auto old_lines = LinesForDelta(first, count);
+  lines_.erase(lines_.begin() + first, lines_.begin() + first + count);
+  auto insert_position = lines_.begin() + first;
+  for (auto& line : new_lines) {
+    lines_.insert(insert_position, line);
+  }
+  AddDelta(first, count, std::move(old_lines), inserted);
+
+  CursorsTracker::Transformation transformation;
+  if (inserted > count) {
+    transformation = transformation.WithBegin(LineColumn(first + count))
+                         .AddToLine(inserted - count);
+  } else if (inserted < count) {
+    transformation = transformation.WithBegin(LineColumn(first + inserted))
+                         .AddToLine(inserted - count)
+                         .OutputLineGe(first + inserted);
+  }
+  NotifyUpdateListeners(transformation);
+}
+
 void BufferContents::NotifyUpdateListeners(
     const CursorsTracker::Transformation& transformation) {
   for (auto& l : update_listeners_) {
@@ -209,5 +280,59 @@ void BufferContents::NotifyUpdateListeners(
   }
 }
 
+vector<shared_ptr<const Line>> BufferContents::LinesForDelta(
+    size_t first, size_t count) const {
+  vector<shared_ptr<const Line>> output;
+  if (deltas_ != nullptr) {
+    output.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+      output.push_back(lines_.at(first + i));
+    }
+  }
+  return output;
+}
+
+void BufferContents::AddDelta(size_t first, size_t old_count,
+                              vector<shared_ptr<const Line>> old_lines,
+                              size_t new_count) {
+  version_ = NewVersion();
+  for (auto& listener : lines_listeners_) {
+    listener(first, old_count, new_count);
+  }
+  if (deltas_ == nullptr) {
+    return;
+  }
+  Delta delta;
+  delta.first = first;
+  delta.old_lines = std::move(old_lines);
+  delta.new_lines.reserve(new_count);
+  for (size_t i = 0; i < new_count; i++) {
+    delta.new_lines.push_back(lines_.at(first + i));
+  }
+  AppendDelta(std::move(delta), deltas_);
+}
+
+void AppendDelta(BufferContents::Delta delta,
+                 vector<BufferContents::Delta>* deltas) {
+  CHECK(deltas != nullptr);
+  if (delta.old_lines.empty() && delta.new_lines.empty()) {
+    return;
+  }
+  if (!deltas->empty()) {
+    auto& last = deltas->back();
+    if (delta.first >= last.first &&
+        delta.first + delta.old_lines.size() <=
+            last.first + last.new_lines.size()) {
+      auto position = last.new_lines.begin() + (delta.first - last.first);
+      position =
+          last.new_lines.erase(position, position + delta.old_lines.size());
+      last.new_lines.insert(position, delta.new_lines.begin(),
+                            delta.new_lines.end());
+      return;
+    }
+  }
+  deltas->push_back(std::move(delta));
+}
+
 }  // namespace editor
 }  // namespace afc
@@ -18,12 +18,25 @@ using std::vector;
 
 class BufferContents {
  public:
+  // A change to the contents: the lines in range [first, first +
+  // old_lines.size()) were replaced by new_lines. Since lines are immutable,
+  // this only holds pointers to them.
+  struct Delta {
+    size_t first = 0;
+    vector<shared_ptr<const Line>> old_lines;
+    vector<shared_ptr<const Line>> new_lines;
+  };
+
   BufferContents() = default;
 
   wint_t character_at(const LineColumn& position) const;
 
   bool empty() const { return lines_.empty(); }
 
+  // Changes whenever the lines change. Values are never reused (not even by
+  // other instances), so a version identifies the state of the contents.
+  size_t version() const { return version_; }
+
   size_t size() const { return lines_.size(); }
 
   // Returns a copy of the contents of the tree. Complexity is linear to the
@@ -75,12 +88,16 @@ class BufferContents {
     }
 
     CHECK_LE(position, size());
+    auto old_lines = LinesForDelta(position, 1);
     lines_[position] = line;
+    AddDelta(position, 1, std::move(old_lines), 1);
   }
 
   template <class C>
   void sort(size_t first, size_t last, C compare) {
+    auto old_lines = LinesForDelta(first, last - first);
     std::sort(lines_.begin() + first, lines_.begin() + last, compare);
+    AddDelta(first, last - first, std::move(old_lines), last - first);
     NotifyUpdateListeners(CursorsTracker::Transformation());
   }
 
@@ -100,6 +117,11 @@ class BufferContents {
 
   void EraseLines(size_t first, size_t last);
 
+  // Replaces the count lines starting at first with new_lines, as a single
+  // change.
+  void ReplaceLines(size_t first, size_t count,
+                    const vector<shared_ptr<const Line>>& new_lines);
+
   void SplitLine(LineColumn position);
 
   // Appends the next line to the current line and removes the next line.
@@ -109,21 +131,61 @@ class BufferContents {
   void push_back(wstring str);
   void push_back(shared_ptr<const Line> line) {
     lines_.push_back(line);
+    AddDelta(size() - 1, 0, {}, 1);
     NotifyUpdateListeners(CursorsTracker::Transformation());
   }
 
   void AddUpdateListener(
       std::function<void(const CursorsTracker::Transformation&)> listener);
 
+  // The listener is called after every change, with the range of lines that
+  // was replaced ([first, first + old_count)) and the number of lines that
+  // replaced it. Lines modified in place are reported as replaced by a single
+  // line.
+  void AddLinesListener(
+      std::function<void(size_t first, size_t old_count, size_t new_count)>
+          listener);
+
+  // While output isn't nullptr, every change to the contents is appended to it
+  // (with AppendDelta). Returns the previous value.
+  vector<Delta>* RecordDeltas(vector<Delta>* output);
+
+  // Replaces the lines introduced by delta with the lines that it replaced.
+  // Returns false (without changing the contents) if the contents no longer
+  // contain the lines introduced by delta (e.g., because they were modified
+  // without recording the changes).
+  bool RevertDelta(const Delta& delta);
+
  private:
+  static size_t NewVersion();
+
   void NotifyUpdateListeners(
       const CursorsTracker::Transformation& cursor_adjuster);
 
+  // If deltas are being recorded, returns the lines in range [first, first +
+  // count) (which a modification is about to replace).
+  vector<shared_ptr<const Line>> LinesForDelta(size_t first,
+                                               size_t count) const;
+  // Notifies the lines listeners that the old_count lines starting at first
+  // were replaced by new_count lines. If deltas are being recorded, records it
+  // (old_lines must hold the lines that were replaced).
+  void AddDelta(size_t first, size_t old_count,
+                vector<shared_ptr<const Line>> old_lines, size_t new_count);
+
   Tree<shared_ptr<const Line>> lines_;
   vector<std::function<void(const CursorsTracker::Transformation&)>>
       update_listeners_;
+  vector<std::function<void(size_t, size_t, size_t)>> lines_listeners_;
+  vector<Delta>* deltas_ = nullptr;
+  size_t version_ = NewVersion();
 };
 
+// Appends delta to deltas. If delta only modifies lines introduced by the last
+// delta in deltas, merges it into that one (so that, for example, consecutive
+// modifications to the same line produce a single delta).
+void AppendDelta(BufferContents::Delta delta,
+                 vector<BufferContents::Delta>* deltas);
+
 }  // namespace editor
 }  // namespace afc
 
@@ -253,6 +253,7 @@ EdgeStruct<wstring>* StringStruct() {
     tree_parser();
     language_keywords();
     typos();
+    fuzzy_finder_ignore();
   }
   return output;
 }
@@ -337,9 +338,11 @@ EdgeVariable<wstring>* dictionary() {
       L"dictionary",
       L"Path to a dictionary file used for autocompletion. If empty, pressing "
       L"TAB (in insert mode) just inserts a tab character into the file; "
-      L"otherwise, it triggers completion to the first string from the "
-      L"dictionary that matches the prefix of the current word. Pressing TAB "
-      L"again iterates through all completions.",
+      L"otherwise, it triggers completion to the most frequent word from the "
+      L"dictionary that starts with the current word (ignoring case). Pressing "
+      L"TAB again iterates through all completions. Each line of the file "
+      L"contains a word, optionally followed by a tab character and its "
+      L"frequency.",
       L"");
   return variable;
 }
@@ -373,6 +376,17 @@ EdgeVariable<wstring>* typos() {
   return variable;
 }
 
+EdgeVariable<wstring>* fuzzy_finder_ignore() {
+  static EdgeVariable<wstring>* variable = StringStruct()->AddVariable(
+      L"fuzzy_finder_ignore",
+      L"Space separated list of shell wildcard patterns for the files and "
+      L"directories that the fuzzy file finder (\"aO\") should skip. Patterns "
+      L"containing a slash are matched against paths (relative to the current "
+      L"directory); the rest, against names.",
+      L".git .hg .svn node_modules *.o *.a *.so *.pyc");
+  return variable;
+}
+
 EdgeStruct<int>* IntStruct() {
   static EdgeStruct<int>* output = nullptr;
   if (output == nullptr) {
@@ -385,6 +399,7 @@ EdgeStruct<int>* IntStruct() {
     view_start_line();
     view_start_column();
     progress();
+    undo_memory_limit();
   }
   return output;
 }
@@ -452,6 +467,15 @@ EdgeVariable<int>* progress() {
   return variable;
 }
 
+EdgeVariable<int>* undo_memory_limit() {
+  static EdgeVariable<int>* variable = IntStruct()->AddVariable(
+      L"undo_memory_limit",
+      L"Maximum amount of memory (in kilobytes) that the undo history of this "
+      L"buffer may retain. When exceeded, the oldest entries are discarded.",
+      64 * 1024);
+  return variable;
+}
+
 EdgeStruct<double>* DoubleStruct() {
   static EdgeStruct<double>* output = nullptr;
   if (output == nullptr) {
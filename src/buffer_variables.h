@@ -47,6 +47,7 @@ EdgeVariable<wstring>* dictionary();
 EdgeVariable<wstring>* tree_parser();
 EdgeVariable<wstring>* language_keywords();
 EdgeVariable<wstring>* typos();
+EdgeVariable<wstring>* fuzzy_finder_ignore();
 
 EdgeStruct<int>* IntStruct();
 EdgeVariable<int>* line_width();
@@ -56,6 +57,7 @@ EdgeVariable<int>* margin_columns();
 EdgeVariable<int>* view_start_line();
 EdgeVariable<int>* view_start_column();
 EdgeVariable<int>* progress();
+EdgeVariable<int>* undo_memory_limit();
 
 EdgeStruct<double>* DoubleStruct();
 EdgeVariable<double>* margin_lines_ratio();
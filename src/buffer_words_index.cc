@@ -0,0 +1,188 @@
+#include "buffer_words_index.h"
+
+#include <algorithm>
+#include <cwctype>
+
+#include <glog/logging.h>
+
+#include "buffer_contents.h"
+#include "parse_tree.h"
+#include "wstring.h"
+
+namespace afc {
+namespace editor {
+
+namespace {
+// Words longer than this are unlikely to be typed (and could be, for example,
+// long encoded strings).
+const size_t kMaxWordLength = 80;
+
+void AddLeaves(const BufferContents& contents, const ParseTree& tree,
+               const wstring& word_characters,
+               BufferWordsIndex::WordCounts* output) {
+  if (tree.children.empty() && tree.range.begin.line == tree.range.end.line &&
+      tree.range.begin.column < tree.range.end.column &&
+      tree.range.end.column - tree.range.begin.column <= kMaxWordLength &&
+      tree.range.begin.line < contents.size()) {
+    const Line& line = *contents.at(tree.range.begin.line);
+    if (tree.range.end.column <= line.size()) {
+      wstring word = line.Substring(tree.range.begin.column,
+                                    tree.range.end.column -
+                                        tree.range.begin.column)
+                         ->ToString();
+      if (word.find_first_not_of(word_characters) == wstring::npos) {
+        (*output)[word]++;
+      }
+    }
+  }
+  for (const auto& child : tree.children) {
+    AddLeaves(contents, child, word_characters, output);
+  }
+}
+
+// Compares the case-folded forms of a and b.
+int CompareFolded(const wstring& a, const wstring& b) {
+  size_t length = std::min(a.size(), b.size());
+  for (size_t i = 0; i < length; i++) {
+    wint_t folded_a = towlower(a[i]);
+    wint_t folded_b = towlower(b[i]);
+    if (folded_a != folded_b) {
+      return folded_a < folded_b ? -1 : 1;
+    }
+  }
+  return a.size() == b.size() ? 0 : a.size() < b.size() ? -1 : 1;
+}
+
+bool StartsWithFolded(const wstring& word, const wstring& key) {
+  if (word.size() < key.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < key.size(); i++) {
+    if (wint_t(towlower(word[i])) != wint_t(key[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+/* static */ BufferWordsIndex::WordCounts BufferWordsIndex::CountWords(
+    const BufferContents& contents, const ParseTree& tree,
+    const wstring& word_characters) {
+  WordCounts output;
+  AddLeaves(contents, tree, word_characters, &output);
+  return output;
+}
+
+void BufferWordsIndex::Update(size_t buffer_id, WordCounts words) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  updates_++;
+  WordCounts& old_words = buffers_[buffer_id];
+  for (const auto& entry : old_words) {
+    auto it = words.find(entry.first);
+    Adjust(entry.first, entry.second, it == words.end() ? 0 : it->second);
+  }
+  for (const auto& entry : words) {
+    if (old_words.find(entry.first) == old_words.end()) {
+      Adjust(entry.first, 0, entry.second);
+    }
+  }
+  old_words = std::move(words);
+  VLOG(5) << "Buffer words updated: " << buffer_id
+          << ", words in buffer: " << old_words.size()
+          << ", total: " << words_.size();
+}
+
+void BufferWordsIndex::RemoveBuffer(size_t buffer_id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = buffers_.find(buffer_id);
+  if (it == buffers_.end()) {
+    return;
+  }
+  for (const auto& entry : it->second) {
+    Adjust(entry.first, entry.second, 0);
+  }
+  buffers_.erase(it);
+}
+
+std::vector<wstring> BufferWordsIndex::Find(const wstring& prefix,
+                                            size_t limit) const {
+  FoldedPrefix folded_prefix;
+  for (wchar_t c : prefix) {
+    folded_prefix.key.push_back(towlower(c));
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::vector<std::map<wstring, Stats, FoldedLess>::const_iterator> matches;
+  for (auto it = words_.lower_bound(folded_prefix);
+       it != words_.end() && StartsWithFolded(it->first, folded_prefix.key);
+       ++it) {
+    if (it->first != prefix) {
+      matches.push_back(it);
+    }
+  }
+  // Positions in matches (which is in alphabetical order, to break ties).
+  std::vector<size_t> ranking(matches.size());
+  for (size_t i = 0; i < ranking.size(); i++) {
+    ranking[i] = i;
+  }
+  auto end = ranking.begin() + std::min(limit, ranking.size());
+  std::partial_sort(ranking.begin(), end, ranking.end(),
+                    [&matches](size_t a, size_t b) {
+                      const Stats& stats_a = matches[a]->second;
+                      const Stats& stats_b = matches[b]->second;
+                      if (stats_a.count != stats_b.count) {
+                        return stats_a.count > stats_b.count;
+                      }
+                      if (stats_a.last_added != stats_b.last_added) {
+                        return stats_a.last_added > stats_b.last_added;
+                      }
+                      return a < b;
+                    });
+
+  std::vector<wstring> output;
+  for (auto it = ranking.begin(); it != end; ++it) {
+    output.push_back(matches[*it]->first);
+  }
+  return output;
+}
+
+size_t BufferWordsIndex::size() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return words_.size();
+}
+
+bool BufferWordsIndex::FoldedLess::operator()(const wstring& a,
+                                              const wstring& b) const {
+  int result = CompareFolded(a, b);
+  return result != 0 ? result < 0 : a < b;
+}
+
+bool BufferWordsIndex::FoldedLess::operator()(const wstring& a,
+                                              const FoldedPrefix& b) const {
+  return CompareFolded(a, b.key) < 0;
+}
+
+bool BufferWordsIndex::FoldedLess::operator()(const FoldedPrefix& a,
+                                              const wstring& b) const {
+  return CompareFolded(a.key, b) < 0;
+}
+
+void BufferWordsIndex::Adjust(const wstring& word, size_t old_count,
+                              size_t new_count) {
+  if (old_count == new_count) {
+    return;
+  }
+  Stats& stats = words_[word];
+  CHECK_GE(stats.count + new_count, old_count);
+  stats.count = stats.count + new_count - old_count;
+  if (new_count > old_count) {
+    stats.last_added = updates_;
+  }
+  if (stats.count == 0) {
+    words_.erase(word);
+  }
+}
+
+}  // namespace editor
+}  // namespace afc
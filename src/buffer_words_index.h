@@ -0,0 +1,83 @@
+#ifndef __AFC_EDITOR_BUFFER_WORDS_INDEX_H__
+#define __AFC_EDITOR_BUFFER_WORDS_INDEX_H__
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace afc {
+namespace editor {
+
+using std::wstring;
+
+class BufferContents;
+struct ParseTree;
+
+// Editor-wide index of the words in all buffers, used to complete words.
+//
+// Each buffer reports the number of occurrences of each of its words whenever
+// its parse tree is updated; only the differences with its previous report are
+// applied. For each word, the index keeps its total number of occurrences and
+// the last report that added occurrences of it (to favor recently typed
+// words).
+//
+// Thread-safe: buffers report from their background threads.
+class BufferWordsIndex {
+ public:
+  using WordCounts = std::unordered_map<wstring, size_t>;
+
+  // Returns the words in the leaves of a parse tree (such as those produced by
+  // the words tree parser) that consist only of word_characters.
+  static WordCounts CountWords(const BufferContents& contents,
+                               const ParseTree& tree,
+                               const wstring& word_characters);
+
+  // Replaces the words of a buffer.
+  void Update(size_t buffer_id, WordCounts words);
+  void RemoveBuffer(size_t buffer_id);
+
+  // Returns (up to limit) words that start with prefix (ignoring case), most
+  // frequent first; among words with the same frequency, those that were
+  // added most recently come first. A word equal to prefix isn't a completion
+  // of it.
+  std::vector<wstring> Find(const wstring& prefix, size_t limit) const;
+
+  // The number of distinct words.
+  size_t size() const;
+
+ private:
+  // A case-folded prefix, compared only against the case-folded words.
+  struct FoldedPrefix {
+    wstring key;
+  };
+
+  // Orders words by their case-folded form (and then by the words themselves)
+  // so that the words that start with a prefix (ignoring case) are adjacent.
+  struct FoldedLess {
+    using is_transparent = void;
+    bool operator()(const wstring& a, const wstring& b) const;
+    bool operator()(const wstring& a, const FoldedPrefix& b) const;
+    bool operator()(const FoldedPrefix& a, const wstring& b) const;
+  };
+
+  struct Stats {
+    size_t count = 0;
+    // The value of updates_ when occurrences of the word were last added.
+    size_t last_added = 0;
+  };
+
+  // Applies a change to the number of occurrences of a word.
+  void Adjust(const wstring& word, size_t old_count, size_t new_count);
+
+  mutable std::mutex mutex_;
+  size_t updates_ = 0;
+  std::unordered_map<size_t, WordCounts> buffers_;
+  std::map<wstring, Stats, FoldedLess> words_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_BUFFER_WORDS_INDEX_H__
@@ -695,7 +695,7 @@ class ActivateLink : public Command {
           target_position->type.type == VMType::OBJECT_TYPE &&
           target_position->type.object_type == L"LineColumn") {
         it->second->set_position(
-            *static_cast<LineColumn*>(target_position->user_value.get()));
+            *static_cast<LineColumn*>(target_position->user_value().get()));
       }
       editor_state->PushCurrentPosition();
       editor_state->ScheduleRedraw();
@@ -906,6 +906,7 @@ std::unique_ptr<MapModeCommands> NewCommandMode(EditorState* editor_state) {
                                      L"editor.ReloadCurrentBuffer();"));
   commands->Add(L"ae", NewSendEndOfFileCommand());
   commands->Add(L"ao", NewOpenFileCommand());
+  commands->Add(L"aO", NewFuzzyOpenFileCommand());
   {
     PromptOptions options;
     options.prompt = L"...$ ";
@@ -0,0 +1,136 @@
+#include "completion_index.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <limits>
+#include <numeric>
+
+#include <glog/logging.h>
+
+#include "wstring.h"
+
+namespace afc {
+namespace editor {
+
+namespace {
+wstring Fold(const wstring& input) {
+  wstring output(input);
+  for (auto& c : output) {
+    c = towlower(c);
+  }
+  return output;
+}
+}  // namespace
+
+CompletionIndex::CompletionIndex(std::vector<Entry> entries) {
+  std::vector<wstring> keys;
+  keys.reserve(entries.size());
+  for (const auto& entry : entries) {
+    keys.push_back(Fold(entry.word));
+  }
+  std::vector<size_t> order(entries.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return keys[a] != keys[b] ? keys[a] < keys[b]
+                              : entries[a].word < entries[b].word;
+  });
+
+  offsets_.push_back(0);
+  for (size_t i : order) {
+    if (entries[i].word.empty()) {
+      continue;
+    }
+    const wstring& word = entries[i].word;
+    if (!frequencies_.empty() &&
+        offsets_.back() - offsets_[size() - 1] == word.size() &&
+        words_.compare(offsets_[size() - 1], word.size(), word) == 0) {
+      frequencies_.back() += entries[i].frequency;
+      continue;
+    }
+    CHECK_LT(words_.size() + word.size(), std::numeric_limits<uint32_t>::max());
+    words_.append(word);
+    keys_.append(keys[i]);
+    offsets_.push_back(words_.size());
+    frequencies_.push_back(entries[i].frequency);
+  }
+  words_.shrink_to_fit();
+  keys_.shrink_to_fit();
+  LOG(INFO) << "Completion index: entries: " << entries.size()
+            << ", words: " << size() << ", characters: " << words_.size();
+}
+
+/* static */ bool CompletionIndex::ParseDictionaryLine(const wstring& line,
+                                                       Entry* output) {
+  size_t tab = line.find_last_of(L'\t');
+  output->word = line.substr(0, tab);
+  output->frequency = 1;
+  if (tab != wstring::npos) {
+    try {
+      output->frequency = std::stoul(line.substr(tab + 1));
+    } catch (const std::exception& e) {
+      VLOG(5) << "Invalid frequency, keeping the whole line: " << e.what();
+      output->word = line;
+    }
+  }
+  return !output->word.empty();
+}
+
+wstring CompletionIndex::word(size_t id) const {
+  return words_.substr(offsets_[id], offsets_[id + 1] - offsets_[id]);
+}
+
+template <typename Predicate>
+/* static */ size_t CompletionIndex::PartitionPoint(size_t begin, size_t end,
+                                                    Predicate predicate) {
+  while (begin < end) {
+    size_t middle = begin + (end - begin) / 2;
+    if (predicate(middle)) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return begin;
+}
+
+std::vector<size_t> CompletionIndex::Find(const wstring& prefix,
+                                          size_t limit) const {
+  const wstring key = Fold(prefix);
+  // Compares the first key.size() characters of the key of id with key.
+  auto compare = [this, &key](size_t id) {
+    size_t length = std::min(key.size(), size_t(offsets_[id + 1]) -
+                                             offsets_[id]);
+    int result = keys_.compare(offsets_[id], length, key, 0, length);
+    return result != 0 ? result : length < key.size() ? -1 : 0;
+  };
+  size_t begin = PartitionPoint(
+      0, size(), [&compare](size_t id) { return compare(id) < 0; });
+  size_t end = PartitionPoint(
+      begin, size(), [&compare](size_t id) { return compare(id) == 0; });
+  VLOG(5) << "Completions for \"" << prefix << "\": " << end - begin;
+
+  std::vector<size_t> output;
+  output.reserve(end - begin);
+  for (size_t id = begin; id < end; id++) {
+    if (offsets_[id + 1] - offsets_[id] != prefix.size() ||
+        words_.compare(offsets_[id], prefix.size(), prefix) != 0) {
+      output.push_back(id);
+    }
+  }
+  auto by_rank = [this](size_t a, size_t b) {
+    return frequencies_[a] != frequencies_[b]
+               ? frequencies_[a] > frequencies_[b]
+               : a < b;
+  };
+  if (output.size() > limit) {
+    std::partial_sort(output.begin(), output.begin() + limit, output.end(),
+                      by_rank);
+    output.resize(limit);
+  } else {
+    std::sort(output.begin(), output.end(), by_rank);
+  }
+  return output;
+}
+
+}  // namespace editor
+}  // namespace afc
@@ -0,0 +1,61 @@
+#ifndef __AFC_EDITOR_COMPLETION_INDEX_H__
+#define __AFC_EDITOR_COMPLETION_INDEX_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace afc {
+namespace editor {
+
+using std::wstring;
+
+// An immutable index of words, used to find the completions of a prefix.
+//
+// The words are sorted by their case-folded form and stored contiguously (in
+// a single string, with an array of offsets), so that the words starting with
+// a prefix (regardless of its case) form a range that is found with a binary
+// search. Since it is immutable, an index can be shared (e.g., across all the
+// buffers that use the same dictionary) and used from multiple threads.
+class CompletionIndex {
+ public:
+  struct Entry {
+    wstring word;
+    size_t frequency = 1;
+  };
+
+  // Entries for the same word are merged (adding their frequencies).
+  explicit CompletionIndex(std::vector<Entry> entries);
+
+  // Parses a line of a dictionary file: either just a word or a word followed
+  // by a tab and its frequency. Returns false for empty lines.
+  static bool ParseDictionaryLine(const wstring& line, Entry* output);
+
+  size_t size() const { return frequencies_.size(); }
+  wstring word(size_t id) const;
+  size_t frequency(size_t id) const { return frequencies_[id]; }
+
+  // Returns the ids of (up to limit) words that start with prefix (ignoring
+  // case), most frequent first (and, among words with the same frequency, in
+  // alphabetical order). A word equal to prefix isn't a completion of it.
+  std::vector<size_t> Find(const wstring& prefix, size_t limit) const;
+
+ private:
+  // Returns the first id in [begin, end) for which predicate is false, given
+  // that predicate is true for all the ids before it.
+  template <typename Predicate>
+  static size_t PartitionPoint(size_t begin, size_t end, Predicate predicate);
+
+  // The words, concatenated, in the order of their keys.
+  wstring words_;
+  // The keys (the words, case-folded), concatenated. Folding preserves lengths,
+  // so word i spans [offsets_[i], offsets_[i + 1]) in both.
+  wstring keys_;
+  std::vector<uint32_t> offsets_;
+  std::vector<uint32_t> frequencies_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_COMPLETION_INDEX_H__
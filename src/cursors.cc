@@ -91,19 +91,346 @@ std::ostream& operator<<(std::ostream& os, const ExtendedTransformation& t) {
   return os;
 }
 
-CursorsTracker::CursorsTracker() {
-  current_cursor_ = cursors_[L""].insert(LineColumn());
+CursorsSet::iterator CursorsSet::begin() const {
+  Flatten();
+  return cursors_.begin();
+}
+
+CursorsSet::iterator CursorsSet::end() const {
+  Flatten();
+  return cursors_.end();
+}
+
+CursorsSet::iterator CursorsSet::find(LineColumn position) const {
+  auto it = lower_bound(position);
+  return it != end() && *it == position ? it : end();
+}
+
+CursorsSet::iterator CursorsSet::lower_bound(LineColumn position) const {
+  Flatten();
+  return std::lower_bound(cursors_.begin(), cursors_.end(), position);
+}
+
+CursorsSet::iterator CursorsSet::insert(LineColumn position) {
+  Flatten();
+  auto it = std::upper_bound(cursors_.begin(), cursors_.end(), position);
+  size_t index = it - cursors_.begin();
+  if (index <= current_index_ && !cursors_.empty()) {
+    current_index_++;
+  }
+  return cursors_.insert(it, position);
+}
+
+CursorsSet::iterator CursorsSet::erase(iterator position) {
+  Flatten();
+  size_t index = position - cursors_.begin();
+  CHECK_LT(index, cursors_.size());
+  auto output = cursors_.erase(cursors_.begin() + index);
+  if (index < current_index_) {
+    current_index_--;
+  } else if (current_index_ >= cursors_.size()) {
+    current_index_ = 0;
+  }
+  return output;
+}
+
+void CursorsSet::clear() {
+  cursors_.clear();
+  line_deltas_.clear();
+  current_index_ = 0;
+}
+
+void CursorsSet::swap(CursorsSet& other) {
+  cursors_.swap(other.cursors_);
+  line_deltas_.swap(other.line_deltas_);
+  std::swap(current_index_, other.current_index_);
+}
+
+void CursorsSet::set_current_index(size_t index) {
+  CHECK_LT(index, cursors_.size());
+  current_index_ = index;
+}
+
+LineColumn CursorsSet::Get(size_t index) const {
+  CHECK_LT(index, cursors_.size());
+  LineColumn output = cursors_[index];
+  output.line += PendingLineDelta(index);
+  return output;
+}
+
+void CursorsSet::Set(size_t index, LineColumn position) {
+  CHECK_LT(index, cursors_.size());
+  position.line -= PendingLineDelta(index);
+  cursors_[index] = position;
+}
+
+void CursorsSet::AddToLines(size_t first, int delta) {
+  if (first >= cursors_.size() || delta == 0) {
+    return;
+  }
+  if (line_deltas_.empty()) {
+    line_deltas_.resize(cursors_.size() + 1);
+  }
+  for (size_t i = first + 1; i < line_deltas_.size(); i += i & -i) {
+    line_deltas_[i] += delta;
+  }
+}
+
+size_t CursorsSet::LowerBoundIndex(LineColumn position) const {
+  size_t begin = 0;
+  size_t end = cursors_.size();
+  while (begin < end) {
+    size_t middle = begin + (end - begin) / 2;
+    if (Get(middle) < position) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return begin;
+}
+
+void CursorsSet::Sort() {
+  Flatten();
+  if (std::is_sorted(cursors_.begin(), cursors_.end())) {
+    return;
+  }
+  LineColumn current = cursors_[current_index_];
+  std::sort(cursors_.begin(), cursors_.end());
+  current_index_ = lower_bound(current) - cursors_.begin();
+}
+
+void CursorsSet::Flatten() const {
+  if (line_deltas_.empty()) {
+    return;
+  }
+  // Turn the Fenwick tree back into the array of deltas (the inverse of its
+  // linear-time construction), then accumulate them.
+  for (size_t i = line_deltas_.size() - 1; i > 0; i--) {
+    size_t parent = i + (i & -i);
+    if (parent < line_deltas_.size()) {
+      line_deltas_[parent] -= line_deltas_[i];
+    }
+  }
+  size_t delta = 0;
+  for (size_t i = 0; i < cursors_.size(); i++) {
+    delta += line_deltas_[i + 1];
+    cursors_[i].line += delta;
+  }
+  line_deltas_.clear();
+}
+
+size_t CursorsSet::PendingLineDelta(size_t index) const {
+  size_t output = 0;
+  if (!line_deltas_.empty()) {
+    for (size_t i = index + 1; i > 0; i -= i & -i) {
+      output += line_deltas_[i];
+    }
+  }
+  return output;
+}
+
+// Returns true if the transformation just adds add_to_line to all positions
+// starting at range.begin, except perhaps for a few positions (immediately
+// after range.begin) that get clamped to output_line_ge.
+bool IsLinesShift(const CursorsTracker::Transformation& transformation) {
+  return transformation.range.begin.column == 0 &&
+         transformation.range.end == LineColumn::Max() &&
+         transformation.add_to_column == 0;
+}
+
+// Holds the cursors that CursorsTracker::ApplyTransformationToCursors is
+// processing and keeps their positions up to date as transformations are
+// received.
+//
+// Cursors are processed in descending order. Modifications done for a cursor
+// normally only affect positions after it, so the cursors that haven't been
+// processed are rarely affected and the cursors that have been processed
+// usually are. The later are stored with their lines relative to line_delta_
+// (which accumulates every transformation that just adds to all lines from a
+// given one), so that those transformations can be applied in constant time
+// regardless of how many cursors are affected. Other transformations only
+// visit the cursors in their range (starting from the smallest position).
+class BatchedCursors {
+ public:
+  BatchedCursors(const CursorsSet& cursors)
+      : pending_(cursors.begin(), cursors.end()),
+        current_index_(cursors.current_index()) {
+    processed_.reserve(pending_.size());
+  }
+
+  // Runs callback on every pending cursor, from the last to the first.
+  void ProcessAll(const std::function<LineColumn(LineColumn)>& callback) {
+    while (!pending_.empty()) {
+      LineColumn position = pending_.back();
+      pending_.pop_back();
+      bool current = pending_.size() == current_index_;
+      AddProcessed(callback(position), current);
+    }
+  }
+
+  void Adjust(const CursorsTracker::Transformation& transformation) {
+    if (transformation.add_to_line == 0 && transformation.add_to_column == 0) {
+      return;
+    }
+    for (auto it = pending_.rbegin();
+         it != pending_.rend() && *it >= transformation.range.begin; ++it) {
+      if (*it < transformation.range.end) {
+        *it = transformation.Transform(*it);
+      }
+    }
+    if (IsLinesShift(transformation)) {
+      AdjustProcessedLinesShift(transformation);
+    } else {
+      AdjustProcessed(transformation);
+    }
+  }
+
+  // Replaces the contents of output with the final positions and sets its
+  // current cursor.
+  void Flush(CursorsSet* output) {
+    output->clear();
+    size_t current_index = 0;
+    bool current_found = false;
+    // processed_ is normally sorted, so this just appends.
+    for (auto it = processed_.rbegin(); it != processed_.rend(); ++it) {
+      size_t index = output->insert(Position(*it)) - output->begin();
+      if (it->current) {
+        current_index = index;
+        current_found = true;
+      } else if (current_found && index <= current_index) {
+        current_index++;
+      }
+    }
+    CHECK(current_found);
+    output->set_current_index(current_index);
+  }
+
+ private:
+  struct Entry {
+    // The actual line is obtained by adding line_delta_ to position.line.
+    LineColumn position;
+    bool current;
+  };
+
+  LineColumn Position(const Entry& entry) const {
+    // Lines use modular arithmetic: position.line may wrap around.
+    return LineColumn(entry.position.line + line_delta_,
+                      entry.position.column);
+  }
+
+  void SetPosition(Entry* entry, LineColumn position, size_t line_delta) {
+    entry->position = position;
+    entry->position.line -= line_delta;
+  }
+
+  void AddProcessed(LineColumn position, bool current) {
+    Entry entry;
+    SetPosition(&entry, position, line_delta_);
+    entry.current = current;
+    // processed_ is sorted in descending order. The new position is normally
+    // the smallest, unless the callback moved the cursor forward.
+    auto it = processed_.end();
+    while (it != processed_.begin() && Position(*(it - 1)) < position) {
+      --it;
+    }
+    processed_.insert(it, entry);
+  }
+
+  void AdjustProcessedLinesShift(
+      const CursorsTracker::Transformation& transformation) {
+    size_t new_line_delta = line_delta_ + transformation.add_to_line;
+    // The range of indices (in processed_) of the clamped entries.
+    size_t begin = processed_.size();
+    size_t end = processed_.size();
+    for (auto it = processed_.rbegin(); it != processed_.rend(); ++it) {
+      LineColumn position = Position(*it);
+      if (position < transformation.range.begin) {
+        SetPosition(&*it, position, new_line_delta);  // Not affected.
+        continue;
+      }
+      LineColumn output = transformation.Transform(position);
+      if (output.line == position.line + transformation.add_to_line) {
+        break;  // This and all subsequent cursors are just shifted.
+      }
+      SetPosition(&*it, output, new_line_delta);
+      begin = processed_.rend() - it - 1;
+      if (end == processed_.size()) {
+        end = begin + 1;
+      }
+    }
+    line_delta_ = new_line_delta;
+    // Entries clamped to the same line keep their columns, so they can end up
+    // out of order.
+    SortProcessedIfUnordered(begin, end);
+  }
+
+  void AdjustProcessed(const CursorsTracker::Transformation& transformation) {
+    size_t begin = processed_.size();
+    size_t end = processed_.size();
+    for (auto it = processed_.rbegin(); it != processed_.rend(); ++it) {
+      LineColumn position = Position(*it);
+      if (position >= transformation.range.end) {
+        break;
+      }
+      if (position >= transformation.range.begin) {
+        SetPosition(&*it, transformation.Transform(position), line_delta_);
+        begin = processed_.rend() - it - 1;
+        if (end == processed_.size()) {
+          end = begin + 1;
+        }
+      }
+    }
+    SortProcessedIfUnordered(begin, end);
+  }
+
+  // Restores the (descending) order of processed_ unless the entries in
+  // [begin, end) are in order among themselves and with their neighbors. The
+  // loops above stop at the first entry outside the transformation's range,
+  // so they depend on the order.
+  void SortProcessedIfUnordered(size_t begin, size_t end) {
+    if (begin >= end) {
+      return;
+    }
+    end = std::min(end + 1, processed_.size());
+    for (size_t i = std::max(begin, size_t(1)); i < end; i++) {
+      if (Position(processed_[i - 1]) < Position(processed_[i])) {
+        std::stable_sort(processed_.begin(), processed_.end(),
+                         [this](const Entry& a, const Entry& b) {
+                           return Position(a) > Position(b);
+                         });
+        return;
+      }
+    }
+  }
+
+  // Cursors that haven't been processed, in ascending order.
+  std::vector<LineColumn> pending_;
+  // Index (in pending_) of the current cursor.
+  const size_t current_index_;
+
+  // Cursors that have been processed, in descending order.
+  std::vector<Entry> processed_;
+  size_t line_delta_ = 0;
+};
+
+CursorsTracker::CursorsTracker() : current_cursors_(&cursors_[L""]) {
+  current_cursors_->insert(LineColumn());
 }
 
 CursorsTracker::~CursorsTracker() {}
 
-LineColumn CursorsTracker::position() const { return *current_cursor_; }
+LineColumn CursorsTracker::position() const {
+  return current_cursors_->current();
+}
 
 void CursorsTracker::SetCurrentCursor(CursorsSet* cursors,
                                       LineColumn position) {
-  current_cursor_ = cursors->find(position);
-  CHECK(current_cursor_ != cursors->end());
-  LOG(INFO) << "Current cursor set to: " << *current_cursor_;
+  auto it = cursors->find(position);
+  CHECK(it != cursors->end());
+  current_cursors_ = cursors;
+  cursors->set_current_index(it - cursors->begin());
+  LOG(INFO) << "Current cursor set to: " << position;
 }
 
 void CursorsTracker::MoveCurrentCursor(CursorsSet* cursors,
@@ -116,38 +443,51 @@ void CursorsTracker::MoveCurrentCursor(CursorsSet* cursors,
 void CursorsTracker::DeleteCurrentCursor(CursorsSet* cursors) {
   CHECK(cursors != nullptr);
   CHECK(cursors->size() > 1) << "Attempted to delete the last cursor in set.";
-  cursors->erase(current_cursor_++);
-  if (current_cursor_ == cursors->end()) {
-    current_cursor_ = cursors->begin();
+  cursors->erase(cursors->begin() + cursors->current_index());
+}
+
+// Sorts cursors_set unless the cursors in [begin, end) are in order among
+// themselves and with their neighbors (the cursors outside the range must
+// already be in order).
+void SortIfUnordered(size_t begin, size_t end, CursorsSet* cursors_set) {
+  end = std::min(end + 1, cursors_set->size());
+  for (size_t i = std::max(begin, size_t(1)); i < end; i++) {
+    if (cursors_set->Get(i - 1) > cursors_set->Get(i)) {
+      cursors_set->Sort();
+      return;
+    }
   }
 }
 
 void AdjustCursorsSet(const CursorsTracker::Transformation& transformation,
-                      CursorsSet* cursors_set,
-                      CursorsSet::iterator* current_cursor) {
+                      CursorsSet* cursors_set) {
   VLOG(8) << "Adjusting cursor set of size: " << cursors_set->size();
-
-  // Transfer all affected cursors from cursors into cursors_affected.
-  CursorsSet cursors_affected;
-  auto it = cursors_set->lower_bound(transformation.range.begin);
-  auto end = cursors_set->lower_bound(transformation.range.end);
-  while (it != end) {
-    auto result = cursors_affected.insert(*it);
-    if (it == *current_cursor) {
-      *current_cursor = result;
+  size_t index = cursors_set->LowerBoundIndex(transformation.range.begin);
+  if (IsLinesShift(transformation)) {
+    size_t begin = index;
+    // Explicitly set the cursors that get clamped; shift the rest lazily.
+    while (index < cursors_set->size()) {
+      LineColumn position = cursors_set->Get(index);
+      LineColumn output = transformation.Transform(position);
+      if (output.line == position.line + transformation.add_to_line) {
+        break;
+      }
+      cursors_set->Set(index++, output);
     }
-    cursors_set->erase(it++);
+    cursors_set->AddToLines(index, transformation.add_to_line);
+    // Shifting preserves the order, but clamping doesn't: the cursors clamped
+    // to the same line keep their columns, so they can end up out of order
+    // among themselves and with their neighbors.
+    SortIfUnordered(begin, index, cursors_set);
+    return;
   }
 
-  // Apply the transformation and add the cursors back.
-  for (auto it = cursors_affected.begin(); it != cursors_affected.end(); ++it) {
-    auto position = transformation.Transform(*it);
-
-    auto result = cursors_set->insert(position);
-    if (it == *current_cursor) {
-      *current_cursor = result;
-    }
+  size_t end = cursors_set->LowerBoundIndex(transformation.range.end);
+  for (size_t i = index; i < end; i++) {
+    cursors_set->Set(i, transformation.Transform(cursors_set->Get(i)));
   }
+  // Transformations normally preserve the order, but verify it.
+  SortIfUnordered(index, end, cursors_set);
 }
 
 bool IsNoop(const CursorsTracker::Transformation& t) {
@@ -156,6 +496,13 @@ bool IsNoop(const CursorsTracker::Transformation& t) {
 }
 
 void CursorsTracker::AdjustCursors(Transformation transformation) {
+  if (batch_ != nullptr) {
+    batch_->Adjust(transformation);
+  }
+  PushTransformation(transformation);
+}
+
+void CursorsTracker::PushTransformation(Transformation transformation) {
   auto output = DelayTransformations();
 
   // Remove unnecessary output_line_ge.
@@ -204,7 +551,7 @@ void CursorsTracker::AdjustCursors(Transformation transformation) {
                              last.transformation.range.begin.line));
     transformation = last.transformation;
     transformations_.pop_back();
-    AdjustCursors(transformation);
+    PushTransformation(transformation);
     return;
   }
 
@@ -222,7 +569,7 @@ void CursorsTracker::AdjustCursors(Transformation transformation) {
     last.transformation.add_to_column += transformation.add_to_column;
     transformation = last.transformation;
     transformations_.pop_back();
-    AdjustCursors(transformation);
+    PushTransformation(transformation);
     return;
   }
 
@@ -247,8 +594,8 @@ void CursorsTracker::AdjustCursors(Transformation transformation) {
     transformation.range.end.line += transformation.add_to_line;
     transformation.add_to_line = 0;
     transformations_.pop_back();
-    AdjustCursors(transformation);
-    AdjustCursors(previous);
+    PushTransformation(transformation);
+    PushTransformation(previous);
     return;
   }
 
@@ -269,7 +616,7 @@ void CursorsTracker::AdjustCursors(Transformation transformation) {
       last.transformation.add_to_line += transformation.add_to_line;
       transformation = last.transformation;
       transformations_.pop_back();
-      AdjustCursors(transformation);
+      PushTransformation(transformation);
       return;
     }
     if (transformation.range.end == last.transformation.range.begin &&
@@ -278,7 +625,7 @@ void CursorsTracker::AdjustCursors(Transformation transformation) {
       last.transformation.range.begin = transformation.range.begin;
       transformation = last.transformation;
       transformations_.pop_back();
-      AdjustCursors(transformation);
+      PushTransformation(transformation);
       return;
     } else {
       LOG(INFO) << "Skip: " << last << " - " << transformation;
@@ -291,8 +638,8 @@ void CursorsTracker::AdjustCursors(Transformation transformation) {
     // Swap the order.
     Transformation previous = last.transformation;
     transformations_.pop_back();
-    AdjustCursors(transformation);
-    AdjustCursors(previous);
+    PushTransformation(transformation);
+    PushTransformation(previous);
     return;
   }
 
@@ -303,23 +650,28 @@ void CursorsTracker::ApplyTransformationToCursors(
     CursorsSet* cursors, std::function<LineColumn(LineColumn)> callback) {
   CHECK(cursors != nullptr);
   LOG(INFO) << "Applying transformation to cursors: " << cursors->size();
-  CHECK(already_applied_cursors_.empty());
-  bool adjusted_current_cursor = false;
-  while (!cursors->empty()) {
-    auto new_position = callback(*cursors->begin());
-
-    auto insert_result = already_applied_cursors_.insert(new_position);
-    if (cursors->begin() == current_cursor_) {
-      VLOG(6) << "Adjusting default cursor (multiple): " << *insert_result;
-      current_cursor_ = insert_result;
-      adjusted_current_cursor = true;
-    }
-    cursors->erase(cursors->begin());
+  CHECK(batch_ == nullptr);
+  CHECK(delay_transformations_.expired());
+
+  CHECK(cursors == current_cursors_);
+
+  BatchedCursors batch(*cursors);
+
+  // While the callbacks run, leave just the current cursor in the set, so that
+  // position() remains valid.
+  LineColumn current_position = cursors->current();
+  cursors->clear();
+  cursors->insert(current_position);
+
+  {
+    auto delay = DelayTransformations();
+    batch_ = &batch;
+    batch.ProcessAll(callback);
+    batch_ = nullptr;
   }
 
-  cursors->swap(already_applied_cursors_);
-  CHECK(adjusted_current_cursor);
-  LOG(INFO) << "Current cursor at: " << *current_cursor_;
+  batch.Flush(cursors);
+  LOG(INFO) << "Current cursor at: " << position();
 }
 
 size_t CursorsTracker::Push() {
@@ -334,7 +686,8 @@ size_t CursorsTracker::Pop() {
 
   cursors_[L""].swap(cursors_stack_.back());
   cursors_stack_.pop_back();
-  current_cursor_ = cursors_[L""].begin();
+  current_cursors_ = &cursors_[L""];
+  current_cursors_->set_current_index(0);
 
   return cursors_stack_.size() + 1;
 }
@@ -359,12 +712,11 @@ void CursorsTracker::ApplyTransformation(const Transformation& transformation) {
     return;
   }
   for (auto& cursors_set : cursors_) {
-    AdjustCursorsSet(transformation, &cursors_set.second, &current_cursor_);
+    AdjustCursorsSet(transformation, &cursors_set.second);
   }
   for (auto& cursors_set : cursors_stack_) {
-    AdjustCursorsSet(transformation, &cursors_set, &current_cursor_);
+    AdjustCursorsSet(transformation, &cursors_set);
   }
-  AdjustCursorsSet(transformation, &already_applied_cursors_, &current_cursor_);
 }
 
 std::ostream& operator<<(std::ostream& os,
@@ -15,8 +15,77 @@
 namespace afc {
 namespace editor {
 
-typedef std::multiset<LineColumn> CursorsSet;
+// A sorted (multi)set of cursors, stored in a flat array.
+//
+// Transformations that shift the lines of every cursor starting at a given
+// index (which is what most edits do) are applied lazily in O(log n): the
+// deltas are kept in a Fenwick tree indexed by position in the array and are
+// only folded into the positions when the array is iterated or modified
+// structurally (insertions and deletions), in O(n).
+//
+// Each set also keeps track of its current cursor, adjusting its index as
+// cursors are inserted or erased.
+class CursorsSet {
+ public:
+  using value_type = LineColumn;
+  using const_iterator = std::vector<LineColumn>::const_iterator;
+  using iterator = const_iterator;
+
+  bool empty() const { return cursors_.empty(); }
+  size_t size() const { return cursors_.size(); }
+
+  iterator begin() const;
+  iterator end() const;
+  iterator find(LineColumn position) const;
+  iterator lower_bound(LineColumn position) const;
+
+  // Inserts position after any equal positions.
+  iterator insert(LineColumn position);
+  template <typename Iterator>
+  void insert(Iterator begin, Iterator end) {
+    while (begin != end) {
+      insert(*begin);
+      ++begin;
+    }
+  }
+
+  // If the current cursor is erased, the next cursor (or the first, if the
+  // current was the last) becomes the current cursor.
+  iterator erase(iterator position);
+  void clear();
+  void swap(CursorsSet& other);
+
+  size_t current_index() const { return current_index_; }
+  void set_current_index(size_t index);
+  LineColumn current() const { return Get(current_index_); }
+
+  // Low-level functions used to apply transformations. They run in
+  // logarithmic time, without folding pending deltas.
+
+  LineColumn Get(size_t index) const;
+  // The caller must ensure that the order is preserved or call Sort.
+  void Set(size_t index, LineColumn position);
+  // Adds delta to the lines of all cursors with index >= first.
+  void AddToLines(size_t first, int delta);
+  // Returns the index of the first cursor that isn't smaller than position.
+  size_t LowerBoundIndex(LineColumn position) const;
+  // Restores the order after calls to Set, retaining the current cursor.
+  void Sort();
+
+ private:
+  // Folds the pending deltas into cursors_.
+  void Flatten() const;
+  size_t PendingLineDelta(size_t index) const;
+
+  // The line of each entry is relative to the pending deltas in line_deltas_.
+  mutable std::vector<LineColumn> cursors_;
+  // A Fenwick tree (1-based) with the pending line deltas. Empty if there are
+  // no pending deltas. Uses modular arithmetic.
+  mutable std::vector<size_t> line_deltas_;
+  size_t current_index_ = 0;
+};
 
+class BatchedCursors;
 class ExtendedTransformation;
 
 class CursorsTracker {
@@ -89,8 +158,7 @@ class CursorsTracker {
   // and set that as the current cursor.
   void MoveCurrentCursor(CursorsSet* cursors, LineColumn position);
 
-  // current_cursor_ must be a value in cursors. cursors must have at least two
-  // elements.
+  // cursors must have at least two elements.
   void DeleteCurrentCursor(CursorsSet* cursors);
 
   CursorsSet* FindOrCreateCursors(const std::wstring& name) {
@@ -106,6 +174,16 @@ class CursorsTracker {
   // position.
   void AdjustCursors(Transformation transformation);
 
+  // Runs callback once for every cursor in cursors (which must contain the
+  // current cursor) and leaves each cursor at the returned position. The
+  // callback may modify the buffer (calling AdjustCursors).
+  //
+  // The cursors are visited in descending order in a single sweep, so that
+  // modifications done for one cursor don't affect the positions of the
+  // cursors that haven't been visited. The adjustments to the cursors already
+  // visited are accumulated lazily (see BatchedCursors) and the adjustments to
+  // the other sets of cursors are delayed until the sweep is done, which
+  // avoids reshuffling every set after every single modification.
   void ApplyTransformationToCursors(
       CursorsSet* cursors, std::function<LineColumn(LineColumn)> callback);
 
@@ -118,21 +196,21 @@ class CursorsTracker {
   std::shared_ptr<bool> DelayTransformations();
 
  private:
+  // Adds transformation to transformations_, collapsing it with the previous
+  // transformations when possible.
+  void PushTransformation(Transformation transformation);
   void ApplyTransformation(const Transformation& transformation);
 
   // Contains a family of cursors.
   std::map<std::wstring, CursorsSet> cursors_;
 
-  // While we're applying a transformation to a set of cursors, we need to
-  // remember what cursors it has already been applied to. To do that, we
-  // gradually drain the original set of cursors and add them here as we apply
-  // the transformation to them. We can't just loop over the set of cursors
-  // since each transformation will likely reshuffle them. Once the source of
-  // cursors to modify is empty, we just swap it back with this.
-  CursorsSet already_applied_cursors_;
+  // While ApplyTransformationToCursors is running, points to the cursors that
+  // it's processing (which have been removed from their set). Every
+  // transformation received is also applied to them.
+  BatchedCursors* batch_ = nullptr;
 
-  // Points to an entry in a value in cursors_.
-  CursorsSet::iterator current_cursor_;
+  // Points to a value in cursors_; its current cursor is the current cursor.
+  CursorsSet* current_cursors_;
 
   // A stack of sets of cursors on which PushActiveCursors and PopActiveCursors
   // operate.
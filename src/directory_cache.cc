@@ -0,0 +1,117 @@
+#include "directory_cache.h"
+
+extern "C" {
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+}
+
+#include <glog/logging.h>
+
+#include "wstring.h"
+
+namespace afc {
+namespace editor {
+
+namespace {
+// The resolution of modification times can be coarse (e.g., one tick of the
+// kernel clock); directories modified in the last few seconds aren't trusted.
+const time_t kRacySeconds = 2;
+
+bool Stat(const wstring& path, struct timespec* mtime) {
+  struct stat info;
+  if (stat(ToByteString(path).c_str(), &info) == -1) {
+    *mtime = {0, 0};
+    return false;
+  }
+  *mtime = info.st_mtim;
+  return true;
+}
+}  // namespace
+
+DirectoryCache::DirectoryCache(size_t max_directories)
+    : max_directories_(max_directories) {}
+
+std::shared_ptr<const DirectoryCache::Listing> DirectoryCache::Get(
+    const wstring& path) {
+  struct timespec mtime;
+  auto listing = GetValid(path, &mtime);
+  if (listing != nullptr) {
+    VLOG(6) << "Directory listing is valid: " << path;
+    return listing;
+  }
+
+  listing = Read(path);
+  std::unique_lock<std::mutex> lock(mutex_);
+  directories_read_++;
+  if (listings_.size() >= max_directories_ &&
+      listings_.find(path) == listings_.end()) {
+    LOG(INFO) << "Directory cache is full, clearing it.";
+    listings_.clear();
+  }
+  CachedListing& entry = listings_[path];
+  entry.mtime = mtime;
+  entry.racy = listing->exists && time(nullptr) - mtime.tv_sec < kRacySeconds;
+  entry.listing = listing;
+  return listing;
+}
+
+bool DirectoryCache::Contains(const wstring& path) {
+  struct timespec mtime;
+  return GetValid(path, &mtime) != nullptr;
+}
+
+size_t DirectoryCache::directories_read() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return directories_read_;
+}
+
+std::shared_ptr<const DirectoryCache::Listing> DirectoryCache::GetValid(
+    const wstring& path, struct timespec* mtime) {
+  bool exists = Stat(path, mtime);
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = listings_.find(path);
+  if (it == listings_.end() || it->second.racy ||
+      it->second.listing->exists != exists ||
+      it->second.mtime.tv_sec != mtime->tv_sec ||
+      it->second.mtime.tv_nsec != mtime->tv_nsec) {
+    return nullptr;
+  }
+  return it->second.listing;
+}
+
+/* static */ std::shared_ptr<const DirectoryCache::Listing>
+DirectoryCache::Read(const wstring& path) {
+  auto listing = std::make_shared<Listing>();
+  LOG(INFO) << "Reading directory: " << path;
+  std::unique_ptr<DIR, decltype(&closedir)> dir(
+      opendir(ToByteString(path).c_str()), &closedir);
+  if (dir == nullptr) {
+    LOG(INFO) << "Unable to open directory: " << path;
+    return listing;
+  }
+  listing->exists = true;
+  struct dirent* entry;
+  while ((entry = readdir(dir.get())) != nullptr) {
+    std::string name = entry->d_name;
+    if (name == "." || name == "..") {
+      continue;
+    }
+    Entry output;
+    output.name = FromByteString(name);
+    output.is_directory = entry->d_type == DT_DIR;
+    if (entry->d_type == DT_UNKNOWN) {
+      // Some file systems (e.g., some network file systems) don't fill d_type.
+      struct stat info;
+      output.is_directory =
+          lstat((ToByteString(path) + "/" + name).c_str(), &info) != -1 &&
+          S_ISDIR(info.st_mode);
+    }
+    listing->entries.push_back(std::move(output));
+  }
+  VLOG(5) << "Directory entries: " << path << ": " << listing->entries.size();
+  return listing;
+}
+
+}  // namespace editor
+}  // namespace afc
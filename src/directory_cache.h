@@ -0,0 +1,75 @@
+#ifndef __AFC_EDITOR_DIRECTORY_CACHE_H__
+#define __AFC_EDITOR_DIRECTORY_CACHE_H__
+
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace afc {
+namespace editor {
+
+using std::wstring;
+
+// Caches the listings of directories.
+//
+// A listing is reused as long as the modification time of its directory
+// (which changes whenever entries are added to it or removed from it) doesn't
+// change, unless the directory was modified too recently for its modification
+// time to be trusted. Validating a listing costs a stat, which is much cheaper
+// than reading the directory again (especially on network file systems).
+//
+// Thread-safe.
+class DirectoryCache {
+ public:
+  struct Entry {
+    wstring name;
+    bool is_directory = false;
+  };
+
+  struct Listing {
+    // False if the directory couldn't be opened.
+    bool exists = false;
+    // Excludes "." and "..".
+    std::vector<Entry> entries;
+  };
+
+  // Once the cache holds max_directories listings, it's cleared (which bounds
+  // the memory it uses).
+  explicit DirectoryCache(size_t max_directories = 4096);
+
+  // Never returns null.
+  std::shared_ptr<const Listing> Get(const wstring& path);
+
+  // Returns true if a valid listing of the directory is in the cache.
+  bool Contains(const wstring& path);
+
+  // The number of directories read so far.
+  size_t directories_read() const;
+
+ private:
+  struct CachedListing {
+    struct timespec mtime = {0, 0};
+    bool racy = false;
+    std::shared_ptr<const Listing> listing;
+  };
+
+  // Returns the cached listing of path if it's still valid, otherwise null.
+  // Sets mtime to the current modification time of path.
+  std::shared_ptr<const Listing> GetValid(const wstring& path,
+                                          struct timespec* mtime);
+  static std::shared_ptr<const Listing> Read(const wstring& path);
+
+  const size_t max_directories_;
+
+  mutable std::mutex mutex_;
+  size_t directories_read_ = 0;
+  std::unordered_map<wstring, CachedListing> listings_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_DIRECTORY_CACHE_H__
@@ -1,5 +1,7 @@
 #include "editor.h"
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <list>
@@ -29,6 +31,7 @@ extern "C" {
 #include "transformation_delete.h"
 #include "vm/public/callbacks.h"
 #include "vm/public/environment.h"
+#include "vm/public/function_call.h"
 #include "vm/public/value.h"
 #include "wstring.h"
 
@@ -78,12 +81,12 @@ void RegisterBufferMethod(ObjectType* editor_type, const wstring& name,
   // Returns nothing.
   callback->type.type_arguments = {VMType(VMType::VM_VOID),
                                    VMType::ObjectType(editor_type)};
-  callback->callback = [method](vector<unique_ptr<Value>> args,
-                                Trampoline* trampoline) {
+  callback->set_callback([method](vector<unique_ptr<Value>> args,
+                                  Trampoline* trampoline) {
     CHECK_EQ(args.size(), size_t(1));
     CHECK_EQ(args[0]->type, VMType::OBJECT_TYPE);
 
-    auto editor = static_cast<EditorState*>(args[0]->user_value.get());
+    auto editor = static_cast<EditorState*>(args[0]->user_value().get());
     CHECK(editor != nullptr);
 
     if (editor->has_current_buffer()) {
@@ -95,11 +98,24 @@ void RegisterBufferMethod(ObjectType* editor_type, const wstring& name,
       editor->ScheduleRedraw();
     }
     trampoline->Return(Value::NewVoid());
-  };
+  });
   editor_type->AddField(name, std::move(callback));
 }
 }  // namespace
 
+std::shared_ptr<OpenBuffer> EditorState::FindBufferWithEnvironment(
+    Environment* environment) const {
+  for (; environment != nullptr;
+       environment = environment->parent_environment()) {
+    for (const auto& buffer : buffers_) {
+      if (buffer.second->environment() == environment) {
+        return buffer.second;
+      }
+    }
+  }
+  return nullptr;
+}
+
 void EditorState::NotifyInternalEvent() {
   VLOG(5) << "Internal event notification!";
   if (write(pipe_to_communicate_internal_events_.second, " ", 1) == -1) {
@@ -121,7 +137,8 @@ Environment EditorState::BuildEditorEnvironment() {
             CHECK_EQ(args.size(), size_t(1));
             CHECK_EQ(args[0]->type, VMType::OBJECT_TYPE);
 
-            auto editor = static_cast<EditorState*>(args[0]->user_value.get());
+            auto editor =
+                static_cast<EditorState*>(args[0]->user_value().get());
             CHECK(editor != nullptr);
 
             if (!editor->has_current_buffer()) {
@@ -149,7 +166,8 @@ Environment EditorState::BuildEditorEnvironment() {
             CHECK_EQ(args.size(), size_t(1));
             CHECK_EQ(args[0]->type, VMType::OBJECT_TYPE);
 
-            auto editor = static_cast<EditorState*>(args[0]->user_value.get());
+            auto editor =
+                static_cast<EditorState*>(args[0]->user_value().get());
             CHECK(editor != nullptr);
 
             if (!editor->has_current_buffer()) {
@@ -200,6 +218,14 @@ Environment EditorState::BuildEditorEnvironment() {
       vm::NewCallback(std::function<void(wstring)>(
           [this](wstring target) { OpenServerBuffer(this, target); })));
 
+  environment.Define(
+      L"ConnectToWithProtocol",
+      vm::NewCallback(std::function<void(wstring, wstring)>(
+          [this](wstring target, wstring protocol) {
+            OpenServerBuffer(this, target,
+                             NegotiateServerProtocol(ToByteString(protocol)));
+          })));
+
   environment.Define(L"SetStatus", vm::NewCallback(std::function<void(wstring)>(
                                        [this](wstring s) { SetStatus(s); })));
 
@@ -207,6 +233,38 @@ Environment EditorState::BuildEditorEnvironment() {
       L"ScheduleRedraw",
       vm::NewCallback(std::function<void()>([this]() { ScheduleRedraw(); })));
 
+  environment.Define(
+      L"ScheduleTimer",
+      Value::NewFunction(
+          {VMType::Integer(), VMType::Integer(),
+           VMType::Function({VMType::Void()})},
+          [this](vector<Value::Ptr> args, Trampoline* trampoline) {
+            CHECK_EQ(args.size(), 2u);
+            CHECK_EQ(args[0]->type, VMType::VM_INTEGER);
+            CHECK_EQ(args[1]->type.type, VMType::FUNCTION);
+            std::shared_ptr<Value> callback = std::move(args[1]);
+            // The callback may depend on the environment of the buffer that
+            // scheduled it, so it must not run once the buffer is gone.
+            auto buffer = FindBufferWithEnvironment(trampoline->environment());
+            std::weak_ptr<OpenBuffer> weak_buffer = buffer;
+            bool has_buffer = buffer != nullptr;
+            auto id = timer_wheel_.Schedule(
+                std::chrono::milliseconds(std::max(0, args[0]->integer())),
+                [this, callback, weak_buffer, has_buffer]() {
+                  if (has_buffer && weak_buffer.expired()) {
+                    LOG(INFO) << "Skipping timer of deleted buffer.";
+                    return;
+                  }
+                  vm::Call(callback.get(), {}, [](Value::Ptr) {});
+                  ScheduleRedraw();
+                });
+            trampoline->Return(Value::NewInteger(static_cast<int>(id)));
+          }));
+
+  environment.Define(L"CancelTimer",
+                     vm::NewCallback(std::function<bool(int)>(
+                         [this](int id) { return timer_wheel_.Cancel(id); })));
+
   environment.Define(
       L"set_screen_needs_hard_redraw",
       vm::NewCallback(std::function<void(bool)>(
@@ -247,8 +305,8 @@ Environment EditorState::BuildEditorEnvironment() {
                            CHECK_EQ(args.size(), 2u);
                            CHECK_EQ(args[0]->type, VMType::VM_STRING);
                            ForkCommandOptions options;
-                           options.command = args[0]->str;
-                           options.enter = args[1]->boolean;
+                           options.command = args[0]->str();
+                           options.enter = args[1]->boolean();
                            return Value::NewObject(L"Buffer",
                                                    ForkCommand(this, options));
                          }));
@@ -262,7 +320,7 @@ Environment EditorState::BuildEditorEnvironment() {
             CHECK_EQ(args[0]->type, VMType::VM_STRING);
             OpenFileOptions options;
             options.editor_state = this;
-            options.path = args[0]->str;
+            options.path = args[0]->str();
             set_current_buffer(OpenFile(options));
             ScheduleRedraw();
             return Value::NewObject(L"Buffer", current_buffer()->second);
@@ -312,9 +370,25 @@ EditorState::EditorState(AudioPlayer* audio_player)
       status_prompt_(false),
       status_(L""),
       pipe_to_communicate_internal_events_(BuildPipe()),
+      line_marks_resolver_([this]() { NotifyInternalEvent(); }),
+      file_predictor_([this]() { NotifyInternalEvent(); }),
       audio_player_(audio_player) {
   LineColumn::Register(&environment_);
   Range::Register(&environment_);
+  int fd = fd_to_detect_internal_events();
+  if (fd != -1) {
+    internal_events_registration_ = event_loop_.Register(fd, [this, fd]() {
+      char buffer[4096];
+      VLOG(5) << "Internal events detected.";
+      while (read(fd, buffer, sizeof(buffer)) > 0) continue;
+      if (line_marks_resolver_.Publish(&line_marks_)) {
+        ScheduleRedraw();
+      }
+      if (file_predictor_.Publish()) {
+        ScheduleRedraw();
+      }
+    });
+  }
 }
 
 EditorState::~EditorState() {
@@ -391,6 +465,7 @@ bool EditorState::AttemptTermination(wstring* error_description,
 }
 
 void EditorState::ProcessInput(int c) {
+  redraw_scheduler_.InputReceived(RedrawScheduler::Clock::now());
   EditorMode* handler = keyboard_redirect().get();
   if (handler != nullptr) {
     // Pass.
@@ -447,15 +522,43 @@ void EditorState::MoveBufferBackwards(size_t times) {
   PushCurrentPosition();
 }
 
+void EditorState::ScheduleProgressRedraw() {
+  if (progress_redraw_scheduled_) {
+    return;
+  }
+  progress_redraw_scheduled_ = true;
+  timer_wheel_.Schedule(std::chrono::seconds(1), [this]() {
+    progress_redraw_scheduled_ = false;
+    for (auto& buffer : buffers_) {
+      if (buffer.second->ShouldDisplayProgress() ||
+          buffer.second->child_pid() != -1) {
+        ScheduleRedraw();
+        ScheduleProgressRedraw();
+        return;
+      }
+    }
+  });
+}
+
 void EditorState::ScheduleRedraw() {
   std::unique_lock<std::mutex> lock(mutex_);
   screen_state_.needs_redraw = true;
+  redraw_requested_ = true;
+}
+
+bool EditorState::TakeRedrawRequest() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  bool output = redraw_requested_;
+  redraw_requested_ = false;
+  return output;
 }
 
 EditorState::ScreenState EditorState::FlushScreenState() {
   std::unique_lock<std::mutex> lock(mutex_);
   ScreenState output = screen_state_;
   screen_state_ = ScreenState();
+  // The frame will show everything requested so far.
+  redraw_requested_ = false;
   return output;
 }
 
@@ -524,6 +627,8 @@ void EditorState::SetStatus(const wstring& status) {
   LOG(INFO) << "SetStatus: " << status;
   status_ = status;
   is_status_warning_ = false;
+  // The status is shown in every frame.
+  ScheduleRedraw();
   if (status_prompt_ || status.empty()) {
     return;
   }
@@ -538,9 +643,6 @@ void EditorState::SetStatus(const wstring& status) {
         buffer_variables::show_in_buffers_list(), false);
   }
   status_buffer_it.first->second->AppendLazyString(this, NewCopyString(status));
-  if (current_buffer_ == status_buffer_it.first) {
-    ScheduleRedraw();
-  }
 }
 
 void EditorState::SetWarningStatus(const wstring& status) {
@@ -10,13 +10,21 @@
 
 #include "audio.h"
 #include "buffer.h"
+#include "buffer_words_index.h"
 #include "command_mode.h"
 #include "direction.h"
 #include "editor_mode.h"
+#include "event_loop.h"
+#include "file_predictor_worker.h"
 #include "lazy_string.h"
 #include "line_marks.h"
+#include "line_marks_resolver.h"
 #include "modifiers.h"
+#include "path_crawler.h"
+#include "redraw_scheduler.h"
+#include "timer_wheel.h"
 #include "transformation.h"
+#include "vm/public/compilation_cache.h"
 #include "vm/public/environment.h"
 #include "vm/public/vm.h"
 
@@ -151,6 +159,10 @@ class EditorState {
 
   const LineMarks* line_marks() const { return &line_marks_; }
   LineMarks* line_marks() { return &line_marks_; }
+  LineMarksResolver* line_marks_resolver() { return &line_marks_resolver_; }
+  BufferWordsIndex* buffer_words_index() { return &buffer_words_index_; }
+  FilePredictorWorker* file_predictor() { return &file_predictor_; }
+  PathCrawler* path_crawler() { return &path_crawler_; }
 
   std::shared_ptr<MapModeCommands> default_commands() const {
     return default_commands_;
@@ -163,14 +175,27 @@ class EditorState {
   void MoveBufferBackwards(size_t times);
 
   void ScheduleRedraw();
+  // Returns true if a redraw has been requested (e.g., through ScheduleRedraw)
+  // since the last call.
+  bool TakeRedrawRequest();
   ScreenState FlushScreenState();
+  RedrawScheduler* redraw_scheduler() { return &redraw_scheduler_; }
+  // Deferred and periodic work. The main loop sleeps until the next timer is
+  // due (or input arrives).
+  TimerWheel* timer_wheel() { return &timer_wheel_; }
+  // While some buffer shows progress (e.g., it's reading from a file or has a
+  // running subprocess), redraws the screen once per second (so that the
+  // durations and progress indicators shown are updated).
+  void ScheduleProgressRedraw();
   void set_screen_needs_redraw(bool value) {
     std::unique_lock<std::mutex> lock(mutex_);
     screen_state_.needs_redraw = value;
+    redraw_requested_ |= value;
   }
   void set_screen_needs_hard_redraw(bool value) {
     std::unique_lock<std::mutex> lock(mutex_);
     screen_state_.needs_hard_redraw = value;
+    redraw_requested_ |= value;
   }
 
   void PushCurrentPosition();
@@ -198,6 +223,8 @@ class EditorState {
   void ApplyToCurrentBuffer(unique_ptr<Transformation> transformation);
 
   Environment* environment() { return &environment_; }
+  // Shared by all buffers, so that hooks are only compiled once.
+  CompilationCache* compilation_cache() { return &compilation_cache_; }
 
   // Meant to be used to construct afc::vm::Evaluator::ErrorHandler instances.
   void DefaultErrorHandler(const wstring& error_description);
@@ -223,6 +250,10 @@ class EditorState {
 
   void NotifyInternalEvent();
 
+  // The main loop waits on this. Buffers register the file descriptors from
+  // which they read; fd_to_detect_internal_events is always registered.
+  EventLoop* event_loop() { return &event_loop_; }
+
   AudioPlayer* audio_player() const { return audio_player_; }
 
   // Can return null.
@@ -235,12 +266,20 @@ class EditorState {
 
  private:
   Environment BuildEditorEnvironment();
+  // Returns the buffer whose environment is environment (or one of its
+  // ancestors), or nullptr if there is none (e.g., for the editor's own
+  // environment).
+  std::shared_ptr<OpenBuffer> FindBufferWithEnvironment(
+      Environment* environment) const;
 
   // While processing input, buffers add themselves here if they need to have
   // their tree re-scanned. Once the chunk of input has been fully processed,
   // we flush the updates. ~OpenBuffer removes entries from here.
   std::unordered_set<OpenBuffer*> buffers_to_parse_;
 
+  // Buffers update it from their background threads (so it must outlive them).
+  BufferWordsIndex buffer_words_index_;
+
   map<wstring, shared_ptr<OpenBuffer>> buffers_;
   map<wstring, shared_ptr<OpenBuffer>>::iterator current_buffer_;
   // TODO: Turn exit_value_ into a std::optional<int> and get rid of terminate_.
@@ -251,6 +290,7 @@ class EditorState {
   vector<wstring> edge_path_;
 
   Environment environment_;
+  CompilationCache compilation_cache_;
 
   wstring last_search_query_;
 
@@ -263,6 +303,12 @@ class EditorState {
 
   std::mutex mutex_;
   ScreenState screen_state_;
+  bool redraw_requested_ = false;
+
+  // Only used from the main thread.
+  RedrawScheduler redraw_scheduler_;
+  TimerWheel timer_wheel_;
+  bool progress_redraw_scheduled_ = false;
 
   bool status_prompt_;
   bool is_status_warning_ = false;
@@ -284,6 +330,17 @@ class EditorState {
   // threads write to the write end to trigger that.
   const std::pair<int, int> pipe_to_communicate_internal_events_;
 
+  EventLoop event_loop_;
+  std::unique_ptr<EventLoop::Registration> internal_events_registration_;
+
+  // Notifies through the internal events pipe (so it must be deleted before
+  // it); its marks are published when internal events are detected.
+  LineMarksResolver line_marks_resolver_;
+  // Same as line_marks_resolver_: its predictions are published when internal
+  // events are detected.
+  FilePredictorWorker file_predictor_;
+  PathCrawler path_crawler_;
+
   AudioPlayer* const audio_player_;
 };
 
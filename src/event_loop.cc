@@ -0,0 +1,127 @@
+#include "event_loop.h"
+
+#include <cstring>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include <sys/epoll.h>
+#include <unistd.h>
+}
+
+#include <glog/logging.h>
+
+namespace afc {
+namespace editor {
+
+struct EventLoop::Registration::State {
+  ~State() { close(epoll_fd); }
+
+  void Unregister(size_t id) {
+    auto it = entries.find(id);
+    CHECK(it != entries.end());
+    if (it->second.polled) {
+      if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr) == -1) {
+        LOG(INFO) << "epoll_ctl (DEL) failed: " << it->second.fd << ": "
+                  << strerror(errno);
+      }
+    } else {
+      always_ready.erase(id);
+    }
+    entries.erase(it);
+  }
+
+  struct Entry {
+    int fd;
+    // Shared so that Wait can retain it while running it, in case it
+    // unregisters itself.
+    std::shared_ptr<std::function<void()>> callback;
+    // False for file descriptors that epoll doesn't support.
+    bool polled;
+  };
+
+  const int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  size_t next_id = 0;
+  // Registrations are identified by an id (rather than the file descriptor)
+  // so that Wait can detect that a file descriptor was closed and reused by a
+  // previous callback.
+  std::unordered_map<size_t, Entry> entries;
+  std::set<size_t> always_ready;
+};
+
+EventLoop::Registration::Registration(std::weak_ptr<State> state, size_t id)
+    : state_(std::move(state)), id_(id) {}
+
+EventLoop::Registration::~Registration() {
+  auto state = state_.lock();
+  if (state != nullptr) {
+    state->Unregister(id_);
+  }
+}
+
+EventLoop::EventLoop() : state_(std::make_shared<Registration::State>()) {
+  PCHECK(state_->epoll_fd != -1) << "epoll_create1 failed";
+}
+
+EventLoop::~EventLoop() = default;
+
+std::unique_ptr<EventLoop::Registration> EventLoop::Register(
+    int fd, std::function<void()> callback) {
+  CHECK_NE(fd, -1);
+  CHECK(callback);
+  size_t id = state_->next_id++;
+  Registration::State::Entry entry;
+  entry.fd = fd;
+  entry.callback = std::make_shared<std::function<void()>>(std::move(callback));
+  entry.polled = true;
+
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN | EPOLLPRI;
+  event.data.u64 = id;
+  if (epoll_ctl(state_->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+    PCHECK(errno == EPERM) << "epoll_ctl (ADD) failed: " << fd;
+    VLOG(5) << "File descriptor not supported by epoll: " << fd;
+    entry.polled = false;
+    state_->always_ready.insert(id);
+  }
+  state_->entries.insert({id, std::move(entry)});
+  return std::unique_ptr<Registration>(new Registration(state_, id));
+}
+
+int EventLoop::Wait(int timeout_ms) {
+  static const int kMaxEvents = 64;
+  struct epoll_event events[kMaxEvents];
+  int events_count =
+      epoll_wait(state_->epoll_fd, events, kMaxEvents,
+                 state_->always_ready.empty() ? timeout_ms : 0);
+  if (events_count == -1) {
+    PCHECK(errno == EINTR) << "epoll_wait failed";
+    return -1;
+  }
+
+  std::vector<size_t> ready(state_->always_ready.begin(),
+                            state_->always_ready.end());
+  for (int i = 0; i < events_count; i++) {
+    ready.push_back(events[i].data.u64);
+  }
+
+  int callbacks = 0;
+  for (size_t id : ready) {
+    auto it = state_->entries.find(id);
+    if (it == state_->entries.end()) {
+      VLOG(5) << "Registration deleted by a previous callback: " << id;
+      continue;
+    }
+    auto callback = it->second.callback;
+    (*callback)();
+    callbacks++;
+  }
+  return callbacks;
+}
+
+size_t EventLoop::size() const { return state_->entries.size(); }
+
+}  // namespace editor
+}  // namespace afc
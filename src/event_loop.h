@@ -0,0 +1,57 @@
+#ifndef __AFC_EDITOR_EVENT_LOOP_H__
+#define __AFC_EDITOR_EVENT_LOOP_H__
+
+#include <functional>
+#include <memory>
+
+namespace afc {
+namespace editor {
+
+// Waits for file descriptors to become readable and runs their callbacks.
+//
+// File descriptors are registered once (rather than on every iteration) and
+// the cost of each call to Wait is proportional to the number of descriptors
+// that are ready, not to the number registered. It's backed by epoll; file
+// descriptors that epoll doesn't support (regular files, which are always
+// readable) are simply reported as ready on every call.
+class EventLoop {
+ public:
+  // Unregisters the file descriptor when deleted. Must be deleted before the
+  // file descriptor is closed. May outlive the loop.
+  class Registration {
+   public:
+    ~Registration();
+
+   private:
+    friend class EventLoop;
+    struct State;
+    Registration(std::weak_ptr<State> state, size_t id);
+
+    const std::weak_ptr<State> state_;
+    const size_t id_;
+  };
+
+  EventLoop();
+  ~EventLoop();
+
+  // Runs callback from Wait whenever fd is readable (or has been closed by the
+  // other end). The callback may register or unregister file descriptors
+  // (including its own).
+  std::unique_ptr<Registration> Register(int fd, std::function<void()> callback);
+
+  // Waits at most timeout_ms (or indefinitely, if -1) for registered file
+  // descriptors to be ready and runs their callbacks. Returns the number of
+  // callbacks ran, or -1 if interrupted by a signal.
+  int Wait(int timeout_ms);
+
+  // The number of registered file descriptors.
+  size_t size() const;
+
+ private:
+  std::shared_ptr<Registration::State> state_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_EVENT_LOOP_H__
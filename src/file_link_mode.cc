@@ -28,6 +28,7 @@ extern "C" {
 #include "run_command_handler.h"
 #include "search_handler.h"
 #include "server.h"
+#include "undo_journal.h"
 #include "vm/public/callbacks.h"
 #include "vm/public/value.h"
 #include "wstring.h"
@@ -89,46 +90,11 @@ class FileBuffer : public OpenBuffer {
   }
 
   bool PersistState() const override {
-    auto path_vector = editor_->edge_path();
-    if (path_vector.empty()) {
-      LOG(INFO) << "Empty edge path.";
+    wstring path;
+    if (!PrepareStateDirectory(&path)) {
       return false;
     }
 
-    auto file_path = Read(buffer_variables::path());
-    list<wstring> file_path_components;
-    if (file_path.empty() || file_path[0] != '/') {
-      LOG(INFO) << "Empty edge path.";
-      return false;
-    }
-
-    if (!DirectorySplit(file_path, &file_path_components)) {
-      LOG(INFO) << "Unable to split path: " << file_path;
-      return false;
-    }
-
-    file_path_components.push_front(L"state");
-
-    wstring path = path_vector[0];
-    LOG(INFO) << "PersistState: Preparing directory for state: " << path;
-    for (auto& component : file_path_components) {
-      path = PathJoin(path, component);
-      struct stat stat_buffer;
-      auto path_byte_string = ToByteString(path);
-      if (stat(path_byte_string.c_str(), &stat_buffer) != -1) {
-        if (S_ISDIR(stat_buffer.st_mode)) {
-          continue;
-        }
-        LOG(INFO) << "Ooops, exists, but is not a directory: " << path;
-        return false;
-      }
-      if (mkdir(path_byte_string.c_str(), 0700)) {
-        editor_->SetStatus(L"mkdir: " + FromByteString(strerror(errno)) +
-                           L": " + path);
-        return false;
-      }
-    }
-
     path = PathJoin(path, L".edge_state");
     LOG(INFO) << "PersistState: Preparing state file: " << path;
     BufferContents contents;
@@ -186,6 +152,12 @@ class FileBuffer : public OpenBuffer {
     }
 
     if (!S_ISDIR(stat_buffer_.st_mode)) {
+      wstring state_directory;
+      if (target->Read(buffer_variables::clear_on_reload()) &&
+          PrepareStateDirectory(&state_directory)) {
+        target->SetUndoJournal(std::make_unique<UndoJournal>(
+            PathJoin(state_directory, L".edge_undo")));
+      }
       char* tmp = strdup(path_raw.c_str());
       if (0 == strcmp(basename(tmp), "passwd")) {
         RunCommandHandler(L"parsers/passwd <" + path, editor_state, {});
@@ -264,6 +236,7 @@ class FileBuffer : public OpenBuffer {
       return;
     }
     ClearModified();
+    UndoJournalSaved();
     editor_state->SetStatus(L"Saved: " + path);
     for (const auto& dir : editor_state->edge_path()) {
       EvaluateFile(editor_state, dir + L"/hooks/buffer-save.cc");
@@ -335,6 +308,52 @@ class FileBuffer : public OpenBuffer {
     });
   }
 
+  // Creates (if needed) the directory in the first element of the edge path
+  // where the state of this file is stored. Returns false on failure.
+  bool PrepareStateDirectory(wstring* output) const {
+    auto path_vector = editor_->edge_path();
+    if (path_vector.empty()) {
+      LOG(INFO) << "Empty edge path.";
+      return false;
+    }
+
+    auto file_path = Read(buffer_variables::path());
+    list<wstring> file_path_components;
+    if (file_path.empty() || file_path[0] != '/') {
+      LOG(INFO) << "Empty edge path.";
+      return false;
+    }
+
+    if (!DirectorySplit(file_path, &file_path_components)) {
+      LOG(INFO) << "Unable to split path: " << file_path;
+      return false;
+    }
+
+    file_path_components.push_front(L"state");
+
+    wstring path = path_vector[0];
+    LOG(INFO) << "PersistState: Preparing directory for state: " << path;
+    for (auto& component : file_path_components) {
+      path = PathJoin(path, component);
+      struct stat stat_buffer;
+      auto path_byte_string = ToByteString(path);
+      if (stat(path_byte_string.c_str(), &stat_buffer) != -1) {
+        if (S_ISDIR(stat_buffer.st_mode)) {
+          continue;
+        }
+        LOG(INFO) << "Ooops, exists, but is not a directory: " << path;
+        return false;
+      }
+      if (mkdir(path_byte_string.c_str(), 0700)) {
+        editor_->SetStatus(L"mkdir: " + FromByteString(strerror(errno)) +
+                           L": " + path);
+        return false;
+      }
+    }
+    *output = path;
+    return true;
+  }
+
   wstring GetPath() const { return Read(buffer_variables::path()); }
 
   struct stat stat_buffer_;
@@ -342,7 +361,9 @@ class FileBuffer : public OpenBuffer {
 
 static wstring realpath_safe(const wstring& path) {
   char* result = realpath(ToByteString(path).c_str(), nullptr);
-  return result == nullptr ? path : FromByteString(result);
+  wstring output = result == nullptr ? path : FromByteString(result);
+  free(result);
+  return output;
 }
 
 static bool CanStatPath(const wstring& path) {
@@ -360,6 +381,27 @@ static bool CanStatPath(const wstring& path) {
 bool FindPath(EditorState* editor_state, vector<wstring> search_paths,
               wstring path, std::function<bool(const wstring&)> validator,
               wstring* resolved_path, LineColumn* position, wstring* pattern) {
+  return FindPathInSearchPaths(
+      std::move(search_paths), editor_state->expand_path(path),
+      [&validator](const wstring& candidate) {
+        return validator(candidate) ? realpath_safe(candidate) : L"";
+      },
+      resolved_path, position, pattern);
+}
+
+static bool FindPath(EditorState* editor_state, vector<wstring> search_paths,
+                     const wstring& path, wstring* resolved_path,
+                     LineColumn* position, wstring* pattern) {
+  return FindPath(editor_state, search_paths, path, CanStatPath, resolved_path,
+                  position, pattern);
+}
+
+}  // namespace
+
+bool FindPathInSearchPaths(vector<wstring> search_paths, const wstring& path,
+                           std::function<wstring(const wstring&)> resolve,
+                           wstring* resolved_path, LineColumn* position,
+                           wstring* pattern) {
   LineColumn position_dummy;
   if (position == nullptr) {
     position = &position_dummy;
@@ -375,7 +417,6 @@ bool FindPath(EditorState* editor_state, vector<wstring> search_paths,
     search_paths.push_back(L"");
   }
 
-  path = editor_state->expand_path(path);
   if (!path.empty() && path[0] == L'/') {
     search_paths = {L""};
   }
@@ -390,7 +431,8 @@ bool FindPath(EditorState* editor_state, vector<wstring> search_paths,
                : L"") +
           path.substr(0, str_end);
 
-      if (!validator(path_with_prefix)) {
+      wstring candidate = resolve(path_with_prefix);
+      if (candidate.empty()) {
         continue;
       }
 
@@ -416,10 +458,10 @@ bool FindPath(EditorState* editor_state, vector<wstring> search_paths,
               value--;
             }
           } catch (const std::invalid_argument& ia) {
-            LOG(INFO) << "stoi failed: invalid argument: " << arg;
+            VLOG(5) << "stoi failed: invalid argument: " << arg;
             break;
           } catch (const std::out_of_range& ia) {
-            LOG(INFO) << "stoi failed: out of range: " << arg;
+            VLOG(5) << "stoi failed: out of range: " << arg;
             break;
           }
           (i == 0 ? position->line : position->column) = value;
@@ -429,7 +471,7 @@ bool FindPath(EditorState* editor_state, vector<wstring> search_paths,
           break;
         }
       }
-      *resolved_path = realpath_safe(path_with_prefix);
+      *resolved_path = candidate;
       VLOG(4) << "Resolved path: " << *resolved_path;
       return true;
     }
@@ -437,15 +479,6 @@ bool FindPath(EditorState* editor_state, vector<wstring> search_paths,
   return false;
 }
 
-static bool FindPath(EditorState* editor_state, vector<wstring> search_paths,
-                     const wstring& path, wstring* resolved_path,
-                     LineColumn* position, wstring* pattern) {
-  return FindPath(editor_state, search_paths, path, CanStatPath, resolved_path,
-                  position, pattern);
-}
-
-}  // namespace
-
 using std::unique_ptr;
 
 shared_ptr<OpenBuffer> GetSearchPathsBuffer(EditorState* editor_state) {
@@ -69,6 +69,15 @@ struct ResolvePathOptions {
 
 bool ResolvePath(ResolvePathOptions options);
 
+// The part of ResolvePath that doesn't depend on the editor (so that it can
+// run in any thread): path must already be expanded. resolve receives each
+// candidate path and returns the absolute path that should be used for it, or
+// an empty string if the file doesn't exist.
+bool FindPathInSearchPaths(vector<wstring> search_paths, const wstring& path,
+                           std::function<wstring(const wstring&)> resolve,
+                           wstring* resolved_path, LineColumn* position,
+                           wstring* pattern);
+
 // Creates a new buffer for the file at the path given.
 map<wstring, shared_ptr<OpenBuffer>>::iterator OpenFile(
     const OpenFileOptions& options);
@@ -0,0 +1,227 @@
+#include "file_predictor_worker.h"
+
+#include <algorithm>
+#include <cwctype>
+
+#include <glog/logging.h>
+
+#include "wstring.h"
+
+namespace afc {
+namespace editor {
+
+namespace {
+// Listing directories is mostly waiting for the file system, so this can be
+// larger than the number of processors.
+const size_t kMaxThreads = 8;
+
+// The maximum number of subdirectories read ahead after each request.
+const size_t kMaxReadAhead = 64;
+
+wstring LowerCase(const wstring& input) {
+  wstring output(input);
+  for (auto& c : output) {
+    c = towlower(c);
+  }
+  return output;
+}
+}  // namespace
+
+FilePredictorWorker::FilePredictorWorker(std::function<void()> notify)
+    : notify_(std::move(notify)) {
+  CHECK(notify_);
+}
+
+FilePredictorWorker::~FilePredictorWorker() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+    generation_++;
+  }
+  condition_.notify_all();
+  if (background_thread_.joinable()) {
+    background_thread_.join();
+  }
+}
+
+void FilePredictorWorker::Predict(std::vector<Query> queries,
+                                  Callback callback) {
+  CHECK(callback);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    request_ = std::make_unique<Request>();
+    request_->generation = ++generation_;
+    request_->queries = std::move(queries);
+    request_->callback = std::move(callback);
+    result_ = nullptr;
+    if (!background_thread_.joinable()) {
+      background_thread_ = std::thread([this]() { BackgroundThread(); });
+    }
+  }
+  condition_.notify_all();
+}
+
+void FilePredictorWorker::Cancel() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (request_ != nullptr || result_ != nullptr || busy_) {
+    VLOG(5) << "Cancelling file predictions.";
+  }
+  generation_++;
+  request_ = nullptr;
+  result_ = nullptr;
+}
+
+bool FilePredictorWorker::Publish() {
+  std::unique_ptr<Result> result;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (result_ == nullptr || result_->generation != generation_) {
+      return false;
+    }
+    result = std::move(result_);
+  }
+  LOG(INFO) << "Publishing file predictions: " << result->predictions.size();
+  result->callback(std::move(result->predictions));
+  return true;
+}
+
+void FilePredictorWorker::WaitForIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_.wait(lock, [this]() { return request_ == nullptr && !busy_; });
+}
+
+void FilePredictorWorker::BackgroundThread() {
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(
+        lock, [this]() { return shutting_down_ || request_ != nullptr; });
+    if (shutting_down_) {
+      return;
+    }
+    std::unique_ptr<Request> request = std::move(request_);
+    busy_ = true;
+    lock.unlock();
+
+    std::vector<wstring> subdirectories;
+    auto result = std::make_unique<Result>();
+    result->generation = request->generation;
+    result->predictions = Run(*request, &subdirectories);
+    result->callback = std::move(request->callback);
+
+    lock.lock();
+    bool notify = false;
+    if (result->generation == generation_) {
+      result_ = std::move(result);
+      notify = true;
+    } else {
+      VLOG(5) << "Discarding cancelled file predictions.";
+    }
+    lock.unlock();
+    if (notify) {
+      notify_();
+    }
+
+    if (!subdirectories.empty()) {
+      VLOG(5) << "Reading ahead directories: " << subdirectories.size();
+      List(subdirectories, request->generation);
+    }
+
+    lock.lock();
+    busy_ = false;
+    lock.unlock();
+    condition_.notify_all();
+  }
+}
+
+std::vector<wstring> FilePredictorWorker::Run(
+    const Request& request, std::vector<wstring>* subdirectories) {
+  std::vector<wstring> directories;
+  for (const auto& query : request.queries) {
+    directories.push_back(query.directory);
+  }
+  auto listings = List(directories, request.generation);
+
+  std::vector<std::pair<wstring, wstring>> predictions;
+  for (size_t i = 0; i < listings.size(); i++) {
+    const Query& query = request.queries[i];
+    for (const auto& entry : listings[i]->entries) {
+      if (entry.name.compare(0, query.prefix.size(), query.prefix) != 0) {
+        VLOG(6) << "Skipping entry: " << entry.name;
+        continue;
+      }
+      wstring prediction = query.output_prefix + entry.name +
+                           (entry.is_directory ? L"/" : L"");
+      if (!query.search_path.empty() &&
+          prediction.compare(0, query.search_path.size(), query.search_path) ==
+              0) {
+        VLOG(6) << "Removing prefix from prediction: " << prediction;
+        size_t start =
+            prediction.find_first_not_of(L'/', query.search_path.size());
+        if (start != wstring::npos) {
+          prediction = prediction.substr(start);
+        }
+      }
+      if (entry.is_directory && subdirectories->size() < kMaxReadAhead) {
+        subdirectories->push_back(query.directory + L"/" + entry.name);
+      }
+      predictions.push_back({LowerCase(prediction), std::move(prediction)});
+    }
+  }
+
+  std::sort(predictions.begin(), predictions.end());
+  std::vector<wstring> output;
+  for (auto& prediction : predictions) {
+    if (output.empty() || output.back() != prediction.second) {
+      output.push_back(std::move(prediction.second));
+    }
+  }
+  VLOG(5) << "File predictions: " << output.size();
+  return output;
+}
+
+std::vector<std::shared_ptr<const DirectoryCache::Listing>>
+FilePredictorWorker::List(const std::vector<wstring>& directories,
+                          size_t generation) {
+  std::vector<std::shared_ptr<const DirectoryCache::Listing>> output(
+      directories.size());
+  // Each thread takes the next directory that nobody has taken; they stop
+  // early if the request is cancelled.
+  size_t next = 0;
+  std::mutex next_mutex;
+  auto work = [&]() {
+    while (true) {
+      size_t position;
+      {
+        std::unique_lock<std::mutex> lock(next_mutex);
+        if (next == directories.size()) {
+          return;
+        }
+        position = next++;
+      }
+      if (IsCancelled(generation)) {
+        VLOG(5) << "Request cancelled, skipping: " << directories[position];
+        output[position] = std::make_shared<DirectoryCache::Listing>();
+      } else {
+        output[position] = directory_cache_.Get(directories[position]);
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < std::min(kMaxThreads, directories.size()); i++) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  return output;
+}
+
+bool FilePredictorWorker::IsCancelled(size_t generation) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return generation != generation_;
+}
+
+}  // namespace editor
+}  // namespace afc
@@ -0,0 +1,108 @@
+#ifndef __AFC_EDITOR_FILE_PREDICTOR_WORKER_H__
+#define __AFC_EDITOR_FILE_PREDICTOR_WORKER_H__
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "directory_cache.h"
+
+namespace afc {
+namespace editor {
+
+using std::wstring;
+
+// Lists directories for FilePredictor in a background thread, so that slow
+// file systems (e.g., network file systems) don't block the editor.
+//
+// The directories of a request are listed in parallel (through a
+// DirectoryCache). Once the predictions have been found, the subdirectories
+// among them are read ahead (since the user is likely to descend into one of
+// them next), unless another request arrives. Only the most recent request
+// matters: a new request (or Cancel) discards the outstanding one.
+class FilePredictorWorker {
+ public:
+  // Lists a directory, keeping the entries that start with a prefix.
+  struct Query {
+    wstring directory;
+    wstring prefix;
+    // Prepended to the names of the entries to produce the predictions.
+    wstring output_prefix;
+    // If not empty, removed from the predictions that start with it (along
+    // with the slashes that follow it).
+    wstring search_path;
+  };
+
+  using Callback = std::function<void(std::vector<wstring> predictions)>;
+
+  // notify will be called from the background thread whenever predictions
+  // become available; it should cause Publish to run.
+  explicit FilePredictorWorker(std::function<void()> notify);
+  ~FilePredictorWorker();
+
+  // Cancels the outstanding request (if any) and starts a new one. Once the
+  // predictions are available, Publish will run callback on them (sorted,
+  // ignoring case, and without duplicates), unless the request is cancelled
+  // first.
+  void Predict(std::vector<Query> queries, Callback callback);
+
+  // Cancels the outstanding request (if any): its callback won't run.
+  void Cancel();
+
+  // Runs the callback of the last request, if its predictions are available.
+  // Must run in the main thread. Returns true if it ran.
+  bool Publish();
+
+  // Blocks until the background thread is done with all requests (including
+  // read ahead).
+  void WaitForIdle();
+
+  DirectoryCache* directory_cache() { return &directory_cache_; }
+
+ private:
+  struct Request {
+    size_t generation;
+    std::vector<Query> queries;
+    Callback callback;
+  };
+
+  struct Result {
+    size_t generation;
+    std::vector<wstring> predictions;
+    Callback callback;
+  };
+
+  void BackgroundThread();
+  // Returns the predictions and the subdirectories to read ahead.
+  std::vector<wstring> Run(const Request& request,
+                           std::vector<wstring>* subdirectories);
+  // Lists the directories (in parallel), stopping early if generation is
+  // cancelled.
+  std::vector<std::shared_ptr<const DirectoryCache::Listing>> List(
+      const std::vector<wstring>& directories, size_t generation);
+  bool IsCancelled(size_t generation);
+
+  const std::function<void()> notify_;
+  DirectoryCache directory_cache_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread background_thread_;
+  bool shutting_down_ = false;
+  // True while the background thread is running a request.
+  bool busy_ = false;
+
+  // Incremented by each request (and by Cancel).
+  size_t generation_ = 0;
+  std::unique_ptr<Request> request_;
+  std::unique_ptr<Result> result_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_FILE_PREDICTOR_WORKER_H__
@@ -2,6 +2,8 @@
 
 #include <algorithm>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 extern "C" {
@@ -11,9 +13,11 @@ extern "C" {
 #include <glog/logging.h>
 
 #include "buffer_variables.h"
+#include "buffer_words_index.h"
 #include "char_buffer.h"
 #include "command.h"
 #include "command_mode.h"
+#include "completion_index.h"
 #include "editable_string.h"
 #include "editor.h"
 #include "editor_mode.h"
@@ -58,15 +62,15 @@ class NewLineTransformation : public Transformation {
       }
     }
 
-    auto continuation_line = std::make_shared<Line>(*line);
-    continuation_line->DeleteCharacters(prefix_end,
-                                        continuation_line->size() - prefix_end);
+    LineBuilder continuation_line(*line);
+    continuation_line.DeleteCharacters(prefix_end,
+                                       continuation_line.size() - prefix_end);
 
     auto transformation = std::make_unique<TransformationStack>();
     {
       auto buffer_to_insert =
           std::make_shared<OpenBuffer>(editor_state, L"- text inserted");
-      buffer_to_insert->AppendRawLine(editor_state, continuation_line);
+      buffer_to_insert->AppendRawLine(editor_state, continuation_line.Build());
       transformation->PushBack(
           NewInsertBufferTransformation(buffer_to_insert, 1, END));
     }
@@ -110,53 +114,47 @@ class InsertEmptyLineTransformation : public Transformation {
 
 class AutocompleteMode : public EditorMode {
  public:
-  using Iterator = Tree<std::shared_ptr<Line>>::const_iterator;
-
   struct Options {
     std::shared_ptr<EditorMode> delegate;
 
-    std::shared_ptr<const Line> prefix;
+    // The completions, in the order they are offered.
+    std::vector<wstring> matches;
 
-    // TODO: Make these shared_ptr weak_ptrs.
-    std::shared_ptr<OpenBuffer> dictionary;
+    // TODO: Make this shared_ptr a weak_ptr.
     std::shared_ptr<OpenBuffer> buffer;
 
-    // The position where the matches begin.
-    size_t matches_start;
     size_t column_start;
     size_t column_end;
   };
 
   AutocompleteMode(Options options)
       : options_(std::move(options)),
-        matches_current_(options_.matches_start),
         word_length_(options_.column_end - options_.column_start),
         original_text_(options_.buffer->LineAt(options_.buffer->position().line)
-                           ->Substring(options_.column_start, word_length_)) {}
+                           ->Substring(options_.column_start, word_length_)) {
+    CHECK(!options_.matches.empty());
+  }
 
   void DrawCurrentMatch(EditorState* editor_state) {
     wstring status;
     const size_t kPrefixLength = 3;
-    size_t start = matches_current_ > options_.matches_start + kPrefixLength
-                       ? matches_current_ - kPrefixLength
-                       : options_.matches_start;
-    for (size_t i = 0; i < 10 && start + i < options_.dictionary->lines_size();
-         i++) {
-      bool is_current = start + i == matches_current_;
+    size_t start =
+        matches_current_ > kPrefixLength ? matches_current_ - kPrefixLength : 0;
+    for (size_t i = start; i < start + 10 && i < options_.matches.size(); i++) {
+      bool is_current = i == matches_current_;
       wstring number_prefix;
-      if (start + i > matches_current_) {
-        number_prefix = std::to_wstring(start + i - matches_current_) + L":";
+      if (i > matches_current_) {
+        number_prefix = std::to_wstring(i - matches_current_) + L":";
       }
       status += wstring(status.empty() ? L"" : L" ") +
                 wstring(is_current ? L"[" : L"") + number_prefix +
-                options_.dictionary->LineAt(start + i)->ToString() +
+                options_.matches[i] +
                 wstring(is_current ? L"]" : L"");
     }
     editor_state->SetStatus(status);
 
-    ReplaceCurrentText(
-        editor_state,
-        options_.dictionary->LineAt(matches_current_)->contents());
+    ReplaceCurrentText(editor_state,
+                       NewCopyString(options_.matches[matches_current_]));
   }
 
   void ProcessInput(wint_t c, EditorState* editor_state) {
@@ -167,8 +165,8 @@ class AutocompleteMode : public EditorMode {
       case Terminal::DOWN_ARROW:
       case Terminal::RIGHT_ARROW:
         matches_current_++;
-        if (matches_current_ == options_.dictionary->lines_size()) {
-          matches_current_ = options_.matches_start;
+        if (matches_current_ == options_.matches.size()) {
+          matches_current_ = 0;
         }
         break;
 
@@ -176,8 +174,8 @@ class AutocompleteMode : public EditorMode {
       case 'h':
       case Terminal::UP_ARROW:
       case Terminal::LEFT_ARROW:
-        if (matches_current_ <= options_.matches_start) {
-          matches_current_ = options_.dictionary->lines_size() - 1;
+        if (matches_current_ == 0) {
+          matches_current_ = options_.matches.size() - 1;
         } else {
           matches_current_--;
         }
@@ -193,8 +191,8 @@ class AutocompleteMode : public EditorMode {
       case '8':
       case '9':
         matches_current_ += c - '0';
-        if (matches_current_ >= options_.dictionary->lines_size()) {
-          matches_current_ = options_.matches_start;
+        if (matches_current_ >= options_.matches.size()) {
+          matches_current_ = 0;
         }
         break;
 
@@ -242,8 +240,8 @@ class AutocompleteMode : public EditorMode {
   }
 
   Options options_;
-  // The position of the line with the current match.
-  size_t matches_current_;
+  // The position (in options_.matches) of the current match.
+  size_t matches_current_ = 0;
 
   // The number of characters that need to be erased (starting at
   // options_.column_start) for the next insertion. Initially, this is computed
@@ -336,13 +334,18 @@ class DefaultScrollBehavior : public ScrollBehavior {
   }
 };
 
+// Returns (up to limit) completions for a prefix, best first.
+using CompletionsFinder =
+    std::function<std::vector<wstring>(const wstring& prefix, size_t limit)>;
+
 void FindCompletion(EditorState* editor_state,
                     std::shared_ptr<OpenBuffer> buffer,
-                    std::shared_ptr<OpenBuffer> dictionary) {
-  if (buffer == nullptr || dictionary == nullptr) {
-    LOG(INFO) << "Buffer or dictionary have expired, giving up.";
-    return;
-  }
+                    CompletionsFinder find_completions) {
+  CHECK(buffer != nullptr);
+  CHECK(find_completions != nullptr);
+
+  // Beyond this, the completions are unlikely to be useful.
+  const size_t kMaxMatches = 1000;
 
   AutocompleteMode::Options options;
 
@@ -352,18 +355,6 @@ void FindCompletion(EditorState* editor_state,
     return;
   }
 
-  if (dictionary->contents()->size() <= 1) {
-    static std::vector<wstring> errors({
-        L"No completions are available.",
-        L"The autocomplete dictionary is empty.",
-        L"Maybe set the `dictionary` variable?",
-    });
-    editor_state->SetStatus(errors[rand() % errors.size()]);
-    return;
-  }
-
-  LOG(INFO) << "Dictionary size: " << dictionary->contents()->size();
-
   auto line = buffer->current_line()->ToString();
   options.column_start =
       line.find_last_not_of(buffer->Read(buffer_variables::word_characters()),
@@ -375,26 +366,19 @@ void FindCompletion(EditorState* editor_state,
   }
   LOG(INFO) << "Positions: start: " << options.column_start
             << ", end: " << options.column_end;
-  options.prefix =
-      std::make_shared<const Line>(Line::Options(NewCopyString(line.substr(
-          options.column_start, options.column_end - options.column_start))));
+  wstring prefix = line.substr(options.column_start,
+                               options.column_end - options.column_start);
+
+  LOG(INFO) << "Find completion for \"" << prefix << "\"";
+  options.matches = find_completions(prefix, kMaxMatches);
+  if (options.matches.empty()) {
+    editor_state->SetStatus(L"No completions for: " + prefix);
+    return;
+  }
 
   options.delegate = buffer->ResetMode();
-  options.dictionary = dictionary;
   options.buffer = buffer;
 
-  LOG(INFO) << "Find completion for \"" << options.prefix->ToString()
-            << "\" among options: " << dictionary->contents()->size();
-  options.matches_start = dictionary->contents()->upper_bound(
-      options.prefix,
-      [](const shared_ptr<const Line>& a, const shared_ptr<const Line>& b) {
-        return a->ToString() < b->ToString();
-      });
-
-  if (options.matches_start == dictionary->lines_size()) {
-    options.matches_start = 0;
-  }
-
   auto autocomplete_mode =
       std::make_unique<AutocompleteMode>(std::move(options));
   autocomplete_mode->DrawCurrentMatch(editor_state);
@@ -402,6 +386,40 @@ void FindCompletion(EditorState* editor_state,
       std::move(autocomplete_mode));
 }
 
+// Returns the index of the words in a dictionary buffer, building it only if
+// the dictionary has changed since the last call for the same path (so that
+// all buffers using a dictionary share its index).
+std::shared_ptr<const CompletionIndex> GetDictionaryIndex(
+    const wstring& path, const OpenBuffer& dictionary) {
+  struct CachedIndex {
+    // See BufferContents::version.
+    size_t version = 0;
+    std::shared_ptr<const CompletionIndex> index;
+  };
+  static std::unordered_map<wstring, CachedIndex> cache;
+
+  const BufferContents& contents = *dictionary.contents();
+  CachedIndex& entry = cache[path];
+  if (entry.index != nullptr && entry.version == contents.version()) {
+    VLOG(5) << "Reusing the index of dictionary: " << path;
+    return entry.index;
+  }
+
+  LOG(INFO) << "Building the index of dictionary: " << path;
+  std::vector<CompletionIndex::Entry> entries;
+  entries.reserve(contents.size());
+  contents.ForEach([&entries](size_t, const Line& line) {
+    CompletionIndex::Entry entry;
+    if (CompletionIndex::ParseDictionaryLine(line.ToString(), &entry)) {
+      entries.push_back(std::move(entry));
+    }
+    return true;
+  });
+  entry.version = contents.version();
+  entry.index = std::make_shared<const CompletionIndex>(std::move(entries));
+  return entry.index;
+}
+
 void StartCompletionFromDictionary(EditorState* editor_state,
                                    std::shared_ptr<OpenBuffer> buffer,
                                    wstring path) {
@@ -417,29 +435,33 @@ void StartCompletionFromDictionary(EditorState* editor_state,
   std::weak_ptr<OpenBuffer> weak_dictionary = file->second;
   std::weak_ptr<OpenBuffer> weak_buffer = buffer;
   file->second->AddEndOfFileObserver([editor_state, weak_buffer,
-                                      weak_dictionary]() {
-    FindCompletion(editor_state, weak_buffer.lock(), weak_dictionary.lock());
-  });
-}
-
-void RegisterLeaves(const OpenBuffer& buffer, const ParseTree& tree,
-                    std::set<wstring>* words) {
-  DCHECK(words != nullptr);
-  if (tree.children.empty() && tree.range.begin.line == tree.range.end.line) {
-    CHECK_LE(tree.range.begin.column, tree.range.end.column);
-    auto line = buffer.LineAt(tree.range.begin.line);
-    CHECK_LE(tree.range.end.column, line->size());
-    auto word = line->Substring(tree.range.begin.column,
-                                tree.range.end.column - tree.range.begin.column)
-                    ->ToString();
-    if (!word.empty()) {
-      DVLOG(5) << "Found leave: " << word;
-      words->insert(word);
+                                      weak_dictionary, path]() {
+    auto buffer = weak_buffer.lock();
+    auto dictionary = weak_dictionary.lock();
+    if (buffer == nullptr || dictionary == nullptr) {
+      LOG(INFO) << "Buffer or dictionary have expired, giving up.";
+      return;
     }
-  }
-  for (auto& child : tree.children) {
-    RegisterLeaves(buffer, child, words);
-  }
+    auto index = GetDictionaryIndex(path, *dictionary);
+    if (index->size() == 0) {
+      static std::vector<wstring> errors({
+          L"No completions are available.",
+          L"The autocomplete dictionary is empty.",
+          L"Maybe set the `dictionary` variable?",
+      });
+      editor_state->SetStatus(errors[rand() % errors.size()]);
+      return;
+    }
+    LOG(INFO) << "Dictionary size: " << index->size();
+    FindCompletion(editor_state, buffer,
+                   [index](const wstring& prefix, size_t limit) {
+                     std::vector<wstring> output;
+                     for (size_t id : index->Find(prefix, limit)) {
+                       output.push_back(index->word(id));
+                     }
+                     return output;
+                   });
+  });
 }
 
 bool StartCompletion(EditorState* editor_state,
@@ -450,22 +472,36 @@ bool StartCompletion(EditorState* editor_state,
     return true;
   }
 
-  std::set<wstring> words;
-  auto root = buffer->parse_tree();
-  RegisterLeaves(*buffer, *buffer->current_tree(root.get()), &words);
-  LOG(INFO) << "Leaves found: " << words.size();
-
-  std::wistringstream keywords(
+  std::vector<CompletionIndex::Entry> entries;
+  std::wistringstream keywords_stream(
       buffer->Read(buffer_variables::language_keywords()));
-  words.insert(std::istream_iterator<wstring, wchar_t>(keywords),
-               std::istream_iterator<wstring, wchar_t>());
-
-  auto dictionary = std::make_shared<OpenBuffer>(editor_state, L"Dictionary");
-  for (auto& word : words) {
-    dictionary->AppendLine(editor_state, NewCopyString(word));
-  }
-
-  FindCompletion(editor_state, buffer, dictionary);
+  for (auto it = std::istream_iterator<wstring, wchar_t>(keywords_stream);
+       it != std::istream_iterator<wstring, wchar_t>(); ++it) {
+    CompletionIndex::Entry entry;
+    entry.word = *it;
+    entries.push_back(std::move(entry));
+  }
+  auto keywords = std::make_shared<const CompletionIndex>(std::move(entries));
+
+  // Words from all buffers come first; keywords that don't appear in any
+  // buffer come last.
+  BufferWordsIndex* words = editor_state->buffer_words_index();
+  FindCompletion(
+      editor_state, buffer,
+      [words, keywords](const wstring& prefix, size_t limit) {
+        std::vector<wstring> output = words->Find(prefix, limit);
+        std::unordered_set<wstring> found(output.begin(), output.end());
+        for (size_t id : keywords->Find(prefix, limit)) {
+          if (output.size() >= limit) {
+            break;
+          }
+          wstring keyword = keywords->word(id);
+          if (found.insert(keyword).second) {
+            output.push_back(std::move(keyword));
+          }
+        }
+        return output;
+      });
   return true;
 }
 
@@ -590,7 +626,7 @@ class InsertMode : public EditorMode {
       insert->AppendToLastLine(
           editor_state,
           NewCopyString(buffer->TransformKeyboardText(wstring(1, c))));
-      buffer->ApplyToCursors(NewInsertBufferTransformation(insert, 1, END));
+      buffer->ApplyKeystroke(NewInsertBufferTransformation(insert, 1, END));
     }
 
     options_.modify_listener();
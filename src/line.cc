@@ -21,107 +21,110 @@ using std::wstring;
 
 Line::Line(wstring x) : Line(Line::Options(NewCopyString(std::move(x)))) {}
 
-Line::Line(const Options& options)
+Line::Line(Options options)
     : environment_(options.environment == nullptr
                        ? std::make_shared<Environment>()
-                       : options.environment),
-      contents_(options.contents),
-      modifiers_(options.modifiers) {
+                       : std::move(options.environment)),
+      contents_(std::move(options.contents)),
+      modifiers_(std::move(options.modifiers)) {
   CHECK(contents_ != nullptr);
   CHECK_EQ(contents_->size(), modifiers_.size());
 }
 
-Line::Line(const Line& line) {
-  std::unique_lock<std::mutex> lock(line.mutex_);
-  environment_ = line.environment_;
-  contents_ = line.contents_;
-  modifiers_ = line.modifiers_;
-}
+Line::Line(const Line& line)
+    : environment_(line.environment_),
+      contents_(line.contents_),
+      modifiers_(line.modifiers_) {}
 
 shared_ptr<LazyString> Line::Substring(size_t pos, size_t length) const {
-  return afc::editor::Substring(contents(), pos, length);
+  return afc::editor::Substring(contents_, pos, length);
 }
 
 shared_ptr<LazyString> Line::Substring(size_t pos) const {
-  return afc::editor::Substring(contents(), pos);
+  return afc::editor::Substring(contents_, pos);
 }
 
-void Line::DeleteCharacters(size_t position, size_t amount) {
-  std::unique_lock<std::mutex> lock(mutex_);
-  CHECK_LE(position, contents_->size());
-  CHECK_LE(position + amount, contents_->size());
-  CHECK_EQ(contents_->size(), modifiers_.size());
-  contents_ =
-      StringAppend(afc::editor::Substring(contents_, 0, position),
-                   afc::editor::Substring(contents_, position + amount));
-  auto it = modifiers_.begin() + position;
-  modifiers_.erase(it, it + amount);
-  CHECK_EQ(contents_->size(), modifiers_.size());
+std::shared_ptr<vm::Environment> Line::environment() const {
+  CHECK(environment_ != nullptr);
+  return environment_;
 }
 
-void Line::DeleteCharacters(size_t position) {
+LineBuilder::LineBuilder(const Line& line) : line_(line) {}
+
+void LineBuilder::DeleteCharacters(size_t position, size_t amount) {
+  auto& contents = line_.contents_;
+  auto& modifiers = line_.modifiers_;
+  CHECK_LE(position, contents->size());
+  CHECK_LE(position + amount, contents->size());
+  CHECK_EQ(contents->size(), modifiers.size());
+  contents = StringAppend(afc::editor::Substring(contents, 0, position),
+                          afc::editor::Substring(contents, position + amount));
+  auto it = modifiers.begin() + position;
+  modifiers.erase(it, it + amount);
+  CHECK_EQ(contents->size(), modifiers.size());
+}
+
+void LineBuilder::DeleteCharacters(size_t position) {
   CHECK_LE(position, size());
   DeleteCharacters(position, size() - position);
 }
 
-void Line::InsertCharacterAtPosition(size_t position) {
-  std::unique_lock<std::mutex> lock(mutex_);
-  CHECK_EQ(contents_->size(), modifiers_.size());
-  contents_ =
-      StringAppend(StringAppend(afc::editor::Substring(contents_, 0, position),
+void LineBuilder::InsertCharacterAtPosition(size_t position) {
+  auto& contents = line_.contents_;
+  auto& modifiers = line_.modifiers_;
+  CHECK_EQ(contents->size(), modifiers.size());
+  contents =
+      StringAppend(StringAppend(afc::editor::Substring(contents, 0, position),
                                 NewCopyString(L" ")),
-                   afc::editor::Substring(contents_, position));
+                   afc::editor::Substring(contents, position));
 
-  modifiers_.push_back(unordered_set<LineModifier, hash<int>>());
-  for (size_t i = modifiers_.size() - 1; i > position; i--) {
-    modifiers_[i] = modifiers_[i - 1];
+  modifiers.push_back(unordered_set<LineModifier, hash<int>>());
+  for (size_t i = modifiers.size() - 1; i > position; i--) {
+    modifiers[i] = modifiers[i - 1];
   }
 }
 
-void Line::SetCharacter(
+void LineBuilder::SetCharacter(
     size_t position, int c,
     const unordered_set<LineModifier, hash<int>>& modifiers) {
-  std::unique_lock<std::mutex> lock(mutex_);
-  CHECK_EQ(contents_->size(), modifiers_.size());
+  auto& contents = line_.contents_;
+  auto& line_modifiers = line_.modifiers_;
+  CHECK_EQ(contents->size(), line_modifiers.size());
   shared_ptr<LazyString> str = NewCopyString(wstring(1, c));
-  if (position >= contents_->size()) {
-    contents_ = StringAppend(contents_, str);
-    modifiers_.push_back(modifiers);
+  if (position >= contents->size()) {
+    contents = StringAppend(contents, str);
+    line_modifiers.push_back(modifiers);
   } else {
-    contents_ = StringAppend(
-        StringAppend(afc::editor::Substring(contents_, 0, position), str),
-        afc::editor::Substring(contents_, position + 1));
-    if (modifiers_.size() <= position) {
-      modifiers_.resize(position + 1);
+    contents = StringAppend(
+        StringAppend(afc::editor::Substring(contents, 0, position), str),
+        afc::editor::Substring(contents, position + 1));
+    if (line_modifiers.size() <= position) {
+      line_modifiers.resize(position + 1);
     }
-    modifiers_[position] = modifiers;
+    line_modifiers[position] = modifiers;
   }
-  CHECK_EQ(contents_->size(), modifiers_.size());
+  CHECK_EQ(contents->size(), line_modifiers.size());
 }
 
-void Line::SetAllModifiers(const LineModifierSet& modifiers) {
-  std::unique_lock<std::mutex> lock(mutex_);
-  CHECK_EQ(contents_->size(), modifiers_.size());
-  modifiers_.assign(contents_->size(), modifiers);
-  CHECK_EQ(contents_->size(), modifiers_.size());
+void LineBuilder::SetAllModifiers(const LineModifierSet& modifiers) {
+  CHECK_EQ(line_.contents_->size(), line_.modifiers_.size());
+  line_.modifiers_.assign(line_.contents_->size(), modifiers);
 }
 
-void Line::Append(const Line& line) {
-  std::unique_lock<std::mutex> lock(mutex_);
-  CHECK_EQ(contents_->size(), modifiers_.size());
+void LineBuilder::Append(const Line& line) {
+  auto& contents = line_.contents_;
+  auto& modifiers = line_.modifiers_;
+  CHECK_EQ(contents->size(), modifiers.size());
   CHECK_EQ(line.contents_->size(), line.modifiers_.size());
-  CHECK(this != &line);
-  contents_ = StringAppend(contents_, line.contents_);
+  contents = StringAppend(contents, line.contents_);
   for (auto& m : line.modifiers_) {
-    modifiers_.push_back(m);
+    modifiers.push_back(m);
   }
-  CHECK_EQ(contents_->size(), modifiers_.size());
+  CHECK_EQ(contents->size(), modifiers.size());
 }
 
-std::shared_ptr<vm::Environment> Line::environment() const {
-  std::unique_lock<std::mutex> lock(mutex_);
-  CHECK(environment_ != nullptr);
-  return environment_;
+std::shared_ptr<Line> LineBuilder::Build() {
+  return std::make_shared<Line>(std::move(line_));
 }
 
 namespace {
@@ -232,26 +235,15 @@ wchar_t ComputeScrollBarCharacter(size_t line, size_t lines_size,
 }  // namespace
 
 void Line::Output(const Line::OutputOptions& options) const {
-  CHECK(options.editor_state != nullptr);
-  CHECK(options.buffer != nullptr);
-  std::unique_lock<std::mutex> lock(mutex_);
+  OutputMargin(options, OutputContents(options));
+}
+
+size_t Line::OutputContents(const Line::OutputOptions& options) const {
   VLOG(5) << "Producing output of line: " << ToString();
   size_t output_column = 0;
   size_t input_column = options.position.column;
   unordered_set<LineModifier, hash<int>> current_modifiers;
 
-  CHECK(environment_ != nullptr);
-  auto target_buffer_value = environment_->Lookup(L"buffer");
-  const auto target_buffer =
-      (target_buffer_value != nullptr &&
-       target_buffer_value->type.type == VMType::OBJECT_TYPE &&
-       target_buffer_value->type.object_type == L"Buffer" &&
-       target_buffer_value->user_value != nullptr)
-          ? static_cast<OpenBuffer*>(target_buffer_value->user_value.get())
-          : options.buffer;
-  const auto view_start_line =
-      options.buffer->Read(buffer_variables::view_start_line());
-
   while (input_column < contents_->size() && output_column < options.width) {
     wint_t c = contents_->get(input_column);
     CHECK(c != '\n');
@@ -290,6 +282,24 @@ void Line::Output(const Line::OutputOptions& options) const {
     }
     input_column++;
   }
+  return output_column;
+}
+
+void Line::OutputMargin(const Line::OutputOptions& options,
+                        size_t output_column) const {
+  CHECK(options.editor_state != nullptr);
+  CHECK(options.buffer != nullptr);
+  CHECK(environment_ != nullptr);
+  auto target_buffer_value = environment_->Lookup(L"buffer");
+  const auto target_buffer =
+      (target_buffer_value != nullptr &&
+       target_buffer_value->type.type == VMType::OBJECT_TYPE &&
+       target_buffer_value->type.object_type == L"Buffer" &&
+       target_buffer_value->user_value() != nullptr)
+          ? static_cast<OpenBuffer*>(target_buffer_value->user_value().get())
+          : options.buffer;
+  const auto view_start_line =
+      options.buffer->Read(buffer_variables::view_start_line());
 
   size_t line_width = target_buffer->Read(buffer_variables::line_width());
 
@@ -3,7 +3,6 @@
 
 #include <map>
 #include <memory>
-#include <mutex>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -30,7 +29,12 @@ using std::unordered_set;
 using std::vector;
 using std::wstring;
 
-// This class is thread-safe.
+class LineBuilder;
+
+// Lines are immutable: once constructed, they never change. This allows them to
+// be read from multiple threads (e.g., the main thread and the thread parsing
+// the buffer) without any locking. To modify a line, use a LineBuilder to
+// produce a new line (and replace the old one with it).
 class Line {
  public:
   struct Options {
@@ -44,74 +48,30 @@ class Line {
   };
 
   Line() : Line(Options()) {}
-  explicit Line(const Options& options);
+  explicit Line(Options options);
   explicit Line(wstring text);
+  // Copies the contents (but not the modified state).
   Line(const Line& line);
+  Line(Line&& line) = default;
 
-  shared_ptr<LazyString> contents() const {
-    std::unique_lock<std::mutex> lock(mutex_);
-    return contents_;
-  }
-  size_t size() const {
-    CHECK(contents() != nullptr);
-    return contents()->size();
-  }
-  bool empty() const {
-    CHECK(contents() != nullptr);
-    return size() == 0;
-  }
+  const shared_ptr<LazyString>& contents() const { return contents_; }
+  size_t size() const { return contents_->size(); }
+  bool empty() const { return size() == 0; }
   wint_t get(size_t column) const {
-    CHECK_LT(column, contents()->size());
-    return contents()->get(column);
+    CHECK_LT(column, contents_->size());
+    return contents_->get(column);
   }
   shared_ptr<LazyString> Substring(size_t pos, size_t length) const;
   // Returns the substring from pos to the end of the string.
   shared_ptr<LazyString> Substring(size_t pos) const;
-  wstring ToString() const { return contents()->ToString(); }
-  // Delete characters in [position, position + amount).
-  void DeleteCharacters(size_t position, size_t amount);
-  // Delete characters from position until the end.
-  void DeleteCharacters(size_t position);
-  void InsertCharacterAtPosition(size_t position);
-  void SetCharacter(size_t position, int c, const LineModifierSet& modifiers);
+  wstring ToString() const { return contents_->ToString(); }
 
-  void SetAllModifiers(const LineModifierSet& modifiers);
-  const vector<LineModifierSet> modifiers() const {
-    std::unique_lock<std::mutex> lock(mutex_);
-    return modifiers_;
-  }
-  vector<LineModifierSet>& modifiers() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    return modifiers_;
-  }
-
-  bool modified() const {
-    std::unique_lock<std::mutex> lock(mutex_);
-    return modified_;
-  }
-  void set_modified(bool modified) {
-    std::unique_lock<std::mutex> lock(mutex_);
-    modified_ = modified;
-  }
+  const vector<LineModifierSet>& modifiers() const { return modifiers_; }
 
-  void Append(const Line& line);
+  bool modified() const { return modified_; }
 
   std::shared_ptr<vm::Environment> environment() const;
 
-  bool filtered() const {
-    std::unique_lock<std::mutex> lock(mutex_);
-    return filtered_;
-  }
-  bool filter_version() const {
-    std::unique_lock<std::mutex> lock(mutex_);
-    return filter_version_;
-  }
-  void set_filtered(bool filtered, size_t filter_version) {
-    std::unique_lock<std::mutex> lock(mutex_);
-    filtered_ = filtered;
-    filter_version_ = filter_version;
-  }
-
   class OutputReceiverInterface {
    public:
     virtual ~OutputReceiverInterface() {}
@@ -136,14 +96,54 @@ class Line {
   };
   void Output(const OutputOptions& options) const;
 
+  // Output is equivalent to calling OutputContents (which only depends on the
+  // contents of the line, position.column and width) followed by OutputMargin
+  // (with the number of columns returned by OutputContents). This allows
+  // customers to cache the output of OutputContents.
+  size_t OutputContents(const OutputOptions& options) const;
+  void OutputMargin(const OutputOptions& options, size_t output_column) const;
+
  private:
-  mutable std::mutex mutex_;
+  friend class LineBuilder;
+
   std::shared_ptr<vm::Environment> environment_;
   shared_ptr<LazyString> contents_;
   vector<LineModifierSet> modifiers_;
   bool modified_ = false;
-  bool filtered_ = true;
-  size_t filter_version_ = 0;
+};
+
+// Used to produce new (immutable) lines, typically by applying modifications
+// to an existing line:
+//
+//   LineBuilder builder(*buffer->LineAt(position.line));
+//   builder.DeleteCharacters(position.column);
+//   buffer->replace_current_line(builder.Build());
+class LineBuilder {
+ public:
+  LineBuilder() : LineBuilder(Line()) {}
+  explicit LineBuilder(const Line& line);
+
+  const shared_ptr<LazyString>& contents() const { return line_.contents_; }
+  size_t size() const { return line_.size(); }
+  const vector<LineModifierSet>& modifiers() const { return line_.modifiers_; }
+  vector<LineModifierSet>& modifiers() { return line_.modifiers_; }
+
+  // Delete characters in [position, position + amount).
+  void DeleteCharacters(size_t position, size_t amount);
+  // Delete characters from position until the end.
+  void DeleteCharacters(size_t position);
+  void InsertCharacterAtPosition(size_t position);
+  void SetCharacter(size_t position, int c, const LineModifierSet& modifiers);
+  void SetAllModifiers(const LineModifierSet& modifiers);
+  void Append(const Line& line);
+
+  void set_modified(bool modified) { line_.modified_ = modified; }
+
+  // Returns the new line. The builder shouldn't be used afterwards.
+  std::shared_ptr<Line> Build();
+
+ private:
+  Line line_;
 };
 
 // Wrapper of a Line::OutputReceiverInterface that coallesces multiple calls to
@@ -53,8 +53,8 @@ std::wstring LineColumn::ToCppString() const {
                            CHECK_EQ(args[1]->type, VMType::VM_INTEGER);
                            return Value::NewObject(
                                L"LineColumn",
-                               std::make_shared<LineColumn>(args[0]->integer,
-                                                            args[1]->integer));
+                               std::make_shared<LineColumn>(
+                                   args[0]->integer(), args[1]->integer()));
                          }));
 
   line_column->AddField(
@@ -63,8 +63,8 @@ std::wstring LineColumn::ToCppString() const {
                    [](std::vector<Value::Ptr> args) {
                      CHECK_EQ(args.size(), size_t(1));
                      CHECK_EQ(args[0]->type, VMType::OBJECT_TYPE);
-                     auto line_column =
-                         static_cast<LineColumn*>(args[0]->user_value.get());
+                     auto line_column = static_cast<LineColumn*>(
+                         args[0]->user_value().get());
                      CHECK(line_column != nullptr);
                      return Value::NewInteger(line_column->line);
                    }));
@@ -75,8 +75,8 @@ std::wstring LineColumn::ToCppString() const {
                      [](std::vector<Value::Ptr> args) {
                        CHECK_EQ(args.size(), size_t(1));
                        CHECK_EQ(args[0]->type, VMType::OBJECT_TYPE);
-                       auto line_column =
-                           static_cast<LineColumn*>(args[0]->user_value.get());
+                       auto line_column = static_cast<LineColumn*>(
+                           args[0]->user_value().get());
                        CHECK(line_column != nullptr);
                        return Value::NewInteger(line_column->column);
                      }));
@@ -103,8 +103,8 @@ std::wstring LineColumn::ToCppString() const {
             return Value::NewObject(
                 L"Range",
                 std::make_shared<Range>(
-                    *static_cast<LineColumn*>(args[0]->user_value.get()),
-                    *static_cast<LineColumn*>(args[1]->user_value.get())));
+                    *static_cast<LineColumn*>(args[0]->user_value().get()),
+                    *static_cast<LineColumn*>(args[1]->user_value().get())));
           }));
 
   range->AddField(
@@ -114,7 +114,7 @@ std::wstring LineColumn::ToCppString() const {
           [](std::vector<Value::Ptr> args) {
             CHECK_EQ(args.size(), size_t(1));
             CHECK_EQ(args[0]->type, VMType::OBJECT_TYPE);
-            auto range = static_cast<Range*>(args[0]->user_value.get());
+            auto range = static_cast<Range*>(args[0]->user_value().get());
             CHECK(range != nullptr);
             return Value::NewObject(L"LineColumn",
                                     std::make_shared<LineColumn>(range->begin));
@@ -127,7 +127,7 @@ std::wstring LineColumn::ToCppString() const {
           [](std::vector<Value::Ptr> args) {
             CHECK_EQ(args.size(), size_t(1));
             CHECK_EQ(args[0]->type, VMType::OBJECT_TYPE);
-            auto range = static_cast<Range*>(args[0]->user_value.get());
+            auto range = static_cast<Range*>(args[0]->user_value().get());
             CHECK(range != nullptr);
             return Value::NewObject(L"LineColumn",
                                     std::make_shared<LineColumn>(range->end));
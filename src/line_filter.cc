@@ -0,0 +1,154 @@
+#include "line_filter.h"
+
+#include <algorithm>
+#include <thread>
+
+#include <glog/logging.h>
+
+namespace afc {
+namespace editor {
+
+namespace {
+// Blocks start small (to keep the cost of showing a screen low) and grow while
+// lines are requested sequentially (e.g., when skipping many hidden lines).
+const size_t kMinBlockSize = 256;
+const size_t kMaxBlockSize = 65536;
+
+// Below this, the cost of starting a thread exceeds what it saves.
+const size_t kMinLinesPerThread = 4096;
+}  // namespace
+
+void LineFilter::Set(Predicate predicate, bool thread_safe) {
+  CHECK(predicate);
+  predicate_ = std::move(predicate);
+  thread_safe_ = thread_safe;
+  version_++;
+  known_.assign(known_.size(), false);
+  evaluated_lines_ = 0;
+}
+
+void LineFilter::Clear() {
+  predicate_ = nullptr;
+  thread_safe_ = false;
+  version_++;
+  known_.assign(known_.size(), false);
+  evaluated_lines_ = 0;
+}
+
+void LineFilter::LinesReplaced(size_t first, size_t old_count,
+                               size_t new_count) {
+  changes_++;
+  if (!active()) {
+    // Nothing to keep up to date: IsShown rebuilds the bitmaps once a filter
+    // is set.
+    known_.clear();
+    shown_.clear();
+    evaluated_lines_ = 0;
+    return;
+  }
+  if (first + old_count > known_.size()) {
+    LOG(INFO) << "Lines replaced beyond the end of the bitmap, resetting.";
+    known_.assign(first + old_count, false);
+    shown_.assign(first + old_count, true);
+    evaluated_lines_ = 0;
+  }
+  for (size_t i = first; i < first + old_count; i++) {
+    if (known_[i]) {
+      evaluated_lines_--;
+    }
+  }
+  if (old_count == new_count) {
+    std::fill(known_.begin() + first, known_.begin() + first + old_count,
+              false);
+    return;
+  }
+  known_.erase(known_.begin() + first, known_.begin() + first + old_count);
+  shown_.erase(shown_.begin() + first, shown_.begin() + first + old_count);
+  known_.insert(known_.begin() + first, new_count, false);
+  shown_.insert(shown_.begin() + first, new_count, true);
+}
+
+bool LineFilter::IsShown(const BufferContents& contents, size_t line) {
+  if (!active()) {
+    return true;
+  }
+  if (known_.size() != contents.size()) {
+    LOG(INFO) << "Bitmap doesn't match the contents, resetting: "
+              << known_.size() << " != " << contents.size();
+    known_.assign(contents.size(), false);
+    shown_.assign(contents.size(), true);
+    evaluated_lines_ = 0;
+  }
+  if (line >= known_.size()) {
+    return true;
+  }
+  if (!known_[line]) {
+    EvaluateBlock(contents, line);
+  }
+  // The predicate may have removed lines.
+  return line >= shown_.size() || shown_[line];
+}
+
+void LineFilter::EvaluateBlock(const BufferContents& contents, size_t line) {
+  if (line > 0 && known_[line - 1]) {
+    block_size_ = std::min(kMaxBlockSize, block_size_ * 2);
+  } else {
+    block_size_ = kMinBlockSize;
+  }
+  size_t last = std::min(contents.size(), line + block_size_);
+
+  // The lines are immutable, so the threads can read them from the snapshot
+  // without synchronization.
+  std::vector<size_t> positions;
+  std::vector<shared_ptr<const Line>> lines;
+  for (size_t i = line; i < last; i++) {
+    if (!known_[i]) {
+      positions.push_back(i);
+      lines.push_back(contents.at(i));
+    }
+  }
+  VLOG(5) << "Evaluating filter on lines: " << lines.size();
+
+  // Not a vector<bool>: the threads write to it concurrently.
+  std::vector<char> results(lines.size());
+  // The predicate may replace itself (or modify the contents).
+  Predicate predicate = predicate_;
+  size_t version = version_;
+  size_t changes = changes_;
+  auto evaluate = [&predicate, &lines, &results](size_t start, size_t end) {
+    for (size_t i = start; i < end; i++) {
+      results[i] = predicate(lines[i]->ToString());
+    }
+  };
+
+  if (thread_safe_) {
+    size_t threads = std::max(
+        size_t(1), std::min(size_t(std::thread::hardware_concurrency()),
+                            lines.size() / kMinLinesPerThread));
+    size_t chunk = (lines.size() + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; i++) {
+      workers.emplace_back(evaluate, i * chunk,
+                           std::min(lines.size(), (i + 1) * chunk));
+    }
+    evaluate(0, std::min(lines.size(), chunk));
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  } else {
+    evaluate(0, lines.size());
+  }
+
+  if (version != version_ || changes != changes_) {
+    LOG(INFO) << "Filter or contents changed during evaluation, ignoring.";
+    return;
+  }
+  for (size_t i = 0; i < positions.size(); i++) {
+    known_[positions[i]] = true;
+    shown_[positions[i]] = results[i];
+  }
+  evaluated_lines_ += positions.size();
+}
+
+}  // namespace editor
+}  // namespace afc
@@ -0,0 +1,71 @@
+#ifndef __AFC_EDITOR_LINE_FILTER_H__
+#define __AFC_EDITOR_LINE_FILTER_H__
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "buffer_contents.h"
+
+namespace afc {
+namespace editor {
+
+using std::wstring;
+
+// Computes whether each line of a buffer passes its filter (and should
+// therefore be shown).
+//
+// The results are kept in a bitmap indexed by line (adjusted as lines are
+// inserted or removed, and discarded whenever the predicate changes) rather
+// than in the lines themselves. They are computed on demand, a block of lines
+// at a time (growing as lines are requested sequentially); thread-safe
+// predicates (such as regular expressions) are evaluated in multiple threads
+// over a snapshot of the lines in the block.
+class LineFilter {
+ public:
+  using Predicate = std::function<bool(const wstring& line)>;
+
+  // Lines will be shown iff predicate returns true for them. If thread_safe is
+  // true, the predicate may run concurrently in multiple threads.
+  void Set(Predicate predicate, bool thread_safe);
+  // All lines will be shown.
+  void Clear();
+
+  bool active() const { return predicate_ != nullptr; }
+  // Incremented whenever the predicate changes.
+  size_t version() const { return version_; }
+
+  // Must be called whenever the old_count lines starting at first are replaced
+  // by new_count lines (see BufferContents::AddLinesListener).
+  void LinesReplaced(size_t first, size_t old_count, size_t new_count);
+
+  // Returns true if the line should be shown. contents must be the contents
+  // whose changes are reported to LinesReplaced.
+  bool IsShown(const BufferContents& contents, size_t line);
+
+  // The number of lines whose result is known.
+  size_t evaluated_lines() const { return evaluated_lines_; }
+
+ private:
+  // Evaluates the predicate on the lines in the block that starts at line.
+  void EvaluateBlock(const BufferContents& contents, size_t line);
+
+  Predicate predicate_;
+  bool thread_safe_ = false;
+  size_t version_ = 0;
+
+  // Incremented whenever lines are replaced, so that evaluation can detect
+  // that the predicate modified the buffer.
+  size_t changes_ = 0;
+
+  // One entry per line.
+  std::vector<bool> known_;
+  std::vector<bool> shown_;
+  size_t evaluated_lines_ = 0;
+  size_t block_size_ = 0;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_LINE_FILTER_H__
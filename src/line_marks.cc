@@ -1,5 +1,6 @@
 #include "line_marks.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -13,91 +14,82 @@ namespace afc {
 namespace editor {
 
 void LineMarks::AddMark(Mark mark) {
-  marks[mark.source].insert(make_pair(mark.target_buffer, mark));
-  updates++;
+  Target* target = &targets_[mark.target_buffer];
+  if (mark.IsExpired()) {
+    target->expired_marks++;
+  }
+  auto source = mark.source;
+  auto it = target->marks.insert(make_pair(mark.target.line, std::move(mark)));
+  sources_[source].push_back({target, it});
 }
 
 void LineMarks::ExpireMarksFromSource(const OpenBuffer& source_buffer,
                                       const std::wstring& source) {
-  auto it = marks.find(source);
-  if (it == marks.end() || it->second.empty()) {
-    LOG(INFO) << "No marks from source: " << source;
+  auto it = sources_.find(source);
+  if (it == sources_.end() || it->second.empty()) {
+    VLOG(5) << "No marks from source: " << source;
     return;
   }
 
   DVLOG(5) << "Expiring marks from: " << source;
-  bool changes = false;
-  for (auto& mark : it->second) {
-    if (mark.second.IsExpired()) {
+  for (auto& entry : it->second) {
+    Mark& mark = entry.second->second;
+    if (mark.IsExpired()) {
       DVLOG(10) << "Skipping already expired mark.";
       continue;
     }
 
     DVLOG(10) << "Mark transitions from fresh to expired.";
-    changes = true;
-    auto line = source_buffer.empty()
+    auto line = source_buffer.empty() ||
+                        mark.source_line >= source_buffer.contents()->size()
                     ? nullptr
-                    : source_buffer.LineAt(mark.second.source_line);
+                    : source_buffer.LineAt(mark.source_line);
     if (line == nullptr) {
       DVLOG(3) << "Unable to find content for mark!";
-      mark.second.source_line_content = NewCopyString(L"Expired mark.");
+      mark.source_line_content = NewCopyString(L"Expired mark.");
     } else {
-      mark.second.source_line_content = line->contents();
+      mark.source_line_content = line->contents();
     }
-    CHECK(mark.second.IsExpired());
-  }
-
-  if (changes) {
-    LOG(INFO) << "Actually expired some marks.";
-    updates++;
+    CHECK(mark.IsExpired());
+    entry.first->expired_marks++;
   }
 }
 
 void LineMarks::RemoveExpiredMarksFromSource(const std::wstring& source) {
-  auto it = marks.find(source);
-  if (it == marks.end() || it->second.empty()) {
-    LOG(INFO) << "No marks from source: " << source;
+  auto it = sources_.find(source);
+  if (it == sources_.end() || it->second.empty()) {
+    VLOG(5) << "No marks from source: " << source;
     return;
   }
 
   DVLOG(5) << "Removing expired marks from: " << source;
-  bool changes = false;
   auto& marks_from_source = it->second;
-  for (auto mark = marks_from_source.begin();
-       mark != marks_from_source.end();) {
-    if (mark->second.IsExpired()) {
-      DVLOG(5) << "Removing expired mark.";
-      changes = true;
-      marks_from_source.erase(mark++);
-    } else {
-      DVLOG(10) << "Skipping fresh mark.";
-      ++mark;
-    }
-  }
+  auto fresh_end = std::remove_if(
+      marks_from_source.begin(), marks_from_source.end(),
+      [](const std::pair<Target*, std::multimap<size_t, Mark>::iterator>&
+             entry) {
+        if (!entry.second->second.IsExpired()) {
+          DVLOG(10) << "Skipping fresh mark.";
+          return false;
+        }
+        DVLOG(5) << "Removing expired mark.";
+        entry.first->expired_marks--;
+        entry.first->marks.erase(entry.second);
+        return true;
+      });
+  marks_from_source.erase(fresh_end, marks_from_source.end());
+}
 
-  if (changes) {
-    LOG(INFO) << "Actually removed some marks.";
-    updates++;
-  }
+const std::multimap<size_t, LineMarks::Mark>&
+LineMarks::GetMarksForTargetBuffer(const std::wstring& target_buffer) const {
+  static const std::multimap<size_t, Mark> empty;
+  auto it = targets_.find(target_buffer);
+  return it == targets_.end() ? empty : it->second.marks;
 }
 
-std::vector<LineMarks::Mark> LineMarks::GetMarksForTargetBuffer(
-    const std::wstring& target_buffer) const {
-  DLOG(INFO) << "Producing marks for buffer: " << target_buffer;
-  std::vector<LineMarks::Mark> output;
-  for (auto& source_it : marks) {
-    auto range = source_it.second.equal_range(target_buffer);
-    if (range.first == source_it.second.end()) {
-      DVLOG(5) << "Didn't find any marks.";
-      continue;
-    }
-    while (range.first != range.second) {
-      DVLOG(6) << "Mark: " << range.first->second;
-      output.push_back(range.first->second);
-      ++range.first;
-    }
-  }
-  return output;
+size_t LineMarks::GetExpiredMarksCount(const std::wstring& target_buffer) const {
+  auto it = targets_.find(target_buffer);
+  return it == targets_.end() ? 0 : it->second.expired_marks;
 }
 
 std::ostream& operator<<(std::ostream& os, const LineMarks::Mark& lm) {
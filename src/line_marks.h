@@ -16,7 +16,10 @@ namespace editor {
 
 class OpenBuffer;
 
-struct LineMarks {
+// Marks are indexed by their target buffer (so that a buffer can read its marks
+// directly, without any copies) and by their source (so that the marks from a
+// source can be expired or removed without scanning the marks of all targets).
+class LineMarks {
  public:
   struct Mark {
     // What created this mark?
@@ -53,12 +56,26 @@ struct LineMarks {
                              const std::wstring& source);
   void RemoveExpiredMarksFromSource(const std::wstring& source);
 
-  std::vector<Mark> GetMarksForTargetBuffer(
+  // Returns the marks for the target, keyed by the line they mark. The
+  // reference may be invalidated by AddMark.
+  const std::multimap<size_t, Mark>& GetMarksForTargetBuffer(
       const std::wstring& target_buffer) const;
+  size_t GetExpiredMarksCount(const std::wstring& target_buffer) const;
 
-  // First key is the source, second key is the target_buffer.
-  std::unordered_map<std::wstring, std::multimap<std::wstring, Mark>> marks;
-  size_t updates = 0;
+ private:
+  struct Target {
+    std::multimap<size_t, Mark> marks;
+    size_t expired_marks = 0;
+  };
+
+  // Entries are never removed, so that references to them remain valid.
+  std::unordered_map<std::wstring, Target> targets_;
+
+  // For each source, the marks it created.
+  std::unordered_map<
+      std::wstring,
+      std::vector<std::pair<Target*, std::multimap<size_t, Mark>::iterator>>>
+      sources_;
 };
 
 std::ostream& operator<<(std::ostream& os, const LineMarks::Mark& lc);
@@ -0,0 +1,175 @@
+#include "line_marks_resolver.h"
+
+#include <glog/logging.h>
+
+#include "file_link_mode.h"
+#include "wstring.h"
+
+namespace afc {
+namespace editor {
+
+LineMarksResolver::LineMarksResolver(std::function<void()> notify)
+    : notify_(std::move(notify)) {
+  CHECK(notify_);
+}
+
+LineMarksResolver::~LineMarksResolver() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  condition_.notify_all();
+  if (background_thread_.joinable()) {
+    background_thread_.join();
+  }
+}
+
+void LineMarksResolver::Resolve(const wstring& source,
+                                std::vector<wstring> search_paths,
+                                std::vector<Line> lines) {
+  if (lines.empty()) {
+    return;
+  }
+  VLOG(5) << "Lines to resolve from " << source << ": " << lines.size();
+  Request request;
+  request.source = source;
+  request.search_paths = std::move(search_paths);
+  request.lines = std::move(lines);
+  Schedule(std::move(request));
+}
+
+void LineMarksResolver::EndOfSource(const wstring& source) {
+  Request request;
+  request.source = source;
+  request.end_of_source = true;
+  Schedule(std::move(request));
+}
+
+void LineMarksResolver::Cancel(const wstring& source) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = generations_.find(source);
+  if (it != generations_.end()) {
+    it->second++;
+  }
+}
+
+bool LineMarksResolver::Publish(LineMarks* marks) {
+  std::vector<Result> results;
+  std::unordered_map<wstring, size_t> generations;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    results.swap(results_);
+    generations = generations_;
+  }
+  size_t published = 0;
+  for (auto& result : results) {
+    if (result.generation != generations[result.source]) {
+      VLOG(5) << "Discarding cancelled marks from: " << result.source;
+      continue;
+    }
+    for (auto& mark : result.marks) {
+      VLOG(5) << "Found a mark: " << mark;
+      marks->AddMark(std::move(mark));
+      published++;
+    }
+    if (result.end_of_source) {
+      // We know that the set of fresh marks is now complete.
+      marks->RemoveExpiredMarksFromSource(result.source);
+    }
+  }
+  if (published > 0) {
+    LOG(INFO) << "Published marks: " << published;
+  }
+  return !results.empty();
+}
+
+void LineMarksResolver::WaitForIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_.wait(lock, [this]() { return requests_.empty() && !busy_; });
+}
+
+void LineMarksResolver::Schedule(Request request) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    request.generation = generations_[request.source];
+    requests_.push_back(std::move(request));
+    if (!background_thread_.joinable()) {
+      background_thread_ = std::thread([this]() { BackgroundThread(); });
+    }
+  }
+  condition_.notify_all();
+}
+
+void LineMarksResolver::BackgroundThread() {
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(
+        lock, [this]() { return shutting_down_ || !requests_.empty(); });
+    if (shutting_down_) {
+      return;
+    }
+    Request request = std::move(requests_.front());
+    requests_.pop_front();
+    if (request.generation != generations_[request.source]) {
+      VLOG(5) << "Skipping cancelled request from: " << request.source;
+      condition_.notify_all();
+      continue;
+    }
+    busy_ = true;
+    lock.unlock();
+
+    Result result = ResolveRequest(request);
+
+    lock.lock();
+    bool notify = results_.empty();
+    results_.push_back(std::move(result));
+    lock.unlock();
+
+    if (notify) {
+      notify_();
+    }
+
+    lock.lock();
+    busy_ = false;
+    lock.unlock();
+    condition_.notify_all();
+  }
+}
+
+LineMarksResolver::Result LineMarksResolver::ResolveRequest(
+    const Request& request) {
+  Result result;
+  result.source = request.source;
+  result.generation = request.generation;
+  result.end_of_source = request.end_of_source;
+  if (request.lines.empty()) {
+    return result;
+  }
+
+  // Directories are checked once per request, so that changes to the file
+  // system are noticed between requests (but not in the middle of one).
+  path_cache_.NewGeneration();
+  size_t stat_calls = path_cache_.stat_calls();
+
+  auto resolve = [this](const wstring& path) {
+    return path_cache_.Resolve(path);
+  };
+  for (const auto& line : request.lines) {
+    LineMarks::Mark mark;
+    wstring pattern;
+    if (!FindPathInSearchPaths(request.search_paths, line.contents, resolve,
+                               &mark.target_buffer, &mark.target, &pattern)) {
+      continue;
+    }
+    mark.source = request.source;
+    mark.source_line = line.source_line;
+    result.marks.push_back(std::move(mark));
+  }
+  VLOG(5) << request.source << ": Resolved lines: " << request.lines.size()
+          << ", marks: " << result.marks.size()
+          << ", stat calls: " << path_cache_.stat_calls() - stat_calls;
+  return result;
+}
+
+}  // namespace editor
+}  // namespace afc
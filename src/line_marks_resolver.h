@@ -0,0 +1,102 @@
+#ifndef __AFC_EDITOR_LINE_MARKS_RESOLVER_H__
+#define __AFC_EDITOR_LINE_MARKS_RESOLVER_H__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "line_marks.h"
+#include "path_cache.h"
+
+namespace afc {
+namespace editor {
+
+using std::wstring;
+
+// Finds the lines (of buffers with contains_line_marks) that reference files,
+// such as "foo.cc:12: error: ...", and turns them into marks.
+//
+// Lines are resolved in a background thread (using a PathCache, so that the
+// files mentioned repeatedly don't need to be looked up every time). The marks
+// found are retained until Publish (which must run in the main thread) adds
+// them to LineMarks in a single batch.
+class LineMarksResolver {
+ public:
+  struct Line {
+    size_t source_line;
+    // The contents of the line, with the path already expanded.
+    wstring contents;
+  };
+
+  // notify will be called from the background thread whenever marks become
+  // available; it should cause Publish to run.
+  explicit LineMarksResolver(std::function<void()> notify);
+  ~LineMarksResolver();
+
+  void Resolve(const wstring& source, std::vector<wstring> search_paths,
+               std::vector<Line> lines);
+
+  // Signals that source has no more lines: once the marks for all the lines
+  // given to Resolve have been published, the expired marks from source are
+  // removed.
+  void EndOfSource(const wstring& source);
+
+  // Discards all the lines from source that haven't been published (e.g.,
+  // because the contents of the source were cleared).
+  void Cancel(const wstring& source);
+
+  // Adds to marks all the marks found so far (and removes expired marks as
+  // requested by EndOfSource). Returns true if marks may have changed.
+  bool Publish(LineMarks* marks);
+
+  // Blocks until all the lines given to Resolve have been resolved.
+  void WaitForIdle();
+
+ private:
+  struct Request {
+    wstring source;
+    size_t generation;
+    std::vector<wstring> search_paths;
+    std::vector<Line> lines;
+    bool end_of_source = false;
+  };
+
+  struct Result {
+    wstring source;
+    size_t generation;
+    std::vector<LineMarks::Mark> marks;
+    bool end_of_source = false;
+  };
+
+  void Schedule(Request request);
+  void BackgroundThread();
+  Result ResolveRequest(const Request& request);
+
+  const std::function<void()> notify_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread background_thread_;
+  bool shutting_down_ = false;
+  // True while the background thread is resolving a request.
+  bool busy_ = false;
+
+  std::deque<Request> requests_;
+  std::vector<Result> results_;
+  // Incremented by Cancel, to detect results that are no longer wanted.
+  std::unordered_map<wstring, size_t> generations_;
+
+  // Only accessed by the background thread.
+  PathCache path_cache_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_LINE_MARKS_RESOLVER_H__
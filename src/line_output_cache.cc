@@ -0,0 +1,101 @@
+#include "line_output_cache.h"
+
+#include <tuple>
+
+#include <glog/logging.h>
+
+namespace afc {
+namespace editor {
+
+void LineOutputRecorder::AddCharacter(wchar_t c) {
+  AddString(wstring(1, c));
+}
+
+void LineOutputRecorder::AddString(const wstring& str) {
+  if (str.empty()) {
+    return;
+  }
+  if (!segments_.empty() && !segments_.back().str.empty()) {
+    segments_.back().str += str;
+    return;
+  }
+  segments_.emplace_back();
+  segments_.back().str = str;
+}
+
+void LineOutputRecorder::AddModifier(LineModifier modifier) {
+  segments_.emplace_back();
+  segments_.back().modifier = modifier;
+}
+
+/* static */ void LineOutputRecorder::Replay(
+    const std::vector<Segment>& segments,
+    Line::OutputReceiverInterface* receiver) {
+  for (const auto& segment : segments) {
+    if (segment.str.empty()) {
+      receiver->AddModifier(segment.modifier);
+    } else {
+      receiver->AddString(segment.str);
+    }
+  }
+}
+
+bool LineOutputCache::InternalKey::operator<(const InternalKey& other) const {
+  return std::tie(line, line_number, column, width, prefix, prefix_modifier,
+                  parse_tree) < std::tie(other.line, other.line_number,
+                                         other.column, other.width,
+                                         other.prefix, other.prefix_modifier,
+                                         other.parse_tree);
+}
+
+const LineOutputCache::Entry* LineOutputCache::Find(const Key& key) {
+  auto it = entries_.find(ToInternalKey(key));
+  if (it == entries_.end()) {
+    stats_.misses++;
+    return nullptr;
+  }
+  // The addresses may have been reused by new instances.
+  if (it->second.line.lock() != key.line ||
+      it->second.parse_tree.lock() != key.parse_tree) {
+    entries_.erase(it);
+    stats_.misses++;
+    return nullptr;
+  }
+  stats_.hits++;
+  it->second.last_used_frame = frame_;
+  return &it->second.entry;
+}
+
+const LineOutputCache::Entry* LineOutputCache::Insert(const Key& key,
+                                                     Entry entry) {
+  InternalEntry& output = entries_[ToInternalKey(key)];
+  output.entry = std::move(entry);
+  output.line = key.line;
+  output.parse_tree = key.parse_tree;
+  output.last_used_frame = frame_;
+  return &output.entry;
+}
+
+void LineOutputCache::FinishFrame() {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->second.last_used_frame + 1 < frame_) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  VLOG(5) << "Line output cache: entries: " << entries_.size()
+          << ", hits: " << stats_.hits << ", misses: " << stats_.misses;
+  frame_++;
+}
+
+/* static */ LineOutputCache::InternalKey LineOutputCache::ToInternalKey(
+    const Key& key) {
+  return InternalKey{key.line.get(),   key.line_number,
+                     key.column,       key.width,
+                     key.prefix,       key.prefix_modifier,
+                     key.parse_tree.get()};
+}
+
+}  // namespace editor
+}  // namespace afc
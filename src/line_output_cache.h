@@ -0,0 +1,113 @@
+#ifndef __AFC_EDITOR_LINE_OUTPUT_CACHE_H__
+#define __AFC_EDITOR_LINE_OUTPUT_CACHE_H__
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "line.h"
+#include "line_modifier.h"
+#include "src/parse_tree.h"
+
+namespace afc {
+namespace editor {
+
+// A Line::OutputReceiverInterface that records the calls it receives, so that
+// they can be replayed later (into a different receiver).
+class LineOutputRecorder : public Line::OutputReceiverInterface {
+ public:
+  struct Segment {
+    // If empty, this segment is a call to AddModifier.
+    wstring str;
+    LineModifier modifier = LineModifier::RESET;
+  };
+
+  void AddCharacter(wchar_t c) override;
+  void AddString(const wstring& str) override;
+  void AddModifier(LineModifier modifier) override;
+
+  std::vector<Segment> TakeSegments() { return std::move(segments_); }
+
+  static void Replay(const std::vector<Segment>& segments,
+                     Line::OutputReceiverInterface* receiver);
+
+ private:
+  std::vector<Segment> segments_;
+};
+
+// Cache of the output produced for the contents of lines in the screen.
+// Since lines are immutable (modifications replace them with new instances),
+// the output only depends on the line instance and the options in the key.
+//
+// Entries only retain weak references to the line and parse tree; an entry
+// whose line or tree has been deleted is never returned.
+class LineOutputCache {
+ public:
+  struct Key {
+    std::shared_ptr<const Line> line;
+    size_t line_number = 0;
+    // The first column of the line that should be shown and the number of
+    // columns available to show it.
+    size_t column = 0;
+    size_t width = 0;
+    // The prefix (e.g., the line number), shown with prefix_modifier.
+    wstring prefix;
+    LineModifier prefix_modifier = LineModifier::RESET;
+    std::shared_ptr<const ParseTree> parse_tree;
+  };
+
+  struct Entry {
+    std::vector<LineOutputRecorder::Segment> segments;
+    // Number of columns used by the output (including the prefix).
+    size_t output_column = 0;
+  };
+
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+  };
+
+  // Returns the entry for the key, or nullptr if it isn't in the cache.
+  const Entry* Find(const Key& key);
+  // Returns the inserted entry.
+  const Entry* Insert(const Key& key, Entry entry);
+
+  // Must be called at the end of each frame. Evicts the entries that weren't
+  // used in the current or the previous frame.
+  void FinishFrame();
+
+  const Stats& stats() const { return stats_; }
+  size_t size() const { return entries_.size(); }
+
+ private:
+  struct InternalKey {
+    bool operator<(const InternalKey& other) const;
+
+    const Line* line;
+    size_t line_number;
+    size_t column;
+    size_t width;
+    wstring prefix;
+    LineModifier prefix_modifier;
+    const ParseTree* parse_tree;
+  };
+
+  struct InternalEntry {
+    Entry entry;
+    std::weak_ptr<const Line> line;
+    std::weak_ptr<const ParseTree> parse_tree;
+    size_t last_used_frame;
+  };
+
+  static InternalKey ToInternalKey(const Key& key);
+
+  std::map<InternalKey, InternalEntry> entries_;
+  size_t frame_ = 0;
+  Stats stats_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_LINE_OUTPUT_CACHE_H__
@@ -198,6 +198,8 @@ void Prompt(EditorState* editor_state, PromptOptions options) {
   auto original_buffer = editor_state->current_buffer();
   insert_mode_options.modify_listener = [editor_state, original_buffer, buffer,
                                          options]() {
+    // The input changed: predictions for the old input are no longer wanted.
+    CancelPredictions(editor_state);
     editor_state->set_current_buffer(original_buffer);
     UpdateStatus(editor_state, buffer.get(), options.prompt);
   };
@@ -286,7 +288,8 @@ void Prompt(EditorState* editor_state, PromptOptions options) {
               editor_state->ScheduleRedraw();
             }
           }
-        });
+        },
+        options.predictions_ranked);
     return true;
   };
 
@@ -32,6 +32,10 @@ struct PromptOptions {
 
   // Optional. Useful for automatic completion.
   Predictor predictor = EmptyPredictor;
+
+  // Optional. Set if predictor produces ranked matches rather than completions
+  // (see Predict).
+  bool predictions_ranked = false;
 };
 
 void Prompt(EditorState* editor_state, PromptOptions options);
@@ -30,15 +30,17 @@ class ListBuffersBuffer : public OpenBuffer {
     set_bool_variable(buffer_variables::wrap_long_lines(), false);
   }
 
+  // Only the rows of buffers that have changed (since the last reload) are
+  // rendered again; the lines of the target are only replaced in the range
+  // that actually changed.
   void ReloadInto(EditorState* editor_state, OpenBuffer* target) {
-    target->ClearContents(editor_state);
     bool show_in_buffers_list = Read(buffer_variables::show_in_buffers_list());
 
     size_t screen_lines = 0;
     auto screen_value = environment()->Lookup(L"screen");
     if (screen_value != nullptr && screen_value->type == VMType::OBJECT_TYPE &&
-        screen_value->user_value != nullptr) {
-      auto screen = static_cast<Screen*>(screen_value->user_value.get());
+        screen_value->user_value() != nullptr) {
+      auto screen = static_cast<Screen*>(screen_value->user_value().get());
       const size_t reserved_lines = 1;  // For the status.
       screen_lines =
           static_cast<size_t>(max(size_t(0), screen->lines() - reserved_lines));
@@ -48,11 +50,11 @@ class ListBuffersBuffer : public OpenBuffer {
     for (const auto& it : *editor_state->buffers()) {
       if (!show_in_buffers_list &&
           !it.second->Read(buffer_variables::show_in_buffers_list())) {
-        LOG(INFO) << "Skipping buffer (!show_in_buffers_list).";
+        VLOG(5) << "Skipping buffer (!show_in_buffers_list).";
         continue;
       }
       if (it.second.get() == target) {
-        LOG(INFO) << "Skipping current buffer.";
+        VLOG(5) << "Skipping current buffer.";
         continue;
       }
       buffers_to_show.push_back(it.second);
@@ -97,47 +99,58 @@ class ListBuffersBuffer : public OpenBuffer {
       }
       CHECK_EQ(extra_lines, size_t(0));
     }
+    size_t width = target->Read(buffer_variables::line_width());
+    std::unordered_map<size_t, Row> rows;
+    vector<std::shared_ptr<const Line>> lines;
     for (const auto& buffer : buffers_to_show) {
-      size_t context_lines_var = lines_to_show[buffer.get()] - 1;
-      auto context = LinesToShow(*buffer, context_lines_var);
-      std::shared_ptr<LazyString> name = NewCopyString(buffer->name());
-      if (context.first != context.second) {
-        name = StringAppend(NewCopyString(L"╭──"), name);
-        size_t width = target->Read(buffer_variables::line_width());
-        if (width > name->size()) {
-          name = StringAppend(
-              name,
-              NewCopyString(wstring(width - (name->size() + 1), L'─') + L"╮"));
-        }
+      Row::Key key;
+      key.name = buffer->name();
+      key.width = width;
+      key.context_lines = lines_to_show[buffer.get()] - 1;
+      auto context = LinesToShow(*buffer, key.context_lines);
+      for (size_t i = context.first; i < context.second; i++) {
+        key.context.push_back(buffer->LineAt(i));
       }
-      if (target->contents()->size() == 1 &&
-          target->contents()->at(0)->size() == 0) {
-        target->AppendToLastLine(editor_state, std::move(name));
+
+      Row row;
+      auto it = rows_.find(buffer->id());
+      if (it != rows_.end() && it->second.key == key) {
+        row = std::move(it->second);
       } else {
-        target->AppendLine(editor_state, std::move(name));
-      }
-      AdjustLastLine(target, buffer);
-
-      size_t index = 0;
-      while (index < context_lines_var) {
-        Line::Options options;
-        options.contents =
-            NewCopyString(index + 1 == context_lines_var ? L"╰ " : L"│ ");
-        options.modifiers.resize(options.contents->size());
-        if (context.first < context.second) {
-          auto line = buffer->LineAt(context.first);
-          options.contents = StringAppend(options.contents, line->contents());
-          for (const auto& m : line->modifiers()) {
-            options.modifiers.push_back(m);
-          }
-          context.first++;
-        }
-        CHECK_EQ(options.contents->size(), options.modifiers.size());
-        target->AppendRawLine(editor_state, std::make_shared<Line>(options));
-        AdjustLastLine(target, buffer);
-        ++index;
+        VLOG(5) << "Rendering row: " << buffer->name();
+        row.lines = RenderRow(buffer, key);
+        row.key = std::move(key);
       }
+      lines.insert(lines.end(), row.lines.begin(), row.lines.end());
+      rows.insert({buffer->id(), std::move(row)});
+    }
+    // Drops the rows of buffers no longer shown.
+    rows_ = std::move(rows);
+    if (lines.empty()) {
+      lines.push_back(empty_line_);
     }
+
+    const BufferContents& contents = *target->contents();
+    size_t prefix = 0;
+    while (prefix < lines.size() && prefix < contents.size() &&
+           lines[prefix] == contents.at(prefix)) {
+      prefix++;
+    }
+    size_t suffix = 0;
+    while (suffix < lines.size() - prefix &&
+           suffix < contents.size() - prefix &&
+           lines[lines.size() - suffix - 1] ==
+               contents.at(contents.size() - suffix - 1)) {
+      suffix++;
+    }
+    if (prefix == lines.size() && prefix == contents.size()) {
+      VLOG(5) << "List of buffers unchanged.";
+      return;
+    }
+    target->ReplaceLines(
+        prefix, contents.size() - prefix - suffix,
+        vector<std::shared_ptr<const Line>>(lines.begin() + prefix,
+                                            lines.end() - suffix));
     editor_state->ScheduleRedraw();
   }
 
@@ -164,10 +177,69 @@ class ListBuffersBuffer : public OpenBuffer {
   }
 
  private:
-  void AdjustLastLine(OpenBuffer* target, std::shared_ptr<OpenBuffer> buffer) {
-    target->contents()->back()->environment()->Define(
-        L"buffer", Value::NewObject(L"Buffer", buffer));
+  // The lines shown for a buffer.
+  struct Row {
+    // The inputs from which the lines were rendered.
+    struct Key {
+      bool operator==(const Key& other) const {
+        return name == other.name && width == other.width &&
+               context_lines == other.context_lines && context == other.context;
+      }
+
+      wstring name;
+      size_t width = 0;
+      size_t context_lines = 0;
+      // Lines are immutable, so we compare them by address.
+      vector<std::shared_ptr<const Line>> context;
+    };
+
+    Key key;
+    vector<std::shared_ptr<const Line>> lines;
+  };
+
+  vector<std::shared_ptr<const Line>> RenderRow(
+      const std::shared_ptr<OpenBuffer>& buffer, const Row::Key& key) {
+    vector<std::shared_ptr<const Line>> output;
+    std::shared_ptr<LazyString> name = NewCopyString(key.name);
+    if (!key.context.empty()) {
+      name = StringAppend(NewCopyString(L"╭──"), name);
+      if (key.width > name->size()) {
+        name = StringAppend(
+            name, NewCopyString(wstring(key.width - (name->size() + 1), L'─') +
+                                L"╮"));
+      }
+    }
+    output.push_back(NewRowLine(Line::Options(std::move(name)), buffer));
+
+    for (size_t index = 0; index < key.context_lines; index++) {
+      Line::Options options;
+      options.contents =
+          NewCopyString(index + 1 == key.context_lines ? L"╰ " : L"│ ");
+      options.modifiers.resize(options.contents->size());
+      if (index < key.context.size()) {
+        const auto& line = key.context[index];
+        options.contents = StringAppend(options.contents, line->contents());
+        for (const auto& m : line->modifiers()) {
+          options.modifiers.push_back(m);
+        }
+      }
+      CHECK_EQ(options.contents->size(), options.modifiers.size());
+      output.push_back(NewRowLine(std::move(options), buffer));
+    }
+    return output;
   }
+
+  std::shared_ptr<const Line> NewRowLine(Line::Options options,
+                                         std::shared_ptr<OpenBuffer> buffer) {
+    auto line = std::make_shared<Line>(std::move(options));
+    line->environment()->Define(L"buffer",
+                                Value::NewObject(L"Buffer", std::move(buffer)));
+    return line;
+  }
+
+  // Keyed by the id of the buffer.
+  std::unordered_map<size_t, Row> rows_;
+  const std::shared_ptr<const Line> empty_line_ = std::make_shared<Line>();
 };
 
 class ListBuffersCommand : public Command {
@@ -8,7 +8,6 @@
 
 extern "C" {
 #include <fcntl.h>
-#include <poll.h>
 #include <signal.h>
 #include <sys/types.h>
 }
@@ -24,6 +23,7 @@ extern "C" {
 #include "run_command_handler.h"
 #include "screen.h"
 #include "screen_curses.h"
+#include "screen_damage_tracking.h"
 #include "screen_vm.h"
 #include "server.h"
 #include "terminal.h"
@@ -83,6 +83,9 @@ struct Args {
 
   bool mute = false;
   bool background = false;
+
+  // Limits on the frequency with which we redraw the screen.
+  RedrawScheduler::Options redraw_options;
 };
 
 static const char* kDefaultCommandsToRun = "ForkCommand(\"sh -l\", true);";
@@ -107,8 +110,9 @@ string CommandsToRun(Args args) {
                        (args.background ? "false" : "true") + ");\n";
   }
   if (!args.client.empty()) {
-    commands_to_run += "Screen screen = RemoteScreen(\"" +
-                       string(getenv(kEdgeParentAddress)) + "\");\n";
+    commands_to_run += "Screen screen = RemoteScreenWithProtocols(\"" +
+                       string(getenv(kEdgeParentAddress)) +
+                       "\", \"binary vm\");\n";
   }
   if (commands_to_run.empty()) {
     return kDefaultCommandsToRun;
@@ -130,7 +134,9 @@ Args ParseArgs(int* argc, const char*** argv) {
       "  -s, --server <path>    Runs in daemon mode at path given\n"
       "  -c, --client <path>    Connects to daemon at path given\n"
       "  --mute                 Disables audio output\n"
-      "  --bg                   -f opens buffers in background\n";
+      "  --bg                   -f opens buffers in background\n"
+      "  --max_fps <fps>        Maximum frequency of screen redraws\n"
+      "  --input_latency <ms>   Maximum delay before showing keystrokes\n";
 
   Args output;
   auto pop_argument = [argc, argv, &output]() {
@@ -186,6 +192,15 @@ Args ParseArgs(int* argc, const char*** argv) {
       output.mute = true;
     } else if (cmd == "--bg") {
       output.background = true;
+    } else if (cmd == "--max_fps") {
+      CHECK_GT(*argc, 0) << output.binary_name << ": " << cmd
+                         << ": Expected number of frames per second.\n";
+      output.redraw_options.max_fps = atof(pop_argument());
+    } else if (cmd == "--input_latency") {
+      CHECK_GT(*argc, 0) << output.binary_name << ": " << cmd
+                         << ": Expected number of milliseconds.\n";
+      output.redraw_options.input_latency =
+          std::chrono::milliseconds(atoi(pop_argument()));
     } else {
       cerr << output.binary_name << ": Invalid flag: " << cmd << std::endl;
       exit(1);
@@ -265,6 +280,7 @@ int main(int argc, const char** argv) {
 
   auto audio_player = args.mute ? NewNullAudioPlayer() : NewAudioPlayer();
   global_editor_state = std::make_unique<EditorState>(audio_player.get());
+  editor_state()->redraw_scheduler()->set_options(args.redraw_options);
 
   int remote_server_fd = -1;
   if (!args.client.empty()) {
@@ -290,7 +306,7 @@ int main(int argc, const char** argv) {
 
   std::shared_ptr<Screen> screen_curses;
   if (!args.server) {
-    screen_curses = NewScreenCurses();
+    screen_curses = std::make_shared<DamageTrackingScreen>(NewScreenCurses());
   }
   RegisterScreenType(editor_state()->environment());
   editor_state()->environment()->Define(
@@ -332,12 +348,45 @@ int main(int argc, const char** argv) {
   BeepFrequencies(audio_player.get(), {783.99, 723.25, 783.99});
   editor_state()->SetStatus(GetGreetingMessage());
 
+  std::unique_ptr<EventLoop::Registration> terminal_registration;
+  if (screen_curses != nullptr) {
+    terminal_registration = editor_state()->event_loop()->Register(0, [&]() {
+      wint_t c;
+      while ((c = ReadChar(&mbstate)) != static_cast<wint_t>(-1)) {
+        if (remote_server_fd == -1) {
+          editor_state()->ProcessInput(c);
+        } else {
+          SendCommandsToParent(remote_server_fd,
+                               "ProcessInput(" + std::to_string(c) + ");\n");
+        }
+      }
+    });
+  }
+
+  auto redraw_scheduler = editor_state()->redraw_scheduler();
+  auto timer_wheel = editor_state()->timer_wheel();
+  // Redraws requested (e.g., by output from background threads or by timers)
+  // need a frame; if we're showing frames too often, the scheduler will
+  // coalesce them.
+  auto take_redraw_request = [&]() {
+    if (editor_state()->TakeRedrawRequest()) {
+      redraw_scheduler->RedrawRequested();
+    }
+  };
   while (!editor_state()->terminate()) {
-    editor_state()->UpdateBuffers();
-    auto screen_state = editor_state()->FlushScreenState();
+    timer_wheel->RunExpired(TimerWheel::Clock::now());
+    take_redraw_request();
+    bool frame_due = redraw_scheduler->FrameDue(RedrawScheduler::Clock::now());
+    EditorState::ScreenState screen_state;
+    if (frame_due) {
+      editor_state()->UpdateBuffers();
+      screen_state = editor_state()->FlushScreenState();
+    }
     if (screen_curses != nullptr) {
       if (args.client.empty()) {
-        terminal.Display(editor_state(), screen_curses.get(), screen_state);
+        if (frame_due) {
+          terminal.Display(editor_state(), screen_curses.get(), screen_state);
+        }
       } else {
         screen_curses->Refresh();  // Don't want this to be buffered!
         auto screen_size =
@@ -355,12 +404,15 @@ int main(int argc, const char** argv) {
     }
     VLOG(5) << "Updating remote screens.";
     for (auto& buffer : *editor_state()->buffers()) {
+      if (!frame_due) {
+        break;
+      }
       auto value = buffer.second->environment()->Lookup(L"screen");
       if (value->type.type != VMType::OBJECT_TYPE ||
           value->type.object_type != L"Screen") {
         continue;
       }
-      auto buffer_screen = static_cast<Screen*>(value->user_value.get());
+      auto buffer_screen = static_cast<Screen*>(value->user_value().get());
       if (buffer_screen == nullptr) {
         continue;
       }
@@ -370,46 +422,21 @@ int main(int argc, const char** argv) {
       LOG(INFO) << "Remote screen for buffer: " << buffer.first;
       terminal.Display(editor_state(), buffer_screen, screen_state);
     }
-
-    std::vector<std::shared_ptr<OpenBuffer>> buffers;
-
-    // The file descriptor at position i will be either fd or fd_error of
-    // buffers[i]. The exception to this is fd 0 (at the end).
-    struct pollfd fds[editor_state()->buffers()->size() * 2 + 3];
-    buffers.reserve(sizeof(fds) / sizeof(fds[0]));
-
-    for (auto& buffer : *editor_state()->buffers()) {
-      if (buffer.second->fd() != -1) {
-        VLOG(5) << buffer.first
-                << ": Installing (out) fd: " << buffer.second->fd();
-        fds[buffers.size()].fd = buffer.second->fd();
-        fds[buffers.size()].events = POLLIN | POLLPRI;
-        buffers.push_back(buffer.second);
-      }
-      if (buffer.second->fd_error() != -1) {
-        VLOG(5) << buffer.first
-                << ": Installing (err) fd: " << buffer.second->fd();
-        fds[buffers.size()].fd = buffer.second->fd_error();
-        fds[buffers.size()].events = POLLIN | POLLPRI;
-        buffers.push_back(buffer.second);
-      }
+    if (frame_due) {
+      terminal.FinishFrame();
+      redraw_scheduler->FrameDrawn(RedrawScheduler::Clock::now());
     }
 
-    if (screen_curses != nullptr) {
-      fds[buffers.size()].fd = 0;
-      fds[buffers.size()].events = POLLIN | POLLPRI;
-      buffers.push_back(nullptr);
-    }
-
-    fds[buffers.size()].fd = editor_state()->fd_to_detect_internal_events();
-    fds[buffers.size()].events = POLLIN | POLLPRI;
-    buffers.push_back(nullptr);
-
-    // TODO: Change to -1. Requires figuring out a way for background threads of
-    // buffers to trigger redraws.
-    if (poll(fds, buffers.size(), 1000) == -1) {
-      CHECK_EQ(errno, EINTR) << "poll failed: " << strerror(errno);
-
+    // Background threads of buffers wake us up through the internal events
+    // file descriptor; anything else that needs to happen at a given time is
+    // scheduled in the timer wheel. If nothing is due, we sleep until input
+    // arrives.
+    take_redraw_request();
+    int wait_result = editor_state()->event_loop()->Wait(
+        redraw_scheduler->PollTimeoutMs(
+            RedrawScheduler::Clock::now(),
+            timer_wheel->TimeoutMs(TimerWheel::Clock::now())));
+    if (wait_result == -1) {
       LOG(INFO) << "Received signals.";
       if (args.client.empty()) {
         // We schedule a redraw in case the signal was SIGWINCH (the screen
@@ -422,46 +449,16 @@ int main(int argc, const char** argv) {
 
       continue;
     }
-
-    for (size_t i = 0; i < buffers.size(); i++) {
-      if (!(fds[i].revents & (POLLIN | POLLPRI | POLLHUP))) {
-        continue;
-      }
-      if (fds[i].fd == 0) {
-        CHECK(screen_curses != nullptr);
-        wint_t c;
-        while ((c = ReadChar(&mbstate)) != static_cast<wint_t>(-1)) {
-          if (remote_server_fd == -1) {
-            editor_state()->ProcessInput(c);
-          } else {
-            SendCommandsToParent(remote_server_fd,
-                                 "ProcessInput(" + std::to_string(c) + ");\n");
-          }
-        }
-        continue;
-      }
-
-      if (fds[i].fd == editor_state()->fd_to_detect_internal_events()) {
-        char buffer[4096];
-        VLOG(5) << "Internal events detected.";
-        while (read(fds[i].fd, buffer, sizeof(buffer)) > 0) continue;
-        continue;
-      }
-
-      CHECK_LE(i, buffers.size());
-      CHECK(buffers[i] != nullptr);
-      if (buffers[i] && fds[i].fd == buffers[i]->fd()) {
-        LOG(INFO) << "Reading (normal): " << buffers[i]->name();
-        buffers[i]->ReadData(editor_state());
-      } else if (buffers[i] && fds[i].fd == buffers[i]->fd_error()) {
-        LOG(INFO) << "Reading (error): " << buffers[i]->name();
-        buffers[i]->ReadErrorData(editor_state());
-      } else {
-        LOG(FATAL) << "Invalid file descriptor.";
-      }
-    }
   }
 
+  const auto& stats = redraw_scheduler->stats();
+  LOG(INFO) << "Redraw stats: frames drawn: " << stats.frames_drawn
+            << ", frames dropped: " << stats.frames_dropped
+            << ", input frames: " << stats.input_frames
+            << ", max input latency (ms): "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   stats.input_latency_max)
+                   .count();
   LOG(INFO) << "Removing server file: " << server_path;
   unlink(ToByteString(server_path).c_str());
   return editor_state()->exit_value();
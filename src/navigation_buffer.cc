@@ -56,7 +56,7 @@ class NavigationBuffer : public OpenBuffer {
     int depth =
         depth_value == nullptr || depth_value->type.type != VMType::VM_INTEGER
             ? 3
-            : size_t(max(0, depth_value->integer));
+            : size_t(max(0, depth_value->integer()));
     DisplayTree(editor_state, source, depth, *tree, EmptyString(), target);
   }
 
@@ -1,5 +1,7 @@
 #include "open_file_command.h"
 
+#include <sstream>
+
 extern "C" {
 #include <sys/stat.h>
 }
@@ -23,6 +25,33 @@ void OpenFileHandler(const wstring& name, EditorState* editor_state) {
   OpenFile(options);
 }
 
+void ResetMode(EditorState* editor_state) {
+  if (editor_state->has_current_buffer()) {
+    editor_state->current_buffer()->second->ResetMode();
+  }
+}
+
+// Opens input if it's the path of an existing file; otherwise, the best match
+// for input in the index.
+void FuzzyOpenFileHandler(const wstring& input, EditorState* editor_state) {
+  struct stat stat_buffer;
+  if (input.empty() || stat(ToByteString(input).c_str(), &stat_buffer) != -1) {
+    OpenFileHandler(input, editor_state);
+    return;
+  }
+  auto matches = editor_state->path_crawler()->index()->Find(input, 1);
+  if (matches.empty()) {
+    editor_state->SetWarningStatus(
+        editor_state->path_crawler()->crawling()
+            ? L"Still looking for files, try again."
+            : L"No files match: " + input);
+    ResetMode(editor_state);
+    return;
+  }
+  LOG(INFO) << "Best match for " << input << ": " << matches[0];
+  OpenFileHandler(matches[0], editor_state);
+}
+
 }  // namespace
 
 std::unique_ptr<Command> NewOpenFileCommand() {
@@ -30,11 +59,7 @@ std::unique_ptr<Command> NewOpenFileCommand() {
   options.prompt = L"<";
   options.history_file = L"files";
   options.handler = OpenFileHandler;
-  options.cancel_handler = [](EditorState* editor_state) {
-    if (editor_state->has_current_buffer()) {
-      editor_state->current_buffer()->second->ResetMode();
-    }
-  };
+  options.cancel_handler = ResetMode;
   options.predictor = FilePredictor;
   return NewLinePromptCommand(
       L"loads a file", [options](EditorState* editor_state) {
@@ -59,5 +84,32 @@ std::unique_ptr<Command> NewOpenFileCommand() {
       });
 }
 
+std::unique_ptr<Command> NewFuzzyOpenFileCommand() {
+  PromptOptions options;
+  options.prompt = L"<~";
+  options.history_file = L"files";
+  options.handler = FuzzyOpenFileHandler;
+  options.cancel_handler = ResetMode;
+  options.predictor = FuzzyFilePredictor;
+  options.predictions_ranked = true;
+  return NewLinePromptCommand(
+      L"loads a file (fuzzy search)", [options](EditorState* editor_state) {
+        // Crawling again picks up the files created since the last time.
+        wstring patterns =
+            editor_state->has_current_buffer()
+                ? editor_state->current_buffer()->second->Read(
+                      buffer_variables::fuzzy_finder_ignore())
+                : buffer_variables::fuzzy_finder_ignore()->default_value();
+        std::wistringstream patterns_stream(patterns);
+        std::vector<wstring> ignore_patterns;
+        wstring pattern;
+        while (patterns_stream >> pattern) {
+          ignore_patterns.push_back(pattern);
+        }
+        editor_state->path_crawler()->Crawl(L".", std::move(ignore_patterns));
+        return options;
+      });
+}
+
 }  // namespace editor
 }  // namespace afc
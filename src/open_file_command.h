@@ -10,6 +10,10 @@ namespace editor {
 
 std::unique_ptr<Command> NewOpenFileCommand();
 
+// Prompts for a file and opens the best fuzzy match for the input among the
+// files in the tree of the current directory (see PathIndex).
+std::unique_ptr<Command> NewFuzzyOpenFileCommand();
+
 }  // namespace editor
 }  // namespace afc
 
@@ -0,0 +1,102 @@
+#include "path_cache.h"
+
+#include <cstdlib>
+
+extern "C" {
+#include <sys/stat.h>
+#include <sys/types.h>
+}
+
+#include <glog/logging.h>
+
+#include "wstring.h"
+
+namespace afc {
+namespace editor {
+
+namespace {
+// Lines that aren't paths (e.g., compiler messages containing slashes) yield
+// directories that don't exist; this bounds the memory they take.
+const size_t kMaxDirectories = 16384;
+
+// The resolution of modification times can be coarse (e.g., one tick of the
+// kernel clock); directories modified in the last few seconds aren't trusted.
+const time_t kRacySeconds = 2;
+}  // namespace
+
+wstring PathCache::Resolve(const wstring& path) {
+  CHECK(!path.empty());
+  size_t slash = path.find_last_of(L'/');
+  if (slash == path.size() - 1) {
+    // No file name: just check the directory.
+    struct timespec mtime;
+    return Stat(path, &mtime) ? path : L"";
+  }
+
+  wstring directory_path = slash == wstring::npos
+                               ? L"."
+                               : slash == 0 ? L"/" : path.substr(0, slash);
+  const Directory& directory = GetDirectory(directory_path);
+  if (!directory.exists) {
+    VLOG(6) << path << ": directory doesn't exist";
+    return L"";
+  }
+
+  wstring name = slash == wstring::npos ? path : path.substr(slash + 1);
+  auto it = directory.files.find(name);
+  if (it != directory.files.end()) {
+    return it->second;
+  }
+
+  wstring real_path;
+  struct timespec mtime;
+  if (Stat(path, &mtime)) {
+    char* result = realpath(ToByteString(path).c_str(), nullptr);
+    real_path = result == nullptr ? path : FromByteString(result);
+    free(result);
+    VLOG(4) << "Stat succeeded: " << path << " -> " << real_path;
+  }
+  directories_[directory_path].files.insert({name, real_path});
+  return real_path;
+}
+
+const PathCache::Directory& PathCache::GetDirectory(const wstring& path) {
+  if (directories_.size() >= kMaxDirectories &&
+      directories_.find(path) == directories_.end()) {
+    LOG(INFO) << "Path cache is full, clearing it.";
+    directories_.clear();
+  }
+
+  Directory& directory = directories_[path];
+  if (directory.generation == generation_) {
+    return directory;
+  }
+  directory.generation = generation_;
+
+  struct timespec mtime;
+  bool exists = Stat(path, &mtime);
+  if (directory.racy || exists != directory.exists ||
+      mtime.tv_sec != directory.mtime.tv_sec ||
+      mtime.tv_nsec != directory.mtime.tv_nsec) {
+    VLOG(5) << "Directory may have changed: " << path;
+    directory.exists = exists;
+    directory.mtime = mtime;
+    directory.files.clear();
+  }
+  directory.racy = exists && time(nullptr) - mtime.tv_sec < kRacySeconds;
+  return directory;
+}
+
+bool PathCache::Stat(const wstring& path, struct timespec* mtime) {
+  stat_calls_++;
+  struct stat info;
+  if (stat(ToByteString(path).c_str(), &info) == -1) {
+    *mtime = {0, 0};
+    return false;
+  }
+  *mtime = info.st_mtim;
+  return true;
+}
+
+}  // namespace editor
+}  // namespace afc
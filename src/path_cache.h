@@ -0,0 +1,62 @@
+#ifndef __AFC_EDITOR_PATH_CACHE_H__
+#define __AFC_EDITOR_PATH_CACHE_H__
+
+#include <ctime>
+#include <string>
+#include <unordered_map>
+
+namespace afc {
+namespace editor {
+
+using std::wstring;
+
+// Caches, for the files in each directory, whether they exist (and their real
+// path), both for files that exist and for files that don't.
+//
+// The entries of a directory are dropped when its modification time changes
+// (which happens whenever files are added to it or removed from it) or if it
+// changed too recently for its modification time to be trusted. Each
+// directory is checked at most once per generation: a batch of lookups that
+// runs in a single generation costs at most one stat per directory, plus one
+// per file not yet in the cache.
+//
+// Not thread-safe.
+class PathCache {
+ public:
+  // Returns the real path of path, or an empty string if it doesn't exist.
+  // Relative paths are resolved against the current working directory.
+  wstring Resolve(const wstring& path);
+
+  // Directories will be checked again before they are used.
+  void NewGeneration() { generation_++; }
+
+  // The number of calls to stat done so far.
+  size_t stat_calls() const { return stat_calls_; }
+
+ private:
+  struct Directory {
+    size_t generation = 0;
+    bool exists = false;
+    struct timespec mtime = {0, 0};
+    // Set if the directory was modified shortly before it was checked, so that
+    // it may have been modified again without a change to mtime.
+    bool racy = false;
+    // The real path of each file, or an empty string if it doesn't exist.
+    std::unordered_map<wstring, wstring> files;
+  };
+
+  // Returns the directory, checking it if it wasn't checked in the current
+  // generation.
+  const Directory& GetDirectory(const wstring& path);
+  bool Stat(const wstring& path, struct timespec* mtime);
+
+  // Starts at 1 so that new directories are always checked.
+  size_t generation_ = 1;
+  size_t stat_calls_ = 0;
+  std::unordered_map<wstring, Directory> directories_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_PATH_CACHE_H__
@@ -0,0 +1,214 @@
+#include "path_crawler.h"
+
+#include <algorithm>
+
+extern "C" {
+#include <fnmatch.h>
+}
+
+#include <glog/logging.h>
+
+#include "wstring.h"
+
+namespace afc {
+namespace editor {
+
+namespace {
+// Large enough to hold all the directories in large trees (otherwise each
+// crawl would read them all again).
+const size_t kMaxDirectories = 1 << 18;
+
+// Bounds the memory used by the index.
+const size_t kMaxPaths = 2000000;
+
+// Listing directories is mostly waiting for the file system, so this can be
+// larger than the number of processors.
+const size_t kMaxThreads = 8;
+
+bool IsIgnored(const std::vector<std::string>& patterns,
+               const std::string& path, const std::string& name) {
+  for (const auto& pattern : patterns) {
+    if (pattern.find('/') == std::string::npos
+            ? fnmatch(pattern.c_str(), name.c_str(), 0) == 0
+            : fnmatch(pattern.c_str(), path.c_str(), FNM_PATHNAME) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Lists the directories (relative to root) in parallel.
+std::vector<std::shared_ptr<const DirectoryCache::Listing>> List(
+    DirectoryCache* directory_cache, const wstring& root,
+    const std::vector<wstring>& directories) {
+  std::vector<std::shared_ptr<const DirectoryCache::Listing>> output(
+      directories.size());
+  size_t next = 0;
+  std::mutex next_mutex;
+  auto work = [&]() {
+    while (true) {
+      size_t position;
+      {
+        std::unique_lock<std::mutex> lock(next_mutex);
+        if (next == directories.size()) {
+          return;
+        }
+        position = next++;
+      }
+      const wstring& directory = directories[position];
+      output[position] =
+          directory_cache->Get(directory.empty() ? root
+                                                 : root + L"/" + directory);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < std::min(kMaxThreads, directories.size()); i++) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  return output;
+}
+}  // namespace
+
+PathCrawler::PathCrawler()
+    : directory_cache_(kMaxDirectories),
+      index_(std::make_shared<PathIndex>(std::vector<wstring>())) {}
+
+PathCrawler::~PathCrawler() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+    generation_++;
+  }
+  condition_.notify_all();
+  if (background_thread_.joinable()) {
+    background_thread_.join();
+  }
+}
+
+void PathCrawler::Crawl(wstring root, std::vector<wstring> ignore_patterns) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    request_ = std::make_unique<Request>();
+    request_->generation = ++generation_;
+    for (const auto& pattern : ignore_patterns) {
+      request_->ignore_patterns.push_back(ToByteString(pattern));
+    }
+    if (root != index_root_) {
+      LOG(INFO) << "Discarding index of: " << index_root_;
+      index_ = std::make_shared<PathIndex>(std::vector<wstring>());
+      index_root_ = L"";
+      index_ignore_patterns_.clear();
+    }
+    request_->root = std::move(root);
+    if (!background_thread_.joinable()) {
+      background_thread_ = std::thread([this]() { BackgroundThread(); });
+    }
+  }
+  condition_.notify_all();
+}
+
+std::shared_ptr<const PathIndex> PathCrawler::index() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return index_;
+}
+
+bool PathCrawler::crawling() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return request_ != nullptr || busy_;
+}
+
+void PathCrawler::WaitForIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_.wait(lock, [this]() { return request_ == nullptr && !busy_; });
+}
+
+void PathCrawler::BackgroundThread() {
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(
+        lock, [this]() { return shutting_down_ || request_ != nullptr; });
+    if (shutting_down_) {
+      return;
+    }
+    std::unique_ptr<Request> request = std::move(request_);
+    busy_ = true;
+    lock.unlock();
+
+    size_t directories_read = directory_cache_.directories_read();
+    auto paths = Run(*request);
+    std::shared_ptr<const PathIndex> index;
+    if (paths != nullptr) {
+      lock.lock();
+      bool unchanged =
+          directories_read == directory_cache_.directories_read() &&
+          index_root_ == request->root &&
+          index_ignore_patterns_ == request->ignore_patterns;
+      lock.unlock();
+      if (unchanged) {
+        VLOG(5) << "No directories changed, keeping index: " << request->root;
+      } else {
+        index = std::make_shared<PathIndex>(std::move(*paths));
+      }
+    }
+
+    lock.lock();
+    if (index != nullptr && request->generation == generation_) {
+      LOG(INFO) << "Crawled " << request->root << ": " << index->size()
+                << " paths.";
+      index_ = std::move(index);
+      index_root_ = request->root;
+      index_ignore_patterns_ = request->ignore_patterns;
+    }
+    busy_ = false;
+    lock.unlock();
+    condition_.notify_all();
+  }
+}
+
+std::unique_ptr<std::vector<wstring>> PathCrawler::Run(
+    const Request& request) {
+  auto paths = std::make_unique<std::vector<wstring>>();
+  // Relative to root; the empty string is root itself. The tree is crawled
+  // one level at a time, listing the directories of each level in parallel.
+  std::vector<wstring> directories = {L""};
+  while (!directories.empty()) {
+    if (IsCancelled(request.generation)) {
+      LOG(INFO) << "Crawl cancelled: " << request.root;
+      return nullptr;
+    }
+    auto listings = List(&directory_cache_, request.root, directories);
+    std::vector<wstring> subdirectories;
+    for (size_t i = 0; i < directories.size(); i++) {
+      wstring prefix = directories[i].empty() ? L"" : directories[i] + L"/";
+      for (const auto& entry : listings[i]->entries) {
+        wstring path = prefix + entry.name;
+        if (IsIgnored(request.ignore_patterns, ToByteString(path),
+                      ToByteString(entry.name))) {
+          VLOG(6) << "Ignoring: " << path;
+        } else if (entry.is_directory) {
+          subdirectories.push_back(std::move(path));
+        } else if (paths->size() < kMaxPaths) {
+          paths->push_back(std::move(path));
+        }
+      }
+    }
+    directories = std::move(subdirectories);
+  }
+  if (paths->size() == kMaxPaths) {
+    LOG(INFO) << "Too many files, index truncated: " << request.root;
+  }
+  return paths;
+}
+
+bool PathCrawler::IsCancelled(size_t generation) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return generation != generation_;
+}
+
+}  // namespace editor
+}  // namespace afc
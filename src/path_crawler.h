@@ -0,0 +1,79 @@
+#ifndef __AFC_EDITOR_PATH_CRAWLER_H__
+#define __AFC_EDITOR_PATH_CRAWLER_H__
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "directory_cache.h"
+#include "path_index.h"
+
+namespace afc {
+namespace editor {
+
+using std::wstring;
+
+// Builds a PathIndex with all the files in a tree, crawling it in a background
+// thread.
+//
+// The listings of the directories are kept in a DirectoryCache, so crawling
+// the same tree again (to pick up changes) only reads the directories that
+// have been modified since the last crawl; if none has, the index is kept.
+class PathCrawler {
+ public:
+  PathCrawler();
+  ~PathCrawler();
+
+  // Starts crawling root (in the background), replacing the outstanding crawl
+  // (if any). Files and directories are skipped if their name (or, for
+  // patterns containing a slash, their path relative to root) matches any of
+  // the shell wildcard patterns in ignore_patterns (see fnmatch).
+  void Crawl(wstring root, std::vector<wstring> ignore_patterns);
+
+  // Returns the index from the last crawl of root that has finished; while the
+  // first crawl of a root is running, returns an empty index. The paths are
+  // relative to root. Never returns null.
+  std::shared_ptr<const PathIndex> index() const;
+
+  // Returns true while a crawl is running.
+  bool crawling() const;
+
+  // Blocks until the background thread is done with all crawls.
+  void WaitForIdle();
+
+ private:
+  struct Request {
+    size_t generation;
+    wstring root;
+    std::vector<std::string> ignore_patterns;
+  };
+
+  void BackgroundThread();
+  // Returns null if the request is cancelled.
+  std::unique_ptr<std::vector<wstring>> Run(const Request& request);
+  bool IsCancelled(size_t generation);
+
+  DirectoryCache directory_cache_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread background_thread_;
+  bool shutting_down_ = false;
+  bool busy_ = false;
+
+  // Incremented by each crawl.
+  size_t generation_ = 0;
+  std::unique_ptr<Request> request_;
+
+  wstring index_root_;
+  std::vector<std::string> index_ignore_patterns_;
+  std::shared_ptr<const PathIndex> index_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_PATH_CRAWLER_H__
@@ -0,0 +1,267 @@
+#include "path_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include <glog/logging.h>
+
+#include "wstring.h"
+
+namespace afc {
+namespace editor {
+
+namespace {
+// Searching is split across threads only for indices large enough that the
+// cost of starting the threads is negligible.
+const size_t kMinPathsPerThread = 50000;
+const size_t kMaxThreads = 8;
+
+const int kMatchScore = 16;
+const int kConsecutiveBonus = 8;
+const int kComponentStartBonus = 10;
+const int kWordStartBonus = 8;
+const int kBasenameBonus = 4;
+const int kGapStartPenalty = 3;
+const int kGapPenalty = 1;
+
+// Only folds ASCII characters: the bytes of other (multibyte) characters must
+// match exactly.
+inline char Fold(char c) { return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c; }
+
+std::string FoldedBytes(const wstring& input) {
+  std::string output = ToByteString(input);
+  for (auto& c : output) {
+    c = Fold(c);
+  }
+  return output;
+}
+
+// Letters and digits get a bit each; the remaining characters share the rest.
+uint64_t CharacterBit(char c) {
+  unsigned char folded = Fold(c);
+  if (folded >= 'a' && folded <= 'z') {
+    return uint64_t(1) << (folded - 'a');
+  }
+  if (folded >= '0' && folded <= '9') {
+    return uint64_t(1) << (26 + folded - '0');
+  }
+  return uint64_t(1) << (36 + folded % 28);
+}
+
+uint64_t CharactersMask(const std::string& input) {
+  uint64_t output = 0;
+  for (char c : input) {
+    output |= CharacterBit(c);
+  }
+  return output;
+}
+
+int BoundaryBonus(const char* path, size_t position) {
+  if (position == 0 || path[position - 1] == '/') {
+    return kComponentStartBonus;
+  }
+  char previous = path[position - 1];
+  if (previous == '_' || previous == '-' || previous == '.' ||
+      previous == ' ' ||
+      (previous >= 'a' && previous <= 'z' && path[position] >= 'A' &&
+       path[position] <= 'Z')) {
+    return kWordStartBonus;
+  }
+  return 0;
+}
+
+// Scores the greedy match of query starting at position start (which must
+// contain a match).
+int ScoreFrom(const std::string& query, const char* path, const char* folded,
+              size_t length, size_t start, size_t basename) {
+  int score = 0;
+  size_t position = start;
+  for (size_t i = 0; i < query.size(); i++) {
+    size_t match = static_cast<const char*>(memchr(folded + position, query[i],
+                                                   length - position)) -
+                   folded;
+    score += kMatchScore + BoundaryBonus(path, match);
+    if (i > 0) {
+      score += match == position
+                   ? kConsecutiveBonus
+                   : -kGapStartPenalty - kGapPenalty * int(match - position);
+    }
+    if (match >= basename) {
+      score += kBasenameBonus;
+    }
+    position = match + 1;
+  }
+  return std::max(score, 0);
+}
+
+// query and folded must be folded (folded is the folded form of path).
+// Scores the shortest match of query that starts as late as possible (which
+// tends to fall in the basename). The searches for characters use memchr and
+// memrchr, which are vectorized.
+int ScorePath(const std::string& query, const char* path, const char* folded,
+              size_t length) {
+  size_t start = length;
+  for (size_t i = query.size(); i > 0; i--) {
+    auto match =
+        static_cast<const char*>(memrchr(folded, query[i - 1], start));
+    if (match == nullptr) {
+      return -1;
+    }
+    start = match - folded;
+  }
+  auto slash = static_cast<const char*>(memrchr(folded, '/', length));
+  size_t basename = slash == nullptr ? 0 : slash - folded + 1;
+  return ScoreFrom(query, path, folded, length, start, basename);
+}
+}  // namespace
+
+PathIndex::PathIndex(std::vector<wstring> paths) {
+  std::sort(paths.begin(), paths.end());
+  paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+  offsets_.reserve(paths.size() + 1);
+  masks_.reserve(paths.size());
+  offsets_.push_back(0);
+  for (const auto& path : paths) {
+    std::string bytes = ToByteString(path);
+    characters_ += bytes;
+    for (char c : bytes) {
+      folded_characters_.push_back(Fold(c));
+    }
+    CHECK_LE(characters_.size(), UINT32_MAX);
+    offsets_.push_back(characters_.size());
+    masks_.push_back(CharactersMask(bytes));
+  }
+  characters_.shrink_to_fit();
+  folded_characters_.shrink_to_fit();
+  VLOG(5) << "Path index: " << size() << " paths, " << characters_.size()
+          << " bytes.";
+}
+
+/* static */ int PathIndex::Score(const wstring& query, const wstring& path) {
+  std::string bytes = ToByteString(path);
+  std::string folded = FoldedBytes(path);
+  return ScorePath(FoldedBytes(query), bytes.c_str(), folded.c_str(),
+                   bytes.size());
+}
+
+wstring PathIndex::path(size_t id) const {
+  CHECK_LT(id, size());
+  return FromByteString(characters_.substr(
+      offsets_[id], offsets_[id + 1] - offsets_[id]));
+}
+
+std::vector<wstring> PathIndex::Find(const wstring& query,
+                                     size_t limit) const {
+  std::string folded_query = FoldedBytes(query);
+  uint64_t mask = CharactersMask(folded_query);
+  // Each character typed in the prompt extends the query, so usually only the
+  // paths that matched the previous query need to be scored.
+  std::shared_ptr<const std::vector<uint32_t>> candidates;
+  {
+    std::unique_lock<std::mutex> lock(last_query_mutex_);
+    if (!last_query_.empty() &&
+        folded_query.compare(0, last_query_.size(), last_query_) == 0) {
+      candidates = last_query_matches_;
+    }
+  }
+  size_t candidates_size =
+      candidates == nullptr ? size() : candidates->size();
+  size_t threads = std::min(
+      {kMaxThreads, size_t(std::max(1u, std::thread::hardware_concurrency())),
+       std::max(size_t(1), candidates_size / kMinPathsPerThread)});
+
+  std::vector<std::vector<Match>> results(threads);
+  std::vector<std::vector<uint32_t>> matching_ids(threads);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < threads; i++) {
+    auto work = [&, i]() {
+      results[i] = FindInRange(folded_query, mask, candidates.get(),
+                               candidates_size * i / threads,
+                               candidates_size * (i + 1) / threads, limit,
+                               &matching_ids[i]);
+    };
+    if (i + 1 == threads) {
+      work();
+    } else {
+      workers.emplace_back(work);
+    }
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  auto all_matching_ids = std::make_shared<std::vector<uint32_t>>();
+  std::vector<Match> matches;
+  for (size_t i = 0; i < threads; i++) {
+    matches.insert(matches.end(), results[i].begin(), results[i].end());
+    all_matching_ids->insert(all_matching_ids->end(), matching_ids[i].begin(),
+                             matching_ids[i].end());
+  }
+  VLOG(5) << "Path index matches for \"" << query
+          << "\": " << all_matching_ids->size() << " (of " << candidates_size
+          << " candidates)";
+  {
+    std::unique_lock<std::mutex> lock(last_query_mutex_);
+    last_query_ = folded_query;
+    last_query_matches_ = std::move(all_matching_ids);
+  }
+
+  auto end = matches.begin() + std::min(limit, matches.size());
+  std::partial_sort(
+      matches.begin(), end, matches.end(),
+      [this](const Match& a, const Match& b) { return Better(a, b); });
+  std::vector<wstring> output;
+  for (auto it = matches.begin(); it != end; ++it) {
+    output.push_back(path(it->id));
+  }
+  return output;
+}
+
+std::vector<PathIndex::Match> PathIndex::FindInRange(
+    const std::string& query, uint64_t mask,
+    const std::vector<uint32_t>* candidates, size_t begin, size_t end,
+    size_t limit, std::vector<uint32_t>* matching_ids) const {
+  // A heap with the best matches found so far; the worst is at the front.
+  std::vector<Match> output;
+  auto better = [this](const Match& a, const Match& b) { return Better(a, b); };
+  for (size_t i = begin; i < end; i++) {
+    uint32_t id = candidates == nullptr ? i : (*candidates)[i];
+    if ((mask & ~masks_[id]) != 0) {
+      continue;
+    }
+    Match match;
+    match.id = id;
+    match.score = ScorePath(query, characters_.data() + offsets_[id],
+                            folded_characters_.data() + offsets_[id],
+                            offsets_[id + 1] - offsets_[id]);
+    if (match.score < 0) {
+      continue;
+    }
+    matching_ids->push_back(id);
+    if (output.size() < limit) {
+      output.push_back(match);
+      std::push_heap(output.begin(), output.end(), better);
+    } else if (limit > 0 && Better(match, output.front())) {
+      std::pop_heap(output.begin(), output.end(), better);
+      output.back() = match;
+      std::push_heap(output.begin(), output.end(), better);
+    }
+  }
+  return output;
+}
+
+bool PathIndex::Better(const Match& a, const Match& b) const {
+  if (a.score != b.score) {
+    return a.score > b.score;
+  }
+  size_t length_a = offsets_[a.id + 1] - offsets_[a.id];
+  size_t length_b = offsets_[b.id + 1] - offsets_[b.id];
+  if (length_a != length_b) {
+    return length_a < length_b;
+  }
+  return a.id < b.id;
+}
+
+}  // namespace editor
+}  // namespace afc
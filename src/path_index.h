@@ -0,0 +1,75 @@
+#ifndef __AFC_EDITOR_PATH_INDEX_H__
+#define __AFC_EDITOR_PATH_INDEX_H__
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace afc {
+namespace editor {
+
+using std::wstring;
+
+// An immutable index of paths (typically, all the files in a tree) supporting
+// fuzzy searches: a query matches the paths that contain all its characters,
+// in order (ignoring case), not necessarily consecutive.
+//
+// The paths are stored contiguously (UTF-8 encoded), along with a bitmask of
+// the characters in each path, so that most paths that don't match a query
+// are rejected without looking at them. The paths that matched the last query
+// are remembered: if the next query extends it, only they are scored.
+class PathIndex {
+ public:
+  explicit PathIndex(std::vector<wstring> paths);
+
+  // Returns the score of path for query, or -1 if path doesn't match query.
+  // Matches at the start of path components (or words), consecutive matches
+  // and matches in the last component of path score higher; characters
+  // skipped between matches lower the score.
+  static int Score(const wstring& query, const wstring& path);
+
+  size_t size() const { return offsets_.size() - 1; }
+  wstring path(size_t id) const;
+
+  // Returns (at most) limit paths that match query, best first (breaking ties
+  // by preferring shorter paths).
+  std::vector<wstring> Find(const wstring& query, size_t limit) const;
+
+ private:
+  struct Match {
+    int score;
+    uint32_t id;
+  };
+
+  // Scores the paths with ids in [begin, end) (or, if candidates isn't null,
+  // with ids in the positions [begin, end) of candidates), returning the best
+  // limit matches (in no particular order). Appends the ids of all matches to
+  // matching_ids.
+  std::vector<Match> FindInRange(const std::string& query, uint64_t mask,
+                                 const std::vector<uint32_t>* candidates,
+                                 size_t begin, size_t end, size_t limit,
+                                 std::vector<uint32_t>* matching_ids) const;
+  bool Better(const Match& a, const Match& b) const;
+
+  // The concatenation of all paths, in alphabetical order.
+  std::string characters_;
+  // characters_ with all (ASCII) characters in lower case.
+  std::string folded_characters_;
+  // Path i starts at characters_[offsets_[i]] and ends at offsets_[i + 1].
+  std::vector<uint32_t> offsets_;
+  // For each path, the set of characters in it (see CharactersMask).
+  std::vector<uint64_t> masks_;
+
+  mutable std::mutex last_query_mutex_;
+  // Folded. Empty if there was no last query.
+  mutable std::string last_query_;
+  // The ids of the paths that matched last_query_, in ascending order.
+  mutable std::shared_ptr<const std::vector<uint32_t>> last_query_matches_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_PATH_INDEX_H__
@@ -8,7 +8,6 @@
 #include <string>
 
 extern "C" {
-#include <dirent.h>
 #include <libgen.h>
 #include <sys/types.h>
 }
@@ -19,6 +18,7 @@ extern "C" {
 #include "dirname.h"
 #include "editor.h"
 #include "file_link_mode.h"
+#include "file_predictor_worker.h"
 #include "lowercase.h"
 #include "predictor.h"
 #include "wstring.h"
@@ -41,11 +41,13 @@ using std::wstring;
 class PredictionsBufferImpl : public OpenBuffer {
  public:
   PredictionsBufferImpl(EditorState* editor_state, Predictor predictor,
-                        const wstring& input, function<void(wstring)> consumer)
+                        const wstring& input, function<void(wstring)> consumer,
+                        bool ranked)
       : OpenBuffer(editor_state, PredictionsBufferName()),
         predictor_(predictor),
         input_(input),
-        consumer_(consumer) {
+        consumer_(consumer),
+        ranked_(ranked) {
     set_bool_variable(buffer_variables::show_in_buffers_list(), false);
     set_bool_variable(buffer_variables::allow_dirty_delete(), true);
   }
@@ -62,19 +64,40 @@ class PredictionsBufferImpl : public OpenBuffer {
     if (contents()->empty()) {
       return;
     }
-    SortContents(
-        0, contents()->size() - 1,
-        [](const shared_ptr<const Line>& a, const shared_ptr<const Line>& b) {
-          return *LowerCase(a->contents()) < *LowerCase(b->contents());
-        });
-    for (size_t line = 0; line < contents()->size();) {
-      if (line == 0 ||
-          LineAt(line - 1)->ToString() != LineAt(line)->ToString()) {
-        line++;
+    if (ranked_) {
+      // The last line is always empty.
+      if (contents()->size() == 2) {
+        consumer_(contents()->front()->ToString());
       } else {
-        EraseLines(line, line + 1);
+        ShowPredictions(editor_state);
+      }
+      return;
+    }
+    // The keys are computed once per line (rather than once per comparison);
+    // exact duplicates become adjacent (and are all removed in one pass).
+    std::vector<std::pair<wstring, shared_ptr<const Line>>> predictions;
+    predictions.reserve(contents()->size());
+    for (size_t i = 0; i < contents()->size(); i++) {
+      auto line = contents()->at(i);
+      predictions.push_back({LowerCase(line->contents())->ToString(), line});
+    }
+    auto compare = [](const std::pair<wstring, shared_ptr<const Line>>& a,
+                      const std::pair<wstring, shared_ptr<const Line>>& b) {
+      return a.first != b.first ? a.first < b.first
+                                : a.second->ToString() < b.second->ToString();
+    };
+    // Some predictors (such as FilePredictor) already produce sorted output.
+    if (!std::is_sorted(predictions.begin(), predictions.end() - 1, compare)) {
+      std::sort(predictions.begin(), predictions.end() - 1, compare);
+    }
+    vector<shared_ptr<const Line>> lines;
+    for (auto& prediction : predictions) {
+      if (lines.empty() ||
+          lines.back()->ToString() != prediction.second->ToString()) {
+        lines.push_back(std::move(prediction.second));
       }
     }
+    ReplaceLines(0, contents()->size(), lines);
 
     wstring common_prefix = contents_.front()->contents()->ToString();
     bool results =
@@ -104,33 +127,38 @@ class PredictionsBufferImpl : public OpenBuffer {
     if (results) {
       consumer_(common_prefix);
     } else {
-      auto it = editor_state->buffers()->find(PredictionsBufferName());
-      if (it == editor_state->buffers()->end()) {
-        editor_state->SetWarningStatus(L"Error: predictions buffer not found.");
-      } else {
-        CHECK_EQ(this, it->second.get());
-        it->second->set_current_position_line(0);
-        editor_state->set_current_buffer(it);
-        editor_state->ScheduleRedraw();
-      }
+      ShowPredictions(editor_state);
     }
   }
 
  private:
+  void ShowPredictions(EditorState* editor_state) {
+    auto it = editor_state->buffers()->find(PredictionsBufferName());
+    if (it == editor_state->buffers()->end()) {
+      editor_state->SetWarningStatus(L"Error: predictions buffer not found.");
+    } else {
+      CHECK_EQ(this, it->second.get());
+      it->second->set_current_position_line(0);
+      editor_state->set_current_buffer(it);
+      editor_state->ScheduleRedraw();
+    }
+  }
+
   Predictor predictor_;
   const wstring input_;
   std::function<void(wstring)> consumer_;
+  const bool ranked_;
 };
 
 }  // namespace
 
 void Predict(EditorState* editor_state, Predictor predictor, wstring input,
-             function<void(const wstring&)> consumer) {
+             function<void(const wstring&)> consumer, bool ranked) {
   auto& predictions_buffer =
       (*editor_state->buffers())[PredictionsBufferName()];
   predictions_buffer = std::make_shared<PredictionsBufferImpl>(
       editor_state, std::move(predictor), std::move(input),
-      std::move(consumer));
+      std::move(consumer), ranked);
   predictions_buffer->Reload(editor_state);
   predictions_buffer->set_current_cursor(LineColumn());
 }
@@ -143,6 +171,7 @@ void FilePredictor(EditorState* editor_state, const wstring& input,
   vector<wstring> search_paths;
   GetSearchPaths(editor_state, &search_paths);
 
+  vector<FilePredictorWorker::Query> queries;
   for (const auto& search_path : search_paths) {
     VLOG(4) << "Considering search path: " << search_path;
     if (!search_path.empty() && !path.empty() && path.front() == '/') {
@@ -150,66 +179,84 @@ void FilePredictor(EditorState* editor_state, const wstring& input,
       continue;
     }
 
-    wstring path_with_prefix = search_path;
+    FilePredictorWorker::Query query;
+    query.search_path = search_path;
+    query.directory = search_path;
     if (search_path.empty()) {
-      path_with_prefix = path.empty() ? L"." : path;
+      query.directory = path.empty() ? L"." : path;
     } else if (!path.empty()) {
-      path_with_prefix += L"/" + path;
+      query.directory += L"/" + path;
     }
 
-    string basename_prefix;
-    if (path_with_prefix.back() != '/') {
-      path_with_prefix = Dirname(path_with_prefix);
+    if (query.directory.back() != '/') {
+      query.directory = Dirname(query.directory);
 
       char* path_copy = strdup(ToByteString(path).c_str());
-      basename_prefix = basename(path_copy);
+      query.prefix = FromByteString(basename(path_copy));
       free(path_copy);
     }
 
-    LOG(INFO) << "Reading directory: " << path_with_prefix;
-    std::unique_ptr<DIR, decltype(&closedir)> dir(
-        opendir(ToByteString(path_with_prefix).c_str()), &closedir);
-    if (dir == nullptr) {
-      LOG(INFO) << "Unable to open, giving up current search path.";
-      continue;
-    }
-
-    if (path_with_prefix == L".") {
-      path_with_prefix = L"";
-    } else if (path_with_prefix.back() != L'/') {
-      path_with_prefix += L"/";
+    if (query.directory == L".") {
+      query.output_prefix = L"";
+    } else if (query.directory.back() != L'/') {
+      query.output_prefix = query.directory + L"/";
+    } else {
+      query.output_prefix = query.directory;
     }
+    queries.push_back(std::move(query));
+  }
 
-    struct dirent* entry;
-    while ((entry = readdir(dir.get())) != nullptr) {
-      string entry_path = entry->d_name;
-      if (!std::equal(basename_prefix.begin(), basename_prefix.end(),
-                      entry_path.begin()) ||
-          entry_path == "." || entry_path == "..") {
-        VLOG(6) << "Skipping entry: " << entry_path;
-        continue;
-      }
-      string prediction = ToByteString(path_with_prefix) + entry->d_name +
-                          (entry->d_type == DT_DIR ? "/" : "");
-      if (!search_path.empty() &&
-          std::equal(search_path.begin(), search_path.end(),
-                     FromByteString(prediction).begin())) {
-        VLOG(6) << "Removing prefix from prediction: " << prediction;
-        size_t start = prediction.find_first_not_of('/', search_path.size());
-        if (start != prediction.npos) {
-          prediction = prediction.substr(start);
+  // The directories are listed in the background; the predictions buffer is
+  // only filled if it's still the current one by then.
+  editor_state->file_predictor()->Predict(
+      std::move(queries),
+      [editor_state, buffer](vector<wstring> predictions) {
+        auto it = editor_state->buffers()->find(PredictionsBufferName());
+        if (it == editor_state->buffers()->end() ||
+            it->second.get() != buffer) {
+          LOG(INFO) << "Predictions buffer is gone, ignoring predictions.";
+          return;
         }
-      }
-      VLOG(5) << "Prediction: " << prediction;
-      buffer->AppendToLastLine(editor_state,
-                               NewCopyString(FromByteString(prediction)));
-      buffer->AppendRawLine(editor_state,
-                            std::make_shared<Line>(Line::Options()));
-    }
+        for (const auto& prediction : predictions) {
+          VLOG(5) << "Prediction: " << prediction;
+          buffer->AppendToLastLine(editor_state, NewCopyString(prediction));
+          buffer->AppendRawLine(editor_state,
+                                std::make_shared<Line>(Line::Options()));
+        }
+        buffer->EndOfFile(editor_state);
+      });
+}
+
+void BufferWordsPredictor(EditorState* editor_state, const wstring& input,
+                          OpenBuffer* buffer) {
+  const size_t kMaxPredictions = 100;
+  for (const auto& word :
+       editor_state->buffer_words_index()->Find(input, kMaxPredictions)) {
+    VLOG(5) << "Prediction: " << word;
+    buffer->AppendToLastLine(editor_state, NewCopyString(word));
+    buffer->AppendRawLine(editor_state,
+                          std::make_shared<Line>(Line::Options()));
   }
   buffer->EndOfFile(editor_state);
 }
 
+void FuzzyFilePredictor(EditorState* editor_state, const wstring& input,
+                        OpenBuffer* buffer) {
+  const size_t kMaxPredictions = 100;
+  auto index = editor_state->path_crawler()->index();
+  for (const auto& path : index->Find(input, kMaxPredictions)) {
+    VLOG(5) << "Prediction: " << path;
+    buffer->AppendToLastLine(editor_state, NewCopyString(path));
+    buffer->AppendRawLine(editor_state,
+                          std::make_shared<Line>(Line::Options()));
+  }
+  buffer->EndOfFile(editor_state);
+}
+
+void CancelPredictions(EditorState* editor_state) {
+  editor_state->file_predictor()->Cancel();
+}
+
 void EmptyPredictor(EditorState* editor_state, const wstring&,
                     OpenBuffer* buffer) {
   buffer->EndOfFile(editor_state);
@@ -33,12 +33,32 @@ const wstring& PredictionsBufferName();
 // Create a new buffer running a given predictor on a given input. When that's
 // done, runs consumer on the results (on the longest unambiguous completion for
 // input).
+//
+// If ranked is true, the predictions are matches for input (rather than
+// completions), best first: they are kept in their order and consumer only
+// runs if there's exactly one.
 void Predict(EditorState* editor_state, Predictor predictor, wstring input,
-             function<void(const wstring&)> consumer);
+             function<void(const wstring&)> consumer, bool ranked = false);
 
+// Lists the directories asynchronously (see FilePredictorWorker).
 void FilePredictor(EditorState* editor_state, const wstring& input,
                    OpenBuffer* buffer);
 
+// Predicts words from all buffers (see BufferWordsIndex), writing the most
+// frequent ones that start with input.
+void BufferWordsPredictor(EditorState* editor_state, const wstring& input,
+                          OpenBuffer* buffer);
+
+// Writes the best matches for input among the files in the tree of the current
+// directory (see PathCrawler), best first. Must be used with ranked
+// predictions.
+void FuzzyFilePredictor(EditorState* editor_state, const wstring& input,
+                        OpenBuffer* buffer);
+
+// Aborts the predictions still being generated in the background (if any);
+// they won't reach the predictions buffer.
+void CancelPredictions(EditorState* editor_state);
+
 void EmptyPredictor(EditorState* editor_state, const wstring& input,
                     OpenBuffer* buffer);
 
@@ -0,0 +1,81 @@
+#include "redraw_scheduler.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace afc {
+namespace editor {
+
+void RedrawScheduler::RedrawRequested() {
+  if (redraw_pending_) {
+    stats_.frames_dropped++;
+  }
+  redraw_pending_ = true;
+}
+
+void RedrawScheduler::InputReceived(Clock::time_point now) {
+  redraw_pending_ = true;
+  if (!input_pending_) {
+    input_pending_ = true;
+    first_pending_input_ = now;
+  }
+}
+
+bool RedrawScheduler::FrameDue(Clock::time_point now) const {
+  return redraw_pending_ && now >= NextFrameTime();
+}
+
+void RedrawScheduler::FrameDrawn(Clock::time_point now) {
+  stats_.frames_drawn++;
+  if (input_pending_) {
+    auto latency = now - first_pending_input_;
+    stats_.input_frames++;
+    stats_.input_latency_total += latency;
+    stats_.input_latency_max = std::max(stats_.input_latency_max, latency);
+    VLOG(5) << "Input latency (ms): "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(latency)
+                   .count();
+  }
+  redraw_pending_ = false;
+  input_pending_ = false;
+  last_frame_ = now;
+}
+
+int RedrawScheduler::PollTimeoutMs(Clock::time_point now,
+                                   int idle_timeout_ms) const {
+  if (!redraw_pending_) {
+    return idle_timeout_ms;
+  }
+  auto next_frame = NextFrameTime();
+  if (now >= next_frame) {
+    return 0;
+  }
+  // Round up, to avoid waking up just before the frame is due.
+  auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  next_frame - now + std::chrono::milliseconds(1) -
+                  Clock::duration(1))
+                  .count();
+  if (idle_timeout_ms < 0) {
+    return static_cast<int>(wait);
+  }
+  return std::min(static_cast<int>(wait), idle_timeout_ms);
+}
+
+RedrawScheduler::Clock::time_point RedrawScheduler::NextFrameTime() const {
+  if (stats_.frames_drawn == 0) {
+    return Clock::time_point::min();
+  }
+  Clock::time_point output = last_frame_;
+  if (options_.max_fps > 0) {
+    output += std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / options_.max_fps));
+  }
+  if (input_pending_) {
+    output = std::min(output, first_pending_input_ + options_.input_latency);
+  }
+  return output;
+}
+
+}  // namespace editor
+}  // namespace afc
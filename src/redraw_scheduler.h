@@ -0,0 +1,76 @@
+#ifndef __AFC_EDITOR_REDRAW_SCHEDULER_H__
+#define __AFC_EDITOR_REDRAW_SCHEDULER_H__
+
+#include <chrono>
+
+namespace afc {
+namespace editor {
+
+// Decides when the main loop should draw a new frame. Redraws caused by output
+// (e.g., a subprocess writing data continuously) are coalesced so that we
+// never draw more than max_fps frames per second. Redraws caused by input
+// (keystrokes) have priority: they always get a frame at most input_latency
+// after the first keystroke that hasn't been shown.
+class RedrawScheduler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    double max_fps = 60;
+    Clock::duration input_latency = std::chrono::milliseconds(0);
+  };
+
+  struct Stats {
+    size_t frames_drawn = 0;
+    // Number of redraw requests that didn't get their own frame (because they
+    // were coalesced with other requests).
+    size_t frames_dropped = 0;
+    // Number of frames drawn to show pending input.
+    size_t input_frames = 0;
+    // Time between the first keystroke pending to be shown and the frame that
+    // shows it.
+    Clock::duration input_latency_total = Clock::duration::zero();
+    Clock::duration input_latency_max = Clock::duration::zero();
+  };
+
+  RedrawScheduler() = default;
+  explicit RedrawScheduler(Options options) : options_(options) {}
+
+  const Options& options() const { return options_; }
+  void set_options(Options options) { options_ = options; }
+  const Stats& stats() const { return stats_; }
+  bool redraw_pending() const { return redraw_pending_; }
+
+  // Signals that something (other than input) changed that requires a frame.
+  // If a frame was already pending, counts as a dropped frame.
+  void RedrawRequested();
+  // Signals that input was received (which requires a frame).
+  void InputReceived(Clock::time_point now);
+
+  // Returns true if a frame should be drawn now.
+  bool FrameDue(Clock::time_point now) const;
+  // Must be called after drawing each frame.
+  void FrameDrawn(Clock::time_point now);
+
+  // Returns the number of milliseconds until the next frame is due, or
+  // idle_timeout_ms if no frame is pending (or if it's due after that). A
+  // negative idle_timeout_ms means no timeout (as in poll).
+  int PollTimeoutMs(Clock::time_point now, int idle_timeout_ms) const;
+
+ private:
+  Clock::time_point NextFrameTime() const;
+
+  Options options_;
+  Stats stats_;
+
+  // Start as pending, so that the first frame is drawn immediately.
+  bool redraw_pending_ = true;
+  bool input_pending_ = false;
+  Clock::time_point first_pending_input_;
+  Clock::time_point last_frame_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_REDRAW_SCHEDULER_H__
@@ -0,0 +1,287 @@
+#include "screen_binary.h"
+
+#include <glog/logging.h>
+
+namespace afc {
+namespace editor {
+namespace {
+// Largest value in the LineModifier enum.
+constexpr LineModifier kLastModifier = LineModifier::BG_RED;
+
+// Number of bytes used to encode the length of each frame.
+constexpr size_t kFrameHeaderLength = 4;
+
+// Refuse frames longer than this; it probably means that the stream is
+// corrupt.
+constexpr size_t kMaxFrameLength = 64 * 1024 * 1024;
+
+void AppendVarint(uint64_t value, std::string* output) {
+  while (value >= 0x80) {
+    output->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  output->push_back(static_cast<char>(value));
+}
+
+// Reads values from a frame, keeping track of the current position.
+class FrameReader {
+ public:
+  FrameReader(const std::string& frame) : frame_(frame) {}
+
+  bool done() const { return position_ >= frame_.size(); }
+
+  bool ReadByte(char* output) {
+    if (done()) {
+      return false;
+    }
+    *output = frame_[position_++];
+    return true;
+  }
+
+  bool ReadVarint(uint64_t* output) {
+    *output = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      char c;
+      if (!ReadByte(&c)) {
+        return false;
+      }
+      *output |= static_cast<uint64_t>(c & 0x7f) << shift;
+      if ((c & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  const std::string& frame_;
+  size_t position_ = 0;
+};
+}  // namespace
+
+void ScreenBinaryEncoder::HardRefresh() {
+  StartOperation(ScreenBinaryOperation::HARD_REFRESH);
+}
+
+void ScreenBinaryEncoder::Refresh() {
+  StartOperation(ScreenBinaryOperation::REFRESH);
+}
+
+void ScreenBinaryEncoder::Clear() {
+  StartOperation(ScreenBinaryOperation::CLEAR);
+}
+
+void ScreenBinaryEncoder::SetCursorVisibility(
+    Screen::CursorVisibility cursor_visibility) {
+  StartOperation(ScreenBinaryOperation::CURSOR_VISIBILITY);
+  AppendVarint(cursor_visibility, &operations_);
+}
+
+void ScreenBinaryEncoder::Move(size_t y, size_t x) {
+  StartOperation(ScreenBinaryOperation::MOVE);
+  AppendVarint(y, &operations_);
+  AppendVarint(x, &operations_);
+}
+
+void ScreenBinaryEncoder::WriteString(const wstring& str) {
+  if (str.empty()) {
+    return;
+  }
+  if (run_modifiers_ != modifiers_) {
+    CloseRun();
+  }
+  run_modifiers_ = modifiers_;
+  for (wchar_t c : str) {
+    AppendVarint(static_cast<uint32_t>(c), &run_);
+  }
+  run_length_ += str.size();
+}
+
+void ScreenBinaryEncoder::SetModifier(LineModifier modifier) {
+  if (modifier == LineModifier::RESET) {
+    modifiers_ = 0;
+  } else {
+    modifiers_ |= ModifiersMask(1) << modifier;
+  }
+}
+
+void ScreenBinaryEncoder::Flush() {
+  StartOperation(ScreenBinaryOperation::FLUSH);
+}
+
+void ScreenBinaryEncoder::Terminate() {
+  StartOperation(ScreenBinaryOperation::TERMINATE);
+}
+
+std::string ScreenBinaryEncoder::TakeFrame() {
+  FlushText();
+  std::string output;
+  output.reserve(kFrameHeaderLength + operations_.size());
+  uint32_t length = operations_.size();
+  for (size_t i = 0; i < kFrameHeaderLength; i++) {
+    output.push_back(static_cast<char>((length >> (8 * i)) & 0xff));
+  }
+  output += operations_;
+  operations_.clear();
+  return output;
+}
+
+void ScreenBinaryEncoder::StartOperation(ScreenBinaryOperation operation) {
+  FlushText();
+  operations_.push_back(static_cast<char>(operation));
+}
+
+void ScreenBinaryEncoder::CloseRun() {
+  if (run_length_ == 0) {
+    return;
+  }
+  AppendVarint(run_modifiers_, &text_);
+  AppendVarint(run_length_, &text_);
+  text_ += run_;
+  text_runs_++;
+  run_.clear();
+  run_length_ = 0;
+}
+
+void ScreenBinaryEncoder::FlushText() {
+  CloseRun();
+  if (text_runs_ == 0) {
+    return;
+  }
+  operations_.push_back(static_cast<char>(ScreenBinaryOperation::TEXT));
+  AppendVarint(text_runs_, &operations_);
+  operations_ += text_;
+  text_.clear();
+  text_runs_ = 0;
+}
+
+void ScreenBinaryDecoder::Consume(const char* input, size_t length,
+                                  Screen* screen) {
+  pending_.append(input, length);
+  size_t position = 0;
+  while (pending_.size() - position >= kFrameHeaderLength) {
+    size_t frame_length = 0;
+    for (size_t i = 0; i < kFrameHeaderLength; i++) {
+      frame_length |= static_cast<size_t>(
+                          static_cast<unsigned char>(pending_[position + i]))
+                      << (8 * i);
+    }
+    if (frame_length > kMaxFrameLength) {
+      LOG(WARNING) << "Invalid frame length, dropping input: " << frame_length;
+      pending_.clear();
+      return;
+    }
+    if (pending_.size() - position - kFrameHeaderLength < frame_length) {
+      break;  // Incomplete frame.
+    }
+    std::string frame =
+        pending_.substr(position + kFrameHeaderLength, frame_length);
+    position += kFrameHeaderLength + frame_length;
+    if (!ApplyFrame(frame, screen)) {
+      LOG(WARNING) << "Invalid frame received, ignoring rest of it.";
+    }
+  }
+  pending_.erase(0, position);
+}
+
+bool ScreenBinaryDecoder::ApplyFrame(const std::string& frame,
+                                     Screen* screen) {
+  VLOG(5) << "Applying frame: " << frame.size() << " bytes.";
+  FrameReader reader(frame);
+  while (!reader.done()) {
+    char operation;
+    if (!reader.ReadByte(&operation)) {
+      return false;
+    }
+    switch (static_cast<ScreenBinaryOperation>(operation)) {
+      case ScreenBinaryOperation::MOVE: {
+        uint64_t y, x;
+        if (!reader.ReadVarint(&y) || !reader.ReadVarint(&x)) {
+          return false;
+        }
+        screen->Move(y, x);
+        break;
+      }
+
+      case ScreenBinaryOperation::TEXT: {
+        uint64_t runs;
+        if (!reader.ReadVarint(&runs)) {
+          return false;
+        }
+        for (uint64_t run = 0; run < runs; run++) {
+          uint64_t modifiers, length;
+          if (!reader.ReadVarint(&modifiers) || !reader.ReadVarint(&length) ||
+              length > frame.size()) {
+            return false;
+          }
+          wstring text;
+          text.reserve(length);
+          for (uint64_t i = 0; i < length; i++) {
+            uint64_t c;
+            if (!reader.ReadVarint(&c)) {
+              return false;
+            }
+            text.push_back(static_cast<wchar_t>(c));
+          }
+          ApplyModifiers(modifiers, screen);
+          screen->WriteString(text);
+        }
+        break;
+      }
+
+      case ScreenBinaryOperation::CLEAR:
+        screen->Clear();
+        break;
+
+      case ScreenBinaryOperation::REFRESH:
+        screen->Refresh();
+        break;
+
+      case ScreenBinaryOperation::HARD_REFRESH:
+        screen->HardRefresh();
+        break;
+
+      case ScreenBinaryOperation::CURSOR_VISIBILITY: {
+        uint64_t cursor_visibility;
+        if (!reader.ReadVarint(&cursor_visibility)) {
+          return false;
+        }
+        screen->SetCursorVisibility(
+            cursor_visibility == Screen::INVISIBLE ? Screen::INVISIBLE
+                                                   : Screen::NORMAL);
+        break;
+      }
+
+      case ScreenBinaryOperation::FLUSH:
+        screen->Flush();
+        break;
+
+      case ScreenBinaryOperation::TERMINATE:
+        terminate_requested_ = true;
+        break;
+
+      default:
+        LOG(WARNING) << "Invalid operation: " << static_cast<int>(operation);
+        return false;
+    }
+  }
+  return true;
+}
+
+void ScreenBinaryDecoder::ApplyModifiers(ModifiersMask modifiers,
+                                         Screen* screen) {
+  if ((modifiers_ & ~modifiers) != 0) {
+    screen->SetModifier(LineModifier::RESET);
+    modifiers_ = 0;
+  }
+  for (int i = 1; i <= kLastModifier; i++) {
+    ModifiersMask bit = ModifiersMask(1) << i;
+    if ((modifiers & bit) && !(modifiers_ & bit)) {
+      screen->SetModifier(static_cast<LineModifier>(i));
+    }
+  }
+  modifiers_ = modifiers;
+}
+
+}  // namespace editor
+}  // namespace afc
@@ -0,0 +1,96 @@
+#ifndef __AFC_EDITOR_SCREEN_BINARY_H__
+#define __AFC_EDITOR_SCREEN_BINARY_H__
+
+#include <cstdint>
+#include <string>
+
+#include "screen.h"
+
+namespace afc {
+namespace editor {
+
+// Binary protocol used to send screen updates to remote clients. This is much
+// cheaper to produce and consume than the VM protocol (which sends VM code
+// that the client must compile and evaluate).
+//
+// The stream is a sequence of frames. Each frame starts with its length (4
+// bytes, little endian) followed by a sequence of operations. Each operation
+// starts with a single byte (see ScreenBinaryOperation) followed by its
+// arguments, encoded as varints. Consecutive calls to WriteString (and the
+// SetModifier calls between them) are merged into a single TEXT operation: a
+// list of runs, each with the modifiers mask and the code points that use it.
+enum class ScreenBinaryOperation : char {
+  MOVE = 'M',
+  TEXT = 'T',
+  CLEAR = 'C',
+  REFRESH = 'R',
+  HARD_REFRESH = 'H',
+  CURSOR_VISIBILITY = 'V',
+  FLUSH = 'F',
+  TERMINATE = 'X',
+};
+
+// Accumulates screen operations and serializes them into frames.
+class ScreenBinaryEncoder {
+ public:
+  void HardRefresh();
+  void Refresh();
+  void Clear();
+  void SetCursorVisibility(Screen::CursorVisibility cursor_visibility);
+  void Move(size_t y, size_t x);
+  void WriteString(const wstring& str);
+  void SetModifier(LineModifier modifier);
+  void Flush();
+  void Terminate();
+
+  // Returns the frame with all the operations received since the last call
+  // and starts a new frame.
+  std::string TakeFrame();
+
+ private:
+  // Bit i is set if LineModifier i is active.
+  using ModifiersMask = uint32_t;
+
+  void StartOperation(ScreenBinaryOperation operation);
+  void CloseRun();
+  void FlushText();
+
+  std::string operations_;
+
+  // Runs of the TEXT operation being produced.
+  std::string text_;
+  size_t text_runs_ = 0;
+  // Code points for the last run in text_.
+  std::string run_;
+  size_t run_length_ = 0;
+
+  ModifiersMask modifiers_ = 0;
+  ModifiersMask run_modifiers_ = 0;
+};
+
+// Receives the bytes of a stream of frames (produced by ScreenBinaryEncoder)
+// and applies them to a screen.
+class ScreenBinaryDecoder {
+ public:
+  // Consumes input, applying every complete frame to screen. Incomplete frames
+  // are retained until the rest of their bytes are received.
+  void Consume(const char* input, size_t length, Screen* screen);
+
+  // Returns true if a TERMINATE operation has been received.
+  bool terminate_requested() const { return terminate_requested_; }
+
+ private:
+  using ModifiersMask = uint32_t;
+
+  bool ApplyFrame(const std::string& frame, Screen* screen);
+  void ApplyModifiers(ModifiersMask modifiers, Screen* screen);
+
+  std::string pending_;
+  ModifiersMask modifiers_ = 0;
+  bool terminate_requested_ = false;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_SCREEN_BINARY_H__
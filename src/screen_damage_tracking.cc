@@ -0,0 +1,242 @@
+#include "screen_damage_tracking.h"
+
+#include <algorithm>
+#include <cwchar>
+
+#include <glog/logging.h>
+
+namespace afc {
+namespace editor {
+namespace {
+// If two spans of modified cells in the same line are separated by at most
+// this number of unmodified cells, we merge them: re-emitting a few cells is
+// cheaper than an additional Move.
+constexpr size_t kMaxGapToMerge = 4;
+
+// Largest value in the LineModifier enum.
+constexpr LineModifier kLastModifier = LineModifier::BG_RED;
+}  // namespace
+
+DamageTrackingScreen::DamageTrackingScreen(std::unique_ptr<Screen> delegate)
+    : delegate_(std::move(delegate)) {
+  CHECK(delegate_ != nullptr);
+}
+
+void DamageTrackingScreen::Flush() { delegate_->Flush(); }
+
+void DamageTrackingScreen::HardRefresh() {
+  delegate_->HardRefresh();
+  emitted_valid_ = false;
+}
+
+void DamageTrackingScreen::Refresh() {
+  AdjustSize();
+  FrameStats stats;
+  for (size_t y = 0; y < frame_.size(); y++) {
+    EmitLine(y, &stats);
+  }
+  if (delegate_modifiers_ != 0) {
+    delegate_->SetModifier(LineModifier::RESET);
+    delegate_modifiers_ = 0;
+  }
+  delegate_->Move(std::min(cursor_y_, frame_.empty() ? 0 : frame_.size() - 1),
+                  cursor_x_);
+  emitted_ = frame_;
+  emitted_valid_ = true;
+  delegate_->Refresh();
+
+  VLOG(5) << "Frame emitted: lines: " << stats.lines_emitted
+          << ", characters: " << stats.characters_emitted
+          << ", moves: " << stats.moves_emitted;
+  last_frame_stats_ = stats;
+}
+
+void DamageTrackingScreen::Clear() {
+  AdjustSize();
+  for (auto& line : frame_) {
+    line.assign(line.size(), Cell());
+  }
+  cursor_y_ = 0;
+  cursor_x_ = 0;
+}
+
+void DamageTrackingScreen::SetCursorVisibility(
+    CursorVisibility cursor_visibility) {
+  delegate_->SetCursorVisibility(cursor_visibility);
+}
+
+void DamageTrackingScreen::Move(size_t y, size_t x) {
+  AdjustSize();
+  cursor_y_ = y;
+  cursor_x_ = x;
+}
+
+void DamageTrackingScreen::WriteString(const wstring& str) {
+  AdjustSize();
+  for (wchar_t c : str) {
+    WriteCharacter(c);
+  }
+}
+
+void DamageTrackingScreen::SetModifier(LineModifier modifier) {
+  if (modifier == LineModifier::RESET) {
+    current_modifiers_ = 0;
+  } else {
+    current_modifiers_ |= ModifiersMask(1) << modifier;
+  }
+}
+
+size_t DamageTrackingScreen::columns() const { return delegate_->columns(); }
+
+size_t DamageTrackingScreen::lines() const { return delegate_->lines(); }
+
+void DamageTrackingScreen::AdjustSize() {
+  size_t lines = delegate_->lines();
+  size_t columns = delegate_->columns();
+  if (frame_.size() == lines &&
+      (frame_.empty() || frame_.front().size() == columns)) {
+    return;
+  }
+  VLOG(5) << "Screen size changed: " << columns << " x " << lines;
+  frame_.assign(lines, std::vector<Cell>(columns));
+  emitted_valid_ = false;
+}
+
+void DamageTrackingScreen::WriteCharacter(wchar_t c) {
+  if (cursor_y_ >= frame_.size()) {
+    return;
+  }
+  auto& line = frame_[cursor_y_];
+  if (c == L'\n') {
+    for (size_t x = cursor_x_; x < line.size(); x++) {
+      line[x] = Cell();
+    }
+    cursor_y_++;
+    cursor_x_ = 0;
+    return;
+  }
+
+  int width = wcwidth(c);
+  if (width == 0) {
+    size_t x = std::min(cursor_x_, line.size());
+    while (x > 0 && line[x - 1].character == 0) {
+      x--;
+    }
+    if (x > 0) {
+      line[x - 1].combining = c;
+    }
+    return;
+  }
+  width = width == 2 ? 2 : 1;
+
+  if (cursor_x_ + width > line.size()) {
+    cursor_y_++;
+    cursor_x_ = 0;
+    if (cursor_y_ >= frame_.size() || size_t(width) > line.size()) {
+      return;
+    }
+    return WriteCharacter(c);
+  }
+
+  Cell cell;
+  cell.character = c;
+  cell.modifiers = current_modifiers_;
+  line[cursor_x_] = cell;
+  if (width == 2) {
+    cell.character = 0;
+    line[cursor_x_ + 1] = cell;
+  }
+  cursor_x_ += width;
+  if (cursor_x_ >= line.size()) {
+    cursor_y_++;
+    cursor_x_ = 0;
+  }
+}
+
+void DamageTrackingScreen::EmitLine(size_t y, FrameStats* stats) {
+  const auto& line = frame_[y];
+  const std::vector<Cell>* previous = emitted_valid_ ? &emitted_[y] : nullptr;
+  auto changed = [&](size_t x) {
+    return previous == nullptr || line[x] != (*previous)[x];
+  };
+
+  bool line_emitted = false;
+  size_t x = 0;
+  while (x < line.size()) {
+    if (!changed(x)) {
+      x++;
+      continue;
+    }
+    size_t begin = x;
+    size_t end = x + 1;
+    size_t gap = 0;
+    for (x = end; x < line.size() && gap <= kMaxGapToMerge; x++) {
+      if (changed(x)) {
+        end = x + 1;
+        gap = 0;
+      } else {
+        gap++;
+      }
+    }
+    // Never start or end in the middle of a wide character.
+    while (begin > 0 && line[begin].character == 0) {
+      begin--;
+    }
+    while (end < line.size() && line[end].character == 0) {
+      end++;
+    }
+    EmitSpan(y, begin, end, stats);
+    line_emitted = true;
+    x = end;
+  }
+  if (line_emitted) {
+    stats->lines_emitted++;
+  }
+}
+
+void DamageTrackingScreen::EmitSpan(size_t y, size_t begin, size_t end,
+                                    FrameStats* stats) {
+  const auto& line = frame_[y];
+  delegate_->Move(y, begin);
+  stats->moves_emitted++;
+
+  wstring output;
+  for (size_t x = begin; x < end; x++) {
+    const Cell& cell = line[x];
+    if (cell.character == 0) {
+      continue;  // Covered by the previous (wide) character.
+    }
+    if (cell.modifiers != delegate_modifiers_) {
+      if (!output.empty()) {
+        delegate_->WriteString(output);
+        output.clear();
+      }
+      EmitModifiers(cell.modifiers);
+    }
+    output.push_back(cell.character);
+    if (cell.combining != 0) {
+      output.push_back(cell.combining);
+    }
+    stats->characters_emitted++;
+  }
+  if (!output.empty()) {
+    delegate_->WriteString(output);
+  }
+}
+
+void DamageTrackingScreen::EmitModifiers(ModifiersMask modifiers) {
+  if ((delegate_modifiers_ & ~modifiers) != 0) {
+    delegate_->SetModifier(LineModifier::RESET);
+    delegate_modifiers_ = 0;
+  }
+  for (int i = 1; i <= kLastModifier; i++) {
+    ModifiersMask bit = ModifiersMask(1) << i;
+    if ((modifiers & bit) && !(delegate_modifiers_ & bit)) {
+      delegate_->SetModifier(static_cast<LineModifier>(i));
+    }
+  }
+  delegate_modifiers_ = modifiers;
+}
+
+}  // namespace editor
+}  // namespace afc
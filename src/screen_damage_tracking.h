@@ -0,0 +1,96 @@
+#ifndef __AFC_EDITOR_SCREEN_DAMAGE_TRACKING_H__
+#define __AFC_EDITOR_SCREEN_DAMAGE_TRACKING_H__
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "screen.h"
+
+namespace afc {
+namespace editor {
+
+// A screen that doesn't forward writes to its delegate directly. Instead, it
+// keeps a model of the cells in the screen (the frame being produced) and of
+// the cells that were last emitted to the delegate. On Refresh, it compares
+// both and only emits (to the delegate) the spans of cells that have changed.
+//
+// The model mimics curses semantics: writing "\n" clears the rest of the line
+// and moves to the beginning of the next; writing past the last column wraps.
+class DamageTrackingScreen : public Screen {
+ public:
+  // Statistics about the output emitted to the delegate during a Refresh.
+  struct FrameStats {
+    size_t lines_emitted = 0;
+    size_t characters_emitted = 0;
+    size_t moves_emitted = 0;
+  };
+
+  explicit DamageTrackingScreen(std::unique_ptr<Screen> delegate);
+  ~DamageTrackingScreen() override = default;
+
+  void Flush() override;
+  void HardRefresh() override;
+  void Refresh() override;
+  void Clear() override;
+  void SetCursorVisibility(CursorVisibility cursor_visibility) override;
+  void Move(size_t y, size_t x) override;
+  void WriteString(const wstring& str) override;
+  void SetModifier(LineModifier modifier) override;
+  size_t columns() const override;
+  size_t lines() const override;
+
+  Screen* delegate() const { return delegate_.get(); }
+  const FrameStats& last_frame_stats() const { return last_frame_stats_; }
+
+ private:
+  // Bit i is set if LineModifier i is active.
+  using ModifiersMask = uint32_t;
+
+  struct Cell {
+    bool operator==(const Cell& other) const {
+      return character == other.character && combining == other.combining &&
+             modifiers == other.modifiers;
+    }
+    bool operator!=(const Cell& other) const { return !(*this == other); }
+
+    // 0 for cells that are covered by the wide character in the previous
+    // cell.
+    wchar_t character = L' ';
+    // A zero-width character (e.g., a combining diacritic) that is drawn in
+    // the same cell, or 0.
+    wchar_t combining = 0;
+    ModifiersMask modifiers = 0;
+  };
+
+  using Frame = std::vector<std::vector<Cell>>;
+
+  void AdjustSize();
+  void WriteCharacter(wchar_t c);
+  void EmitLine(size_t y, FrameStats* stats);
+  void EmitSpan(size_t y, size_t begin, size_t end, FrameStats* stats);
+  void EmitModifiers(ModifiersMask modifiers);
+
+  const std::unique_ptr<Screen> delegate_;
+
+  // The frame being produced.
+  Frame frame_;
+  // What we believe the delegate is currently showing. Only meaningful if
+  // emitted_valid_ is true.
+  Frame emitted_;
+  bool emitted_valid_ = false;
+
+  size_t cursor_y_ = 0;
+  size_t cursor_x_ = 0;
+  ModifiersMask current_modifiers_ = 0;
+
+  // The modifiers that are currently active in the delegate.
+  ModifiersMask delegate_modifiers_ = 0;
+
+  FrameStats last_frame_stats_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_SCREEN_DAMAGE_TRACKING_H__
@@ -5,6 +5,8 @@
 #include <glog/logging.h>
 
 #include "screen.h"
+#include "screen_binary.h"
+#include "screen_damage_tracking.h"
 #include "server.h"
 #include "vm/public/callbacks.h"
 #include "vm/public/environment.h"
@@ -16,7 +18,7 @@ namespace vm {
 template <>
 struct VMTypeMapper<editor::Screen*> {
   static editor::Screen* get(Value* value) {
-    return static_cast<editor::Screen*>(value->user_value.get());
+    return static_cast<editor::Screen*>(value->user_value().get());
   }
 
   static const VMType vmtype;
@@ -33,12 +35,43 @@ using vm::Value;
 using vm::VMType;
 
 namespace {
-class ScreenVm : public Screen {
+// Base class for screens that send their updates to a remote Edge instance.
+// The remote instance tells us its size (through set_size).
+class RemoteScreenBase : public Screen {
  public:
-  ScreenVm(int fd) : fd_(fd) {}
+  RemoteScreenBase(int fd) : fd_(fd) {}
+
+  size_t columns() const override { return columns_; }
+  size_t lines() const override { return lines_; }
+  void set_size(size_t columns, size_t lines) {
+    DVLOG(5) << "Received new size: " << columns << " x " << lines;
+    columns_ = columns;
+    lines_ = lines;
+  }
+
+ protected:
+  int fd() const { return fd_; }
+
+  // Sends all of data in a single write.
+  void Write(const string& data) {
+    int result = write(fd_, data.c_str(), data.size());
+    if (result != static_cast<int>(data.size())) {
+      LOG(INFO) << "Remote screen update failed!";
+    }
+  }
+
+ private:
+  const int fd_;
+  size_t columns_ = 80;
+  size_t lines_ = 25;
+};
+
+class ScreenVm : public RemoteScreenBase {
+ public:
+  ScreenVm(int fd) : RemoteScreenBase(fd) {}
 
   ~ScreenVm() override {
-    LOG(INFO) << "Sending terminate command to remote screen: fd: " << fd_;
+    LOG(INFO) << "Sending terminate command to remote screen: fd: " << fd();
     buffer_ += "set_terminate(0);";
     Write();
   }
@@ -73,30 +106,56 @@ class ScreenVm : public Screen {
     buffer_ += "screen.SetModifier(\"" + ModifierToString(modifier) + "\");";
   }
 
-  size_t columns() const { return columns_; }
-  size_t lines() const { return lines_; }
-  void set_size(size_t columns, size_t lines) {
-    DVLOG(5) << "Received new size: " << columns << " x " << lines;
-    columns_ = columns;
-    lines_ = lines;
-  }
-
  private:
   void Write() {
     buffer_ += "\n";
     LOG(INFO) << "Sending command: " << buffer_;
-    int result = write(fd_, buffer_.c_str(), buffer_.size());
-    if (result != static_cast<int>(buffer_.size())) {
-      LOG(INFO) << "Remote screen update failed!";
-    }
+    RemoteScreenBase::Write(buffer_);
     buffer_.clear();
   }
 
   string buffer_;
-  const int fd_;
-  size_t columns_ = 80;
-  size_t lines_ = 25;
 };
+
+// Sends the updates as binary frames (see screen_binary.h): all the
+// operations between two calls to Flush are sent in a single write.
+class ScreenBinary : public RemoteScreenBase {
+ public:
+  ScreenBinary(int fd) : RemoteScreenBase(fd) {}
+
+  ~ScreenBinary() override {
+    LOG(INFO) << "Sending terminate command to remote screen: fd: " << fd();
+    encoder_.Terminate();
+    Write(encoder_.TakeFrame());
+  }
+
+  void Flush() override {
+    encoder_.Flush();
+    string frame = encoder_.TakeFrame();
+    VLOG(5) << "Sending frame: " << frame.size() << " bytes.";
+    Write(frame);
+  }
+
+  void HardRefresh() override { encoder_.HardRefresh(); }
+  void Refresh() override { encoder_.Refresh(); }
+  void Clear() override { encoder_.Clear(); }
+
+  void SetCursorVisibility(CursorVisibility cursor_visibility) override {
+    encoder_.SetCursorVisibility(cursor_visibility);
+  }
+
+  void Move(size_t y, size_t x) override { encoder_.Move(y, x); }
+
+  void WriteString(const wstring& str) override { encoder_.WriteString(str); }
+
+  void SetModifier(LineModifier modifier) override {
+    encoder_.SetModifier(modifier);
+  }
+
+ private:
+  ScreenBinaryEncoder encoder_;
+};
+
 }  // namespace
 
 void RegisterScreenType(Environment* environment) {
@@ -111,8 +170,32 @@ void RegisterScreenType(Environment* environment) {
             CHECK_EQ(args.size(), 1u);
             CHECK_EQ(args[0]->type, VMType::VM_STRING);
             wstring error;
-            int fd = MaybeConnectToServer(ToByteString(args[0]->str), &error);
-            return Value::NewObject(L"Screen", std::make_shared<ScreenVm>(fd));
+            int fd = MaybeConnectToServer(ToByteString(args[0]->str()), &error);
+            return Value::NewObject(
+                L"Screen", std::shared_ptr<Screen>(NewScreenVm(fd)));
+          }));
+
+  // Like RemoteScreen, but receives a list of protocols (separated by spaces)
+  // in order of preference; uses the first one that we support.
+  environment->Define(
+      L"RemoteScreenWithProtocols",
+      Value::NewFunction(
+          {VMType::ObjectType(screen_type.get()), VMType::String(),
+           VMType::String()},
+          [](vector<unique_ptr<Value>> args) {
+            CHECK_EQ(args.size(), 2u);
+            CHECK_EQ(args[0]->type, VMType::VM_STRING);
+            CHECK_EQ(args[1]->type, VMType::VM_STRING);
+            ServerProtocol protocol =
+                NegotiateServerProtocol(ToByteString(args[1]->str()));
+            wstring error;
+            int fd = MaybeConnectToServer(ToByteString(args[0]->str()),
+                                          protocol, &error);
+            return Value::NewObject(
+                L"Screen",
+                std::shared_ptr<Screen>(protocol == ServerProtocol::BINARY_SCREEN
+                                            ? NewScreenBinary(fd)
+                                            : NewScreenVm(fd)));
           }));
 
   // Methods for Screen.
@@ -179,9 +262,16 @@ void RegisterScreenType(Environment* environment) {
   screen_type->AddField(
       L"set_size", vm::NewCallback(std::function<void(Screen*, int, int)>(
                        [](Screen* screen, int columns, int lines) {
-                         ScreenVm* screen_vm = dynamic_cast<ScreenVm*>(screen);
                          CHECK(screen != nullptr);
-                         screen_vm->set_size(columns, lines);
+                         auto damage_tracking =
+                             dynamic_cast<DamageTrackingScreen*>(screen);
+                         if (damage_tracking != nullptr) {
+                           screen = damage_tracking->delegate();
+                         }
+                         auto remote_screen =
+                             dynamic_cast<RemoteScreenBase*>(screen);
+                         CHECK(remote_screen != nullptr);
+                         remote_screen->set_size(columns, lines);
                        })));
 
   screen_type->AddField(
@@ -201,7 +291,12 @@ void RegisterScreenType(Environment* environment) {
 }
 
 std::unique_ptr<Screen> NewScreenVm(int fd) {
-  return std::make_unique<ScreenVm>(fd);
+  return std::make_unique<DamageTrackingScreen>(std::make_unique<ScreenVm>(fd));
+}
+
+std::unique_ptr<Screen> NewScreenBinary(int fd) {
+  return std::make_unique<DamageTrackingScreen>(
+      std::make_unique<ScreenBinary>(fd));
 }
 
 }  // namespace editor
@@ -7,7 +7,11 @@ namespace afc {
 namespace editor {
 
 void RegisterScreenType(vm::Environment* environment);
+// Returns a screen that sends its updates (as VM code) to a remote Edge
+// instance through fd. Only the cells that change between frames are sent.
 std::unique_ptr<Screen> NewScreenVm(int fd);
+// Like NewScreenVm, but uses the binary protocol (see screen_binary.h).
+std::unique_ptr<Screen> NewScreenBinary(int fd);
 
 }  // namespace editor
 }  // namespace afc
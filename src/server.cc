@@ -6,6 +6,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <utility>
 
@@ -21,6 +22,8 @@ extern "C" {
 #include "editor.h"
 #include "file_link_mode.h"
 #include "lazy_string.h"
+#include "screen.h"
+#include "screen_binary.h"
 #include "vm/public/vm.h"
 #include "wstring.h"
 
@@ -96,7 +99,38 @@ int MaybeConnectToParentServer(wstring* error) {
   return MaybeConnectToServer(string(server_address), error);
 }
 
+string ServerProtocolToString(ServerProtocol protocol) {
+  switch (protocol) {
+    case ServerProtocol::VM:
+      return "vm";
+    case ServerProtocol::BINARY_SCREEN:
+      return "binary";
+  }
+  LOG(FATAL) << "Invalid protocol.";
+  return "";
+}
+
+ServerProtocol NegotiateServerProtocol(const string& protocols) {
+  std::istringstream input(protocols);
+  string name;
+  while (input >> name) {
+    for (auto protocol : {ServerProtocol::BINARY_SCREEN, ServerProtocol::VM}) {
+      if (name == ServerProtocolToString(protocol)) {
+        LOG(INFO) << "Negotiated protocol: " << name;
+        return protocol;
+      }
+    }
+    LOG(INFO) << "Ignoring unsupported protocol: " << name;
+  }
+  return ServerProtocol::VM;
+}
+
 int MaybeConnectToServer(const string& address, wstring* error) {
+  return MaybeConnectToServer(address, ServerProtocol::VM, error);
+}
+
+int MaybeConnectToServer(const string& address, ServerProtocol protocol,
+                         wstring* error) {
   wstring dummy;
   if (error == nullptr) {
     error = &dummy;
@@ -115,7 +149,11 @@ int MaybeConnectToServer(const string& address, wstring* error) {
     return -1;
   }
   LOG(INFO) << "Fifo created: " << private_fifo;
-  string command = "ConnectTo(\"" + ToByteString(private_fifo) + "\");\n";
+  string command =
+      protocol == ServerProtocol::VM
+          ? "ConnectTo(\"" + ToByteString(private_fifo) + "\");\n"
+          : "ConnectToWithProtocol(\"" + ToByteString(private_fifo) +
+                "\", \"" + ServerProtocolToString(protocol) + "\");\n";
   LOG(INFO) << "Sending connection command: " << command;
   if (write(fd, command.c_str(), command.size()) == -1) {
     *error = FromByteString(address) + L": write failed: " +
@@ -163,8 +201,9 @@ void Daemonize(const std::unordered_set<int>& surviving_fds) {
 
 class ServerBuffer : public OpenBuffer {
  public:
-  ServerBuffer(EditorState* editor_state, const wstring& name)
-      : OpenBuffer(editor_state, name) {
+  ServerBuffer(EditorState* editor_state, const wstring& name,
+               ServerProtocol protocol)
+      : OpenBuffer(editor_state, name), protocol_(protocol) {
     set_bool_variable(buffer_variables::clear_on_reload(), false);
     set_bool_variable(buffer_variables::vm_exec(), true);
     set_bool_variable(buffer_variables::show_in_buffers_list(), false);
@@ -185,7 +224,49 @@ class ServerBuffer : public OpenBuffer {
     editor_state->ScheduleRedraw();
   }
 
+  void ReadData(EditorState* editor_state) override {
+    if (protocol_ == ServerProtocol::VM) {
+      OpenBuffer::ReadData(editor_state);
+      return;
+    }
+    char input[64 * 1024];
+    ssize_t length = read(fd_.fd, input, sizeof(input));
+    if (length == -1 && errno == EAGAIN) {
+      return;
+    }
+    if (length <= 0) {
+      LOG(INFO) << "Binary screen connection closed: " << fd_.fd;
+      fd_.Close();
+      fd_.Reset();
+      EndOfFile(editor_state);
+      return;
+    }
+    auto screen = GetScreen();
+    if (screen == nullptr) {
+      LOG(INFO) << "No screen found, ignoring frames.";
+      return;
+    }
+    decoder_.Consume(input, length, screen);
+    if (decoder_.terminate_requested()) {
+      EvaluateString(editor_state, L"set_terminate(0);",
+                     [](std::unique_ptr<Value>) {});
+    }
+  }
+
   bool ShouldDisplayProgress() const override { return false; }
+
+ private:
+  Screen* GetScreen() {
+    auto value = environment()->Lookup(L"screen");
+    if (value == nullptr || value->type.type != VMType::OBJECT_TYPE ||
+        value->type.object_type != L"Screen") {
+      return nullptr;
+    }
+    return static_cast<Screen*>(value->user_value().get());
+  }
+
+  const ServerProtocol protocol_;
+  ScreenBinaryDecoder decoder_;
 };
 
 bool StartServer(EditorState* editor_state, wstring address,
@@ -212,8 +293,14 @@ bool StartServer(EditorState* editor_state, wstring address,
 
 shared_ptr<OpenBuffer> OpenServerBuffer(EditorState* editor_state,
                                         const wstring& address) {
+  return OpenServerBuffer(editor_state, address, ServerProtocol::VM);
+}
+
+shared_ptr<OpenBuffer> OpenServerBuffer(EditorState* editor_state,
+                                        const wstring& address,
+                                        ServerProtocol protocol) {
   auto buffer = std::make_shared<ServerBuffer>(
-      editor_state, editor_state->GetUnusedBufferName(L"- server"));
+      editor_state, editor_state->GetUnusedBufferName(L"- server"), protocol);
   buffer->set_string_variable(buffer_variables::path(), address);
   editor_state->buffers()->insert(make_pair(buffer->name(), buffer));
   buffer->Reload(editor_state);
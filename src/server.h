@@ -17,7 +17,28 @@ wstring CppEscapeString(wstring input);
 
 void Daemonize(const std::unordered_set<int>& surviving_fd);
 
+// Protocols for the data sent through the connections created by
+// MaybeConnectToServer.
+enum class ServerProtocol {
+  // The data is VM code, evaluated by the receiving instance.
+  VM,
+  // The data is a stream of binary screen frames (see screen_binary.h),
+  // applied to the screen of the receiving instance.
+  BINARY_SCREEN,
+};
+
+string ServerProtocolToString(ServerProtocol protocol);
+
+// Receives a list of protocol names (separated by spaces), in order of
+// preference, and returns the first one that we support. If none is
+// supported, returns ServerProtocol::VM.
+ServerProtocol NegotiateServerProtocol(const string& protocols);
+
 int MaybeConnectToServer(const string& address, wstring* error);
+// Like MaybeConnectToServer, but tells the server to interpret the data it
+// receives according to protocol.
+int MaybeConnectToServer(const string& address, ServerProtocol protocol,
+                         wstring* error);
 int MaybeConnectToParentServer(wstring* error);
 
 class EditorState;
@@ -29,6 +50,9 @@ bool StartServer(EditorState* editor_state, wstring address,
 
 shared_ptr<OpenBuffer> OpenServerBuffer(EditorState* editor_state,
                                         const wstring& address);
+shared_ptr<OpenBuffer> OpenServerBuffer(EditorState* editor_state,
+                                        const wstring& address,
+                                        ServerProtocol protocol);
 
 }  // namespace editor
 }  // namespace afc
@@ -9,6 +9,7 @@
 #include "buffer_variables.h"
 #include "dirname.h"
 #include "line_marks.h"
+#include "line_output_cache.h"
 #include "src/parse_tree.h"
 
 namespace afc {
@@ -78,6 +79,16 @@ void AdvanceToNextLine(const OpenBuffer& buffer, LineColumn* position) {
   position->line++;
   position->column = buffer.Read(buffer_variables::view_start_column());
 }
+
+void OutputPrefix(const wstring& prefix, LineModifier modifier,
+                  Line::OutputReceiverInterface* receiver) {
+  if (prefix.empty()) {
+    return;
+  }
+  receiver->AddModifier(modifier);
+  receiver->AddString(prefix);
+  receiver->AddModifier(LineModifier::RESET);
+}
 }  // namespace
 
 void Terminal::Display(EditorState* editor_state, Screen* screen,
@@ -702,6 +713,12 @@ class ParseTreeHighlighterTokens : public Line::OutputReceiverInterface {
     modifiers_merger_.AddParentModifier(modifier);
   }
 
+  // Drops the modifiers that come from the tree (but not those from the
+  // parent), as if we had reached a position not covered by any token.
+  void ResetTokensModifiers() {
+    modifiers_merger_.AddChildrenModifier(LineModifier::RESET);
+  }
+
  private:
   void UpdateCurrent(LineColumn position) {
     // Go up the tree until we're at a root that includes position.
@@ -838,14 +855,66 @@ void Terminal::ShowBuffer(
         (current_cursors != cursors.end() &&
          buffer->Read(buffer_variables::multiple_cursors()));
     line_output_options.has_cursor = current_cursors != cursors.end();
+    LineModifier prefix_modifier =
+        line_output_options.has_active_cursor
+            ? LineModifier::CYAN
+            : (line_output_options.has_cursor ? LineModifier::BLUE
+                                              : LineModifier::DIM);
 
     std::unique_ptr<Line::OutputReceiverInterface> cursors_highlighter;
 
     auto line = buffer->LineAt(position.line);
 
     CHECK(line->contents() != nullptr);
-    if (position.line == buffer->position().line &&
-        buffer->Read(buffer_variables::atomic_lines())) {
+    bool highlight_atomic_line =
+        position.line == buffer->position().line &&
+        buffer->Read(buffer_variables::atomic_lines());
+    bool highlight_current_tree =
+        current_tree != root.get() &&
+        position.line >= current_tree->range.begin.line &&
+        position.line <= current_tree->range.end.line;
+    if (!highlight_atomic_line && !highlight_current_tree &&
+        current_cursors == cursors.end()) {
+      // The common case: the output of the contents of the line can be
+      // reused across frames.
+      LineOutputCache::Key key;
+      key.line = line;
+      key.line_number = position.line;
+      key.column = position.column;
+      key.width = line_output_options.width;
+      key.prefix = number_prefix;
+      key.prefix_modifier = prefix_modifier;
+      if (!root->children.empty()) {
+        key.parse_tree = root;
+      }
+      const LineOutputCache::Entry* entry = line_output_cache_.Find(key);
+      if (entry == nullptr) {
+        LineOutputRecorder recorder;
+        Line::OutputOptions options = line_output_options;
+        options.output_receiver = &recorder;
+        std::unique_ptr<ParseTreeHighlighterTokens> tokens_highlighter;
+        if (key.parse_tree != nullptr) {
+          tokens_highlighter = std::make_unique<ParseTreeHighlighterTokens>(
+              &recorder, number_prefix.size(), root.get(), position.line);
+          options.output_receiver = tokens_highlighter.get();
+        }
+        OutputPrefix(number_prefix, prefix_modifier, options.output_receiver);
+        LineOutputCache::Entry new_entry;
+        new_entry.output_column = line->OutputContents(options);
+        if (tokens_highlighter != nullptr) {
+          tokens_highlighter->ResetTokensModifiers();
+        }
+        new_entry.segments = recorder.TakeSegments();
+        entry = line_output_cache_.Insert(key, std::move(new_entry));
+      }
+      LineOutputRecorder::Replay(entry->segments, line_output_receiver.get());
+      line->OutputMargin(line_output_options, entry->output_column);
+      line_output_receiver->AddModifier(LineModifier::RESET);
+      last_line = position.line;
+      continue;
+    }
+
+    if (highlight_atomic_line) {
       buffer->set_last_highlighted_line(position.line);
       atomic_lines_highlighter =
           std::make_unique<HighlightedLineOutputReceiver>(
@@ -882,9 +951,7 @@ void Terminal::ShowBuffer(
     }
 
     std::unique_ptr<Line::OutputReceiverInterface> parse_tree_highlighter;
-    if (current_tree != root.get() &&
-        position.line >= current_tree->range.begin.line &&
-        position.line <= current_tree->range.end.line) {
+    if (highlight_current_tree) {
       size_t begin = position.line == current_tree->range.begin.line
                          ? current_tree->range.begin.column
                          : 0;
@@ -895,24 +962,15 @@ void Terminal::ShowBuffer(
           line_output_options.output_receiver, number_prefix.size(), begin,
           end);
       line_output_options.output_receiver = parse_tree_highlighter.get();
-    } else if (!buffer->parse_tree()->children.empty()) {
+    } else if (!root->children.empty()) {
       parse_tree_highlighter = std::make_unique<ParseTreeHighlighterTokens>(
           line_output_options.output_receiver, number_prefix.size(), root.get(),
           position.line);
       line_output_options.output_receiver = parse_tree_highlighter.get();
     }
 
-    if (!number_prefix.empty()) {
-      if (line_output_options.has_active_cursor) {
-        line_output_options.output_receiver->AddModifier(LineModifier::CYAN);
-      } else if (line_output_options.has_cursor) {
-        line_output_options.output_receiver->AddModifier(LineModifier::BLUE);
-      } else {
-        line_output_options.output_receiver->AddModifier(LineModifier::DIM);
-      }
-      line_output_options.output_receiver->AddString(number_prefix);
-      line_output_options.output_receiver->AddModifier(LineModifier::RESET);
-    }
+    OutputPrefix(number_prefix, prefix_modifier,
+                 line_output_options.output_receiver);
     line->Output(line_output_options);
 
     // Need to do this for atomic lines, since they override the Reset modifier
@@ -922,6 +980,8 @@ void Terminal::ShowBuffer(
   }
 }
 
+void Terminal::FinishFrame() { line_output_cache_.FinishFrame(); }
+
 void Terminal::AdjustPosition(
     const shared_ptr<OpenBuffer> buffer, Screen* screen,
     const std::vector<LineColumn>& screen_line_positions) {
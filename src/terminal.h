@@ -7,6 +7,7 @@
 #include <string>
 
 #include "editor.h"
+#include "line_output_cache.h"
 #include "screen.h"
 
 namespace afc {
@@ -33,6 +34,9 @@ class Terminal {
 
   void Display(EditorState* editor_state, Screen* screen,
                const EditorState::ScreenState& screen_state);
+  // Must be called once per frame, after all screens have been displayed
+  // (the same Terminal displays every screen).
+  void FinishFrame();
 
  private:
   void ShowStatus(const EditorState& editor_state, Screen* screen);
@@ -45,6 +49,8 @@ class Terminal {
                   const std::vector<LineColumn>& screen_line_positions);
   void AdjustPosition(const shared_ptr<OpenBuffer> buffer, Screen* screen,
                       const std::vector<LineColumn>& screen_line_positions);
+
+  LineOutputCache line_output_cache_;
 };
 
 }  // namespace editor
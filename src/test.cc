@@ -1,5 +1,6 @@
 #include <csignal>
 #include <iostream>
+#include <map>
 #include <string>
 
 #include <glog/logging.h>
@@ -7,9 +8,28 @@
 
 #include "audio.h"
 #include "buffer_variables.h"
+#include "char_buffer.h"
 #include "editor.h"
+#include "list_buffers_command.h"
 #include "src/test/buffer_contents_test.h"
+#include "src/test/buffer_words_index_test.h"
+#include "src/test/completion_index_test.h"
+#include "src/test/cursors_test.h"
+#include "src/test/event_loop_test.h"
+#include "src/test/file_predictor_worker_test.h"
+#include "src/test/line_filter_test.h"
+#include "src/test/line_marks_resolver_test.h"
+#include "src/test/line_marks_test.h"
+#include "src/test/line_output_cache_test.h"
 #include "src/test/line_test.h"
+#include "src/test/path_index_test.h"
+#include "src/test/redraw_scheduler_test.h"
+#include "src/test/screen_binary_test.h"
+#include "src/test/screen_damage_tracking_test.h"
+#include "src/test/timer_wheel_test.h"
+#include "src/test/undo_history_test.h"
+#include "src/test/undo_journal_test.h"
+#include "src/test/vm_test.h"
 #include "terminal.h"
 #include "tree.h"
 
@@ -700,18 +720,179 @@ void TestCases() {
 
   Clear(&editor_state);
 
+  // Bulk line operations from extensions; each is a single undo entry.
+  editor_state.ProcessInputString("ialejandro\nforero\ncuervo\nedge");
+  editor_state.ProcessInput(Terminal::ESCAPE);
+  {
+    auto buffer = editor_state.current_buffer()->second;
+    CHECK(buffer->EvaluateString(
+        &editor_state,
+        L"buffer.ReplaceRegex(1, -1, \"r+\", \"R\");"
+        L"buffer.KeepLinesMatching(0, -1, \"o$\");"
+        L"string Wrap(string s) { return \"[\" + s + \"]\"; }"
+        L"buffer.MapLines(0, 2, Wrap);"
+        L"bool Short(string s) { return s.size() < 10; }"
+        L"buffer.KeepLines(0, -1, Short);",
+        [](std::unique_ptr<afc::vm::Value>) {}));
+    CHECK_EQ(ToByteString(buffer->ToString()), "[foReRo]\ncueRvo");
+    editor_state.ProcessInputString("u");
+    CHECK_EQ(ToByteString(buffer->ToString()),
+             "[alejandro]\n[foReRo]\ncueRvo");
+  }
+
+  Clear(&editor_state);
+
+  // Deleting all lines leaves the buffer with an empty line.
+  editor_state.ProcessInputString("ialpha\nbeta");
+  editor_state.ProcessInput(Terminal::ESCAPE);
+  {
+    auto buffer = editor_state.current_buffer()->second;
+    CHECK(buffer->EvaluateString(&editor_state,
+                                 L"buffer.KeepLinesMatching(0, -1, \"zzz\");",
+                                 [](std::unique_ptr<afc::vm::Value>) {}));
+    CHECK_EQ(buffer->contents()->size(), 1u);
+    CHECK_EQ(ToByteString(buffer->ToString()), "");
+    editor_state.ProcessInputString("u");
+    CHECK_EQ(ToByteString(buffer->ToString()), "alpha\nbeta");
+    CHECK(buffer->EvaluateString(
+        &editor_state,
+        L"bool Never(string s) { return false; }"
+        L"buffer.KeepLines(0, -1, Never);",
+        [](std::unique_ptr<afc::vm::Value>) {}));
+    CHECK_EQ(buffer->contents()->size(), 1u);
+    CHECK_EQ(ToByteString(buffer->ToString()), "");
+  }
+
+  Clear(&editor_state);
+
+  // Filters hide lines without modifying the buffer.
+  editor_state.ProcessInputString("ialejandro\nforero\ncuervo");
+  editor_state.ProcessInput(Terminal::ESCAPE);
+  {
+    auto buffer = editor_state.current_buffer()->second;
+    CHECK(buffer->EvaluateString(
+        &editor_state,
+        L"bool Long(string s) { return s.size() > 6; }"
+        L"buffer.Filter(Long);",
+        [](std::unique_ptr<afc::vm::Value>) {}));
+    CHECK(buffer->IsLineFiltered(0));
+    CHECK(!buffer->IsLineFiltered(1));
+    CHECK(!buffer->IsLineFiltered(2));
+    CHECK(buffer->EvaluateString(&editor_state,
+                                 L"buffer.FilterRegex(\"^[fc]\");",
+                                 [](std::unique_ptr<afc::vm::Value>) {}));
+    CHECK(!buffer->IsLineFiltered(0));
+    CHECK(buffer->IsLineFiltered(1));
+    CHECK(buffer->IsLineFiltered(2));
+    CHECK(buffer->EvaluateString(&editor_state, L"buffer.ClearFilter();",
+                                 [](std::unique_ptr<afc::vm::Value>) {}));
+    CHECK(buffer->IsLineFiltered(0));
+    CHECK_EQ(ToByteString(buffer->ToString()), "alejandro\nforero\ncuervo");
+  }
+
+  Clear(&editor_state);
+
+  {
+    auto buffer = editor_state.current_buffer()->second;
+    CHECK(buffer->EvaluateString(
+        &editor_state,
+        L"void Fire() { SetStatus(\"fired\"); }"
+        L"int id = ScheduleTimer(0, Fire);"
+        L"CancelTimer(ScheduleTimer(0, Fire));"
+        L"SetStatus(\"scheduled\");",
+        [](std::unique_ptr<afc::vm::Value>) {}));
+    CHECK(editor_state.status() == L"scheduled");
+    CHECK_GE(editor_state.timer_wheel()->RunExpired(
+                 TimerWheel::Clock::now() + std::chrono::milliseconds(1)),
+             1u);
+    CHECK(editor_state.status() == L"fired");
+  }
+
+  // Timers scheduled by a buffer don't fire once the buffer is deleted.
+  {
+    auto buffer = std::make_shared<OpenBuffer>(&editor_state, L"timers");
+    editor_state.buffers()->insert({L"timers", buffer});
+    CHECK(buffer->EvaluateString(
+        &editor_state,
+        L"void Fire() { SetStatus(\"fired\"); }"
+        L"ScheduleTimer(0, Fire);"
+        L"SetStatus(\"scheduled\");",
+        [](std::unique_ptr<afc::vm::Value>) {}));
+    editor_state.buffers()->erase(L"timers");
+    buffer = nullptr;
+    editor_state.timer_wheel()->RunExpired(TimerWheel::Clock::now() +
+                                           std::chrono::milliseconds(1));
+    CHECK(editor_state.status() == L"scheduled");
+  }
+
+  Clear(&editor_state);
+
   editor_state.ProcessInputString("al");
 
   Clear(&editor_state);
 }
 
+void TestBuffersList() {
+  auto audio_player = NewNullAudioPlayer();
+  EditorState editor_state(audio_player.get());
+  std::vector<std::shared_ptr<OpenBuffer>> buffers;
+  for (auto name : {L"alpha", L"beta"}) {
+    auto buffer = std::make_shared<OpenBuffer>(&editor_state, name);
+    buffer->set_int_variable(buffer_variables::buffer_list_context_lines(), 1);
+    buffer->AppendToLastLine(&editor_state, NewCopyString(L"first"));
+    editor_state.buffers()->insert({name, buffer});
+    buffers.push_back(buffer);
+  }
+  NewListBuffersCommand()->ProcessInput(0, &editor_state);
+  auto list = editor_state.current_buffer()->second;
+  CHECK_EQ(list->lines_size(), 4u);
+  std::map<wstring, size_t> rows;
+  for (size_t i = 0; i < list->lines_size(); i += 2) {
+    auto name = list->LineAt(i)->ToString();
+    rows[name.substr(name.find_first_of(L"ab"), 4)] = i;
+    CHECK(list->LineAt(i + 1)->ToString() == L"╰ first");
+  }
+  CHECK_EQ(rows.size(), 2u);
+
+  // Only the row of the buffer that changed is replaced.
+  auto alpha = list->LineAt(rows[L"alph"]);
+  buffers[1]->AppendToLastLine(&editor_state, NewCopyString(L" second"));
+  list->Reload(&editor_state);
+  CHECK_EQ(list->lines_size(), 4u);
+  CHECK(list->LineAt(rows[L"alph"]) == alpha);
+  CHECK(list->LineAt(rows[L"beta"] + 1)->ToString() == L"╰ first second");
+
+  editor_state.buffers()->erase(L"alpha");
+  list->Reload(&editor_state);
+  CHECK_EQ(list->lines_size(), 2u);
+  CHECK(list->LineAt(1)->ToString() == L"╰ first second");
+}
+
 int main(int, char** argv) {
   signal(SIGPIPE, SIG_IGN);
   google::InitGoogleLogging(argv[0]);
 
   testing::BufferContentsTests();
+  testing::BufferWordsIndexTests();
+  testing::CompletionIndexTests();
+  testing::CursorsTests();
+  testing::EventLoopTests();
+  testing::FilePredictorWorkerTests();
+  testing::LineFilterTests();
+  testing::LineMarksResolverTests();
+  testing::LineMarksTests();
+  testing::LineOutputCacheTests();
   testing::LineTests();
+  testing::PathIndexTests();
+  testing::RedrawSchedulerTests();
+  testing::ScreenBinaryTests();
+  testing::ScreenDamageTrackingTests();
+  testing::TimerWheelTests();
+  testing::UndoHistoryTests();
+  testing::UndoJournalTests();
+  testing::VmTests();
   TestCases();
+  TestBuffersList();
   TreeTestsLong();
   TreeTestsBasic();
 
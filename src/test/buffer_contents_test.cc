@@ -32,6 +32,23 @@ void TestBufferContentsSnapshot() {
            ToByteString(copy->ToString()));
 }
 
+void TestBufferContentsVersion() {
+  BufferContents contents;
+  for (auto& s : {L"alejandro", L"forero", L"cuervo"}) {
+    contents.push_back(s);
+  }
+  auto copy = contents.copy();
+  CHECK_EQ(copy->version(), contents.version());
+  CHECK_NE(BufferContents().version(), contents.version());
+
+  // Changing a line in the middle changes the version.
+  size_t version = contents.version();
+  contents.SetCharacter(1, 0, L'F', {});
+  CHECK_NE(contents.version(), version);
+  copy->SetCharacter(1, 0, L'F', {});
+  CHECK_NE(copy->version(), contents.version());
+}
+
 void TestBufferInsertModifiers() {
   BufferContents contents;
   Line::Options options;
@@ -42,9 +59,9 @@ void TestBufferInsertModifiers() {
   contents.push_back(std::make_shared<Line>(options));
   options.modifiers[2].insert(LineModifier::BOLD);
   contents.push_back(std::make_shared<Line>(options));
-  auto line = std::make_shared<Line>(*contents.at(1));
-  line->SetAllModifiers(LineModifierSet({LineModifier::DIM}));
-  contents.push_back(line);
+  LineBuilder line(*contents.at(1));
+  line.SetAllModifiers(LineModifierSet({LineModifier::DIM}));
+  contents.push_back(line.Build());
 
   for (int i = 0; i < 2; i++) {
     LOG(INFO) << "Start iteration: " << i;
@@ -88,6 +105,7 @@ void TestBufferInsertModifiers() {
 void BufferContentsTests() {
   LOG(INFO) << "BufferContents tests: start.";
   TestBufferContentsSnapshot();
+  TestBufferContentsVersion();
   TestBufferInsertModifiers();
   LOG(INFO) << "BufferContents tests: done.";
 }
@@ -0,0 +1,99 @@
+#include "src/test/buffer_words_index_test.h"
+
+#include <glog/logging.h>
+
+#include "src/buffer_contents.h"
+#include "src/buffer_words_index.h"
+#include "src/char_buffer.h"
+#include "src/parse_tree.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+using Words = std::vector<std::wstring>;
+
+BufferWordsIndex::WordCounts CountWords(std::unique_ptr<TreeParser> parser,
+                                        const std::wstring& word_characters,
+                                        std::vector<std::wstring> lines) {
+  BufferContents contents;
+  for (auto& line : lines) {
+    contents.push_back(
+        std::make_shared<Line>(Line::Options(NewCopyString(line))));
+  }
+  ParseTree tree;
+  tree.range.end = LineColumn(contents.size() - 1, contents.back()->size());
+  parser->FindChildren(contents, &tree);
+  return BufferWordsIndex::CountWords(contents, tree, word_characters);
+}
+
+void TestCountWords() {
+  const std::wstring kLetters = L"abcdefghijklmnopqrstuvwxyzB";
+  auto words = CountWords(
+      NewLineTreeParser(NewWordsTreeParser(kLetters, {}, NewNullTreeParser())),
+      kLetters, {L"foo bar foo", L"", L"Baz q-x"});
+  CHECK_EQ(words.size(), 5u);
+  CHECK_EQ(words[L"foo"], 2u);
+  CHECK_EQ(words[L"bar"], 1u);
+  CHECK_EQ(words[L"Baz"], 1u);
+  CHECK_EQ(words[L"x"], 1u);
+
+  // Leaves with characters that aren't word characters are ignored.
+  words = CountWords(NewLineTreeParser(NewCharTreeParser()), kLetters,
+                     {L"a-b", L"a"});
+  CHECK_EQ(words.size(), 2u);
+  CHECK_EQ(words[L"a"], 2u);
+  CHECK_EQ(words[L"b"], 1u);
+}
+
+void TestFindByFrequency() {
+  BufferWordsIndex index;
+  index.Update(1, {{L"format", 3}, {L"for", 5}, {L"Formal", 1}});
+  index.Update(2, {{L"format", 4}, {L"bar", 2}});
+  CHECK_EQ(index.size(), 4u);
+  CHECK(index.Find(L"fo", 10) == Words({L"format", L"for", L"Formal"}));
+  CHECK(index.Find(L"FORM", 10) == Words({L"format", L"Formal"}));
+  CHECK(index.Find(L"fo", 1) == Words({L"format"}));
+  CHECK(index.Find(L"for", 10) == Words({L"format", L"Formal"}));
+  CHECK(index.Find(L"x", 10).empty());
+  CHECK_EQ(index.Find(L"", 10).size(), 4u);
+}
+
+void TestIncrementalUpdates() {
+  BufferWordsIndex index;
+  index.Update(1, {{L"alpha", 2}, {L"beta", 1}});
+  index.Update(2, {{L"alpha", 1}});
+  index.Update(1, {{L"beta", 1}, {L"gamma", 1}});
+  CHECK(index.Find(L"a", 10) == Words({L"alpha"}));
+  CHECK(index.Find(L"g", 10) == Words({L"gamma"}));
+
+  index.RemoveBuffer(2);
+  CHECK(index.Find(L"a", 10).empty());
+  CHECK_EQ(index.size(), 2u);
+  index.RemoveBuffer(1);
+  CHECK_EQ(index.size(), 0u);
+  index.RemoveBuffer(1);
+}
+
+void TestRecency() {
+  BufferWordsIndex index;
+  index.Update(1, {{L"apple", 1}, {L"apricot", 1}});
+  index.Update(2, {{L"ape", 1}});
+  CHECK(index.Find(L"ap", 10) == Words({L"ape", L"apple", L"apricot"}));
+  // apricot is typed again (and then removed) in buffer 3.
+  index.Update(3, {{L"apricot", 1}});
+  index.Update(3, {});
+  CHECK(index.Find(L"ap", 10) == Words({L"apricot", L"ape", L"apple"}));
+}
+}  // namespace
+
+void BufferWordsIndexTests() {
+  TestCountWords();
+  TestFindByFrequency();
+  TestIncrementalUpdates();
+  TestRecency();
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
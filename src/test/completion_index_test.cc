@@ -0,0 +1,94 @@
+#include "src/test/completion_index_test.h"
+
+#include <glog/logging.h>
+
+#include "src/completion_index.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+CompletionIndex::Entry NewEntry(std::wstring word, size_t frequency = 1) {
+  CompletionIndex::Entry entry;
+  entry.word = std::move(word);
+  entry.frequency = frequency;
+  return entry;
+}
+
+std::vector<std::wstring> FindWords(const CompletionIndex& index,
+                                    const std::wstring& prefix,
+                                    size_t limit = 100) {
+  std::vector<std::wstring> output;
+  for (size_t id : index.Find(prefix, limit)) {
+    output.push_back(index.word(id));
+  }
+  return output;
+}
+
+void TestPrefixRange() {
+  CompletionIndex index({NewEntry(L"fox"), NewEntry(L"foobar"),
+                         NewEntry(L"bar"), NewEntry(L"food"), NewEntry(L"fo"),
+                         NewEntry(L"zzz"), NewEntry(L"")});
+  CHECK_EQ(index.size(), 6u);
+  CHECK(FindWords(index, L"foo") ==
+        std::vector<std::wstring>({L"foobar", L"food"}));
+  CHECK(FindWords(index, L"fo") ==
+        std::vector<std::wstring>({L"foobar", L"food", L"fox"}));
+  CHECK(FindWords(index, L"f").size() == 4u);
+  CHECK(FindWords(index, L"").size() == 6u);
+  CHECK(FindWords(index, L"zzzz").empty());
+  CHECK(FindWords(index, L"a").empty());
+  CHECK(FindWords(index, L"zzz").empty());
+}
+
+void TestIgnoresCase() {
+  CompletionIndex index(
+      {NewEntry(L"Apple"), NewEntry(L"apricot"), NewEntry(L"APE")});
+  CHECK(FindWords(index, L"ap") ==
+        std::vector<std::wstring>({L"APE", L"Apple", L"apricot"}));
+  CHECK(FindWords(index, L"APP") == std::vector<std::wstring>({L"Apple"}));
+  // Only the exact word is excluded.
+  CHECK(FindWords(index, L"ape") == std::vector<std::wstring>({L"APE"}));
+}
+
+void TestFrequency() {
+  CompletionIndex index({NewEntry(L"for", 10), NewEntry(L"format", 3),
+                         NewEntry(L"formal"), NewEntry(L"format", 20),
+                         NewEntry(L"forest", 3)});
+  CHECK_EQ(index.size(), 4u);
+  CHECK(FindWords(index, L"fo") ==
+        std::vector<std::wstring>({L"format", L"for", L"forest", L"formal"}));
+  CHECK(FindWords(index, L"fo", 2) ==
+        std::vector<std::wstring>({L"format", L"for"}));
+  auto ids = index.Find(L"format", 10);
+  CHECK(ids.empty());
+  ids = index.Find(L"forma", 10);
+  CHECK_EQ(ids.size(), 2u);
+  CHECK_EQ(index.frequency(ids[0]), 23u);
+}
+
+void TestParseDictionaryLine() {
+  CompletionIndex::Entry entry;
+  CHECK(CompletionIndex::ParseDictionaryLine(L"word", &entry));
+  CHECK(entry.word == L"word");
+  CHECK_EQ(entry.frequency, 1u);
+  CHECK(CompletionIndex::ParseDictionaryLine(L"word\t42", &entry));
+  CHECK(entry.word == L"word");
+  CHECK_EQ(entry.frequency, 42u);
+  CHECK(CompletionIndex::ParseDictionaryLine(L"a\tb", &entry));
+  CHECK(entry.word == L"a\tb");
+  CHECK_EQ(entry.frequency, 1u);
+  CHECK(!CompletionIndex::ParseDictionaryLine(L"", &entry));
+}
+}  // namespace
+
+void CompletionIndexTests() {
+  TestPrefixRange();
+  TestIgnoresCase();
+  TestFrequency();
+  TestParseDictionaryLine();
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
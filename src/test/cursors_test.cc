@@ -0,0 +1,267 @@
+#include "src/test/cursors_test.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "src/cursors.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+using Transformation = CursorsTracker::Transformation;
+
+CursorsSet* SetCursors(CursorsTracker* tracker, const std::wstring& name,
+                       const std::vector<LineColumn>& positions) {
+  auto cursors = tracker->FindOrCreateCursors(name);
+  cursors->clear();
+  cursors->insert(positions.begin(), positions.end());
+  return cursors;
+}
+
+std::vector<LineColumn> ToVector(const CursorsSet& cursors) {
+  return std::vector<LineColumn>(cursors.begin(), cursors.end());
+}
+
+void TestCursorsSetCurrentIndex() {
+  CursorsSet cursors;
+  cursors.insert(LineColumn(5));
+  cursors.insert(LineColumn(9));
+  cursors.set_current_index(1);
+  CHECK_EQ(cursors.current(), LineColumn(9));
+
+  cursors.insert(LineColumn(1));
+  cursors.insert(LineColumn(9));  // Goes after the existing one.
+  CHECK_EQ(cursors.current_index(), 2u);
+  CHECK_EQ(cursors.current(), LineColumn(9));
+
+  cursors.erase(cursors.begin());
+  CHECK_EQ(cursors.current_index(), 1u);
+  CHECK_EQ(cursors.current(), LineColumn(9));
+
+  cursors.erase(cursors.begin() + 1);
+  CHECK_EQ(cursors.current(), LineColumn(9));
+  cursors.erase(cursors.begin() + 1);
+  CHECK_EQ(cursors.current(), LineColumn(5));  // Wrapped around.
+}
+
+void TestCursorsSetLazyLines() {
+  CursorsSet cursors;
+  for (size_t i = 0; i < 20; i++) {
+    cursors.insert(LineColumn(i, 1));
+  }
+  cursors.AddToLines(5, 10);
+  cursors.AddToLines(15, 3);
+  CHECK_EQ(cursors.Get(4), LineColumn(4, 1));
+  CHECK_EQ(cursors.Get(5), LineColumn(15, 1));
+  CHECK_EQ(cursors.Get(15), LineColumn(28, 1));
+  CHECK_EQ(cursors.LowerBoundIndex(LineColumn(15)), 5u);
+  CHECK_EQ(cursors.LowerBoundIndex(LineColumn(23)), 13u);
+
+  cursors.Set(4, LineColumn(4, 7));
+  CHECK_EQ(cursors.Get(4), LineColumn(4, 7));
+
+  cursors.insert(LineColumn(16));  // Folds the pending deltas.
+  std::vector<LineColumn> expected;
+  for (size_t i = 0; i < 20; i++) {
+    if (i == 4) {
+      expected.push_back(LineColumn(4, 7));
+    } else {
+      expected.push_back(
+          LineColumn(i + (i >= 5 ? 10 : 0) + (i >= 15 ? 3 : 0), 1));
+    }
+    if (i == 5) {
+      expected.push_back(LineColumn(16));
+    }
+  }
+  CHECK(ToVector(cursors) == expected);
+}
+
+// Inserts an empty line before every cursor.
+void TestInsertLines() {
+  CursorsTracker tracker;
+  std::vector<LineColumn> positions;
+  std::vector<LineColumn> marks;
+  for (size_t i = 0; i < 100; i++) {
+    positions.push_back(LineColumn(i, 3));
+    marks.push_back(LineColumn(i, 0));
+  }
+  auto cursors = SetCursors(&tracker, L"", positions);
+  SetCursors(&tracker, L"marks", marks);
+  tracker.SetCurrentCursor(cursors, LineColumn(50, 3));
+
+  tracker.ApplyTransformationToCursors(
+      cursors, [&tracker](LineColumn position) {
+        tracker.AdjustCursors(
+            Transformation().WithBegin(LineColumn(position.line)).AddToLine(1));
+        return LineColumn(position.line + 1, position.column);
+      });
+
+  std::vector<LineColumn> expected_cursors;
+  std::vector<LineColumn> expected_marks;
+  for (size_t i = 0; i < 100; i++) {
+    expected_cursors.push_back(LineColumn(2 * i + 1, 3));
+    expected_marks.push_back(LineColumn(2 * i + 1, 0));
+  }
+  CHECK(ToVector(*cursors) == expected_cursors);
+  CHECK(ToVector(*tracker.FindCursors(L"marks")) == expected_marks);
+  CHECK_EQ(tracker.position(), LineColumn(101, 3));
+}
+
+// Inserts a character at every cursor, with many cursors in the same line.
+void TestInsertCharacters() {
+  CursorsTracker tracker;
+  auto cursors = SetCursors(&tracker, L"",
+                            {LineColumn(0, 0), LineColumn(0, 2),
+                             LineColumn(0, 4), LineColumn(1, 1)});
+  tracker.SetCurrentCursor(cursors, LineColumn(0, 0));
+
+  tracker.ApplyTransformationToCursors(
+      cursors, [&tracker](LineColumn position) {
+        tracker.AdjustCursors(Transformation()
+                                  .WithBegin(position)
+                                  .WithEnd(LineColumn(position.line + 1))
+                                  .AddToColumn(1));
+        return LineColumn(position.line, position.column + 1);
+      });
+
+  CHECK(ToVector(*cursors) ==
+        std::vector<LineColumn>({LineColumn(0, 1), LineColumn(0, 4),
+                                 LineColumn(0, 7), LineColumn(1, 2)}));
+  CHECK_EQ(tracker.position(), LineColumn(0, 1));
+}
+
+// Deletes the line of every cursor. Cursors in deleted lines get clamped.
+void TestDeleteLines() {
+  CursorsTracker tracker;
+  std::vector<LineColumn> positions;
+  for (size_t i = 0; i < 10; i++) {
+    positions.push_back(LineColumn(i));
+  }
+  auto cursors = SetCursors(&tracker, L"", positions);
+  SetCursors(&tracker, L"marks", {LineColumn(5, 2), LineColumn(12, 1)});
+  tracker.SetCurrentCursor(cursors, LineColumn(3));
+
+  tracker.ApplyTransformationToCursors(
+      cursors, [&tracker](LineColumn position) {
+        tracker.AdjustCursors(Transformation()
+                                  .WithBegin(LineColumn(position.line))
+                                  .AddToLine(-1)
+                                  .OutputLineGe(position.line));
+        return LineColumn(position.line);
+      });
+
+  CHECK(ToVector(*cursors) == std::vector<LineColumn>(10, LineColumn(0)));
+  CHECK(ToVector(*tracker.FindCursors(L"marks")) ==
+        std::vector<LineColumn>({LineColumn(0, 2), LineColumn(2, 1)}));
+  CHECK_EQ(tracker.position(), LineColumn(0));
+}
+
+// Erases a line (as BufferContents::EraseLines does) just after a line with a
+// cursor past the columns of the cursors below it, which must end up before it.
+void TestEraseLinesKeepsOrder() {
+  CursorsTracker tracker;
+  auto marks = SetCursors(&tracker, L"marks",
+                          {LineColumn(5, 10), LineColumn(6, 2), LineColumn(7)});
+  tracker.AdjustCursors(Transformation()
+                            .WithBegin(LineColumn(5))
+                            .AddToLine(-1)
+                            .OutputLineGe(5));
+  auto positions = ToVector(*marks);
+  CHECK(std::is_sorted(positions.begin(), positions.end()));
+  CHECK(positions == std::vector<LineColumn>({LineColumn(5, 2),
+                                              LineColumn(5, 10),
+                                              LineColumn(6)}));
+  CHECK(marks->find(LineColumn(5, 2)) != marks->end());
+
+  // Cursors clamped to the same line can end up out of order among
+  // themselves.
+  marks = SetCursors(&tracker, L"marks",
+                     {LineColumn(3), LineColumn(6, 10), LineColumn(7, 2),
+                      LineColumn(8, 50)});
+  tracker.AdjustCursors(Transformation()
+                            .WithBegin(LineColumn(6))
+                            .AddToLine(-2)
+                            .OutputLineGe(6));
+  positions = ToVector(*marks);
+  CHECK(std::is_sorted(positions.begin(), positions.end()));
+  CHECK(positions == std::vector<LineColumn>({LineColumn(3), LineColumn(6, 2),
+                                              LineColumn(6, 10),
+                                              LineColumn(6, 50)}));
+  CHECK(marks->find(LineColumn(6, 2)) != marks->end());
+}
+
+// Clamps cursors that have already been processed to the same line, leaving
+// them out of order, and then adjusts a range that only contains one of them.
+void TestClampProcessedCursors() {
+  CursorsTracker tracker;
+  auto cursors = SetCursors(&tracker, L"", {LineColumn(3), LineColumn(6, 10),
+                                             LineColumn(7, 2),
+                                             LineColumn(8, 50)});
+  tracker.SetCurrentCursor(cursors, LineColumn(3));
+
+  tracker.ApplyTransformationToCursors(
+      cursors, [&tracker](LineColumn position) {
+        if (position.line == 3) {
+          tracker.AdjustCursors(Transformation()
+                                    .WithBegin(LineColumn(6))
+                                    .AddToLine(-2)
+                                    .OutputLineGe(6));
+          tracker.AdjustCursors(Transformation()
+                                    .WithBegin(LineColumn(6))
+                                    .WithEnd(LineColumn(6, 5))
+                                    .AddToColumn(1));
+        }
+        return position;
+      });
+
+  CHECK(ToVector(*cursors) ==
+        std::vector<LineColumn>({LineColumn(3), LineColumn(6, 3),
+                                 LineColumn(6, 10), LineColumn(6, 50)}));
+  CHECK_EQ(tracker.position(), LineColumn(3));
+}
+
+// Splits the line at every cursor, with the same transformations that
+// BufferContents::SplitLine produces.
+void TestSplitLines() {
+  CursorsTracker tracker;
+  auto cursors =
+      SetCursors(&tracker, L"", {LineColumn(0, 2), LineColumn(0, 5)});
+  tracker.SetCurrentCursor(cursors, LineColumn(0, 5));
+
+  tracker.ApplyTransformationToCursors(
+      cursors, [&tracker](LineColumn position) {
+        tracker.AdjustCursors(Transformation()
+                                  .WithBegin(LineColumn(position.line + 1))
+                                  .AddToLine(1));
+        tracker.AdjustCursors(Transformation()
+                                  .WithBegin(position)
+                                  .WithEnd(LineColumn(position.line + 1))
+                                  .AddToLine(1)
+                                  .AddToColumn(-position.column));
+        return LineColumn(position.line + 1);
+      });
+
+  CHECK(ToVector(*cursors) ==
+        std::vector<LineColumn>({LineColumn(1), LineColumn(2)}));
+  CHECK_EQ(tracker.position(), LineColumn(2));
+}
+}  // namespace
+
+void CursorsTests() {
+  LOG(INFO) << "Cursors tests: start.";
+  TestCursorsSetCurrentIndex();
+  TestCursorsSetLazyLines();
+  TestInsertLines();
+  TestInsertCharacters();
+  TestDeleteLines();
+  TestEraseLinesKeepsOrder();
+  TestClampProcessedCursors();
+  TestSplitLines();
+  LOG(INFO) << "Cursors tests: done.";
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
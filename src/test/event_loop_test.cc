@@ -0,0 +1,128 @@
+#include "src/test/event_loop_test.h"
+
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+#include "src/event_loop.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+struct Pipe {
+  Pipe() {
+    int fds[2];
+    CHECK_NE(pipe2(fds, O_NONBLOCK), -1);
+    read_fd = fds[0];
+    write_fd = fds[1];
+  }
+
+  ~Pipe() {
+    close(read_fd);
+    close(write_fd);
+  }
+
+  void Write() { CHECK_EQ(write(write_fd, "x", 1), 1); }
+
+  void Drain() {
+    char buffer[64];
+    while (read(read_fd, buffer, sizeof(buffer)) > 0) continue;
+  }
+
+  int read_fd;
+  int write_fd;
+};
+
+void TestOnlyReadyCallbacksRun() {
+  EventLoop loop;
+  Pipe idle;
+  Pipe ready;
+  int idle_calls = 0;
+  int ready_calls = 0;
+  auto idle_registration =
+      loop.Register(idle.read_fd, [&idle_calls]() { idle_calls++; });
+  auto ready_registration = loop.Register(ready.read_fd, [&]() {
+    ready_calls++;
+    ready.Drain();
+  });
+  CHECK_EQ(loop.size(), 2u);
+  CHECK_EQ(loop.Wait(0), 0);
+
+  ready.Write();
+  CHECK_EQ(loop.Wait(1000), 1);
+  CHECK_EQ(ready_calls, 1);
+  CHECK_EQ(idle_calls, 0);
+  CHECK_EQ(loop.Wait(0), 0);
+
+  // Unregistered file descriptors are ignored.
+  ready_registration = nullptr;
+  CHECK_EQ(loop.size(), 1u);
+  ready.Write();
+  CHECK_EQ(loop.Wait(0), 0);
+  CHECK_EQ(ready_calls, 1);
+}
+
+void TestCallbackUnregisters() {
+  EventLoop loop;
+  Pipe first;
+  Pipe second;
+  std::unique_ptr<EventLoop::Registration> first_registration;
+  std::unique_ptr<EventLoop::Registration> second_registration;
+  int calls = 0;
+  // Whichever runs first unregisters both.
+  auto callback = [&]() {
+    calls++;
+    first_registration = nullptr;
+    second_registration = nullptr;
+  };
+  first_registration = loop.Register(first.read_fd, callback);
+  second_registration = loop.Register(second.read_fd, callback);
+  first.Write();
+  second.Write();
+  CHECK_EQ(loop.Wait(1000), 1);
+  CHECK_EQ(calls, 1);
+  CHECK_EQ(loop.size(), 0u);
+}
+
+void TestRegularFileIsAlwaysReady() {
+  char path[] = "/tmp/edge_event_loop_test_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK_NE(fd, -1);
+  unlink(path);
+  EventLoop loop;
+  int calls = 0;
+  auto registration = loop.Register(fd, [&calls]() { calls++; });
+  CHECK_EQ(loop.Wait(1000), 1);
+  CHECK_EQ(loop.Wait(1000), 1);
+  CHECK_EQ(calls, 2);
+  registration = nullptr;
+  close(fd);
+}
+
+void TestRegistrationOutlivesLoop() {
+  Pipe input;
+  std::unique_ptr<EventLoop::Registration> registration;
+  {
+    EventLoop loop;
+    registration = loop.Register(input.read_fd, []() {});
+  }
+  registration = nullptr;
+}
+}  // namespace
+
+void EventLoopTests() {
+  LOG(INFO) << "EventLoop tests: start.";
+  TestOnlyReadyCallbacksRun();
+  TestCallbackUnregisters();
+  TestRegularFileIsAlwaysReady();
+  TestRegistrationOutlivesLoop();
+  LOG(INFO) << "EventLoop tests: done.";
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
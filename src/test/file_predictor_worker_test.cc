@@ -0,0 +1,174 @@
+#include "src/test/file_predictor_worker_test.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+#include "src/directory_cache.h"
+#include "src/file_predictor_worker.h"
+#include "src/wstring.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+// A temporary directory, deleted (along with the files and directories
+// created through it) when the instance is deleted.
+class TemporaryDirectory {
+ public:
+  TemporaryDirectory() {
+    char path[] = "/tmp/edge-test-XXXXXX";
+    CHECK(mkdtemp(path) != nullptr);
+    path_ = FromByteString(path);
+  }
+
+  ~TemporaryDirectory() {
+    for (auto it = paths_.rbegin(); it != paths_.rend(); ++it) {
+      remove(ToByteString(*it).c_str());
+    }
+    rmdir(ToByteString(path_).c_str());
+  }
+
+  const wstring& path() const { return path_; }
+
+  void CreateFile(const wstring& name) {
+    wstring file = path_ + L"/" + name;
+    int fd = open(ToByteString(file).c_str(), O_CREAT | O_WRONLY, 0600);
+    CHECK_NE(fd, -1);
+    close(fd);
+    paths_.push_back(file);
+  }
+
+  void CreateDirectory(const wstring& name) {
+    wstring directory = path_ + L"/" + name;
+    CHECK_NE(mkdir(ToByteString(directory).c_str(), 0700), -1);
+    paths_.push_back(directory);
+  }
+
+  // Sets the modification time of a directory far enough in the past that
+  // DirectoryCache trusts it.
+  void Age(const wstring& name) {
+    struct timeval times[2];
+    gettimeofday(&times[0], nullptr);
+    times[0].tv_sec -= 100;
+    times[1] = times[0];
+    CHECK_NE(utimes(ToByteString(path_ + name).c_str(), times), -1);
+  }
+
+ private:
+  wstring path_;
+  std::vector<wstring> paths_;
+};
+
+void TestDirectoryCacheValidation() {
+  TemporaryDirectory directory;
+  directory.CreateFile(L"a.cc");
+  directory.CreateDirectory(L"src");
+  DirectoryCache cache;
+
+  // Recently modified: not trusted.
+  auto listing = cache.Get(directory.path());
+  CHECK(listing->exists);
+  CHECK_EQ(listing->entries.size(), 2u);
+  CHECK(!cache.Contains(directory.path()));
+
+  directory.Age(L"");
+  cache.Get(directory.path());
+  CHECK(cache.Contains(directory.path()));
+  size_t reads = cache.directories_read();
+  listing = cache.Get(directory.path());
+  CHECK_EQ(cache.directories_read(), reads);
+  for (const auto& entry : listing->entries) {
+    CHECK_EQ(entry.is_directory, entry.name == L"src");
+  }
+
+  // Adding a file changes the modification time.
+  directory.CreateFile(L"b.cc");
+  CHECK(!cache.Contains(directory.path()));
+  CHECK_EQ(cache.Get(directory.path())->entries.size(), 3u);
+
+  CHECK(!cache.Get(directory.path() + L"/missing")->exists);
+}
+
+void TestWorkerPredicts() {
+  TemporaryDirectory directory;
+  directory.CreateFile(L"Buffer.cc");
+  directory.CreateFile(L"buffer.h");
+  directory.CreateFile(L"editor.cc");
+  directory.CreateDirectory(L"bin");
+  directory.CreateFile(L"bin/tool");
+  directory.Age(L"");
+  directory.Age(L"/bin");
+
+  std::atomic<size_t> notifications(0);
+  FilePredictorWorker worker([&notifications]() { notifications++; });
+  CHECK(!worker.Publish());
+
+  FilePredictorWorker::Query query;
+  query.directory = directory.path();
+  query.prefix = L"b";
+  query.output_prefix = directory.path() + L"/";
+  query.search_path = directory.path();
+  // The same directory twice: the predictions are deduplicated.
+  std::vector<FilePredictorWorker::Query> queries = {query, query};
+  std::vector<wstring> predictions;
+  worker.Predict(queries, [&predictions](std::vector<wstring> output) {
+    predictions = std::move(output);
+  });
+  worker.WaitForIdle();
+  CHECK_EQ(notifications.load(), 1u);
+  CHECK(predictions.empty());
+  CHECK(worker.Publish());
+  // Like the prefix of the path, the prefix of the names is case-sensitive.
+  CHECK(predictions == std::vector<wstring>({L"bin/", L"buffer.h"}));
+  CHECK(!worker.Publish());
+
+  // The subdirectories among the predictions were read ahead.
+  CHECK(worker.directory_cache()->Contains(directory.path() + L"/bin"));
+}
+
+void TestWorkerCancel() {
+  TemporaryDirectory directory;
+  directory.CreateFile(L"a.cc");
+  FilePredictorWorker worker([]() {});
+  FilePredictorWorker::Query query;
+  query.directory = directory.path();
+
+  bool called = false;
+  worker.Predict({query}, [&called](std::vector<wstring>) { called = true; });
+  worker.WaitForIdle();
+  worker.Cancel();
+  CHECK(!worker.Publish());
+  CHECK(!called);
+
+  // A new request replaces the outstanding one.
+  std::vector<wstring> predictions;
+  worker.Predict({query}, [&called](std::vector<wstring>) { called = true; });
+  query.prefix = L"x";
+  worker.Predict({query}, [&predictions](std::vector<wstring> output) {
+    predictions = std::move(output);
+    predictions.push_back(L"done");
+  });
+  worker.WaitForIdle();
+  CHECK(worker.Publish());
+  CHECK(!called);
+  CHECK(predictions == std::vector<wstring>({L"done"}));
+}
+}  // namespace
+
+void FilePredictorWorkerTests() {
+  TestDirectoryCacheValidation();
+  TestWorkerPredicts();
+  TestWorkerCancel();
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
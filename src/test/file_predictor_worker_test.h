@@ -0,0 +1,12 @@
+#ifndef __AFC_EDITOR_TEST_FILE_PREDICTOR_WORKER_TEST_H__
+#define __AFC_EDITOR_TEST_FILE_PREDICTOR_WORKER_TEST_H__
+
+namespace afc {
+namespace editor {
+namespace testing {
+void FilePredictorWorkerTests();
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_TEST_FILE_PREDICTOR_WORKER_TEST_H__
@@ -0,0 +1,146 @@
+#include "src/test/line_filter_test.h"
+
+#include <glog/logging.h>
+
+#include "src/buffer_contents.h"
+#include "src/char_buffer.h"
+#include "src/line_filter.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+// Contents with the given number of lines, reporting their changes to filter.
+class FilteredContents {
+ public:
+  FilteredContents(size_t lines) {
+    contents.AddLinesListener(
+        [this](size_t first, size_t old_count, size_t new_count) {
+          filter.LinesReplaced(first, old_count, new_count);
+        });
+    for (size_t i = 0; i < lines; i++) {
+      contents.push_back(std::to_wstring(i));
+    }
+  }
+
+  bool IsShown(size_t line) { return filter.IsShown(contents, line); }
+
+  BufferContents contents;
+  LineFilter filter;
+};
+
+bool IsEven(const wstring& line) { return std::stoi(line) % 2 == 0; }
+
+void TestNoFilter() {
+  FilteredContents test(10);
+  CHECK(!test.filter.active());
+  for (size_t i = 0; i < 10; i++) {
+    CHECK(test.IsShown(i));
+  }
+  CHECK_EQ(test.filter.evaluated_lines(), 0u);
+}
+
+void TestEvaluatesBlocks() {
+  for (bool thread_safe : {false, true}) {
+    FilteredContents test(100000);
+    size_t calls = 0;
+    test.filter.Set(
+        [&calls, thread_safe](const wstring& line) {
+          if (!thread_safe) {
+            calls++;
+          }
+          return IsEven(line);
+        },
+        thread_safe);
+    CHECK(test.IsShown(0));
+    CHECK(!test.IsShown(1));
+    CHECK(test.IsShown(99998));
+    CHECK(!test.IsShown(99999));
+    // Only the blocks around the lines requested are evaluated.
+    size_t evaluated = test.filter.evaluated_lines();
+    CHECK_GT(evaluated, 0u);
+    CHECK_LT(evaluated, 100000u);
+    if (!thread_safe) {
+      CHECK_EQ(calls, evaluated);
+    }
+    for (size_t i = 0; i < 100; i++) {
+      CHECK_EQ(test.IsShown(i), i % 2 == 0);
+    }
+    CHECK_EQ(test.filter.evaluated_lines(), evaluated);
+  }
+}
+
+void TestSetDiscardsResults() {
+  FilteredContents test(10);
+  test.filter.Set(IsEven, true);
+  CHECK(!test.IsShown(3));
+  size_t version = test.filter.version();
+  test.filter.Set([](const wstring& line) { return !IsEven(line); }, true);
+  CHECK_GT(test.filter.version(), version);
+  CHECK(test.IsShown(3));
+  test.filter.Clear();
+  CHECK(test.IsShown(4));
+  CHECK_EQ(test.filter.evaluated_lines(), 0u);
+}
+
+void TestLinesReplaced() {
+  FilteredContents test(10);
+  test.filter.Set(IsEven, true);
+  CHECK(test.IsShown(0));
+  CHECK_EQ(test.filter.evaluated_lines(), 10u);
+
+  // Lines shift: "4" is now at position 2.
+  test.contents.EraseLines(0, 2);
+  CHECK_EQ(test.filter.evaluated_lines(), 8u);
+  CHECK(test.IsShown(2));
+  CHECK(!test.IsShown(3));
+
+  // Only the replaced line is evaluated again.
+  test.contents.set_line(3, std::make_shared<Line>(L"20"));
+  CHECK_EQ(test.filter.evaluated_lines(), 7u);
+  CHECK(test.IsShown(3));
+  CHECK_EQ(test.filter.evaluated_lines(), 8u);
+
+  test.contents.insert_line(0, std::make_shared<Line>(L"7"));
+  CHECK(!test.IsShown(0));
+  CHECK(test.IsShown(3));
+  CHECK(test.IsShown(4));
+
+  test.contents.push_back(L"11");
+  CHECK(!test.IsShown(test.contents.size() - 1));
+}
+
+void TestLinesReplacedWithoutFilter() {
+  FilteredContents test(10);
+  test.filter.Set(IsEven, true);
+  CHECK(test.IsShown(0));
+  test.filter.Clear();
+
+  // Changes while no filter is set don't need to be tracked...
+  test.contents.EraseLines(0, 1);
+  test.contents.insert_line(5, std::make_shared<Line>(L"7"));
+  CHECK(test.IsShown(0));
+  CHECK_EQ(test.filter.evaluated_lines(), 0u);
+
+  // ... but are reflected once one is set.
+  test.filter.Set(IsEven, true);
+  CHECK(!test.IsShown(0));
+  CHECK(test.IsShown(1));
+  CHECK(!test.IsShown(5));
+  CHECK(!test.IsShown(9));
+}
+}  // namespace
+
+void LineFilterTests() {
+  LOG(INFO) << "LineFilter tests: start.";
+  TestNoFilter();
+  TestEvaluatesBlocks();
+  TestSetDiscardsResults();
+  TestLinesReplaced();
+  TestLinesReplacedWithoutFilter();
+  LOG(INFO) << "LineFilter tests: done.";
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
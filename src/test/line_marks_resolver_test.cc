@@ -0,0 +1,179 @@
+#include "src/test/line_marks_resolver_test.h"
+
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+#include "src/char_buffer.h"
+#include "src/line_marks.h"
+#include "src/line_marks_resolver.h"
+#include "src/path_cache.h"
+#include "src/wstring.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+// A temporary directory, deleted (along with the files created through it)
+// when the instance is deleted.
+class TemporaryDirectory {
+ public:
+  TemporaryDirectory() {
+    char path[] = "/tmp/edge-test-XXXXXX";
+    CHECK(mkdtemp(path) != nullptr);
+    path_ = FromByteString(path);
+  }
+
+  ~TemporaryDirectory() {
+    for (auto& file : files_) {
+      unlink(ToByteString(file).c_str());
+    }
+    rmdir(ToByteString(path_).c_str());
+  }
+
+  const wstring& path() const { return path_; }
+
+  wstring CreateFile(const wstring& name) {
+    wstring file = path_ + L"/" + name;
+    int fd = open(ToByteString(file).c_str(), O_CREAT | O_WRONLY, 0600);
+    CHECK_NE(fd, -1);
+    close(fd);
+    files_.push_back(file);
+    return file;
+  }
+
+ private:
+  wstring path_;
+  std::vector<wstring> files_;
+};
+
+void TestPathCacheResolves() {
+  TemporaryDirectory directory;
+  wstring file = directory.CreateFile(L"a.cc");
+  PathCache cache;
+  CHECK(cache.Resolve(file) == file);
+  CHECK(cache.Resolve(directory.path() + L"/b.cc").empty());
+  CHECK(cache.Resolve(directory.path() + L"/missing/a.cc").empty());
+  CHECK(cache.Resolve(directory.path() + L"/") == directory.path() + L"/");
+}
+
+void TestPathCacheAvoidsStats() {
+  TemporaryDirectory directory;
+  wstring file = directory.CreateFile(L"a.cc");
+  PathCache cache;
+  CHECK(cache.Resolve(file) == file);
+  CHECK(cache.Resolve(directory.path() + L"/b.cc").empty());
+  size_t stat_calls = cache.stat_calls();
+  for (int i = 0; i < 10; i++) {
+    CHECK(cache.Resolve(file) == file);
+    CHECK(cache.Resolve(directory.path() + L"/b.cc").empty());
+  }
+  CHECK_EQ(cache.stat_calls(), stat_calls);
+
+  // A single stat for all the files in a directory that doesn't exist.
+  for (int i = 0; i < 10; i++) {
+    CHECK(cache.Resolve(directory.path() + L"/missing/" +
+                        std::to_wstring(i) + L".cc")
+              .empty());
+  }
+  CHECK_EQ(cache.stat_calls(), stat_calls + 1);
+}
+
+void TestPathCacheNoticesNewFiles() {
+  TemporaryDirectory directory;
+  PathCache cache;
+  CHECK(cache.Resolve(directory.path() + L"/a.cc").empty());
+  wstring file = directory.CreateFile(L"a.cc");
+  cache.NewGeneration();
+  CHECK(cache.Resolve(file) == file);
+}
+
+LineMarksResolver::Line NewLine(size_t source_line, wstring contents) {
+  LineMarksResolver::Line line;
+  line.source_line = source_line;
+  line.contents = std::move(contents);
+  return line;
+}
+
+void TestResolverPublishesMarks() {
+  TemporaryDirectory directory;
+  wstring file = directory.CreateFile(L"a.cc");
+  int notifications = 0;
+  LineMarksResolver resolver([&notifications]() { notifications++; });
+  LineMarks marks;
+  CHECK(!resolver.Publish(&marks));
+
+  resolver.Resolve(L"make", {L"", directory.path()},
+                   {NewLine(0, L"a.cc:12: error: foo"),
+                    NewLine(1, L"Compilation failed."),
+                    NewLine(2, file + L":3")});
+  resolver.WaitForIdle();
+  CHECK_EQ(notifications, 1);
+  CHECK(resolver.Publish(&marks));
+  const auto& a = marks.GetMarksForTargetBuffer(file);
+  CHECK_EQ(a.size(), 2u);
+  CHECK_EQ(a.begin()->first, 2u);
+  CHECK_EQ(a.begin()->second.source_line, 2u);
+  CHECK_EQ(a.rbegin()->first, 11u);
+  CHECK_EQ(a.rbegin()->second.source_line, 0u);
+  CHECK(a.rbegin()->second.source == L"make");
+  CHECK(!resolver.Publish(&marks));
+}
+
+void TestResolverCancel() {
+  TemporaryDirectory directory;
+  wstring file = directory.CreateFile(L"a.cc");
+  LineMarksResolver resolver([]() {});
+  LineMarks marks;
+  resolver.Resolve(L"make", {}, {NewLine(0, file)});
+  resolver.Resolve(L"grep", {}, {NewLine(0, file + L":2")});
+  resolver.Cancel(L"make");
+  resolver.WaitForIdle();
+  resolver.Publish(&marks);
+  const auto& a = marks.GetMarksForTargetBuffer(file);
+  CHECK_EQ(a.size(), 1u);
+  CHECK(a.begin()->second.source == L"grep");
+}
+
+void TestResolverEndOfSource() {
+  TemporaryDirectory directory;
+  wstring file = directory.CreateFile(L"a.cc");
+  LineMarksResolver resolver([]() {});
+  LineMarks marks;
+  LineMarks::Mark expired;
+  expired.source = L"make";
+  expired.source_line = 0;
+  expired.target_buffer = file;
+  expired.target = LineColumn(7);
+  expired.source_line_content = NewCopyString(L"a.cc:8");
+  marks.AddMark(expired);
+
+  resolver.Resolve(L"make", {}, {NewLine(0, file + L":5")});
+  resolver.EndOfSource(L"make");
+  resolver.WaitForIdle();
+  CHECK_EQ(marks.GetMarksForTargetBuffer(file).size(), 1u);
+  resolver.Publish(&marks);
+  const auto& a = marks.GetMarksForTargetBuffer(file);
+  CHECK_EQ(a.size(), 1u);
+  CHECK_EQ(a.begin()->first, 4u);
+  CHECK(!a.begin()->second.IsExpired());
+}
+}  // namespace
+
+void LineMarksResolverTests() {
+  LOG(INFO) << "LineMarksResolver tests: start.";
+  TestPathCacheResolves();
+  TestPathCacheAvoidsStats();
+  TestPathCacheNoticesNewFiles();
+  TestResolverPublishesMarks();
+  TestResolverCancel();
+  TestResolverEndOfSource();
+  LOG(INFO) << "LineMarksResolver tests: done.";
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
@@ -0,0 +1,95 @@
+#include "src/test/line_marks_test.h"
+
+#include <glog/logging.h>
+
+#include "src/audio.h"
+#include "src/buffer.h"
+#include "src/char_buffer.h"
+#include "src/editor.h"
+#include "src/line_marks.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+LineMarks::Mark NewMark(std::wstring source, size_t source_line,
+                        std::wstring target_buffer, size_t line) {
+  LineMarks::Mark mark;
+  mark.source = std::move(source);
+  mark.source_line = source_line;
+  mark.target_buffer = std::move(target_buffer);
+  mark.target = LineColumn(line);
+  return mark;
+}
+
+void TestMarksByTarget() {
+  LineMarks marks;
+  CHECK(marks.GetMarksForTargetBuffer(L"a.cc").empty());
+  marks.AddMark(NewMark(L"make", 0, L"a.cc", 10));
+  marks.AddMark(NewMark(L"make", 1, L"b.cc", 20));
+  marks.AddMark(NewMark(L"grep", 0, L"a.cc", 5));
+
+  const auto& a = marks.GetMarksForTargetBuffer(L"a.cc");
+  CHECK_EQ(a.size(), 2u);
+  CHECK(a.begin()->second.source == L"grep");
+  CHECK_EQ(a.begin()->first, 5u);
+  CHECK_EQ(marks.GetMarksForTargetBuffer(L"b.cc").size(), 1u);
+
+  marks.AddMark(NewMark(L"make", 2, L"a.cc", 30));
+  CHECK_EQ(marks.GetMarksForTargetBuffer(L"a.cc").size(), 3u);
+  CHECK_EQ(marks.GetExpiredMarksCount(L"a.cc"), 0u);
+}
+
+void TestExpireAndRemove() {
+  auto audio_player = NewNullAudioPlayer();
+  EditorState editor_state(audio_player.get());
+  OpenBuffer make(&editor_state, L"make");
+  make.AppendToLastLine(&editor_state, NewCopyString(L"a.cc:10: error"));
+
+  LineMarks marks;
+  marks.AddMark(NewMark(L"make", 0, L"a.cc", 10));
+  marks.AddMark(NewMark(L"make", 1, L"b.cc", 20));
+  marks.AddMark(NewMark(L"grep", 0, L"a.cc", 5));
+
+  marks.ExpireMarksFromSource(make, L"make");
+  CHECK_EQ(marks.GetExpiredMarksCount(L"a.cc"), 1u);
+  CHECK_EQ(marks.GetExpiredMarksCount(L"b.cc"), 1u);
+  const auto& a = marks.GetMarksForTargetBuffer(L"a.cc");
+  auto expired = a.find(10);
+  CHECK(expired != a.end());
+  CHECK(expired->second.IsExpired());
+  CHECK(expired->second.source_line_content->ToString() == L"a.cc:10: error");
+  CHECK(!a.find(5)->second.IsExpired());
+
+  // Expiring again doesn't change anything.
+  marks.ExpireMarksFromSource(make, L"make");
+  CHECK_EQ(marks.GetExpiredMarksCount(L"a.cc"), 1u);
+
+  // New marks from the source are fresh and survive the removal.
+  marks.AddMark(NewMark(L"make", 0, L"a.cc", 11));
+  marks.RemoveExpiredMarksFromSource(L"make");
+  const auto& updated = marks.GetMarksForTargetBuffer(L"a.cc");
+  CHECK_EQ(marks.GetExpiredMarksCount(L"a.cc"), 0u);
+  CHECK_EQ(updated.size(), 2u);
+  CHECK(updated.find(10) == updated.end());
+  CHECK(updated.find(11) != updated.end());
+  CHECK(marks.GetMarksForTargetBuffer(L"b.cc").empty());
+
+  // Removing only affects the given source.
+  marks.ExpireMarksFromSource(make, L"grep");
+  marks.RemoveExpiredMarksFromSource(L"grep");
+  CHECK_EQ(updated.size(), 1u);
+  CHECK(updated.begin()->second.source == L"make");
+}
+}  // namespace
+
+void LineMarksTests() {
+  LOG(INFO) << "LineMarks tests: start.";
+  TestMarksByTarget();
+  TestExpireAndRemove();
+  LOG(INFO) << "LineMarks tests: done.";
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
@@ -0,0 +1,84 @@
+#include "src/test/line_output_cache_test.h"
+
+#include <memory>
+
+#include <glog/logging.h>
+
+#include "src/line_output_cache.h"
+#include "src/wstring.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+void TestRecorderReplay() {
+  LineOutputRecorder recorder;
+  recorder.AddModifier(LineModifier::BOLD);
+  recorder.AddCharacter(L'a');
+  recorder.AddString(L"lejandro");
+  recorder.AddModifier(LineModifier::RESET);
+  recorder.AddString(L"\n");
+  auto segments = recorder.TakeSegments();
+  CHECK_EQ(segments.size(), 4u);
+
+  LineOutputRecorder copy;
+  LineOutputRecorder::Replay(segments, &copy);
+  auto copied_segments = copy.TakeSegments();
+  CHECK_EQ(copied_segments.size(), 4u);
+  CHECK_EQ(copied_segments[0].modifier, LineModifier::BOLD);
+  CHECK_EQ(ToByteString(copied_segments[1].str), "alejandro");
+  CHECK_EQ(copied_segments[2].modifier, LineModifier::RESET);
+  CHECK_EQ(ToByteString(copied_segments[3].str), "\n");
+}
+
+void TestCacheLookups() {
+  LineOutputCache cache;
+  LineOutputCache::Key key;
+  key.line = std::make_shared<Line>(L"alejandro");
+  key.width = 80;
+  CHECK(cache.Find(key) == nullptr);
+
+  LineOutputCache::Entry entry;
+  entry.output_column = 9;
+  cache.Insert(key, std::move(entry));
+  CHECK(cache.Find(key) != nullptr);
+  CHECK_EQ(cache.Find(key)->output_column, 9u);
+
+  auto other_width = key;
+  other_width.width = 40;
+  CHECK(cache.Find(other_width) == nullptr);
+
+  // A different (but equal) line is a different key.
+  auto other_line = key;
+  other_line.line = std::make_shared<Line>(L"alejandro");
+  CHECK(cache.Find(other_line) == nullptr);
+
+  CHECK_EQ(cache.stats().hits, 2u);
+  CHECK_EQ(cache.stats().misses, 3u);
+}
+
+void TestCacheEviction() {
+  LineOutputCache cache;
+  LineOutputCache::Key key;
+  key.line = std::make_shared<Line>(L"forero");
+  cache.Insert(key, LineOutputCache::Entry());
+  cache.FinishFrame();
+  CHECK(cache.Find(key) != nullptr);
+  cache.FinishFrame();
+  cache.FinishFrame();
+  cache.FinishFrame();
+  CHECK_EQ(cache.size(), 0u);
+}
+}  // namespace
+
+void LineOutputCacheTests() {
+  LOG(INFO) << "LineOutputCache tests: start.";
+  TestRecorderReplay();
+  TestCacheLookups();
+  TestCacheEviction();
+  LOG(INFO) << "LineOutputCache tests: done.";
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
@@ -22,15 +22,17 @@ void CheckSingleton(C const container, V value) {
 
 void TestLineDeleteCharacters() {
   // Preparation.
-  Line line(Line::Options(NewCopyCharBuffer(L"alejo")));
-  line.modifiers()[0].insert(LineModifier::RED);
-  line.modifiers()[1].insert(LineModifier::GREEN);
-  line.modifiers()[2].insert(LineModifier::BLUE);
-  line.modifiers()[3].insert(LineModifier::BOLD);
-  line.modifiers()[4].insert(LineModifier::DIM);
+  LineBuilder builder(Line(Line::Options(NewCopyCharBuffer(L"alejo"))));
+  builder.modifiers()[0].insert(LineModifier::RED);
+  builder.modifiers()[1].insert(LineModifier::GREEN);
+  builder.modifiers()[2].insert(LineModifier::BLUE);
+  builder.modifiers()[3].insert(LineModifier::BOLD);
+  builder.modifiers()[4].insert(LineModifier::DIM);
+  auto line_ptr = builder.Build();
+  const Line& line = *line_ptr;
 
   {
-    Line line_copy(line);
+    LineBuilder line_copy(line);
     line_copy.DeleteCharacters(2);
     CHECK_EQ(ToByteString(line_copy.contents()->ToString()), "al");
     CHECK_EQ(line_copy.modifiers().size(), 2);
@@ -39,7 +41,7 @@ void TestLineDeleteCharacters() {
   }
 
   {
-    Line line_copy(line);
+    LineBuilder line_copy(line);
     line_copy.DeleteCharacters(1, 2);
     CHECK_EQ(ToByteString(line_copy.contents()->ToString()), "ajo");
     CHECK_EQ(line_copy.modifiers().size(), 3);
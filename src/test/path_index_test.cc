@@ -0,0 +1,124 @@
+#include "src/test/path_index_test.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+#include "src/path_crawler.h"
+#include "src/path_index.h"
+#include "src/wstring.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+void TestScore() {
+  CHECK_EQ(PathIndex::Score(L"", L"src/buffer.cc"), 0);
+  CHECK_EQ(PathIndex::Score(L"xyz", L"src/buffer.cc"), -1);
+  // The characters must appear in order.
+  CHECK_EQ(PathIndex::Score(L"cfb", L"src/buffer.cc"), -1);
+  CHECK_GE(PathIndex::Score(L"BUF", L"src/buffer.cc"), 0);
+  CHECK_GE(PathIndex::Score(L"sbcc", L"src/buffer.cc"), 0);
+
+  // Consecutive matches in the basename beat scattered matches.
+  CHECK_GT(PathIndex::Score(L"buffer", L"src/buffer.cc"),
+           PathIndex::Score(L"buffer", L"b/u/f/f/e/r.cc"));
+  CHECK_GT(PathIndex::Score(L"buffer", L"src/buffer.cc"),
+           PathIndex::Score(L"buffer", L"buffer/src.cc"));
+  // Matches at the start of words beat matches inside them.
+  CHECK_GT(PathIndex::Score(L"lpm", L"src/line_prompt_mode.cc"),
+           PathIndex::Score(L"lpm", L"src/helper_impl.cc"));
+  CHECK_GT(PathIndex::Score(L"lpm", L"src/LinePromptMode.cc"),
+           PathIndex::Score(L"lpm", L"src/helper_impl.cc"));
+  // The earliest match (in "build") isn't the best one.
+  CHECK_EQ(PathIndex::Score(L"buffer", L"src/build/buffer.cc"),
+           PathIndex::Score(L"buffer", L"buffer.cc"));
+}
+
+void TestFind() {
+  PathIndex index({L"src/buffer.cc", L"src/buffer.h", L"src/buffer_contents.cc",
+                   L"README", L"src/test/buffer_test.cc", L"src/buffer.cc"});
+  CHECK_EQ(index.size(), 5u);
+  CHECK(index.path(0) == L"README");
+
+  auto matches = index.Find(L"bufcc", 10);
+  CHECK_EQ(matches.size(), 3u);
+  CHECK(matches[0] == L"src/buffer.cc");
+  CHECK_EQ(index.Find(L"bufcc", 1).size(), 1u);
+  CHECK(index.Find(L"zzz", 10).empty());
+
+  // Ties are broken by length (and then alphabetically).
+  CHECK(PathIndex({L"a/bb/x.cc", L"a/x.cc", L"b/x.cc"}).Find(L"x", 10) ==
+        std::vector<wstring>({L"a/x.cc", L"b/x.cc", L"a/bb/x.cc"}));
+  CHECK(PathIndex(std::vector<wstring>()).Find(L"x", 10).empty());
+}
+
+void CreateFile(const std::string& path) {
+  int fd = open(path.c_str(), O_CREAT | O_WRONLY, 0600);
+  CHECK_NE(fd, -1);
+  close(fd);
+}
+
+void TestCrawler() {
+  char root[] = "/tmp/edge-test-XXXXXX";
+  CHECK(mkdtemp(root) != nullptr);
+  std::string path = root;
+  std::vector<std::string> directories = {"/src", "/src/test", "/.git",
+                                          "/build", "/docs"};
+  std::vector<std::string> files = {
+      "/README", "/src/buffer.cc", "/src/test/buffer_test.cc",
+      "/.git/config", "/build/buffer.o", "/docs/buffer.md"};
+  for (const auto& directory : directories) {
+    CHECK_NE(mkdir((path + directory).c_str(), 0700), -1);
+  }
+  for (const auto& file : files) {
+    CreateFile(path + file);
+  }
+
+  PathCrawler crawler;
+  CHECK_EQ(crawler.index()->size(), 0u);
+  crawler.Crawl(FromByteString(path), {L".git", L"*.o", L"docs/*"});
+  crawler.WaitForIdle();
+  CHECK(!crawler.crawling());
+  CHECK(crawler.index()->Find(L"", 10) ==
+        std::vector<wstring>(
+            {L"README", L"src/buffer.cc", L"src/test/buffer_test.cc"}));
+
+  // Crawling again picks up new files.
+  files.push_back("/src/test/new_test.cc");
+  CreateFile(path + files.back());
+  crawler.Crawl(FromByteString(path), {L".git", L"*.o", L"docs/*"});
+  crawler.WaitForIdle();
+  CHECK_EQ(crawler.index()->size(), 4u);
+  CHECK(crawler.index()->Find(L"new", 10) ==
+        std::vector<wstring>({L"src/test/new_test.cc"}));
+
+  // The index of another root isn't used.
+  crawler.Crawl(FromByteString(path + "/src"), {});
+  crawler.WaitForIdle();
+  CHECK_EQ(crawler.index()->size(), 3u);
+
+  for (auto it = files.rbegin(); it != files.rend(); ++it) {
+    unlink((path + *it).c_str());
+  }
+  for (auto it = directories.rbegin(); it != directories.rend(); ++it) {
+    rmdir((path + *it).c_str());
+  }
+  rmdir(root);
+}
+}  // namespace
+
+void PathIndexTests() {
+  TestScore();
+  TestFind();
+  TestCrawler();
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
@@ -0,0 +1,69 @@
+#include "src/test/redraw_scheduler_test.h"
+
+#include <glog/logging.h>
+
+#include "src/redraw_scheduler.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+using Clock = RedrawScheduler::Clock;
+using std::chrono::milliseconds;
+
+RedrawScheduler::Options TestOptions() {
+  RedrawScheduler::Options options;
+  options.max_fps = 10;  // One frame every 100ms.
+  options.input_latency = milliseconds(5);
+  return options;
+}
+
+void TestOutputRedrawsAreCoalesced() {
+  RedrawScheduler scheduler(TestOptions());
+  Clock::time_point start;
+  CHECK(scheduler.FrameDue(start));
+  scheduler.FrameDrawn(start);
+  CHECK(!scheduler.FrameDue(start));
+  CHECK_EQ(scheduler.PollTimeoutMs(start, 1000), 1000);
+  CHECK_EQ(scheduler.PollTimeoutMs(start, -1), -1);
+
+  for (int i = 0; i < 50; i++) {
+    scheduler.RedrawRequested();
+    CHECK(!scheduler.FrameDue(start + milliseconds(i)));
+  }
+  CHECK_EQ(scheduler.PollTimeoutMs(start + milliseconds(40), 1000), 60);
+  CHECK(scheduler.FrameDue(start + milliseconds(100)));
+  scheduler.FrameDrawn(start + milliseconds(100));
+
+  CHECK_EQ(scheduler.stats().frames_drawn, 2u);
+  CHECK_EQ(scheduler.stats().frames_dropped, 49u);
+  CHECK_EQ(scheduler.stats().input_frames, 0u);
+}
+
+void TestInputHasPriority() {
+  RedrawScheduler scheduler(TestOptions());
+  Clock::time_point start;
+  scheduler.FrameDrawn(start);
+  scheduler.RedrawRequested();
+  scheduler.InputReceived(start + milliseconds(10));
+  CHECK(!scheduler.FrameDue(start + milliseconds(12)));
+  CHECK_EQ(scheduler.PollTimeoutMs(start + milliseconds(12), 1000), 3);
+  CHECK_EQ(scheduler.PollTimeoutMs(start + milliseconds(12), -1), 3);
+  CHECK(scheduler.FrameDue(start + milliseconds(15)));
+  scheduler.FrameDrawn(start + milliseconds(16));
+  CHECK_EQ(scheduler.stats().input_frames, 1u);
+  CHECK(scheduler.stats().input_latency_max == milliseconds(6));
+  CHECK(!scheduler.redraw_pending());
+}
+}  // namespace
+
+void RedrawSchedulerTests() {
+  LOG(INFO) << "RedrawScheduler tests: start.";
+  TestOutputRedrawsAreCoalesced();
+  TestInputHasPriority();
+  LOG(INFO) << "RedrawScheduler tests: done.";
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
@@ -0,0 +1,125 @@
+#include "src/test/screen_binary_test.h"
+
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "src/screen_binary.h"
+#include "src/wstring.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+// A screen that records a description of each operation it receives.
+class RecordingScreen : public Screen {
+ public:
+  void Flush() override { operations.push_back("Flush"); }
+  void HardRefresh() override { operations.push_back("HardRefresh"); }
+  void Refresh() override { operations.push_back("Refresh"); }
+  void Clear() override { operations.push_back("Clear"); }
+  void SetCursorVisibility(CursorVisibility cursor_visibility) override {
+    operations.push_back("SetCursorVisibility:" +
+                         CursorVisibilityToString(cursor_visibility));
+  }
+  void Move(size_t y, size_t x) override {
+    operations.push_back("Move:" + std::to_string(y) + "," +
+                         std::to_string(x));
+  }
+  void WriteString(const wstring& str) override {
+    // Consecutive writes may be merged.
+    if (!operations.empty() && operations.back().find("Write:") == 0 &&
+        modifiers_ == last_write_modifiers_) {
+      operations.back() += ToByteString(str);
+      return;
+    }
+    last_write_modifiers_ = modifiers_;
+    operations.push_back("Write:" + modifiers_ + ":" + ToByteString(str));
+  }
+  void SetModifier(LineModifier modifier) override {
+    if (modifier == LineModifier::RESET) {
+      modifiers_.clear();
+    } else {
+      modifiers_ += ModifierToString(modifier) + ",";
+    }
+  }
+  size_t columns() const override { return 80; }
+  size_t lines() const override { return 25; }
+
+  std::vector<string> operations;
+
+ private:
+  string modifiers_;
+  string last_write_modifiers_;
+};
+
+template <typename T>
+void SendOperations(T* screen) {
+  screen->Clear();
+  screen->SetCursorVisibility(Screen::INVISIBLE);
+  screen->Move(3, 200);
+  screen->WriteString(L"alejandro ");
+  screen->WriteString(L"forero");
+  screen->SetModifier(LineModifier::BOLD);
+  screen->WriteString(L" cuervo ñandú");
+  screen->SetModifier(LineModifier::RESET);
+  screen->WriteString(L".");
+  screen->Move(0, 0);
+  screen->HardRefresh();
+  screen->Refresh();
+  screen->Flush();
+}
+
+void TestRoundTrip() {
+  RecordingScreen expected;
+  SendOperations(&expected);
+
+  ScreenBinaryEncoder encoder;
+  SendOperations(&encoder);
+  string frame = encoder.TakeFrame();
+  // Feed it twice, split arbitrarily, to check that incomplete frames are
+  // retained.
+  string input = frame + frame;
+
+  RecordingScreen output;
+  ScreenBinaryDecoder decoder;
+  decoder.Consume(input.c_str(), 3, &output);
+  CHECK(output.operations.empty());
+  decoder.Consume(input.c_str() + 3, frame.size() + 2, &output);
+  CHECK(output.operations == expected.operations);
+  decoder.Consume(input.c_str() + frame.size() + 5, frame.size() - 5, &output);
+  CHECK_EQ(output.operations.size(), 2 * expected.operations.size());
+  CHECK(!decoder.terminate_requested());
+
+  encoder.Terminate();
+  frame = encoder.TakeFrame();
+  decoder.Consume(frame.c_str(), frame.size(), &output);
+  CHECK(decoder.terminate_requested());
+}
+
+void TestInvalidFrameIsIgnored() {
+  string frame("\x02\x00\x00\x00?M", 6);
+  RecordingScreen output;
+  ScreenBinaryDecoder decoder;
+  decoder.Consume(frame.c_str(), frame.size(), &output);
+  CHECK(output.operations.empty());
+
+  ScreenBinaryEncoder encoder;
+  encoder.Refresh();
+  frame = encoder.TakeFrame();
+  decoder.Consume(frame.c_str(), frame.size(), &output);
+  CHECK_EQ(output.operations.size(), 1u);
+}
+}  // namespace
+
+void ScreenBinaryTests() {
+  LOG(INFO) << "ScreenBinary tests: start.";
+  TestRoundTrip();
+  TestInvalidFrameIsIgnored();
+  LOG(INFO) << "ScreenBinary tests: done.";
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
@@ -0,0 +1,95 @@
+#include "src/test/screen_damage_tracking_test.h"
+
+#include <memory>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "src/screen_damage_tracking.h"
+#include "src/wstring.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+// A screen that just keeps the contents of each line (ignoring modifiers) and
+// counts the characters written to it.
+class FakeScreen : public Screen {
+ public:
+  FakeScreen(size_t columns, size_t lines)
+      : contents(lines, wstring(columns, L' ')) {}
+
+  void Flush() override {}
+  void HardRefresh() override {}
+  void Refresh() override {}
+  void Clear() override {}
+  void SetCursorVisibility(CursorVisibility) override {}
+  void Move(size_t y, size_t x) override {
+    y_ = y;
+    x_ = x;
+  }
+  void WriteString(const wstring& str) override {
+    for (auto& c : str) {
+      CHECK(c != L'\n');
+      contents[y_][x_++] = c;
+      characters_written++;
+    }
+  }
+  void SetModifier(LineModifier) override {}
+  size_t columns() const override { return contents[0].size(); }
+  size_t lines() const override { return contents.size(); }
+
+  std::vector<wstring> contents;
+  size_t characters_written = 0;
+
+ private:
+  size_t y_ = 0;
+  size_t x_ = 0;
+};
+
+void TestOnlyChangesAreEmitted() {
+  auto fake = std::make_unique<FakeScreen>(10, 3);
+  FakeScreen* fake_ptr = fake.get();
+  DamageTrackingScreen screen(std::move(fake));
+
+  screen.Move(0, 0);
+  screen.WriteString(L"alejandro\nforero\ncuervo");
+  screen.Refresh();
+  CHECK_EQ(ToByteString(fake_ptr->contents[0]), "alejandro ");
+  CHECK_EQ(ToByteString(fake_ptr->contents[1]), "forero    ");
+  CHECK_EQ(ToByteString(fake_ptr->contents[2]), "cuervo    ");
+  CHECK_EQ(screen.last_frame_stats().lines_emitted, 3u);
+
+  // Rewriting the same contents emits nothing.
+  fake_ptr->characters_written = 0;
+  screen.Move(0, 0);
+  screen.WriteString(L"alejandro\nforero\ncuervo");
+  screen.Refresh();
+  CHECK_EQ(fake_ptr->characters_written, 0u);
+  CHECK_EQ(screen.last_frame_stats().lines_emitted, 0u);
+
+  // Only the modified span is emitted.
+  screen.Move(1, 0);
+  screen.WriteString(L"fOrero\n");
+  screen.Refresh();
+  CHECK_EQ(ToByteString(fake_ptr->contents[1]), "fOrero    ");
+  CHECK_EQ(fake_ptr->characters_written, 1u);
+  CHECK_EQ(screen.last_frame_stats().lines_emitted, 1u);
+
+  // After a hard refresh, everything is emitted again.
+  fake_ptr->characters_written = 0;
+  screen.HardRefresh();
+  screen.Refresh();
+  CHECK_EQ(fake_ptr->characters_written, 30u);
+}
+}  // namespace
+
+void ScreenDamageTrackingTests() {
+  LOG(INFO) << "ScreenDamageTracking tests: start.";
+  TestOnlyChangesAreEmitted();
+  LOG(INFO) << "ScreenDamageTracking tests: done.";
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
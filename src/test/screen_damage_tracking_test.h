@@ -0,0 +1,12 @@
+#ifndef __AFC_EDITOR_TEST_SCREEN_DAMAGE_TRACKING_TEST_H__
+#define __AFC_EDITOR_TEST_SCREEN_DAMAGE_TRACKING_TEST_H__
+
+namespace afc {
+namespace editor {
+namespace testing {
+void ScreenDamageTrackingTests();
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_TEST_SCREEN_DAMAGE_TRACKING_TEST_H__
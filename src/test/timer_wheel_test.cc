@@ -0,0 +1,167 @@
+#include "src/test/timer_wheel_test.h"
+
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "src/timer_wheel.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+using Clock = TimerWheel::Clock;
+using std::chrono::milliseconds;
+
+void TestRunsInOrder() {
+  Clock::time_point start;
+  TimerWheel timers(start);
+  CHECK_EQ(timers.TimeoutMs(start), -1);
+  std::vector<int> log;
+  timers.Schedule(start + milliseconds(30), [&log]() { log.push_back(30); });
+  timers.Schedule(start + milliseconds(10), [&log]() { log.push_back(10); });
+  timers.Schedule(start + milliseconds(20), [&log]() { log.push_back(20); });
+  CHECK_EQ(timers.size(), 3u);
+  CHECK_EQ(timers.TimeoutMs(start), 10);
+  CHECK_EQ(timers.TimeoutMs(start + milliseconds(4)), 6);
+
+  CHECK_EQ(timers.RunExpired(start + milliseconds(9)), 0u);
+  CHECK_EQ(timers.RunExpired(start + milliseconds(25)), 2u);
+  CHECK(log == std::vector<int>({10, 20}));
+  CHECK_EQ(timers.TimeoutMs(start + milliseconds(25)), 5);
+
+  CHECK_EQ(timers.RunExpired(start + milliseconds(30)), 1u);
+  CHECK(log == std::vector<int>({10, 20, 30}));
+  CHECK_EQ(timers.size(), 0u);
+  CHECK_EQ(timers.TimeoutMs(start + milliseconds(30)), -1);
+}
+
+void TestCancel() {
+  Clock::time_point start;
+  TimerWheel timers(start);
+  int calls = 0;
+  auto id = timers.Schedule(start + milliseconds(5), [&calls]() { calls++; });
+  timers.Schedule(start + milliseconds(500), [&calls]() { calls++; });
+  CHECK(timers.Cancel(id));
+  CHECK(!timers.Cancel(id));
+  CHECK_EQ(timers.TimeoutMs(start), 500);
+  CHECK_EQ(timers.RunExpired(start + milliseconds(1000)), 1u);
+  CHECK_EQ(calls, 1);
+}
+
+void TestDeadlineInThePast() {
+  Clock::time_point start;
+  TimerWheel timers(start);
+  timers.RunExpired(start + milliseconds(100));
+  int calls = 0;
+  timers.Schedule(start + milliseconds(50), [&calls]() { calls++; });
+  CHECK_EQ(timers.TimeoutMs(start + milliseconds(100)), 0);
+  CHECK_EQ(timers.RunExpired(start + milliseconds(100)), 1u);
+  CHECK_EQ(calls, 1);
+}
+
+void TestCallbacksReschedule() {
+  Clock::time_point start;
+  TimerWheel timers(start);
+  int calls = 0;
+  std::function<void()> periodic = [&]() {
+    calls++;
+    timers.Schedule(start + milliseconds(100 * (calls + 1)), periodic);
+  };
+  timers.Schedule(start + milliseconds(100), periodic);
+  CHECK_EQ(timers.RunExpired(start + milliseconds(1050)), 10u);
+  CHECK_EQ(calls, 10);
+  CHECK_EQ(timers.TimeoutMs(start + milliseconds(1050)), 50);
+}
+
+// Checks that timers far in the future (which are cascaded through the levels
+// of the wheel) run neither early nor late.
+void TestLongDelays() {
+  Clock::time_point start;
+  TimerWheel timers(start);
+  std::vector<int64_t> delays = {63,       64,        65,       4095,
+                                 4096,     4097,      262143,   262144,
+                                 1000000,  16777215,  16777216, 20000000,
+                                 100000000};
+  std::map<int64_t, bool> ran;
+  for (auto delay : delays) {
+    timers.Schedule(start + milliseconds(delay),
+                    [&ran, delay]() { ran[delay] = true; });
+  }
+  for (auto delay : delays) {
+    CHECK_EQ(timers.TimeoutMs(start + milliseconds(delay - 1)), 1);
+    timers.RunExpired(start + milliseconds(delay - 1));
+    CHECK(!ran[delay]) << "Early: " << delay;
+    timers.RunExpired(start + milliseconds(delay));
+    CHECK(ran[delay]) << "Late: " << delay;
+  }
+  CHECK_EQ(timers.size(), 0u);
+}
+
+// Compares the wheel against a trivial implementation.
+void TestRandom() {
+  Clock::time_point start;
+  TimerWheel timers(start);
+  std::map<TimerWheel::TimerId, int64_t> pending;
+  std::vector<TimerWheel::TimerId> log;
+  int64_t now = 0;
+  srand(0);
+  for (int i = 0; i < 5000; i++) {
+    int64_t deadline = now + rand() % (rand() % 2 ? 100 : 10000000);
+    auto id = std::make_shared<TimerWheel::TimerId>();
+    *id = timers.Schedule(start + milliseconds(deadline),
+                          [&log, id]() { log.push_back(*id); });
+    pending[*id] = deadline;
+    if (rand() % 10 == 0) {
+      auto it = pending.begin();
+      std::advance(it, rand() % pending.size());
+      CHECK(timers.Cancel(it->first));
+      pending.erase(it);
+    }
+    if (rand() % 3 != 0) {
+      continue;
+    }
+    now += rand() % (rand() % 2 ? 50 : 100000);
+    timers.RunExpired(start + milliseconds(now));
+    int64_t last_deadline = 0;
+    for (auto& id : log) {
+      auto it = pending.find(id);
+      CHECK(it != pending.end());
+      CHECK_LE(it->second, now);
+      CHECK_LE(last_deadline, it->second);
+      last_deadline = it->second;
+      pending.erase(it);
+    }
+    log.clear();
+    CHECK_EQ(timers.size(), pending.size());
+    int64_t next = -1;
+    for (auto& entry : pending) {
+      CHECK_GT(entry.second, now);
+      if (next == -1 || entry.second < next) {
+        next = entry.second;
+      }
+    }
+    CHECK_EQ(timers.TimeoutMs(start + milliseconds(now)),
+             next == -1 ? -1 : next - now);
+  }
+}
+}  // namespace
+
+void TimerWheelTests() {
+  LOG(INFO) << "TimerWheel tests: start.";
+  TestRunsInOrder();
+  TestCancel();
+  TestDeadlineInThePast();
+  TestCallbacksReschedule();
+  TestLongDelays();
+  TestRandom();
+  LOG(INFO) << "TimerWheel tests: done.";
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
@@ -0,0 +1,171 @@
+#include "src/test/undo_history_test.h"
+
+#include <glog/logging.h>
+
+#include "src/buffer_contents.h"
+#include "src/char_buffer.h"
+#include "src/undo_history.h"
+#include "src/wstring.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+shared_ptr<const Line> NewLine(const wstring& contents) {
+  return std::make_shared<Line>(Line::Options(NewCopyString(contents)));
+}
+
+void FillContents(BufferContents* contents) {
+  for (auto& s : {L"alejandro", L"forero", L"cuervo"}) {
+    contents->push_back(NewLine(s));
+  }
+}
+
+void TestRevertDeltas() {
+  BufferContents contents;
+  FillContents(&contents);
+
+  vector<BufferContents::Delta> deltas;
+  contents.RecordDeltas(&deltas);
+  contents.set_line(1, NewLine(L"FORERO"));
+  contents.SplitLine(LineColumn(0, 4));
+  contents.EraseLines(3, 4);
+  contents.RecordDeltas(nullptr);
+  CHECK_EQ("alej\nandro\nFORERO", ToByteString(contents.ToString()));
+
+  vector<BufferContents::Delta> redo;
+  contents.RecordDeltas(&redo);
+  for (auto it = deltas.rbegin(); it != deltas.rend(); ++it) {
+    contents.RevertDelta(*it);
+  }
+  contents.RecordDeltas(nullptr);
+  CHECK_EQ("alejandro\nforero\ncuervo", ToByteString(contents.ToString()));
+
+  for (auto it = redo.rbegin(); it != redo.rend(); ++it) {
+    contents.RevertDelta(*it);
+  }
+  CHECK_EQ("alej\nandro\nFORERO", ToByteString(contents.ToString()));
+
+  // The contents no longer contain the lines introduced by the deltas.
+  contents.EraseLines(1, 3);
+  CHECK(!contents.RevertDelta(redo.front()));
+  CHECK_EQ("alej", ToByteString(contents.ToString()));
+
+  // A line introduced by a delta was replaced without recording it.
+  BufferContents other;
+  FillContents(&other);
+  vector<BufferContents::Delta> changes;
+  other.RecordDeltas(&changes);
+  other.set_line(1, NewLine(L"FORERO"));
+  other.RecordDeltas(nullptr);
+  other.set_line(1, NewLine(L"Forero"));
+  CHECK(!other.RevertDelta(changes.front()));
+  CHECK_EQ("alejandro\nForero\ncuervo", ToByteString(other.ToString()));
+
+  // Lines with the same contents (e.g., from the journal) match.
+  other.set_line(1, NewLine(L"FORERO"));
+  CHECK(other.RevertDelta(changes.front()));
+  CHECK_EQ("alejandro\nforero\ncuervo", ToByteString(other.ToString()));
+}
+
+void TestAppendDeltaMerges() {
+  BufferContents contents;
+  FillContents(&contents);
+
+  vector<BufferContents::Delta> deltas;
+  contents.RecordDeltas(&deltas);
+  contents.set_line(1, NewLine(L"f"));
+  contents.set_line(1, NewLine(L"fo"));
+  contents.set_line(1, NewLine(L"for"));
+  contents.RecordDeltas(nullptr);
+
+  CHECK_EQ(deltas.size(), 1u);
+  CHECK_EQ(deltas[0].first, 1u);
+  CHECK_EQ(deltas[0].old_lines.size(), 1u);
+  CHECK_EQ(ToByteString(deltas[0].old_lines[0]->ToString()), "forero");
+  CHECK_EQ(deltas[0].new_lines.size(), 1u);
+  CHECK_EQ(ToByteString(deltas[0].new_lines[0]->ToString()), "for");
+}
+
+UndoEntry NewKeystrokeEntry(LineColumn start, size_t line) {
+  UndoEntry entry;
+  entry.active_cursor = start;
+  entry.modified_buffer = true;
+  BufferContents::Delta delta;
+  delta.first = line;
+  delta.old_lines.push_back(NewLine(L"old"));
+  delta.new_lines.push_back(NewLine(L"new"));
+  entry.deltas.push_back(std::move(delta));
+  return entry;
+}
+
+void TestCoalesceKeystrokes() {
+  UndoHistory history;
+  for (size_t i = 0; i < 5; i++) {
+    history.Push(UndoHistory::PAST,
+                 NewKeystrokeEntry(LineColumn(3, i), 3));
+    history.CoalesceKeystroke(LineColumn(3, i + 1));
+  }
+  CHECK_EQ(history.size(UndoHistory::PAST), 1u);
+
+  // Starts elsewhere: not coalesced.
+  history.Push(UndoHistory::PAST, NewKeystrokeEntry(LineColumn(8, 0), 8));
+  history.CoalesceKeystroke(LineColumn(8, 1));
+  CHECK_EQ(history.size(UndoHistory::PAST), 2u);
+
+  // Not a keystroke: breaks the sequence.
+  history.Push(UndoHistory::PAST, UndoEntry());
+  history.Push(UndoHistory::PAST, NewKeystrokeEntry(LineColumn(8, 1), 8));
+  history.CoalesceKeystroke(LineColumn(8, 2));
+  CHECK_EQ(history.size(UndoHistory::PAST), 4u);
+
+  auto entry = history.Pop(UndoHistory::PAST);
+  CHECK_EQ(entry.keystroke_end, LineColumn(8, 2));
+
+  // Merged entries are undone at once, with the cursor of the first.
+  history.MergeIntoLast(NewKeystrokeEntry(LineColumn(9, 0), 9));
+  CHECK_EQ(history.size(UndoHistory::PAST), 3u);
+  entry = history.Pop(UndoHistory::PAST);
+  CHECK_EQ(entry.deltas.size(), 1u);
+  CHECK(entry.active_cursor == LineColumn());
+}
+
+void TestMemoryLimit() {
+  UndoHistory history;
+  history.Push(UndoHistory::PAST, NewKeystrokeEntry(LineColumn(), 0));
+  size_t entry_size = history.memory_usage();
+  CHECK_GT(entry_size, 0u);
+
+  history.set_memory_limit(entry_size * 3);
+  for (size_t i = 1; i < 10; i++) {
+    history.Push(UndoHistory::PAST, NewKeystrokeEntry(LineColumn(i), i));
+  }
+  CHECK_EQ(history.size(UndoHistory::PAST), 3u);
+  CHECK_EQ(history.memory_usage(), entry_size * 3);
+  // The oldest entries were dropped.
+  CHECK_EQ(history.Pop(UndoHistory::PAST).active_cursor, LineColumn(9));
+
+  // The entry just pushed is always retained.
+  history.set_memory_limit(0);
+  history.Push(UndoHistory::FUTURE, NewKeystrokeEntry(LineColumn(), 0));
+  CHECK(history.empty(UndoHistory::PAST));
+  CHECK_EQ(history.size(UndoHistory::FUTURE), 1u);
+  CHECK_EQ(history.memory_usage(), entry_size);
+
+  history.Clear(UndoHistory::FUTURE);
+  CHECK_EQ(history.memory_usage(), 0u);
+}
+}  // namespace
+
+void UndoHistoryTests() {
+  LOG(INFO) << "Undo history tests: start.";
+  TestRevertDeltas();
+  TestAppendDeltaMerges();
+  TestCoalesceKeystrokes();
+  TestMemoryLimit();
+  LOG(INFO) << "Undo history tests: done.";
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
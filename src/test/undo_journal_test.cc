@@ -0,0 +1,191 @@
+#include "src/test/undo_journal_test.h"
+
+#include <fstream>
+
+extern "C" {
+#include <stdlib.h>
+#include <unistd.h>
+}
+
+#include <glog/logging.h>
+
+#include "src/char_buffer.h"
+#include "src/dirname.h"
+#include "src/undo_journal.h"
+#include "src/wstring.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+wstring NewJournalPath() {
+  char directory[] = "/tmp/edge_undo_journal_test_XXXXXX";
+  CHECK(mkdtemp(directory) != nullptr);
+  return FromByteString(directory) + L"/.edge_undo";
+}
+
+void Remove(const wstring& path) {
+  unlink(ToByteString(path).c_str());
+  rmdir(ToByteString(Dirname(path)).c_str());
+}
+
+UndoEntry NewEntry(size_t line, wstring old_contents, wstring new_contents) {
+  UndoEntry entry;
+  entry.active_cursor = LineColumn(line, 1);
+  entry.modified_buffer = true;
+  BufferContents::Delta delta;
+  delta.first = line;
+  delta.old_lines.push_back(
+      std::make_shared<Line>(Line::Options(NewCopyString(old_contents))));
+  delta.new_lines.push_back(
+      std::make_shared<Line>(Line::Options(NewCopyString(new_contents))));
+  entry.deltas.push_back(std::move(delta));
+  return entry;
+}
+
+BufferContents NewContents(wstring line) {
+  BufferContents contents;
+  contents.push_back(line);
+  return contents;
+}
+
+std::vector<wstring> NewLines(const std::vector<UndoEntry>& entries) {
+  std::vector<wstring> output;
+  for (auto& entry : entries) {
+    output.push_back(entry.deltas.back().new_lines.back()->ToString());
+  }
+  return output;
+}
+
+// Simulates a session that saves "a", then "ab", "abc", "ab" (undo).
+void WriteFirstSession(const wstring& path) {
+  UndoJournal journal(path);
+  journal.Push(NewEntry(0, L"", L"a"));
+  journal.Saved(ContentsChecksum(NewContents(L"a")));
+  journal.Push(NewEntry(0, L"a", L"ab"));
+  journal.Push(NewEntry(0, L"ab", L"abc"));
+  journal.Pop();
+  journal.Saved(ContentsChecksum(NewContents(L"ab")));
+  // Not saved: discarded in the next session.
+  journal.Push(NewEntry(0, L"ab", L"abd"));
+}
+
+void TestLoad() {
+  auto path = NewJournalPath();
+  WriteFirstSession(path);
+
+  UndoJournal journal(path);
+  std::vector<UndoEntry> entries;
+  CHECK(!journal.Load(ContentsChecksum(NewContents(L"abd")), &entries));
+  CHECK(journal.Load(ContentsChecksum(NewContents(L"ab")), &entries));
+  CHECK(NewLines(entries) == std::vector<wstring>({L"a", L"ab"}));
+  CHECK_EQ(entries[1].active_cursor, LineColumn(0, 1));
+
+  // Changes in this session don't affect what Load returns.
+  journal.Pop();
+  journal.Push(NewEntry(0, L"a", L"x"));
+  entries.clear();
+  CHECK(journal.Load(ContentsChecksum(NewContents(L"ab")), &entries));
+  CHECK_EQ(entries.size(), 2u);
+  Remove(path);
+}
+
+void TestCoalesce() {
+  auto path = NewJournalPath();
+  {
+    UndoJournal journal(path);
+    journal.Push(NewEntry(0, L"", L"a"));
+    journal.Push(NewEntry(0, L"a", L"ab"));
+    journal.Coalesce();
+    journal.Saved(ContentsChecksum(NewContents(L"ab")));
+  }
+  UndoJournal journal(path);
+  std::vector<UndoEntry> entries;
+  CHECK(journal.Load(ContentsChecksum(NewContents(L"ab")), &entries));
+  CHECK_EQ(entries.size(), 1u);
+  CHECK_EQ(entries[0].deltas.size(), 1u);
+  CHECK(entries[0].deltas[0].old_lines[0]->ToString() == L"");
+  CHECK(entries[0].deltas[0].new_lines[0]->ToString() == L"ab");
+  Remove(path);
+}
+
+void TestCorruptedTail() {
+  auto path = NewJournalPath();
+  WriteFirstSession(path);
+  {
+    std::ofstream file(ToByteString(path), std::ios::app | std::ios::binary);
+    file << "garbage that doesn't form a valid record";
+  }
+  // The invalid tail is discarded, so the RESTORE record doesn't get lost.
+  UndoJournal journal(path);
+  std::vector<UndoEntry> entries;
+  CHECK(journal.Load(ContentsChecksum(NewContents(L"ab")), &entries));
+  CHECK(NewLines(entries) == std::vector<wstring>({L"a", L"ab"}));
+  Remove(path);
+}
+
+void TestCompact() {
+  auto path = NewJournalPath();
+  WriteFirstSession(path);
+  for (int i = 0; i < 100; i++) {
+    UndoJournal journal(path);
+    journal.Push(NewEntry(0, L"ab", L"abd"));
+    journal.Pop();
+  }
+  size_t size_before;
+  {
+    std::ifstream file(ToByteString(path), std::ios::ate | std::ios::binary);
+    size_before = file.tellg();
+  }
+  {
+    UndoJournal journal(path);
+    journal.Compact();
+    journal.Flush();
+    std::ifstream file(ToByteString(path), std::ios::ate | std::ios::binary);
+    CHECK_LT(static_cast<size_t>(file.tellg()), size_before / 10);
+  }
+  UndoJournal journal(path);
+  std::vector<UndoEntry> entries;
+  CHECK(journal.Load(ContentsChecksum(NewContents(L"ab")), &entries));
+  CHECK(NewLines(entries) == std::vector<wstring>({L"a", L"ab"}));
+  Remove(path);
+}
+
+// Saving during the session and then compacting must retain the entries from
+// previous sessions, both for this session and for the next one.
+void TestCompactAfterSaveInSession() {
+  auto path = NewJournalPath();
+  WriteFirstSession(path);
+  {
+    UndoJournal journal(path);
+    journal.Pop();
+    journal.Push(NewEntry(0, L"a", L"x"));
+    journal.Saved(ContentsChecksum(NewContents(L"x")));
+    journal.Push(NewEntry(0, L"x", L"xy"));
+    journal.Compact();
+    journal.Flush();
+    std::vector<UndoEntry> entries;
+    CHECK(journal.Load(ContentsChecksum(NewContents(L"ab")), &entries));
+    CHECK(NewLines(entries) == std::vector<wstring>({L"a", L"ab"}));
+  }
+  UndoJournal journal(path);
+  std::vector<UndoEntry> entries;
+  CHECK(journal.Load(ContentsChecksum(NewContents(L"x")), &entries));
+  CHECK(NewLines(entries) == std::vector<wstring>({L"a", L"x"}));
+  Remove(path);
+}
+}  // namespace
+
+void UndoJournalTests() {
+  LOG(INFO) << "Undo journal tests: start.";
+  TestLoad();
+  TestCoalesce();
+  TestCorruptedTail();
+  TestCompact();
+  TestCompactAfterSaveInSession();
+  LOG(INFO) << "Undo journal tests: done.";
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
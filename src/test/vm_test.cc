@@ -0,0 +1,231 @@
+#include "src/test/vm_test.h"
+
+#include <fstream>
+
+extern "C" {
+#include <stdlib.h>
+#include <unistd.h>
+}
+
+#include <glog/logging.h>
+
+#include "src/vm/public/compilation_cache.h"
+#include "src/vm/public/constant_expression.h"
+#include "src/vm/public/environment.h"
+#include "src/vm/public/value.h"
+#include "src/vm/public/vm.h"
+#include "src/wstring.h"
+
+namespace afc {
+namespace editor {
+namespace testing {
+namespace {
+using vm::Environment;
+using vm::Value;
+using vm::VMType;
+
+Value::Ptr EvaluateProgram(Environment* environment, const wstring& code) {
+  wstring error;
+  auto expression = vm::CompileString(code, environment, &error);
+  CHECK(expression != nullptr) << "Compilation failed: " << error;
+  Value::Ptr output;
+  vm::Evaluate(expression.get(), environment,
+               [&output](Value::Ptr value) { output = std::move(value); });
+  CHECK(output != nullptr);
+  return output;
+}
+
+int EvaluateInteger(Environment* environment, const wstring& code) {
+  auto value = EvaluateProgram(environment, code);
+  CHECK_EQ(value->type.type, VMType::VM_INTEGER);
+  return value->integer();
+}
+
+int EvaluateInteger(const wstring& code) {
+  Environment environment(Environment::GetDefault());
+  return EvaluateInteger(&environment, code);
+}
+
+void TestExpressions() {
+  CHECK_EQ(EvaluateInteger(L"8 - 2 * 3 + 5;"), 7);
+  CHECK_EQ(EvaluateInteger(L"int x = 4; x = x * x; -x;"), -16);
+  CHECK_EQ(EvaluateInteger(L"true && false ? 1 : 2;"), 2);
+  CHECK_EQ(EvaluateInteger(L"false || !false ? 1 : 2;"), 1);
+  CHECK_EQ(EvaluateInteger(L"\"alejandro\".size();"), 9);
+}
+
+void TestLoops() {
+  CHECK_EQ(EvaluateInteger(L"int i = 0; int s = 0;"
+                           L"while (i < 100) { s = s + i; i = i + 1; }"
+                           L"s;"),
+           4950);
+  CHECK_EQ(EvaluateInteger(L"int i = 0; int s = 0;"
+                           L"while (i < 10) {"
+                           L"  if (i == 3 || i == 5) { s = s + 100; }"
+                           L"  else { s = s + 1; }"
+                           L"  i = i + 1;"
+                           L"}"
+                           L"s;"),
+           208);
+}
+
+void TestFunctions() {
+  CHECK_EQ(EvaluateInteger(L"int Sum(int n) {"
+                           L"  if (n == 0) { return 0; }"
+                           L"  return n + Sum(n - 1);"
+                           L"}"
+                           L"Sum(30);"),
+           465);
+  // Returning from inside a loop.
+  CHECK_EQ(EvaluateInteger(L"int Find(int n) {"
+                           L"  int i = 0;"
+                           L"  while (true) {"
+                           L"    if (i * i >= n) { return i; }"
+                           L"    i = i + 1;"
+                           L"  }"
+                           L"  return -1;"
+                           L"}"
+                           L"Find(50) + Find(0);"),
+           8);
+}
+
+// Returns the value of the expression, which must have been folded into a
+// constant during compilation.
+Value::Ptr FoldConstant(const wstring& code) {
+  Environment environment(Environment::GetDefault());
+  wstring error;
+  auto expression = vm::CompileString(code, &environment, &error);
+  CHECK(expression != nullptr) << "Compilation failed: " << error;
+  const Value* value = vm::GetConstantValue(expression.get());
+  CHECK(value != nullptr) << "Not folded: " << code;
+  return std::make_unique<Value>(*value);
+}
+
+void TestConstantFolding() {
+  CHECK(FoldConstant(L"\"al\" + \"ej\" + \"andro\";")->str() ==
+        L"alejandro");
+  CHECK_EQ(FoldConstant(L"-(2 * 3) + 1;")->integer(), -5);
+  CHECK_EQ(FoldConstant(L"1 < 2 && !(3 == 4) ? 10 : 20;")->integer(), 10);
+  CHECK_EQ(FoldConstant(L"false || \"a\" != \"a\";")->boolean(), false);
+  CHECK_EQ(FoldConstant(L"\"ignored\"; 4;")->integer(), 4);
+
+  // Dead branches are dropped, without their effects.
+  CHECK_EQ(EvaluateInteger(L"int s = 1;"
+                           L"if (2 > 3) { s = 2; } else { s = s + 10; }"
+                           L"while (false) { s = 0; }"
+                           L"s;"),
+           11);
+  // Constant right operands don't drop the left operand's effects.
+  CHECK_EQ(EvaluateInteger(L"int c = 0;"
+                           L"bool Touch() { c = c + 1; return true; }"
+                           L"Touch() && false;"
+                           L"Touch() || true;"
+                           L"true && Touch();"
+                           L"c;"),
+           3);
+}
+
+void TestSuspendedCall() {
+  Environment environment(Environment::GetDefault());
+  std::vector<std::function<void(Value::Ptr)>> pending;
+  environment.Define(
+      L"Wait", Value::NewFunction({VMType::Integer(), VMType::Integer()},
+                                  [&pending](std::vector<Value::Ptr> args,
+                                             vm::Trampoline* trampoline) {
+                                    CHECK_EQ(args.size(), 1ul);
+                                    pending.push_back(trampoline->Interrupt());
+                                  }));
+  wstring error;
+  auto expression = vm::CompileString(
+      L"int s = 0; int i = 0; while (i < 3) { s = s + Wait(i); i = i + 1; } s;",
+      &environment, &error);
+  CHECK(expression != nullptr) << "Compilation failed: " << error;
+  Value::Ptr output;
+  vm::Evaluate(expression.get(), &environment,
+               [&output](Value::Ptr value) { output = std::move(value); });
+  for (int i = 0; i < 3; i++) {
+    CHECK(output == nullptr);
+    CHECK_EQ(pending.size(), size_t(i + 1));
+    pending.back()(Value::NewInteger(10 * (i + 1)));
+  }
+  CHECK(output != nullptr);
+  CHECK_EQ(output->integer(), 60);
+}
+
+void WriteFile(const string& path, const string& contents) {
+  std::ofstream file(path);
+  file << contents;
+  CHECK(file.good());
+}
+
+// Evaluates the file through the cache and returns the value of `result`.
+int EvaluateCachedFile(vm::CompilationCache* cache, const string& path,
+                       Environment* environment) {
+  wstring error;
+  auto expression = cache->CompileFile(path, environment, &error);
+  CHECK(expression != nullptr) << "Compilation failed: " << error;
+  vm::Evaluate(expression.get(), environment, [](Value::Ptr) {});
+  return environment->Lookup(L"result")->integer();
+}
+
+void TestCompilationCache() {
+  char directory[] = "/tmp/edge_vm_test_XXXXXX";
+  CHECK(mkdtemp(directory) != nullptr);
+  string library = string(directory) + "/library.cc";
+  string main = string(directory) + "/main.cc";
+  WriteFile(library, "int Scale(int x) { return x * factor; }\n");
+  WriteFile(main, "#include \"library.cc\"\nint result = Scale(10);\n");
+
+  vm::CompilationCache cache;
+  Environment first(Environment::GetDefault());
+  first.Define(L"factor", Value::NewInteger(2));
+  Environment second(Environment::GetDefault());
+  second.Define(L"factor", Value::NewInteger(3));
+
+  CHECK_EQ(EvaluateCachedFile(&cache, main, &first), 20);
+  CHECK_EQ(cache.stats().misses, 1ul);
+
+  // The expression is shared, but its functions are bound to each environment.
+  CHECK_EQ(EvaluateCachedFile(&cache, main, &second), 30);
+  CHECK_EQ(cache.stats().hits, 1ul);
+  CHECK_EQ(EvaluateInteger(&first, L"Scale(1);"), 2);
+  CHECK_EQ(EvaluateInteger(&second, L"Scale(1);"), 3);
+
+  // Evaluating the file again in an environment that already has its
+  // definitions.
+  CHECK_EQ(EvaluateCachedFile(&cache, main, &first), 20);
+  CHECK_EQ(cache.stats().hits, 2ul);
+
+  // An environment with a different layout.
+  Environment third(Environment::GetDefault());
+  third.Define(L"unused", Value::NewInteger(0));
+  third.Define(L"factor", Value::NewInteger(4));
+  CHECK_EQ(EvaluateCachedFile(&cache, main, &third), 40);
+  CHECK_EQ(cache.stats().misses, 2ul);
+
+  // Modifying an included file invalidates the entry.
+  WriteFile(library, "int Scale(int x) { return x * factor + 1; }\n");
+  CHECK_EQ(EvaluateCachedFile(&cache, main, &second), 31);
+  CHECK_EQ(cache.stats().misses, 3ul);
+  CHECK_EQ(cache.stats().invalidations, 1ul);
+  CHECK_EQ(EvaluateCachedFile(&cache, main, &first), 21);
+  CHECK_EQ(cache.stats().hits, 3ul);
+
+  unlink(library.c_str());
+  unlink(main.c_str());
+  rmdir(directory);
+}
+}  // namespace
+
+void VmTests() {
+  TestExpressions();
+  TestLoops();
+  TestFunctions();
+  TestConstantFolding();
+  TestSuspendedCall();
+  TestCompilationCache();
+}
+
+}  // namespace testing
+}  // namespace editor
+}  // namespace afc
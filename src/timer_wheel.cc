@@ -0,0 +1,205 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <glog/logging.h>
+
+namespace afc {
+namespace editor {
+
+TimerWheel::TimerWheel() : TimerWheel(Clock::now()) {}
+
+TimerWheel::TimerWheel(Clock::time_point start)
+    : start_(start), levels_(kLevels, std::vector<Slot>(kSlots)) {}
+
+TimerWheel::TimerId TimerWheel::Schedule(Clock::time_point deadline,
+                                         std::function<void()> callback) {
+  CHECK(callback);
+  TimerId id = next_id_++;
+  Timer* timer = &timers_[id];
+  timer->tick = DeadlineToTick(deadline);
+  timer->callback = std::move(callback);
+  Place(id, timer);
+  VLOG(6) << "Scheduled timer " << id << " at tick " << timer->tick
+          << " (current: " << current_tick_ << ", level: " << timer->level
+          << ")";
+  return id;
+}
+
+bool TimerWheel::Cancel(TimerId id) {
+  auto it = timers_.find(id);
+  if (it == timers_.end()) {
+    return false;
+  }
+  Remove(it);
+  return true;
+}
+
+size_t TimerWheel::RunExpired(Clock::time_point now) {
+  size_t ran = RunSlot(&expired_);
+  Tick target = TimeToTick(now);
+  while (current_tick_ < target) {
+    if (timers_.empty()) {
+      current_tick_ = target;
+      break;
+    }
+    // If the lowest levels are empty, nothing happens until the next cascade
+    // into them, so we skip directly to it.
+    size_t level = 0;
+    while (level < kLevels - 1 && level_sizes_[level] == 0) {
+      level++;
+    }
+    if (level > 0) {
+      Tick last_before_cascade =
+          current_tick_ | ((Tick(1) << (kSlotBits * level)) - 1);
+      if (last_before_cascade >= target) {
+        current_tick_ = target;
+        break;
+      }
+      current_tick_ = last_before_cascade;
+    }
+    ran += Step();
+  }
+  return ran;
+}
+
+int TimerWheel::TimeoutMs(Clock::time_point now) const {
+  if (timers_.empty()) {
+    return -1;
+  }
+  Tick next = NextTick();
+  Tick now_tick = TimeToTick(now);
+  if (next <= now_tick) {
+    return 0;
+  }
+  return static_cast<int>(std::min(
+      next - now_tick, static_cast<Tick>(std::numeric_limits<int>::max())));
+}
+
+TimerWheel::Tick TimerWheel::DeadlineToTick(Clock::time_point deadline) const {
+  if (deadline <= start_) {
+    return 0;
+  }
+  auto milliseconds =
+      std::chrono::duration_cast<std::chrono::milliseconds>(deadline - start_);
+  if (start_ + milliseconds < deadline) {
+    milliseconds += std::chrono::milliseconds(1);
+  }
+  return milliseconds.count();
+}
+
+TimerWheel::Tick TimerWheel::TimeToTick(Clock::time_point time) const {
+  if (time <= start_) {
+    return 0;
+  }
+  return std::chrono::duration_cast<std::chrono::milliseconds>(time - start_)
+      .count();
+}
+
+void TimerWheel::Place(TimerId id, Timer* timer) {
+  if (timer->tick <= current_tick_) {
+    timer->level = kLevels;
+    timer->slot = &expired_;
+  } else {
+    Tick delta = timer->tick - current_tick_;
+    size_t level = 0;
+    while (level < kLevels && delta >= Tick(1) << (kSlotBits * (level + 1))) {
+      level++;
+    }
+    timer->level = level;
+    if (level == kLevels) {
+      timer->slot = &overflow_;
+    } else {
+      timer->slot = &levels_[level][SlotIndex(timer->tick, level)];
+      level_sizes_[level]++;
+    }
+  }
+  timer->position = timer->slot->insert(timer->slot->end(), id);
+}
+
+void TimerWheel::Remove(std::unordered_map<TimerId, Timer>::iterator it) {
+  Timer* timer = &it->second;
+  timer->slot->erase(timer->position);
+  if (timer->level < kLevels) {
+    level_sizes_[timer->level]--;
+  }
+  timers_.erase(it);
+}
+
+void TimerWheel::Cascade(Slot* slot) {
+  Slot timers;
+  timers.swap(*slot);
+  for (TimerId id : timers) {
+    Timer* timer = &timers_.at(id);
+    if (timer->level < kLevels) {
+      level_sizes_[timer->level]--;
+    }
+    Place(id, timer);
+  }
+}
+
+size_t TimerWheel::Step() {
+  current_tick_++;
+  // Each time a level wraps around, the next slot of the level above it
+  // becomes due.
+  size_t level = 1;
+  while (level < kLevels && SlotIndex(current_tick_, level - 1) == 0) {
+    Cascade(&levels_[level][SlotIndex(current_tick_, level)]);
+    level++;
+  }
+  if (level == kLevels) {
+    Cascade(&overflow_);
+  }
+  return RunSlot(&levels_[0][SlotIndex(current_tick_, 0)]) +
+         RunSlot(&expired_);
+}
+
+size_t TimerWheel::RunSlot(Slot* slot) {
+  // Timers scheduled by the callbacks (which are appended at the end) are left
+  // for the next call, so that a callback that keeps rescheduling itself
+  // doesn't block us.
+  TimerId limit = next_id_;
+  size_t ran = 0;
+  while (!slot->empty() && slot->front() < limit) {
+    auto it = timers_.find(slot->front());
+    CHECK(it != timers_.end());
+    auto callback = std::move(it->second.callback);
+    Remove(it);
+    callback();
+    ran++;
+  }
+  return ran;
+}
+
+TimerWheel::Tick TimerWheel::NextTick() const {
+  if (!expired_.empty()) {
+    return current_tick_;
+  }
+  // In each level, the first non-empty slot after the current one contains the
+  // earliest timers of the level.
+  Tick output = std::numeric_limits<Tick>::max();
+  for (size_t level = 0; level < kLevels; level++) {
+    if (level_sizes_[level] == 0) {
+      continue;
+    }
+    size_t current = SlotIndex(current_tick_, level);
+    for (size_t i = 1; i <= kSlots; i++) {
+      const Slot& slot = levels_[level][(current + i) % kSlots];
+      if (slot.empty()) {
+        continue;
+      }
+      for (TimerId id : slot) {
+        output = std::min(output, timers_.at(id).tick);
+      }
+      break;
+    }
+  }
+  for (TimerId id : overflow_) {
+    output = std::min(output, timers_.at(id).tick);
+  }
+  return output;
+}
+
+}  // namespace editor
+}  // namespace afc
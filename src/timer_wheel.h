@@ -0,0 +1,104 @@
+#ifndef __AFC_EDITOR_TIMER_WHEEL_H__
+#define __AFC_EDITOR_TIMER_WHEEL_H__
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace afc {
+namespace editor {
+
+// Runs callbacks at given deadlines, with a resolution of one millisecond.
+//
+// Timers are kept in a hierarchical timing wheel: each level has kSlots
+// slots, where each slot of a level spans all the slots of the level below.
+// Scheduling and cancelling are constant time; when time advances past the
+// span of a slot in a higher level, its timers are moved down (cascaded) to
+// the levels below. Timers too far in the future for the highest level wait in
+// an overflow list.
+//
+// Callbacks never run early, but may run late (if RunExpired isn't called on
+// time). They may schedule or cancel timers.
+class TimerWheel {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using TimerId = size_t;
+
+  TimerWheel();
+  explicit TimerWheel(Clock::time_point start);
+
+  TimerId Schedule(Clock::time_point deadline, std::function<void()> callback);
+  TimerId Schedule(Clock::duration delay, std::function<void()> callback) {
+    return Schedule(Clock::now() + delay, std::move(callback));
+  }
+
+  // Returns false if the timer had already run (or been cancelled).
+  bool Cancel(TimerId id);
+
+  // Runs the callbacks of all the timers whose deadline is at or before now.
+  // Returns the number of callbacks ran.
+  size_t RunExpired(Clock::time_point now);
+
+  // Returns the number of milliseconds (rounded up) until RunExpired should be
+  // called, or -1 if there are no timers. Suitable for poll's timeout.
+  int TimeoutMs(Clock::time_point now) const;
+
+  size_t size() const { return timers_.size(); }
+
+ private:
+  using Tick = uint64_t;
+  using Slot = std::list<TimerId>;
+
+  struct Timer {
+    Tick tick;
+    std::function<void()> callback;
+    // The slot in which the timer currently is and its position in it. level
+    // is kLevels if the slot is overflow_ or expired_.
+    size_t level;
+    Slot* slot;
+    Slot::iterator position;
+  };
+
+  static const size_t kLevels = 4;
+  static const size_t kSlotBits = 6;
+  static const size_t kSlots = 1 << kSlotBits;
+
+  static size_t SlotIndex(Tick tick, size_t level) {
+    return (tick >> (kSlotBits * level)) & (kSlots - 1);
+  }
+
+  // Rounds up, so that timers never fire early.
+  Tick DeadlineToTick(Clock::time_point deadline) const;
+  Tick TimeToTick(Clock::time_point time) const;
+  // Inserts the timer in the slot that corresponds to its tick.
+  void Place(TimerId id, Timer* timer);
+  void Remove(std::unordered_map<TimerId, Timer>::iterator it);
+  // Moves the timers in the slot to the levels below.
+  void Cascade(Slot* slot);
+  // Advances current_tick_ by one, running the callbacks of the timers due.
+  size_t Step();
+  size_t RunSlot(Slot* slot);
+  // Returns the tick of the earliest timer.
+  Tick NextTick() const;
+
+  const Clock::time_point start_;
+  // All timers with a tick at or before this one have been ran.
+  Tick current_tick_ = 0;
+  TimerId next_id_ = 0;
+
+  std::unordered_map<TimerId, Timer> timers_;
+  std::vector<std::vector<Slot>> levels_;
+  // Number of timers in each level.
+  size_t level_sizes_[kLevels] = {0, 0, 0, 0};
+  Slot overflow_;
+  // Timers scheduled with a deadline that had already passed.
+  Slot expired_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_TIMER_WHEEL_H__
@@ -143,20 +143,20 @@ class DeleteCharactersTransformation : public Transformation {
     LOG(INFO) << "Preparing deleted text buffer.";
     auto delete_buffer =
         std::make_shared<OpenBuffer>(editor_state, OpenBuffer::kPasteBuffer);
-    auto first_line = std::make_shared<Line>(*buffer->LineAt(begin.line));
+    LineBuilder first_line(*buffer->LineAt(begin.line));
     if (begin.line == line_end) {
-      first_line->DeleteCharacters(chars_erase_line);
+      first_line.DeleteCharacters(chars_erase_line);
     }
-    first_line->DeleteCharacters(0, begin.column);
-    delete_buffer->AppendToLastLine(editor_state, first_line->contents(),
-                                    first_line->modifiers());
+    first_line.DeleteCharacters(0, begin.column);
+    delete_buffer->AppendToLastLine(editor_state, first_line.contents(),
+                                    first_line.modifiers());
 
     for (size_t i = begin.line + 1; i <= line_end; i++) {
-      auto line = std::make_shared<Line>(*buffer->LineAt(i));
+      LineBuilder line(*buffer->LineAt(i));
       if (i == line_end) {
-        line->DeleteCharacters(chars_erase_line);
+        line.DeleteCharacters(chars_erase_line);
       }
-      delete_buffer->AppendRawLine(editor_state, line);
+      delete_buffer->AppendRawLine(editor_state, line.Build());
     }
 
     return delete_buffer;
@@ -0,0 +1,148 @@
+#include "transformation_map.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "buffer.h"
+#include "char_buffer.h"
+#include "line.h"
+
+namespace afc {
+namespace editor {
+
+namespace {
+
+// Below this, the cost of starting a thread exceeds what it saves.
+const size_t kMinLinesPerThread = 4096;
+
+class MapLinesTransformation : public Transformation {
+ public:
+  MapLinesTransformation(MapLinesOptions options)
+      : options_(std::move(options)) {
+    CHECK(options_.map);
+  }
+
+  void Apply(EditorState*, OpenBuffer* buffer, Result* result) const override {
+    CHECK(buffer != nullptr);
+    size_t first = options_.first;
+    size_t last = std::min(options_.last, buffer->contents()->size());
+    if (first >= last) {
+      return;
+    }
+    size_t count = last - first;
+
+    // The lines are immutable, so the threads can read them from the snapshot
+    // without synchronization.
+    std::vector<shared_ptr<const Line>> lines(count);
+    for (size_t i = 0; i < count; i++) {
+      lines[i] = buffer->LineAt(first + i);
+    }
+    std::vector<LineState> states(count);
+    MapRange(lines, &states);
+
+    size_t first_changed = 0;
+    while (first_changed < count && !states[first_changed].changed()) {
+      first_changed++;
+    }
+    if (first_changed == count) {
+      return;
+    }
+    size_t last_changed = count;
+    while (!states[last_changed - 1].changed()) {
+      last_changed--;
+    }
+
+    std::vector<shared_ptr<const Line>> replacement;
+    replacement.reserve(last_changed - first_changed);
+    size_t deleted = 0;
+    for (size_t i = first_changed; i < last_changed; i++) {
+      auto& state = states[i];
+      if (state.deleted) {
+        deleted++;
+      } else if (state.modified) {
+        // The modifiers can't be mapped to the new contents, so they are
+        // dropped.
+        Line::Options line_options(NewCopyString(std::move(state.contents)));
+        line_options.environment = lines[i]->environment();
+        replacement.push_back(std::make_shared<Line>(std::move(line_options)));
+      } else {
+        replacement.push_back(std::move(lines[i]));
+      }
+    }
+    if (replacement.empty() &&
+        last_changed - first_changed == buffer->contents()->size()) {
+      // Buffers always contain at least one line.
+      replacement.push_back(std::make_shared<Line>());
+    }
+    VLOG(5) << "Map lines: replacing range starting at "
+            << first + first_changed << " with " << replacement.size()
+            << " lines (deleted: " << deleted << ")";
+    buffer->ReplaceLines(first + first_changed, last_changed - first_changed,
+                         replacement);
+    buffer->AdjustLineColumn(&result->cursor);
+    result->made_progress = true;
+    result->modified_buffer = true;
+  }
+
+  unique_ptr<Transformation> Clone() override {
+    return std::make_unique<MapLinesTransformation>(options_);
+  }
+
+ private:
+  struct LineState {
+    bool changed() const { return modified || deleted; }
+
+    bool modified = false;
+    bool deleted = false;
+    // Only set if modified.
+    wstring contents;
+  };
+
+  void MapRange(const std::vector<shared_ptr<const Line>>& lines,
+                std::vector<LineState>* states) const {
+    auto map = [this, &lines, states](size_t start, size_t end) {
+      for (size_t i = start; i < end; i++) {
+        wstring original = lines[i]->ToString();
+        wstring contents = original;
+        auto& state = states->at(i);
+        if (!options_.map(&contents)) {
+          state.deleted = true;
+        } else if (contents != original) {
+          state.modified = true;
+          state.contents = std::move(contents);
+        }
+      }
+    };
+
+    size_t threads = 1;
+    if (options_.parallel) {
+      threads = std::max(
+          size_t(1), std::min(size_t(std::thread::hardware_concurrency()),
+                              lines.size() / kMinLinesPerThread));
+    }
+    size_t chunk = (lines.size() + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; i++) {
+      workers.emplace_back(map, i * chunk,
+                           std::min(lines.size(), (i + 1) * chunk));
+    }
+    map(0, std::min(lines.size(), chunk));
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  const MapLinesOptions options_;
+};
+
+}  // namespace
+
+unique_ptr<Transformation> NewMapLinesTransformation(MapLinesOptions options) {
+  return std::make_unique<MapLinesTransformation>(std::move(options));
+}
+
+}  // namespace editor
+}  // namespace afc
@@ -0,0 +1,41 @@
+#ifndef __AFC_EDITOR_TRANSFORMATION_MAP_H__
+#define __AFC_EDITOR_TRANSFORMATION_MAP_H__
+
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include "transformation.h"
+
+namespace afc {
+namespace editor {
+
+using std::unique_ptr;
+using std::wstring;
+
+struct MapLinesOptions {
+  // The range of lines to map: [first, last). The end is adjusted to the size
+  // of the buffer.
+  size_t first = 0;
+  size_t last = std::numeric_limits<size_t>::max();
+
+  // Receives the contents of a line in output and adjusts them. Returns false
+  // if the line should be deleted.
+  std::function<bool(wstring* output)> map;
+
+  // If true, map may run concurrently in multiple threads.
+  bool parallel = false;
+};
+
+// Runs map natively over a snapshot of the lines in the range and then
+// replaces, as a single change, the lines that it modified or deleted. Lines
+// that aren't modified are retained (along with their modifiers); lines that
+// are modified lose their modifiers. If all lines are deleted, the buffer is
+// left with a single empty line.
+unique_ptr<Transformation> NewMapLinesTransformation(MapLinesOptions options);
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_TRANSFORMATION_MAP_H__
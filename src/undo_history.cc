@@ -0,0 +1,159 @@
+#include "undo_history.h"
+
+#include <glog/logging.h>
+
+#include "undo_journal.h"
+
+namespace afc {
+namespace editor {
+
+size_t EstimateMemoryUsage(const UndoEntry& entry) {
+  size_t output = sizeof(UndoEntry);
+  for (const auto& delta : entry.deltas) {
+    output += sizeof(delta) + (delta.old_lines.size() + delta.new_lines.size()) *
+                                  sizeof(std::shared_ptr<const Line>);
+    // The new lines are usually shared with the buffer (or with the next
+    // entry); the old lines are only retained by the history.
+    for (const auto& line : delta.old_lines) {
+      output += sizeof(Line) + line->size() * sizeof(wchar_t);
+    }
+  }
+  if (entry.cursors != nullptr) {
+    output += entry.cursors->size() * sizeof(LineColumn);
+  }
+  return output;
+}
+
+void MergeUndoEntries(UndoEntry last, UndoEntry* previous) {
+  CHECK(previous != nullptr);
+  for (auto& delta : last.deltas) {
+    AppendDelta(std::move(delta), &previous->deltas);
+  }
+  previous->modified_buffer |= last.modified_buffer;
+  previous->keystroke_end = last.keystroke_end;
+}
+
+UndoHistory::UndoHistory() = default;
+UndoHistory::~UndoHistory() = default;
+
+void UndoHistory::Push(Stack stack, UndoEntry entry) {
+  if (stack == PAST && journal_ != nullptr && !entry.deltas.empty()) {
+    journal_->Push(entry);
+  }
+  memory_usage_ += EstimateMemoryUsage(entry);
+  entries(stack).push_back(std::move(entry));
+  EnforceMemoryLimit(stack);
+}
+
+UndoEntry UndoHistory::Pop(Stack stack) {
+  CHECK(!empty(stack));
+  UndoEntry output = std::move(entries(stack).back());
+  entries(stack).pop_back();
+  memory_usage_ -= EstimateMemoryUsage(output);
+  if (stack == PAST && journal_ != nullptr && !output.deltas.empty()) {
+    journal_->Pop();
+  }
+  return output;
+}
+
+void UndoHistory::Clear(Stack stack) {
+  for (const auto& entry : entries(stack)) {
+    memory_usage_ -= EstimateMemoryUsage(entry);
+  }
+  entries(stack).clear();
+}
+
+void UndoHistory::CoalesceKeystroke(LineColumn keystroke_end) {
+  if (past_.empty()) {
+    return;
+  }
+  auto last = std::prev(past_.end());
+  last->keystroke = true;
+  last->keystroke_end = keystroke_end;
+  if (last == past_.begin()) {
+    return;
+  }
+  auto previous = std::prev(last);
+  if (!previous->keystroke || previous->keystroke_end != last->active_cursor) {
+    return;
+  }
+  VLOG(5) << "Coalescing keystroke into previous undo entry.";
+  MergeLastEntries();
+}
+
+void UndoHistory::MergeIntoLast(UndoEntry entry) {
+  Push(PAST, std::move(entry));
+  // Pushing may have dropped the previous entry (if the memory limit was
+  // exceeded).
+  if (past_.size() > 1) {
+    MergeLastEntries();
+  }
+}
+
+void UndoHistory::MergeLastEntries() {
+  CHECK_GE(past_.size(), 2u);
+  auto last = std::prev(past_.end());
+  auto previous = std::prev(last);
+  if (journal_ != nullptr && !previous->deltas.empty() &&
+      !last->deltas.empty()) {
+    journal_->Coalesce();
+  }
+  memory_usage_ -= EstimateMemoryUsage(*previous) + EstimateMemoryUsage(*last);
+  MergeUndoEntries(std::move(*last), &*previous);
+  past_.erase(last);
+  memory_usage_ += EstimateMemoryUsage(*previous);
+}
+
+void UndoHistory::set_memory_limit(size_t memory_limit) {
+  memory_limit_ = memory_limit;
+  if (journal_ != nullptr) {
+    journal_->set_memory_limit(memory_limit);
+  }
+}
+
+void UndoHistory::set_journal(std::unique_ptr<UndoJournal> journal) {
+  journal_ = std::move(journal);
+  journal_exhausted_ = false;
+  if (journal_ != nullptr) {
+    journal_->set_memory_limit(memory_limit_);
+  }
+}
+
+bool UndoHistory::LoadJournal(uint64_t contents_checksum) {
+  CHECK(past_.empty());
+  if (journal_ == nullptr || journal_exhausted_) {
+    return false;
+  }
+  journal_exhausted_ = true;
+  std::vector<UndoEntry> entries;
+  if (!journal_->Load(contents_checksum, &entries)) {
+    return false;
+  }
+  // The entries are already in the journal, so we bypass Push.
+  for (auto& entry : entries) {
+    memory_usage_ += EstimateMemoryUsage(entry);
+    past_.push_back(std::move(entry));
+  }
+  EnforceMemoryLimit(FUTURE);
+  return !entries.empty();
+}
+
+void UndoHistory::EnforceMemoryLimit(Stack keep) {
+  for (auto stack : {PAST, FUTURE}) {
+    auto& stack_entries = entries(stack);
+    size_t minimum_size = stack == keep ? 1 : 0;
+    while (memory_usage_ > memory_limit_ &&
+           stack_entries.size() > minimum_size) {
+      VLOG(5) << "Undo history exceeds memory limit, dropping oldest entry.";
+      memory_usage_ -= EstimateMemoryUsage(stack_entries.front());
+      stack_entries.pop_front();
+      if (stack == PAST) {
+        // PAST no longer reaches the start of the session.
+        journal_exhausted_ = true;
+      }
+    }
+  }
+}
+
+}  // namespace editor
+}  // namespace afc
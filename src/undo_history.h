@@ -0,0 +1,114 @@
+#ifndef __AFC_EDITOR_UNDO_HISTORY_H__
+#define __AFC_EDITOR_UNDO_HISTORY_H__
+
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "buffer_contents.h"
+#include "line_column.h"
+
+namespace afc {
+namespace editor {
+
+// An entry in the undo (or redo) history of a buffer.
+struct UndoEntry {
+  // The changes done to the contents of the buffer. To undo the entry, they
+  // are reverted in reverse order.
+  std::vector<BufferContents::Delta> deltas;
+
+  // The cursors to restore after reverting the deltas: active_cursor and, if
+  // there were multiple cursors, all of them. Consecutive entries share the
+  // snapshot when the cursors don't change.
+  LineColumn active_cursor;
+  std::shared_ptr<const std::vector<LineColumn>> cursors;
+
+  bool modified_buffer = false;
+
+  // Set for entries produced by keystrokes in insert mode, along with the
+  // position of the cursor after the keystroke.
+  bool keystroke = false;
+  LineColumn keystroke_end;
+};
+
+// Returns an estimate of the number of bytes that the entry retains.
+size_t EstimateMemoryUsage(const UndoEntry& entry);
+
+// Merges last (which was applied after previous) into previous.
+void MergeUndoEntries(UndoEntry last, UndoEntry* previous);
+
+class UndoJournal;
+
+// The undo and redo stacks of a buffer. Keeps track of the memory retained by
+// the entries and drops the oldest entries when a limit is exceeded.
+class UndoHistory {
+ public:
+  enum Stack { PAST, FUTURE };
+
+  UndoHistory();
+  ~UndoHistory();
+
+  bool empty(Stack stack) const { return entries(stack).empty(); }
+  size_t size(Stack stack) const { return entries(stack).size(); }
+
+  void Push(Stack stack, UndoEntry entry);
+  UndoEntry Pop(Stack stack);
+  void Clear(Stack stack);
+
+  // Marks the last entry in PAST as produced by a keystroke (after which the
+  // cursor was left at keystroke_end). If the previous entry was also produced
+  // by a keystroke that left the cursor where this one started, merges them,
+  // so that a sequence of keystrokes is undone at once.
+  void CoalesceKeystroke(LineColumn keystroke_end);
+
+  // Merges entry into the last entry in PAST (so that they are undone at once)
+  // or, if PAST is empty, pushes it.
+  void MergeIntoLast(UndoEntry entry);
+
+  size_t memory_usage() const { return memory_usage_; }
+  void set_memory_limit(size_t memory_limit);
+
+  // Sets the journal where changes to PAST will be persisted (or nullptr).
+  // Should be called when PAST is empty, at the start of a session: the journal
+  // is able to provide the entries from previous sessions.
+  void set_journal(std::unique_ptr<UndoJournal> journal);
+  UndoJournal* journal() const { return journal_.get(); }
+
+  // Should be called when PAST is empty. If it is possible to extend PAST with
+  // the entries in the journal (from previous sessions), loads them. Returns
+  // true if any entries were loaded. contents_checksum is the checksum of the
+  // contents of the buffer (to detect that they don't match the journal).
+  bool LoadJournal(uint64_t contents_checksum);
+
+ private:
+  std::list<UndoEntry>& entries(Stack stack) {
+    return stack == PAST ? past_ : future_;
+  }
+  const std::list<UndoEntry>& entries(Stack stack) const {
+    return stack == PAST ? past_ : future_;
+  }
+
+  // Merges the last entry in PAST into the previous one.
+  void MergeLastEntries();
+
+  // Drops the oldest entries (but never the last entry in keep) until the
+  // memory usage is below the limit.
+  void EnforceMemoryLimit(Stack keep);
+
+  std::list<UndoEntry> past_;
+  std::list<UndoEntry> future_;
+  size_t memory_usage_ = 0;
+  size_t memory_limit_ = std::numeric_limits<size_t>::max();
+
+  std::unique_ptr<UndoJournal> journal_;
+  // Set once the journal has been loaded (or when it can no longer be loaded
+  // because the oldest entries in PAST were dropped).
+  bool journal_exhausted_ = false;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_UNDO_HISTORY_H__
@@ -0,0 +1,635 @@
+#include "undo_journal.h"
+
+#include <algorithm>
+#include <cstring>
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+}
+
+#include <glog/logging.h>
+
+#include "char_buffer.h"
+#include "wstring.h"
+
+namespace afc {
+namespace editor {
+namespace {
+// The file is compacted when it grows past this size and past twice its size
+// after the last compaction.
+constexpr size_t kCompactionMinimumSize = 1024 * 1024;
+
+// Every record starts with a header with the size of its payload and a checksum
+// of the payload.
+constexpr size_t kHeaderSize = sizeof(uint32_t) + sizeof(uint64_t);
+
+using Entries = std::vector<std::shared_ptr<const UndoEntry>>;
+
+uint64_t Fnv1a(const char* data, size_t size, uint64_t hash) {
+  for (size_t i = 0; i < size; i++) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+constexpr uint64_t kFnv1aOffset = 14695981039346656037ull;
+
+template <typename T>
+void Write(T value, std::string* output) {
+  output->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void WriteString(const std::string& value, std::string* output) {
+  Write<uint64_t>(value.size(), output);
+  output->append(value);
+}
+
+void WritePosition(LineColumn position, std::string* output) {
+  Write<uint64_t>(position.line, output);
+  Write<uint64_t>(position.column, output);
+}
+
+void WriteLines(const std::vector<std::shared_ptr<const Line>>& lines,
+                std::string* output) {
+  Write<uint64_t>(lines.size(), output);
+  for (const auto& line : lines) {
+    WriteString(ToByteString(line->ToString()), output);
+  }
+}
+
+// Reads values from a serialized record. Every method returns false if the
+// record is too short.
+class Reader {
+ public:
+  Reader(const char* data, size_t size) : data_(data), size_(size) {}
+
+  template <typename T>
+  bool Read(T* value) {
+    if (size_ - position_ < sizeof(T)) {
+      return false;
+    }
+    memcpy(value, data_ + position_, sizeof(T));
+    position_ += sizeof(T);
+    return true;
+  }
+
+  bool ReadString(std::string* value) {
+    uint64_t size;
+    if (!Read(&size) || size_ - position_ < size) {
+      return false;
+    }
+    value->assign(data_ + position_, size);
+    position_ += size;
+    return true;
+  }
+
+  bool ReadPosition(LineColumn* position) {
+    uint64_t line, column;
+    if (!Read(&line) || !Read(&column)) {
+      return false;
+    }
+    *position = LineColumn(line, column);
+    return true;
+  }
+
+  bool ReadLines(std::vector<std::shared_ptr<const Line>>* lines) {
+    uint64_t count;
+    if (!Read(&count)) {
+      return false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+      std::string line;
+      if (!ReadString(&line)) {
+        return false;
+      }
+      lines->push_back(std::make_shared<Line>(
+          Line::Options(NewCopyString(FromByteString(line)))));
+    }
+    return true;
+  }
+
+  bool done() const { return position_ == size_; }
+
+ private:
+  const char* const data_;
+  const size_t size_;
+  size_t position_ = 0;
+};
+
+void SerializeEntry(const UndoEntry& entry, std::string* output) {
+  WritePosition(entry.active_cursor, output);
+  Write<uint8_t>(entry.modified_buffer, output);
+  if (entry.cursors == nullptr) {
+    Write<uint64_t>(0, output);
+  } else {
+    Write<uint64_t>(entry.cursors->size(), output);
+    for (auto& cursor : *entry.cursors) {
+      WritePosition(cursor, output);
+    }
+  }
+  Write<uint64_t>(entry.deltas.size(), output);
+  for (const auto& delta : entry.deltas) {
+    Write<uint64_t>(delta.first, output);
+    WriteLines(delta.old_lines, output);
+    WriteLines(delta.new_lines, output);
+  }
+}
+
+bool ParseEntry(Reader* reader, UndoEntry* entry) {
+  uint8_t modified_buffer;
+  uint64_t cursors_count;
+  if (!reader->ReadPosition(&entry->active_cursor) ||
+      !reader->Read(&modified_buffer) || !reader->Read(&cursors_count)) {
+    return false;
+  }
+  entry->modified_buffer = modified_buffer;
+  if (cursors_count > 0) {
+    auto cursors = std::make_shared<std::vector<LineColumn>>();
+    for (uint64_t i = 0; i < cursors_count; i++) {
+      LineColumn cursor;
+      if (!reader->ReadPosition(&cursor)) {
+        return false;
+      }
+      cursors->push_back(cursor);
+    }
+    entry->cursors = std::move(cursors);
+  }
+  uint64_t deltas_count;
+  if (!reader->Read(&deltas_count)) {
+    return false;
+  }
+  for (uint64_t i = 0; i < deltas_count; i++) {
+    BufferContents::Delta delta;
+    uint64_t first;
+    if (!reader->Read(&first) || !reader->ReadLines(&delta.old_lines) ||
+        !reader->ReadLines(&delta.new_lines)) {
+      return false;
+    }
+    delta.first = first;
+    entry->deltas.push_back(std::move(delta));
+  }
+  return true;
+}
+
+void AppendRecord(uint8_t type, const std::string& payload,
+                  std::string* output) {
+  std::string body;
+  Write<uint8_t>(type, &body);
+  body.append(payload);
+  Write<uint32_t>(body.size(), output);
+  Write<uint64_t>(Fnv1a(body.data(), body.size(), kFnv1aOffset), output);
+  output->append(body);
+}
+
+// The state obtained by replaying the records in a journal.
+struct Replay {
+  Entries stack;
+
+  // The stack (and the checksum of the contents) at the last SAVED record.
+  Entries saved_stack;
+  bool has_saved = false;
+  uint64_t saved_checksum = 0;
+  // Offset just after the last SAVED record.
+  size_t saved_end = 0;
+
+  // The stack (and the checksum of its contents) at the last RESTORE record.
+  Entries session_stack;
+  bool session_has_checksum = false;
+  uint64_t session_checksum = 0;
+  // Offset of the last RESTORE record, or std::string::npos.
+  size_t restore_start = std::string::npos;
+
+  // Size of the prefix of valid records.
+  size_t valid_size = 0;
+  size_t records = 0;
+};
+
+// Returns the size of the prefix of data with valid records (with the right
+// checksums).
+size_t ValidPrefixSize(const std::string& data) {
+  size_t position = 0;
+  while (data.size() - position >= kHeaderSize) {
+    uint32_t size;
+    uint64_t checksum;
+    memcpy(&size, data.data() + position, sizeof(size));
+    memcpy(&checksum, data.data() + position + sizeof(size), sizeof(checksum));
+    if (size == 0 || data.size() - position - kHeaderSize < size ||
+        Fnv1a(data.data() + position + kHeaderSize, size, kFnv1aOffset) !=
+            checksum) {
+      break;
+    }
+    position += kHeaderSize + size;
+  }
+  return position;
+}
+
+enum RecordType : uint8_t { PUSH, POP, COALESCE, SAVED, RESTORE };
+
+// Replays the records in data, stopping at the first invalid one.
+Replay ReplayJournal(const std::string& data) {
+  Replay replay;
+  size_t position = 0;
+  while (data.size() - position >= kHeaderSize) {
+    uint32_t size;
+    uint64_t checksum;
+    memcpy(&size, data.data() + position, sizeof(size));
+    memcpy(&checksum, data.data() + position + sizeof(size), sizeof(checksum));
+    if (size == 0 || data.size() - position - kHeaderSize < size) {
+      LOG(INFO) << "Undo journal: truncated record at " << position;
+      break;
+    }
+    const char* body = data.data() + position + kHeaderSize;
+    if (Fnv1a(body, size, kFnv1aOffset) != checksum) {
+      LOG(WARNING) << "Undo journal: checksum mismatch at " << position;
+      break;
+    }
+    Reader reader(body, size);
+    uint8_t type;
+    reader.Read(&type);
+    bool valid = true;
+    switch (type) {
+      case PUSH: {
+        auto entry = std::make_shared<UndoEntry>();
+        valid = ParseEntry(&reader, entry.get());
+        replay.stack.push_back(std::move(entry));
+        break;
+      }
+      case POP:
+        if (!replay.stack.empty()) {
+          replay.stack.pop_back();
+        }
+        break;
+      case COALESCE:
+        if (replay.stack.size() >= 2) {
+          auto previous = std::make_shared<UndoEntry>(
+              *replay.stack[replay.stack.size() - 2]);
+          MergeUndoEntries(*replay.stack.back(), previous.get());
+          replay.stack.pop_back();
+          replay.stack.back() = std::move(previous);
+        }
+        break;
+      case SAVED:
+        valid = reader.Read(&replay.saved_checksum);
+        replay.has_saved = true;
+        replay.saved_stack = replay.stack;
+        replay.saved_end = position + kHeaderSize + size;
+        break;
+      case RESTORE:
+        replay.stack = replay.saved_stack;
+        replay.session_stack = replay.stack;
+        replay.session_has_checksum = replay.has_saved;
+        replay.session_checksum = replay.saved_checksum;
+        replay.restore_start = position;
+        break;
+      default:
+        valid = false;
+    }
+    if (!valid || !reader.done()) {
+      LOG(WARNING) << "Undo journal: invalid record at " << position;
+      break;
+    }
+    position += kHeaderSize + size;
+    replay.valid_size = position;
+    replay.records++;
+  }
+  return replay;
+}
+
+bool ReadFile(const std::string& path, std::string* output) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  char buffer[64 * 1024];
+  ssize_t bytes;
+  while ((bytes = read(fd, buffer, sizeof(buffer))) > 0) {
+    output->append(buffer, bytes);
+  }
+  close(fd);
+  return bytes == 0;
+}
+
+bool WriteAll(int fd, const std::string& data) {
+  size_t position = 0;
+  while (position < data.size()) {
+    ssize_t bytes = write(fd, data.data() + position, data.size() - position);
+    if (bytes == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    position += bytes;
+  }
+  return true;
+}
+}  // namespace
+
+uint64_t ContentsChecksum(const BufferContents& contents) {
+  uint64_t hash = kFnv1aOffset;
+  contents.ForEach([&hash](size_t position, const Line& line) {
+    if (position > 0) {
+      hash = Fnv1a("\n", 1, hash);
+    }
+    std::string str = ToByteString(line.ToString());
+    hash = Fnv1a(str.data(), str.size(), hash);
+    return true;
+  });
+  return hash;
+}
+
+/* static */ std::string UndoJournal::SerializeRecord(
+    const Operation& operation) {
+  std::string payload;
+  std::string output;
+  switch (operation.type) {
+    case Operation::PUSH:
+      SerializeEntry(operation.entry, &payload);
+      AppendRecord(PUSH, payload, &output);
+      break;
+    case Operation::POP:
+      AppendRecord(POP, payload, &output);
+      break;
+    case Operation::COALESCE:
+      AppendRecord(COALESCE, payload, &output);
+      break;
+    case Operation::SAVED:
+      Write<uint64_t>(operation.contents_checksum, &payload);
+      AppendRecord(SAVED, payload, &output);
+      break;
+    case Operation::RESTORE:
+      AppendRecord(RESTORE, payload, &output);
+      break;
+    case Operation::COMPACT:
+      LOG(FATAL) << "Compaction isn't a record.";
+  }
+  return output;
+}
+
+UndoJournal::UndoJournal(std::wstring path) : path_(std::move(path)) {
+  Operation restore;
+  restore.type = Operation::RESTORE;
+  Schedule(std::move(restore));
+  background_thread_ = std::thread([this]() { BackgroundThread(); });
+}
+
+UndoJournal::~UndoJournal() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  condition_.notify_all();
+  background_thread_.join();
+}
+
+void UndoJournal::Push(const UndoEntry& entry) {
+  Operation operation;
+  operation.type = Operation::PUSH;
+  operation.entry = entry;
+  Schedule(std::move(operation));
+}
+
+void UndoJournal::Pop() {
+  Operation operation;
+  operation.type = Operation::POP;
+  Schedule(std::move(operation));
+}
+
+void UndoJournal::Coalesce() {
+  Operation operation;
+  operation.type = Operation::COALESCE;
+  Schedule(std::move(operation));
+}
+
+void UndoJournal::Saved(uint64_t contents_checksum) {
+  Operation operation;
+  operation.type = Operation::SAVED;
+  operation.contents_checksum = contents_checksum;
+  Schedule(std::move(operation));
+}
+
+void UndoJournal::set_memory_limit(size_t memory_limit) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  memory_limit_ = memory_limit;
+}
+
+bool UndoJournal::Load(uint64_t contents_checksum,
+                       std::vector<UndoEntry>* output) {
+  CHECK(output != nullptr);
+  Flush();
+  // The background thread is idle (and only we could schedule operations), so
+  // it's safe to read the file.
+  std::string data;
+  if (!ReadFile(ToByteString(path_), &data)) {
+    LOG(INFO) << path_ << ": Unable to read undo journal.";
+    return false;
+  }
+  Replay replay = ReplayJournal(data);
+  if (replay.session_stack.empty()) {
+    return false;
+  }
+  if (!replay.session_has_checksum ||
+      replay.session_checksum != contents_checksum) {
+    LOG(INFO) << path_ << ": Undo journal doesn't match the contents.";
+    return false;
+  }
+  for (const auto& entry : replay.session_stack) {
+    output->push_back(*entry);
+  }
+  return true;
+}
+
+void UndoJournal::Compact() {
+  Operation operation;
+  operation.type = Operation::COMPACT;
+  Schedule(std::move(operation));
+}
+
+void UndoJournal::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_.wait(lock, [this]() { return operations_.empty() && !busy_; });
+}
+
+void UndoJournal::Schedule(Operation operation) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    operations_.push_back(std::move(operation));
+  }
+  condition_.notify_all();
+}
+
+void UndoJournal::BackgroundThread() {
+  // Discard any invalid tail (e.g., from a write that was interrupted), so that
+  // the records we append are reachable.
+  const std::string path = ToByteString(path_);
+  std::string data;
+  if (ReadFile(path, &data)) {
+    file_size_ = ValidPrefixSize(data);
+    if (file_size_ < data.size()) {
+      LOG(WARNING) << path << ": Truncating undo journal: " << data.size()
+                   << " -> " << file_size_;
+      if (truncate(path.c_str(), file_size_) == -1) {
+        LOG(INFO) << path << ": truncate failed: " << strerror(errno);
+      }
+    }
+    compacted_size_ = file_size_;
+  }
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this]() {
+      return shutting_down_ || !operations_.empty();
+    });
+    if (operations_.empty()) {
+      CHECK(shutting_down_);
+      return;
+    }
+    std::deque<Operation> operations;
+    operations.swap(operations_);
+    size_t memory_limit = memory_limit_;
+    busy_ = true;
+    lock.unlock();
+
+    std::string records;
+    bool compact = false;
+    for (const auto& operation : operations) {
+      if (operation.type == Operation::COMPACT) {
+        compact = true;
+      } else {
+        records += SerializeRecord(operation);
+      }
+    }
+    Append(records);
+    if (compact || (file_size_ > kCompactionMinimumSize &&
+                    file_size_ > 2 * compacted_size_)) {
+      CompactFile(memory_limit);
+    }
+
+    lock.lock();
+    busy_ = false;
+    lock.unlock();
+    condition_.notify_all();
+  }
+}
+
+void UndoJournal::Append(const std::string& records) {
+  if (records.empty()) {
+    return;
+  }
+  int fd = open(ToByteString(path_).c_str(), O_WRONLY | O_APPEND | O_CREAT,
+                0600);
+  if (fd == -1) {
+    LOG(INFO) << path_ << ": Unable to open undo journal: " << strerror(errno);
+    return;
+  }
+  if (!WriteAll(fd, records)) {
+    LOG(INFO) << path_ << ": Unable to write undo journal: " << strerror(errno);
+  }
+  close(fd);
+  file_size_ += records.size();
+}
+
+void UndoJournal::CompactFile(size_t memory_limit) {
+  const std::string path = ToByteString(path_);
+  std::string data;
+  if (!ReadFile(path, &data)) {
+    return;
+  }
+  Replay replay = ReplayJournal(data);
+
+  // If the contents were saved during the current session, the compacted
+  // journal must still contain the RESTORE record of the session (Load uses
+  // it to find the entries from previous sessions). We rebuild the stack at
+  // the start of the session, restore it, and then transform it into the
+  // stack at the last save.
+  bool saved_in_session = replay.restore_start != std::string::npos &&
+                          replay.has_saved &&
+                          replay.saved_end > replay.restore_start;
+  const Entries& first_stack =
+      saved_in_session ? replay.session_stack : replay.saved_stack;
+  // The number of entries at the bottom of first_stack that are also in
+  // replay.saved_stack.
+  size_t shared = first_stack.size();
+  if (saved_in_session) {
+    shared = 0;
+    while (shared < first_stack.size() &&
+           shared < replay.saved_stack.size() &&
+           first_stack[shared] == replay.saved_stack[shared]) {
+      shared++;
+    }
+  }
+
+  // Drop the oldest entries that don't fit in the memory limit.
+  size_t start = first_stack.size();
+  size_t memory_usage = 0;
+  while (start > 0) {
+    memory_usage += EstimateMemoryUsage(*first_stack[start - 1]);
+    if (memory_usage > memory_limit) {
+      break;
+    }
+    start--;
+  }
+  start = std::min(start, shared);
+
+  std::string output;
+  Operation operation;
+  operation.type = Operation::PUSH;
+  for (size_t i = start; i < first_stack.size(); i++) {
+    operation.entry = *first_stack[i];
+    output += SerializeRecord(operation);
+  }
+  if (saved_in_session) {
+    if (replay.session_has_checksum) {
+      operation.type = Operation::SAVED;
+      operation.contents_checksum = replay.session_checksum;
+      output += SerializeRecord(operation);
+    }
+    operation.type = Operation::RESTORE;
+    output += SerializeRecord(operation);
+    operation.type = Operation::POP;
+    for (size_t i = shared; i < first_stack.size(); i++) {
+      output += SerializeRecord(operation);
+    }
+    operation.type = Operation::PUSH;
+    for (size_t i = shared; i < replay.saved_stack.size(); i++) {
+      operation.entry = *replay.saved_stack[i];
+      output += SerializeRecord(operation);
+    }
+  }
+  size_t tail = replay.saved_end;
+  if (replay.has_saved) {
+    operation.type = Operation::SAVED;
+    operation.contents_checksum = replay.saved_checksum;
+    output += SerializeRecord(operation);
+  }
+  // Records between the last SAVED and the last RESTORE have no effect.
+  if (replay.restore_start != std::string::npos &&
+      replay.restore_start > tail) {
+    tail = replay.restore_start;
+  }
+  output.append(data, tail, replay.valid_size - tail);
+
+  const std::string tmp_path = path + ".tmp";
+  int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd == -1) {
+    LOG(INFO) << tmp_path << ": Unable to open: " << strerror(errno);
+    return;
+  }
+  bool success = WriteAll(fd, output);
+  close(fd);
+  if (!success || rename(tmp_path.c_str(), path.c_str()) == -1) {
+    LOG(INFO) << path << ": Unable to compact undo journal: "
+              << strerror(errno);
+    return;
+  }
+  LOG(INFO) << path << ": Compacted undo journal: " << data.size() << " -> "
+            << output.size() << " bytes.";
+  file_size_ = output.size();
+  compacted_size_ = file_size_;
+}
+
+}  // namespace editor
+}  // namespace afc
@@ -0,0 +1,103 @@
+#ifndef __AFC_EDITOR_UNDO_JOURNAL_H__
+#define __AFC_EDITOR_UNDO_JOURNAL_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer_contents.h"
+#include "undo_history.h"
+
+namespace afc {
+namespace editor {
+
+// Returns a checksum of the contents of a buffer, used to validate that the
+// entries in an undo journal apply to it.
+uint64_t ContentsChecksum(const BufferContents& contents);
+
+// An append-only file that persists the PAST stack of the undo history of a
+// buffer across sessions. Every change to the stack is appended as a record
+// (with a checksum, so that a truncated or corrupted tail is ignored):
+//
+// - PUSH: an entry was pushed.
+// - POP: the last entry was removed.
+// - COALESCE: the last two entries were merged (see MergeUndoEntries).
+// - SAVED: the buffer was saved; carries the ContentsChecksum of its contents.
+// - RESTORE: a session started from the file in disk, so the stack goes back
+//   to what it was at the last SAVED record.
+//
+// Records are written (and the file is compacted, when it grows too large) by
+// a background thread. The file is only read when the entries are needed.
+class UndoJournal {
+ public:
+  // Appends a RESTORE record to the journal at path (creating it if needed).
+  UndoJournal(std::wstring path);
+  ~UndoJournal();
+
+  const std::wstring& path() const { return path_; }
+
+  void Push(const UndoEntry& entry);
+  void Pop();
+  void Coalesce();
+  void Saved(uint64_t contents_checksum);
+
+  // Bounds (approximately) the memory used by the entries retained when the
+  // journal is compacted; the oldest entries are dropped.
+  void set_memory_limit(size_t memory_limit);
+
+  // Reads the entries in the stack at the start of the current session
+  // (oldest first). Returns false if the journal can't be read or if the
+  // contents of the buffer at the last save don't match contents_checksum.
+  bool Load(uint64_t contents_checksum, std::vector<UndoEntry>* output);
+
+  // Rewrites the file keeping only the records required to reproduce the
+  // stack. Happens automatically when the file grows too large.
+  void Compact();
+
+  // Blocks until all pending records have been written.
+  void Flush();
+
+ private:
+  // A record to append (serialized by the background thread) or a request to
+  // compact the file.
+  struct Operation {
+    enum Type { PUSH, POP, COALESCE, SAVED, RESTORE, COMPACT };
+    Type type;
+    UndoEntry entry;
+    uint64_t contents_checksum = 0;
+  };
+
+  // Returns the record (header and payload) for an operation.
+  static std::string SerializeRecord(const Operation& operation);
+
+  void Schedule(Operation operation);
+  void BackgroundThread();
+  void Append(const std::string& records);
+  void CompactFile(size_t memory_limit);
+
+  const std::wstring path_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<Operation> operations_;
+  bool busy_ = false;
+  bool shutting_down_ = false;
+  size_t memory_limit_ = std::numeric_limits<size_t>::max();
+
+  // Only accessed by the background thread.
+  size_t file_size_ = 0;
+  size_t compacted_size_ = 0;
+
+  std::thread background_thread_;
+};
+
+}  // namespace editor
+}  // namespace afc
+
+#endif  // __AFC_EDITOR_UNDO_JOURNAL_H__
@@ -1,7 +1,9 @@
 #include "append_expression.h"
 
+#include "../public/constant_expression.h"
 #include "../public/value.h"
 #include "../public/vm.h"
+#include "bytecode.h"
 
 namespace afc {
 namespace vm {
@@ -27,6 +29,11 @@ class AppendExpression : public Expression {
         });
   }
 
+  void CompileBytecode(BytecodeCompiler* compiler, size_t output) override {
+    compiler->Compile(e0_.get(), output);
+    compiler->Compile(e1_.get(), output);
+  }
+
   std::unique_ptr<Expression> Clone() override {
     return std::make_unique<AppendExpression>(e0_, e1_);
   }
@@ -43,6 +50,10 @@ std::unique_ptr<Expression> NewAppendExpression(std::unique_ptr<Expression> a,
   if (a == nullptr || b == nullptr) {
     return nullptr;
   }
+  if (GetConstantValue(a.get()) != nullptr) {
+    // Evaluating a constant has no effects.
+    return b;
+  }
   return std::make_unique<AppendExpression>(std::move(a), std::move(b));
 }
 
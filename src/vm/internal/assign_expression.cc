@@ -5,6 +5,7 @@
 #include "../public/environment.h"
 #include "../public/value.h"
 #include "../public/vm.h"
+#include "bytecode.h"
 #include "compilation.h"
 #include "wstring.h"
 
@@ -16,30 +17,40 @@ namespace {
 // TODO: Don't pass symbol by const reference.
 class AssignExpression : public Expression {
  public:
-  AssignExpression(const wstring& symbol, unique_ptr<Expression> value)
-      : symbol_(symbol), value_(std::move(value)) {}
+  AssignExpression(const wstring& symbol, Environment::Slot slot,
+                   unique_ptr<Expression> value)
+      : symbol_(symbol), slot_(slot), value_(std::move(value)) {}
 
   const VMType& type() { return value_->type(); }
 
   void Evaluate(Trampoline* trampoline) override {
     auto expression = value_;
     auto symbol = symbol_;
+    auto slot = slot_;
     trampoline->Bounce(
-        expression.get(), [expression, symbol](std::unique_ptr<Value> value,
-                                               Trampoline* trampoline) {
+        expression.get(), [expression, symbol, slot](std::unique_ptr<Value> value,
+                                                     Trampoline* trampoline) {
           DVLOG(3) << "Setting value for: " << symbol;
           DVLOG(4) << "Value: " << *value;
-          trampoline->environment()->Assign(symbol, std::move(value));
+          trampoline->environment()->Assign(slot, std::move(value));
           trampoline->Continue(Value::NewVoid());
         });
   }
 
+  void CompileBytecode(BytecodeCompiler* compiler, size_t output) override {
+    compiler->Compile(value_.get(), output);
+    compiler->Emit(Opcode::STORE_SLOT, compiler->AddSlot(slot_), output);
+    compiler->Emit(Opcode::LOAD_CONSTANT, output,
+                   compiler->AddConstant(Value::NewVoid()));
+  }
+
   std::unique_ptr<Expression> Clone() override {
-    return std::make_unique<AssignExpression>(symbol_, value_->Clone());
+    return std::make_unique<AssignExpression>(symbol_, slot_, value_->Clone());
   }
 
  private:
   const wstring symbol_;
+  const Environment::Slot slot_;
   const std::shared_ptr<Expression> value_;
 };
 
@@ -58,15 +69,19 @@ unique_ptr<Expression> NewAssignExpression(Compilation* compilation,
     compilation->errors.push_back(L"Unknown type: \"" + symbol + L"\"");
     return nullptr;
   }
-  compilation->environment->Define(symbol,
-                                   std::make_unique<Value>(value->type()));
+  VMType value_type = value->type();
+  compilation->Define(symbol, [value_type](Environment*) {
+    return std::make_unique<Value>(value_type);
+  });
   if (!(*type_def == value->type())) {
     compilation->errors.push_back(
         L"Unable to assign a value of type \"" + value->type().ToString() +
         L"\" to a variable of type \"" + type_def->ToString() + L"\".");
     return nullptr;
   }
-  return std::make_unique<AssignExpression>(symbol, std::move(value));
+  Environment::Slot slot;
+  CHECK(compilation->environment->Resolve(symbol, &slot));
+  return std::make_unique<AssignExpression>(symbol, slot, std::move(value));
 }
 
 unique_ptr<Expression> NewAssignExpression(Compilation* compilation,
@@ -75,7 +90,10 @@ unique_ptr<Expression> NewAssignExpression(Compilation* compilation,
   if (value == nullptr) {
     return nullptr;
   }
-  auto obj = compilation->environment->Lookup(symbol);
+  Environment::Slot slot;
+  Value* obj = compilation->environment->Resolve(symbol, &slot)
+                   ? compilation->environment->Lookup(slot)
+                   : nullptr;
   if (obj == nullptr) {
     compilation->errors.push_back(L"Variable not found: \"" + symbol + L"\"");
     return nullptr;
@@ -87,7 +105,7 @@ unique_ptr<Expression> NewAssignExpression(Compilation* compilation,
     return nullptr;
   }
 
-  return std::make_unique<AssignExpression>(symbol, std::move(value));
+  return std::make_unique<AssignExpression>(symbol, slot, std::move(value));
 }
 
 }  // namespace vm
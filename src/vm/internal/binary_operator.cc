@@ -2,7 +2,9 @@
 
 #include <glog/logging.h>
 
+#include "../public/constant_expression.h"
 #include "../public/value.h"
+#include "bytecode.h"
 
 namespace afc {
 namespace vm {
@@ -40,10 +42,37 @@ void BinaryOperator::Evaluate(Trampoline* trampoline) {
       });
 }
 
+void BinaryOperator::CompileBytecode(BytecodeCompiler* compiler,
+                                     size_t output) {
+  compiler->Compile(a_.get(), output);
+  size_t b_register = compiler->NewRegister();
+  compiler->Compile(b_.get(), b_register);
+  compiler->Emit(Opcode::BINARY_OPERATOR, output, b_register,
+                 compiler->AddBinaryOperator(type_, operator_));
+  compiler->ReleaseRegisters(b_register);
+}
+
 std::unique_ptr<Expression> BinaryOperator::Clone() {
   return std::make_unique<BinaryOperator>(a_->Clone(), b_->Clone(), type_,
                                           operator_);
 }
 
+unique_ptr<Expression> NewBinaryExpression(
+    unique_ptr<Expression> a, unique_ptr<Expression> b, const VMType type,
+    function<void(const Value&, const Value&, Value*)> callback) {
+  CHECK(a != nullptr);
+  CHECK(b != nullptr);
+  const Value* a_value = GetConstantValue(a.get());
+  const Value* b_value = GetConstantValue(b.get());
+  if (a_value != nullptr && b_value != nullptr) {
+    auto output = std::make_unique<Value>(type);
+    callback(*a_value, *b_value, output.get());
+    DVLOG(5) << "Folded constant expression: " << *output;
+    return NewConstantExpression(std::move(output));
+  }
+  return std::make_unique<BinaryOperator>(std::move(a), std::move(b), type,
+                                          std::move(callback));
+}
+
 }  // namespace vm
 }  // namespace afc
@@ -21,6 +21,8 @@ class BinaryOperator : public Expression {
 
   void Evaluate(Trampoline* evaluation);
 
+  void CompileBytecode(BytecodeCompiler* compiler, size_t output) override;
+
   std::unique_ptr<Expression> Clone() override;
 
  private:
@@ -30,6 +32,12 @@ class BinaryOperator : public Expression {
   std::function<void(const Value&, const Value&, Value*)> operator_;
 };
 
+// Returns a constant expression if both operands are constants (the operator
+// must not have side effects).
+unique_ptr<Expression> NewBinaryExpression(
+    unique_ptr<Expression> a, unique_ptr<Expression> b, const VMType type,
+    function<void(const Value&, const Value&, Value*)> callback);
+
 }  // namespace vm
 }  // namespace afc
 
@@ -0,0 +1,300 @@
+#include "bytecode.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "../public/constant_expression.h"
+
+namespace afc {
+namespace vm {
+
+void Expression::CompileBytecode(BytecodeCompiler* compiler, size_t output) {
+  compiler->Emit(Opcode::EVALUATE, output, compiler->AddExpression(this));
+}
+
+BytecodeCompiler::BytecodeCompiler() : program_(std::make_unique<Program>()) {}
+
+size_t BytecodeCompiler::NewRegister() {
+  size_t output = next_register_++;
+  program_->registers = std::max(program_->registers, next_register_);
+  return output;
+}
+
+void BytecodeCompiler::ReleaseRegisters(size_t first) {
+  CHECK_LE(first, next_register_);
+  next_register_ = first;
+}
+
+void BytecodeCompiler::Compile(Expression* expression, size_t output) {
+  CHECK(expression != nullptr);
+  CHECK_LT(output, next_register_);
+  expression->CompileBytecode(this, output);
+}
+
+size_t BytecodeCompiler::Emit(Opcode opcode, size_t a, size_t b, size_t c) {
+  Instruction instruction;
+  instruction.opcode = opcode;
+  instruction.a = a;
+  instruction.b = b;
+  instruction.c = c;
+  program_->instructions.push_back(instruction);
+  return program_->instructions.size() - 1;
+}
+
+void BytecodeCompiler::SetJumpTarget(size_t position, size_t target) {
+  Instruction* instruction = &program_->instructions.at(position);
+  switch (instruction->opcode) {
+    case Opcode::JUMP:
+      instruction->a = target;
+      break;
+    case Opcode::JUMP_IF:
+      instruction->c = target;
+      break;
+    default:
+      LOG(FATAL) << "Not a jump instruction: " << position;
+  }
+}
+
+size_t BytecodeCompiler::AddConstant(std::unique_ptr<Value> value) {
+  CHECK(value != nullptr);
+  program_->constants.push_back(std::move(value));
+  return program_->constants.size() - 1;
+}
+
+size_t BytecodeCompiler::AddSlot(Environment::Slot slot) {
+  program_->slots.push_back(slot);
+  return program_->slots.size() - 1;
+}
+
+size_t BytecodeCompiler::AddBinaryOperator(
+    VMType type,
+    std::function<void(const Value&, const Value&, Value*)> callback) {
+  program_->binary_operators.push_back({std::move(type), std::move(callback)});
+  return program_->binary_operators.size() - 1;
+}
+
+size_t BytecodeCompiler::AddNegateOperator(std::function<void(Value*)> negate) {
+  program_->negate_operators.push_back(std::move(negate));
+  return program_->negate_operators.size() - 1;
+}
+
+size_t BytecodeCompiler::AddExpression(Expression* expression) {
+  program_->expressions.push_back(expression);
+  return program_->expressions.size() - 1;
+}
+
+std::unique_ptr<Program> BytecodeCompiler::Build() {
+  auto output = std::move(program_);
+  program_ = std::make_unique<Program>();
+  next_register_ = 0;
+  return output;
+}
+
+namespace {
+
+// The state of an evaluation of a program.
+struct Frame {
+  Frame(std::shared_ptr<const Program> input_program)
+      : program(std::move(input_program)),
+        registers(program->registers, Value(VMType::VM_VOID)) {}
+
+  const std::shared_ptr<const Program> program;
+  // Values are held directly (rather than through Value::Ptr) so that
+  // evaluating expressions that don't involve calls doesn't allocate.
+  std::vector<Value> registers;
+  size_t next_instruction = 0;
+
+  // Set while Run is executing instructions from this frame.
+  bool running = false;
+  // Set while a call (or an expression evaluated in the trampoline) hasn't
+  // delivered its value.
+  bool waiting = false;
+};
+
+void Run(std::shared_ptr<Frame> frame, Trampoline* trampoline);
+
+// Receives the value of a call. If the call completed synchronously, Run is
+// still on the stack and will pick up the value; otherwise, resumes execution.
+void Deliver(std::shared_ptr<Frame> frame, size_t output, Value::Ptr value,
+             Trampoline* trampoline) {
+  CHECK(value != nullptr);
+  CHECK(frame->waiting);
+  frame->registers[output] = std::move(*value);
+  frame->waiting = false;
+  if (!frame->running) {
+    Run(std::move(frame), trampoline);
+  }
+}
+
+void Run(std::shared_ptr<Frame> frame, Trampoline* trampoline) {
+  CHECK(!frame->running);
+  CHECK(!frame->waiting);
+  const Program& program = *frame->program;
+  std::vector<Value>& registers = frame->registers;
+  frame->running = true;
+  while (true) {
+    CHECK_LT(frame->next_instruction, program.instructions.size());
+    const Instruction& instruction =
+        program.instructions[frame->next_instruction++];
+    switch (instruction.opcode) {
+      case Opcode::LOAD_CONSTANT:
+        registers[instruction.a] = *program.constants[instruction.b];
+        break;
+
+      case Opcode::LOAD_SLOT: {
+        Value* value =
+            trampoline->environment()->Lookup(program.slots[instruction.b]);
+        CHECK(value != nullptr);
+        registers[instruction.a] = *value;
+        break;
+      }
+
+      case Opcode::STORE_SLOT: {
+        Value* value =
+            trampoline->environment()->Lookup(program.slots[instruction.a]);
+        CHECK(value != nullptr);
+        *value = std::move(registers[instruction.b]);
+        break;
+      }
+
+      case Opcode::BINARY_OPERATOR: {
+        const auto& binary_operator = program.binary_operators[instruction.c];
+        Value value(binary_operator.type);
+        binary_operator.callback(registers[instruction.a],
+                                 registers[instruction.b], &value);
+        registers[instruction.a] = std::move(value);
+        break;
+      }
+
+      case Opcode::NEGATE:
+        program.negate_operators[instruction.b](&registers[instruction.a]);
+        break;
+
+      case Opcode::JUMP:
+        frame->next_instruction = instruction.a;
+        break;
+
+      case Opcode::JUMP_IF:
+        if (registers[instruction.a].boolean() == (instruction.b != 0)) {
+          frame->next_instruction = instruction.c;
+        }
+        break;
+
+      case Opcode::CALL: {
+        Value callee = std::move(registers[instruction.b]);
+        CHECK_EQ(callee.type.type, VMType::FUNCTION);
+        std::vector<Value::Ptr> args;
+        args.reserve(instruction.c);
+        for (size_t i = 0; i < instruction.c; i++) {
+          args.push_back(std::make_unique<Value>(
+              std::move(registers[instruction.b + 1 + i])));
+        }
+        size_t output = instruction.a;
+        // Shared, so that copying the continuation (which the callee may do
+        // many times) doesn't copy the state, which contains the continuations
+        // of all the calls in the stack.
+        auto original_state =
+            std::make_shared<std::function<void(Trampoline*)>>(
+                trampoline->Save());
+        Trampoline::Continuation resume = [frame, output, original_state](
+                                              Value::Ptr value,
+                                              Trampoline* trampoline) {
+          // Make copies, since restoring the state may delete us.
+          auto frame_copy = frame;
+          auto output_copy = output;
+          auto original_state_copy = original_state;
+          (*original_state_copy)(trampoline);
+          Deliver(std::move(frame_copy), output_copy, std::move(value),
+                  trampoline);
+        };
+        frame->waiting = true;
+        trampoline->SetReturnContinuation(resume);
+        trampoline->SetContinuation(std::move(resume));
+        callee.callback()(std::move(args), trampoline);
+        if (frame->waiting) {
+          DVLOG(6) << "Call will complete asynchronously.";
+          frame->running = false;
+          return;
+        }
+        break;
+      }
+
+      case Opcode::EVALUATE: {
+        size_t output = instruction.a;
+        frame->waiting = true;
+        frame->running = false;
+        trampoline->Bounce(program.expressions[instruction.b],
+                           [frame, output](Value::Ptr value,
+                                           Trampoline* trampoline) {
+                             Deliver(frame, output, std::move(value),
+                                     trampoline);
+                           });
+        return;
+      }
+
+      case Opcode::RETURN:
+        frame->running = false;
+        trampoline->Return(
+            std::make_unique<Value>(std::move(registers[instruction.a])));
+        return;
+
+      case Opcode::END:
+        frame->running = false;
+        trampoline->Continue(
+            std::make_unique<Value>(std::move(registers[instruction.a])));
+        return;
+    }
+  }
+}
+
+class BytecodeExpression : public Expression {
+ public:
+  BytecodeExpression(std::shared_ptr<Expression> expression,
+                     std::shared_ptr<const Program> program)
+      : expression_(std::move(expression)), program_(std::move(program)) {
+    CHECK(expression_ != nullptr);
+    CHECK(program_ != nullptr);
+  }
+
+  const VMType& type() { return expression_->type(); }
+
+  void Evaluate(Trampoline* trampoline) override {
+    Run(std::make_shared<Frame>(program_), trampoline);
+  }
+
+  std::unique_ptr<Expression> Clone() override {
+    return std::make_unique<BytecodeExpression>(expression_, program_);
+  }
+
+ private:
+  // The program may point to subexpressions, so we retain it.
+  const std::shared_ptr<Expression> expression_;
+  const std::shared_ptr<const Program> program_;
+};
+
+}  // namespace
+
+std::unique_ptr<Expression> NewBytecodeExpression(
+    std::unique_ptr<Expression> expression) {
+  CHECK(expression != nullptr);
+  if (GetConstantValue(expression.get()) != nullptr) {
+    return expression;
+  }
+  BytecodeCompiler compiler;
+  size_t output = compiler.NewRegister();
+  compiler.Compile(expression.get(), output);
+  compiler.Emit(Opcode::END, output);
+  std::shared_ptr<const Program> program = compiler.Build();
+  if (program->expressions.size() == 1 &&
+      program->expressions[0] == expression.get()) {
+    return expression;
+  }
+  DVLOG(5) << "Compiled expression to bytecode, instructions: "
+           << program->instructions.size();
+  return std::make_unique<BytecodeExpression>(std::move(expression),
+                                              std::move(program));
+}
+
+}  // namespace vm
+}  // namespace afc
@@ -0,0 +1,115 @@
+#ifndef __AFC_VM_BYTECODE_H__
+#define __AFC_VM_BYTECODE_H__
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "../public/environment.h"
+#include "../public/types.h"
+#include "../public/value.h"
+#include "../public/vm.h"
+
+namespace afc {
+namespace vm {
+
+// Expressions are compiled into programs for a register machine. Each
+// instruction operates on the registers of the frame executing the program;
+// the operands index either registers or the tables in the program.
+enum class Opcode {
+  // registers[a] = copy of constants[b].
+  LOAD_CONSTANT,
+  // registers[a] = copy of the value in slots[b] of the environment.
+  LOAD_SLOT,
+  // Moves registers[b] into slots[a] of the environment.
+  STORE_SLOT,
+  // registers[a] = binary_operators[c](registers[a], registers[b]).
+  BINARY_OPERATOR,
+  // Applies negate_operators[b] to registers[a].
+  NEGATE,
+  // Continues execution at instruction a.
+  JUMP,
+  // Continues execution at instruction c if registers[a]->boolean() == b.
+  JUMP_IF,
+  // Calls the function in registers[b] with the c values in the registers that
+  // follow it as arguments and stores its result in registers[a].
+  CALL,
+  // Evaluates expressions[b] in the trampoline and stores its value in
+  // registers[a].
+  EVALUATE,
+  // Returns registers[a] from the function being evaluated.
+  RETURN,
+  // Terminates the program; registers[a] is the value of the expression.
+  END,
+};
+
+struct Instruction {
+  Opcode opcode;
+  size_t a = 0;
+  size_t b = 0;
+  size_t c = 0;
+};
+
+struct Program {
+  struct Operator {
+    VMType type;
+    std::function<void(const Value&, const Value&, Value*)> callback;
+  };
+
+  std::vector<Instruction> instructions;
+  std::vector<std::unique_ptr<Value>> constants;
+  std::vector<Environment::Slot> slots;
+  std::vector<Operator> binary_operators;
+  std::vector<std::function<void(Value*)>> negate_operators;
+  // Expressions that are evaluated in the trampoline. They are owned by the
+  // expression from which the program was compiled.
+  std::vector<Expression*> expressions;
+  size_t registers = 0;
+};
+
+class BytecodeCompiler {
+ public:
+  BytecodeCompiler();
+
+  // Registers are allocated as a stack: ReleaseRegisters(first) releases first
+  // and all registers allocated after it.
+  size_t NewRegister();
+  void ReleaseRegisters(size_t first);
+
+  // Emits the instructions for an expression, leaving its value in output.
+  void Compile(Expression* expression, size_t output);
+
+  // Returns the position of the new instruction.
+  size_t Emit(Opcode opcode, size_t a = 0, size_t b = 0, size_t c = 0);
+  size_t next_instruction() const { return program_->instructions.size(); }
+  // Adjusts the target of a JUMP or JUMP_IF instruction.
+  void SetJumpTarget(size_t instruction, size_t target);
+
+  // Each of these adds an entry to a table in the program and returns its
+  // position.
+  size_t AddConstant(std::unique_ptr<Value> value);
+  size_t AddSlot(Environment::Slot slot);
+  size_t AddBinaryOperator(
+      VMType type,
+      std::function<void(const Value&, const Value&, Value*)> callback);
+  size_t AddNegateOperator(std::function<void(Value*)> negate);
+  size_t AddExpression(Expression* expression);
+
+  std::unique_ptr<Program> Build();
+
+ private:
+  std::unique_ptr<Program> program_;
+  size_t next_register_ = 0;
+};
+
+// Compiles an expression into a program and returns an expression that
+// evaluates it. Only calls to functions (which may need to suspend the
+// evaluation) go through the trampoline. If the expression is a constant or
+// nothing in it can be compiled, returns it unmodified.
+std::unique_ptr<Expression> NewBytecodeExpression(
+    std::unique_ptr<Expression> expression);
+
+}  // namespace vm
+}  // namespace afc
+
+#endif  // __AFC_VM_BYTECODE_H__
@@ -1,6 +1,7 @@
 #ifndef __AFC_VM_COMPILATION_H__
 #define __AFC_VM_COMPILATION_H__
 
+#include <functional>
 #include <list>
 #include <memory>
 #include <string>
@@ -20,14 +21,29 @@ using std::wstring;
 class VMType;
 class Expression;
 class Environment;
+class Value;
 
 struct Compilation {
+  // A symbol defined by the compilation. Since expressions resolve symbols to
+  // slots during compilation, an expression can only be evaluated in an
+  // environment other than the one in which it was compiled after replaying
+  // the definitions (in the same order) in that environment.
+  struct Definition {
+    wstring symbol;
+    // Returns the initial value for the symbol in a given environment.
+    std::function<unique_ptr<Value>(Environment*)> value;
+  };
+
   void AddError(wstring error) {
     // TODO: Enable this logging statement.
     // LOG(INFO) << "Compilation error: " << error;
     errors.push_back(std::move(error));
   }
 
+  // Defines a symbol in the current environment and records the definition.
+  void Define(const wstring& symbol,
+              std::function<unique_ptr<Value>(Environment*)> value);
+
   // The directory containing the file currently being compiled. Used for
   // resolving relative paths (that are relative to this directory, rather than
   // to cwd).
@@ -40,8 +56,22 @@ struct Compilation {
   list<VMType> return_types;
   Environment* environment;
   wstring last_token;
+
+  // A stack parallel to the environments: we push_back when starting
+  // compilation of a new function. The first entry holds the definitions in
+  // the environment in which the compilation started.
+  list<vector<Definition>> definitions = list<vector<Definition>>(1);
+
+  // The paths of all the files read (including those that failed to open).
+  vector<string> files;
 };
 
+// Compiles a file in the environment of the compilation. Unlike the CompileFile
+// in vm.h, allows the caller to inspect the compilation afterwards.
+unique_ptr<Expression> CompileFile(const string& path,
+                                   Compilation* compilation,
+                                   wstring* error_description);
+
 }  // namespace vm
 }  // namespace afc
 
@@ -0,0 +1,165 @@
+#include "../public/compilation_cache.h"
+
+#include <cstdlib>
+#include <utility>
+
+#include <sys/stat.h>
+
+#include <glog/logging.h>
+
+#include "../public/environment.h"
+#include "../public/value.h"
+#include "../public/vm.h"
+#include "compilation.h"
+
+namespace afc {
+namespace vm {
+
+namespace {
+
+// The state of a file, used to detect modifications. A file that doesn't exist
+// has a default state.
+struct FileState {
+  bool operator==(const FileState& other) const {
+    return exists == other.exists && size == other.size &&
+           modified.tv_sec == other.modified.tv_sec &&
+           modified.tv_nsec == other.modified.tv_nsec;
+  }
+
+  bool exists = false;
+  off_t size = 0;
+  timespec modified = {0, 0};
+};
+
+FileState GetFileState(const string& path) {
+  FileState output;
+  struct stat stat_buffer;
+  if (stat(path.c_str(), &stat_buffer) != -1) {
+    output.exists = true;
+    output.size = stat_buffer.st_size;
+    output.modified = stat_buffer.st_mtim;
+  }
+  return output;
+}
+
+string ResolvePath(const string& path) {
+  char* result = realpath(path.c_str(), nullptr);
+  if (result == nullptr) {
+    return path;
+  }
+  string output = result;
+  free(result);
+  return output;
+}
+
+// The symbols that an expression may have resolved to slots: those in the
+// environment itself and, since environments only grow, the number of symbols
+// in each of its ancestors.
+struct Layout {
+  static Layout Get(const Environment* environment) {
+    Layout output;
+    output.symbols = environment->symbols();
+    for (auto ancestor = environment->parent_environment(); ancestor != nullptr;
+         ancestor = ancestor->parent_environment()) {
+      output.ancestors.push_back({ancestor, ancestor->size()});
+    }
+    return output;
+  }
+
+  bool operator==(const Layout& other) const {
+    return symbols == other.symbols && ancestors == other.ancestors;
+  }
+
+  std::vector<wstring> symbols;
+  std::vector<std::pair<const Environment*, size_t>> ancestors;
+};
+
+// Entries for a given path are capped, to avoid growing without bounds when
+// the file is evaluated in environments with many different layouts.
+const size_t kMaxEntriesPerPath = 8;
+
+}  // namespace
+
+struct CompilationCache::Entry {
+  std::vector<std::pair<string, FileState>> files;
+  // The layouts of the environment before and after the compilation. The
+  // expression is also valid after the compilation: replaying the definitions
+  // would not change the slots of any symbols.
+  Layout layout_before;
+  Layout layout_after;
+  std::vector<Compilation::Definition> definitions;
+  shared_ptr<Expression> expression;
+};
+
+CompilationCache::CompilationCache() = default;
+CompilationCache::~CompilationCache() = default;
+
+shared_ptr<Expression> CompilationCache::CompileFile(
+    const string& path, Environment* environment, wstring* error_description) {
+  CHECK(environment != nullptr);
+  string resolved_path = ResolvePath(path);
+  Entry* entry = Find(resolved_path, environment);
+  if (entry != nullptr) {
+    stats_.hits++;
+    VLOG(5) << "Compilation cache hit: " << resolved_path;
+    for (const auto& definition : entry->definitions) {
+      environment->Define(definition.symbol, definition.value(environment));
+    }
+    return entry->expression;
+  }
+
+  stats_.misses++;
+  VLOG(5) << "Compilation cache miss: " << resolved_path;
+  auto new_entry = std::make_unique<Entry>();
+  new_entry->layout_before = Layout::Get(environment);
+
+  Compilation compilation;
+  compilation.environment = environment;
+  new_entry->expression = vm::CompileFile(resolved_path, &compilation,
+                                          error_description);
+  if (new_entry->expression == nullptr) {
+    return nullptr;
+  }
+  CHECK_EQ(compilation.definitions.size(), 1ul);
+  new_entry->definitions = std::move(compilation.definitions.front());
+  new_entry->layout_after = Layout::Get(environment);
+  for (const auto& file : compilation.files) {
+    new_entry->files.push_back({file, GetFileState(file)});
+  }
+
+  auto& entries = entries_[resolved_path];
+  entries.push_front(std::move(new_entry));
+  if (entries.size() > kMaxEntriesPerPath) {
+    entries.pop_back();
+  }
+  return entries.front()->expression;
+}
+
+CompilationCache::Entry* CompilationCache::Find(const string& path,
+                                                Environment* environment) {
+  auto it = entries_.find(path);
+  if (it == entries_.end()) {
+    return nullptr;
+  }
+  auto& entries = it->second;
+  Layout layout = Layout::Get(environment);
+  for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+    if (!((*entry)->layout_before == layout) &&
+        !((*entry)->layout_after == layout)) {
+      continue;
+    }
+    for (const auto& file : (*entry)->files) {
+      if (!(GetFileState(file.first) == file.second)) {
+        VLOG(5) << "Compilation cache: file modified: " << file.first;
+        stats_.invalidations++;
+        entries.erase(entry);
+        return nullptr;
+      }
+    }
+    return entry->get();
+  }
+  return nullptr;
+}
+
+}  // namespace vm
+}  // namespace afc
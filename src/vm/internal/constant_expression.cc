@@ -4,6 +4,7 @@
 
 #include "../public/value.h"
 #include "../public/vm.h"
+#include "bytecode.h"
 
 namespace afc {
 namespace vm {
@@ -23,11 +24,18 @@ class ConstantExpression : public Expression {
     trampoline->Continue(std::make_unique<Value>(*value_));
   }
 
+  void CompileBytecode(BytecodeCompiler* compiler, size_t output) override {
+    compiler->Emit(Opcode::LOAD_CONSTANT, output,
+                   compiler->AddConstant(std::make_unique<Value>(*value_)));
+  }
+
   std::unique_ptr<Expression> Clone() override {
     return std::make_unique<ConstantExpression>(
         std::make_unique<Value>(*value_));
   }
 
+  const Value& value() const { return *value_; }
+
  private:
   const std::unique_ptr<Value> value_;
 };
@@ -44,5 +52,11 @@ std::unique_ptr<Expression> NewConstantExpression(
   return std::make_unique<ConstantExpression>(std::move(value));
 }
 
+const Value* GetConstantValue(Expression* expression) {
+  CHECK(expression != nullptr);
+  auto constant = dynamic_cast<ConstantExpression*>(expression);
+  return constant == nullptr ? nullptr : &constant->value();
+}
+
 }  // namespace vm
 }  // namespace afc
@@ -57,38 +57,60 @@ statement(OUT) ::= function_declaration_params(FUNC)
     OUT = nullptr;
   } else {
     // TODO: Use unique_ptr rather than shared_ptr when lambda capture works.
-    std::shared_ptr<Expression> body(BODY);
+    std::shared_ptr<Expression> body(
+        NewBytecodeExpression(unique_ptr<Expression>(BODY)));
     BODY = nullptr;
 
-    shared_ptr<Environment> func_environment(compilation->environment);
+    // The environment in which the body was compiled. Each evaluation of the
+    // definition of the function (see Compilation::Definition) creates a new
+    // one with the same layout.
+    unique_ptr<Environment> compile_environment(compilation->environment);
     compilation->environment = compilation->environment->parent_environment();
     compilation->return_types.pop_back();
 
-    const vector<wstring> argument_names(FUNC->argument_names);
+    vector<Environment::Slot> argument_slots;
+    for (const auto& name : FUNC->argument_names) {
+      argument_slots.emplace_back();
+      CHECK(compile_environment->Resolve(name, &argument_slots.back()));
+    }
 
-    unique_ptr<Value> value(new Value(FUNC->type));
-    value->callback = [compilation, body, func_environment, argument_names](
-        vector<unique_ptr<Value>> args, Trampoline* trampoline) {
-      CHECK_EQ(args.size(), argument_names.size());
-      for (size_t i = 0; i < args.size(); i++) {
-        func_environment->Define(argument_names[i], std::move(args[i]));
+    auto body_definitions = std::make_shared<vector<Compilation::Definition>>(
+        std::move(compilation->definitions.back()));
+    compilation->definitions.pop_back();
+
+    VMType type = FUNC->type;
+    compilation->Define(FUNC->name,
+        [type, body, body_definitions, argument_slots](
+            Environment* environment) {
+      auto func_environment = std::make_shared<Environment>(environment);
+      for (const auto& definition : *body_definitions) {
+        func_environment->Define(definition.symbol,
+                                 definition.value(func_environment.get()));
       }
-      std::function<void(Trampoline*)> original_state = trampoline->Save();
-      trampoline->SetEnvironment(func_environment.get());
-      trampoline->SetReturnContinuation(
-          [original_state](std::unique_ptr<Value> value,
-                           Trampoline* trampoline) {
-            CHECK(value != nullptr);
-            original_state(trampoline);
-            trampoline->Return(std::move(value));
-          });
-      trampoline->Bounce(
-          body.get(),
-          [body](Value::Ptr value, Trampoline* trampoline) {
-            trampoline->Return(std::move(value));
-          });
-    };
-    compilation->environment->Define(FUNC->name, std::move(value));
+      auto value = std::make_unique<Value>(type);
+      value->set_callback([body, func_environment, argument_slots](
+          vector<unique_ptr<Value>> args, Trampoline* trampoline) {
+        CHECK_EQ(args.size(), argument_slots.size());
+        for (size_t i = 0; i < args.size(); i++) {
+          func_environment->Assign(argument_slots[i], std::move(args[i]));
+        }
+        std::function<void(Trampoline*)> original_state = trampoline->Save();
+        trampoline->SetEnvironment(func_environment.get());
+        trampoline->SetReturnContinuation(
+            [original_state](std::unique_ptr<Value> value,
+                             Trampoline* trampoline) {
+              CHECK(value != nullptr);
+              original_state(trampoline);
+              trampoline->Return(std::move(value));
+            });
+        trampoline->Bounce(
+            body.get(),
+            [body](Value::Ptr value, Trampoline* trampoline) {
+              trampoline->Return(std::move(value));
+            });
+      });
+      return value;
+    });
     OUT = NewVoidExpression().release();
   }
 }
@@ -105,27 +127,32 @@ function_declaration_params(OUT) ::= SYMBOL(RETURN_TYPE) SYMBOL(NAME) LPAREN
     OUT = nullptr;
   } else {
     const VMType* return_type_def =
-        compilation->environment->LookupType(RETURN_TYPE->str);
+        compilation->environment->LookupType(RETURN_TYPE->str());
     if (return_type_def == nullptr) {
       compilation->errors.push_back(
-          L"Unknown type: \"" + RETURN_TYPE->str + L"\"");
+          L"Unknown type: \"" + RETURN_TYPE->str() + L"\"");
       OUT = nullptr;
     } else {
       OUT = new UserFunction();
-      OUT->name = NAME->str;
+      OUT->name = NAME->str();
       OUT->type.type = VMType::FUNCTION;
       OUT->type.type_arguments.push_back(*return_type_def);
       for (pair<VMType, wstring> arg : *ARGS) {
         OUT->type.type_arguments.push_back(arg.first);
         OUT->argument_names.push_back(arg.second);
       }
-      compilation->environment->Define(
-          NAME->str, unique_ptr<Value>(new Value(OUT->type)));
+      VMType type = OUT->type;
+      compilation->Define(NAME->str(), [type](Environment*) {
+        return std::make_unique<Value>(type);
+      });
       compilation->environment = new Environment(compilation->environment);
+      compilation->definitions.emplace_back();
       compilation->return_types.push_back(*return_type_def);
       for (pair<VMType, wstring> arg : *ARGS) {
-        compilation->environment
-            ->Define(arg.second, unique_ptr<Value>(new Value(arg.first)));
+        VMType arg_type = arg.first;
+        compilation->Define(arg.second, [arg_type](Environment*) {
+          return std::make_unique<Value>(arg_type);
+        });
       }
     }
   }
@@ -180,7 +207,7 @@ statement(A) ::= IF LPAREN expr(CONDITION) RPAREN statement(TRUE_CASE). {
 }
 
 statement(A) ::= SYMBOL(TYPE) SYMBOL(NAME) EQ expr(VALUE) SEMICOLON. {
-  A = NewAssignExpression(compilation, TYPE->str, NAME->str,
+  A = NewAssignExpression(compilation, TYPE->str(), NAME->str(),
                           unique_ptr<Expression>(VALUE)).release();
   delete TYPE;
   delete NAME;
@@ -224,13 +251,13 @@ function_declaration_arguments(OUT) ::= non_empty_function_declaration_arguments
 %destructor non_empty_function_declaration_arguments { delete $$; }
 
 non_empty_function_declaration_arguments(OUT) ::= SYMBOL(TYPE) SYMBOL(NAME). {
-  const VMType* type_def = compilation->environment->LookupType(TYPE->str);
+  const VMType* type_def = compilation->environment->LookupType(TYPE->str());
   if (type_def == nullptr) {
-    compilation->errors.push_back(L"Unknown type: \"" + TYPE->str + L"\"");
+    compilation->errors.push_back(L"Unknown type: \"" + TYPE->str() + L"\"");
     OUT = nullptr;
   } else {
     OUT = new vector<pair<VMType, wstring>>;
-    OUT->push_back(make_pair(*type_def, NAME->str));
+    OUT->push_back(make_pair(*type_def, NAME->str()));
   }
   delete TYPE;
   delete NAME;
@@ -241,13 +268,13 @@ non_empty_function_declaration_arguments(OUT) ::=
   if (LIST == nullptr) {
     OUT = nullptr;
   } else {
-    const VMType* type_def = compilation->environment->LookupType(TYPE->str);
+    const VMType* type_def = compilation->environment->LookupType(TYPE->str());
     if (type_def == nullptr) {
-      compilation->errors.push_back(L"Unknown type: \"" + TYPE->str + L"\"");
+      compilation->errors.push_back(L"Unknown type: \"" + TYPE->str() + L"\"");
       OUT = nullptr;
     } else {
       OUT = LIST;
-      OUT->push_back(make_pair(*type_def, NAME->str));
+      OUT->push_back(make_pair(*type_def, NAME->str()));
       LIST = nullptr;
     }
   }
@@ -278,7 +305,7 @@ expr(A) ::= LPAREN expr(B) RPAREN. {
 }
 
 expr(OUT) ::= SYMBOL(NAME) EQ expr(VALUE). {
-  OUT = NewAssignExpression(compilation, NAME->str,
+  OUT = NewAssignExpression(compilation, NAME->str(),
                             unique_ptr<Expression>(VALUE)).release();
   VALUE = nullptr;
   delete NAME;
@@ -312,16 +339,16 @@ expr(OUT) ::= expr(OBJ) DOT SYMBOL(FIELD) LPAREN arguments_list(ARGS) RPAREN. {
           L"Unknown type: \"" + OBJ->type().ToString() + L"\"");
       OUT = nullptr;
     } else {
-      auto field = object_type->LookupField(FIELD->str);
+      auto field = object_type->LookupField(FIELD->str());
       if (field == nullptr) {
         compilation->errors.push_back(
             L"Unknown method: \"" + object_type->ToString() + L"::"
-            + FIELD->str + L"\"");
+            + FIELD->str() + L"\"");
         OUT = nullptr;
       } else if (field->type.type_arguments.size() != 2 + ARGS->size()) {
         compilation->errors.push_back(
             L"Invalid number of arguments provided for method \""
-            + object_type->ToString() + L"::" + FIELD->str + L"\": Expected "
+            + object_type->ToString() + L"::" + FIELD->str() + L"\": Expected "
             + to_wstring(field->type.type_arguments.size() - 2) + L" but found "
             + to_wstring(ARGS->size()));
         OUT = nullptr;
@@ -336,8 +363,8 @@ expr(OUT) ::= expr(OBJ) DOT SYMBOL(FIELD) LPAREN arguments_list(ARGS) RPAREN. {
         if (argument < ARGS->size()) {
           compilation->errors.push_back(
               L"Type mismatch in argument " + to_wstring(argument)
-              + L" to method \"" + object_type->ToString() + L"::" + FIELD->str
-              + L"\": Expected \""
+              + L" to method \"" + object_type->ToString() + L"::"
+              + FIELD->str() + L"\": Expected \""
               + field->type.type_arguments[2 + argument].ToString()
               + L"\" but found \"" + ARGS->at(argument)->type().ToString()
               + L"\"");
@@ -443,7 +470,7 @@ non_empty_arguments_list(OUT) ::= non_empty_arguments_list(L) COMMA expr(E). {
 
 expr(OUT) ::= NOT expr(A). {
   OUT = NewNegateExpression(
-      [](Value* value) { value->boolean = !value->boolean; },
+      [](Value* value) { value->set_boolean(!value->boolean()); },
       VMType::Bool(),
       compilation, unique_ptr<Expression>(A)).release();
   A = nullptr;
@@ -454,24 +481,24 @@ expr(OUT) ::= expr(A) EQUALS expr(B). {
     OUT = nullptr;
   } else if (A->type().type == VMType::VM_STRING
              && B->type().type == VMType::VM_STRING) {
-    OUT = new BinaryOperator(
+    OUT = NewBinaryExpression(
         unique_ptr<Expression>(A),
         unique_ptr<Expression>(B),
         VMType::Bool(),
         [](const Value& a, const Value& b, Value* output) {
-          output->boolean = a.str == b.str;
-        });
+          output->set_boolean(a.str() == b.str());
+        }).release();
     A = nullptr;
     B = nullptr;
   } else if (A->type().type == VMType::VM_INTEGER
              && B->type().type == VMType::VM_INTEGER) {
-    OUT = new BinaryOperator(
+    OUT = NewBinaryExpression(
         unique_ptr<Expression>(A),
         unique_ptr<Expression>(B),
         VMType::Bool(),
         [](const Value& a, const Value& b, Value* output) {
-          output->boolean = a.integer == b.integer;
-        });
+          output->set_boolean(a.integer() == b.integer());
+        }).release();
     A = nullptr;
     B = nullptr;
   } else {
@@ -487,24 +514,24 @@ expr(OUT) ::= expr(A) NOT_EQUALS expr(B). {
     OUT = nullptr;
   } else if (A->type().type == VMType::VM_STRING
              && B->type().type == VMType::VM_STRING) {
-    OUT = new BinaryOperator(
+    OUT = NewBinaryExpression(
         unique_ptr<Expression>(A),
         unique_ptr<Expression>(B),
         VMType::Bool(),
         [](const Value& a, const Value& b, Value* output) {
-          output->boolean = a.str != b.str;
-        });
+          output->set_boolean(a.str() != b.str());
+        }).release();
     A = nullptr;
     B = nullptr;
   } else if (A->type().type == VMType::VM_INTEGER
              && B->type().type == VMType::VM_INTEGER) {
-    OUT = new BinaryOperator(
+    OUT = NewBinaryExpression(
         unique_ptr<Expression>(A),
         unique_ptr<Expression>(B),
         VMType::Bool(),
         [](const Value& a, const Value& b, Value* output) {
-          output->boolean = a.integer != b.integer;
-        });
+          output->set_boolean(a.integer() != b.integer());
+        }).release();
     A = nullptr;
     B = nullptr;
   } else {
@@ -523,13 +550,13 @@ expr(OUT) ::= expr(A) LESS_THAN expr(B). {
     OUT = nullptr;
   } else {
     // TODO: Don't evaluate B if not needed.
-    OUT = new BinaryOperator(
+    OUT = NewBinaryExpression(
         unique_ptr<Expression>(A),
         unique_ptr<Expression>(B),
         VMType::Bool(),
         [](const Value& a, const Value& b, Value* output) {
-          output->boolean = a.integer < b.integer;
-        });
+          output->set_boolean(a.integer() < b.integer());
+        }).release();
     A = nullptr;
     B = nullptr;
   }
@@ -543,13 +570,13 @@ expr(OUT) ::= expr(A) LESS_OR_EQUAL expr(B). {
     OUT = nullptr;
   } else {
     // TODO: Don't evaluate B if not needed.
-    OUT = new BinaryOperator(
+    OUT = NewBinaryExpression(
         unique_ptr<Expression>(A),
         unique_ptr<Expression>(B),
         VMType::Bool(),
         [](const Value& a, const Value& b, Value* output) {
-          output->boolean = a.integer <= b.integer;
-        });
+          output->set_boolean(a.integer() <= b.integer());
+        }).release();
     A = nullptr;
     B = nullptr;
   }
@@ -563,13 +590,13 @@ expr(OUT) ::= expr(A) GREATER_THAN expr(B). {
     OUT = nullptr;
   } else {
     // TODO: Don't evaluate B if not needed.
-    OUT = new BinaryOperator(
+    OUT = NewBinaryExpression(
         unique_ptr<Expression>(A),
         unique_ptr<Expression>(B),
         VMType::Bool(),
         [](const Value& a, const Value& b, Value* output) {
-          output->boolean = a.integer > b.integer;
-        });
+          output->set_boolean(a.integer() > b.integer());
+        }).release();
     A = nullptr;
     B = nullptr;
   }
@@ -583,13 +610,13 @@ expr(OUT) ::= expr(A) GREATER_OR_EQUAL expr(B). {
     OUT = nullptr;
   } else {
     // TODO: Don't evaluate B if not needed.
-    OUT = new BinaryOperator(
+    OUT = NewBinaryExpression(
         unique_ptr<Expression>(A),
         unique_ptr<Expression>(B),
         VMType::Bool(),
         [](const Value& a, const Value& b, Value* output) {
-          output->boolean = a.integer >= b.integer;
-        });
+          output->set_boolean(a.integer() >= b.integer());
+        }).release();
     A = nullptr;
     B = nullptr;
   }
@@ -613,23 +640,23 @@ expr(A) ::= expr(B) PLUS expr(C). {
   if (B == nullptr || C == nullptr || !(B->type() == C->type())) {
     A = nullptr;
   } else if (B->type().type == VMType::VM_STRING) {
-    A = new BinaryOperator(
+    A = NewBinaryExpression(
         unique_ptr<Expression>(B),
         unique_ptr<Expression>(C),
         VMType::String(),
         [](const Value& a, const Value& b, Value* output) {
-          output->str = a.str + b.str;
-        });
+          output->set_str(a.str() + b.str());
+        }).release();
     B = nullptr;
     C = nullptr;
   } else if (B->type().type == VMType::VM_INTEGER) {
-    A = new BinaryOperator(
+    A = NewBinaryExpression(
         unique_ptr<Expression>(B),
         unique_ptr<Expression>(C),
         VMType::Integer(),
         [](const Value& a, const Value& b, Value* output) {
-          output->integer = a.integer + b.integer;
-        });
+          output->set_integer(a.integer() + b.integer());
+        }).release();
     B = nullptr;
     C = nullptr;
   } else {
@@ -645,13 +672,13 @@ expr(A) ::= expr(B) MINUS expr(C). {
         L"Unable to subtract different types: \"" + B->type().ToString() +
         L"\" and \"" + C->type().ToString() + L"\"");
   } else if (B->type().type == VMType::VM_INTEGER) {
-    A = new BinaryOperator(
+    A = NewBinaryExpression(
         unique_ptr<Expression>(B),
         unique_ptr<Expression>(C),
         VMType::Integer(),
         [](const Value& a, const Value& b, Value* output) {
-          output->integer = a.integer - b.integer;
-        });
+          output->set_integer(a.integer() - b.integer());
+        }).release();
     B = nullptr;
     C = nullptr;
   } else {
@@ -663,7 +690,7 @@ expr(A) ::= expr(B) MINUS expr(C). {
 
 expr(OUT) ::= MINUS expr(A). {
   OUT = NewNegateExpression(
-      [](Value* value) { value->integer = -value->integer; },
+      [](Value* value) { value->set_integer(-value->integer()); },
       VMType::Integer(),
       compilation, unique_ptr<Expression>(A)).release();
 }
@@ -672,13 +699,13 @@ expr(A) ::= expr(B) TIMES expr(C). {
   if (B == nullptr || C == nullptr || !(B->type() == C->type())) {
     A = nullptr;
   } else if (B->type().type == VMType::VM_INTEGER) {
-    A = new BinaryOperator(
+    A = NewBinaryExpression(
         unique_ptr<Expression>(B),
         unique_ptr<Expression>(C),
         VMType::Integer(),
         [](const Value& a, const Value& b, Value* output) {
-          output->integer = a.integer * b.integer;
-        });
+          output->set_integer(a.integer() * b.integer());
+        }).release();
     B = nullptr;
     C = nullptr;
   } else {
@@ -731,12 +758,12 @@ string(OUT) ::= string(A) STRING(B). {
   assert(A->type.type == VMType::VM_STRING);
   assert(B->type.type == VMType::VM_STRING);
   OUT = A;
-  OUT->str = A->str + B->str;
+  OUT->set_str(A->str() + B->str());
   A = nullptr;
 }
 
 expr(OUT) ::= SYMBOL(S). {
   assert(S->type.type == VMType::VM_SYMBOL);
-  OUT = NewVariableLookup(compilation, S->str).release();
+  OUT = NewVariableLookup(compilation, S->str()).release();
   delete S;
 }
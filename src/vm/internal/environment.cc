@@ -65,20 +65,45 @@ void Environment::DefineType(const wstring& name,
   it.first->second = std::move(value);
 }
 
+bool Environment::Resolve(const wstring& symbol, Slot* output) const {
+  CHECK(output != nullptr);
+  output->depth = 0;
+  for (auto environment = this; environment != nullptr;
+       environment = environment->parent_environment_) {
+    auto it = environment->table_.find(symbol);
+    if (it != environment->table_.end()) {
+      output->index = it->second;
+      return true;
+    }
+    output->depth++;
+  }
+  return false;
+}
+
 Value* Environment::Lookup(const wstring& symbol) {
-  auto it = table_.find(symbol);
-  if (it != table_.end()) {
-    return it->second.get();
+  Slot slot;
+  return Resolve(symbol, &slot) ? Lookup(slot) : nullptr;
+}
+
+Value* Environment::Lookup(const Slot& slot) {
+  auto environment = this;
+  for (size_t i = 0; i < slot.depth && environment != nullptr; i++) {
+    environment = environment->parent_environment_;
   }
-  if (parent_environment_ != nullptr) {
-    return parent_environment_->Lookup(symbol);
+  if (environment == nullptr || slot.index >= environment->values_.size()) {
+    return nullptr;
   }
-
-  return nullptr;
+  return environment->values_[slot.index].get();
 }
 
 void Environment::Define(const wstring& symbol, unique_ptr<Value> value) {
-  table_[symbol] = std::move(value);
+  auto it = table_.find(symbol);
+  if (it != table_.end()) {
+    values_[it->second] = std::move(value);
+    return;
+  }
+  table_.insert(make_pair(symbol, values_.size()));
+  values_.push_back(std::move(value));
 }
 
 void Environment::Assign(const wstring& symbol, unique_ptr<Value> value) {
@@ -95,7 +120,26 @@ void Environment::Assign(const wstring& symbol, unique_ptr<Value> value) {
     parent_environment_->Assign(symbol, std::move(value));
     return;
   }
-  it->second = std::move(value);
+  values_[it->second] = std::move(value);
+}
+
+void Environment::Assign(const Slot& slot, unique_ptr<Value> value) {
+  auto environment = this;
+  for (size_t i = 0; i < slot.depth; i++) {
+    CHECK(environment->parent_environment_ != nullptr)
+        << "Invalid slot (depth " << slot.depth << ").";
+    environment = environment->parent_environment_;
+  }
+  CHECK_LT(slot.index, environment->values_.size());
+  environment->values_[slot.index] = std::move(value);
+}
+
+vector<wstring> Environment::symbols() const {
+  vector<wstring> output(values_.size());
+  for (const auto& entry : table_) {
+    output[entry.second] = entry.first;
+  }
+  return output;
 }
 
 }  // namespace vm
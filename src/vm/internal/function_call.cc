@@ -3,8 +3,10 @@
 #include <glog/logging.h>
 
 #include "../public/constant_expression.h"
+#include "../public/environment.h"
 #include "../public/value.h"
 #include "../public/vm.h"
+#include "bytecode.h"
 
 namespace afc {
 namespace vm {
@@ -36,6 +38,20 @@ class FunctionCall : public Expression {
         });
   }
 
+  void CompileBytecode(BytecodeCompiler* compiler, size_t output) override {
+    size_t callee = compiler->NewRegister();
+    compiler->Compile(func_.get(), callee);
+    for (size_t i = 0; i < args_->size(); i++) {
+      // Compile releases any registers it allocates, so the arguments end up
+      // in consecutive registers.
+      size_t arg_register = compiler->NewRegister();
+      CHECK_EQ(arg_register, callee + 1 + i);
+      compiler->Compile(args_->at(i).get(), arg_register);
+    }
+    compiler->Emit(Opcode::CALL, output, callee, args_->size());
+    compiler->ReleaseRegisters(callee);
+  }
+
   std::unique_ptr<Expression> Clone() override {
     return std::make_unique<FunctionCall>(func_, args_);
   }
@@ -50,7 +66,7 @@ class FunctionCall : public Expression {
     CHECK(values != nullptr);
     CHECK(callback != nullptr);
     CHECK_EQ(callback->type.type, VMType::FUNCTION);
-    CHECK(callback->callback);
+    CHECK(callback->callback());
 
     DVLOG(5) << "Evaluating function parameters, args: " << args_types->size();
     if (values->size() == args_types->size()) {
@@ -60,12 +76,12 @@ class FunctionCall : public Expression {
           [original_state](std::unique_ptr<Value> value,
                            Trampoline* trampoline) {
             CHECK(value != nullptr);
-            LOG(INFO) << "Got returned value: " << *value;
+            DVLOG(5) << "Got returned value: " << *value;
             original_state(trampoline);
             trampoline->Continue(std::move(value));
           });
       trampoline->SetContinuation(trampoline->return_continuation());
-      callback->callback(std::move(*values), trampoline);
+      callback->callback()(std::move(*values), trampoline);
       return;
     }
     trampoline->Bounce(
@@ -79,7 +95,7 @@ class FunctionCall : public Expression {
           DVLOG(6) << "Recursive call.";
           CHECK(callback != nullptr);
           CHECK_EQ(callback->type.type, VMType::FUNCTION);
-          CHECK(callback->callback);
+          CHECK(callback->callback());
           CaptureArgs(trampoline, args_types, values, callback);
         });
   }
@@ -101,19 +117,18 @@ std::unique_ptr<Expression> NewFunctionCall(
 
 void Call(Value* func, vector<Value::Ptr> args,
           std::function<void(Value::Ptr)> consumer) {
-  std::vector<std::unique_ptr<Expression>> args_expr;
-  for (auto& a : args) {
-    args_expr.push_back(NewConstantExpression(std::move(a)));
-  }
-  // TODO: Use unique_ptr and capture by std::move.
-  std::shared_ptr<Expression> function_expr =
-      NewFunctionCall(NewConstantExpression(Value::NewFunction(
-                          func->type.type_arguments, func->callback)),
-                      std::move(args_expr));
-  Evaluate(function_expr.get(), nullptr,
-           [function_expr, consumer](Value::Ptr value) {
-             consumer(std::move(value));
-           });
+  CHECK_EQ(func->type.type, VMType::FUNCTION);
+  // Retained, in case the call deletes func.
+  Value::Callback callback = func->callback();
+  // User functions switch to their own environment, but saving the state of
+  // the trampoline requires one.
+  Trampoline trampoline(Environment::GetDefault(),
+                        [consumer](Value::Ptr value, Trampoline*) {
+                          consumer(std::move(value));
+                        });
+  trampoline.Enter([&callback, &args](Trampoline* trampoline) {
+    callback(std::move(args), trampoline);
+  });
 }
 
 }  // namespace vm
@@ -3,7 +3,9 @@
 #include <glog/logging.h>
 
 #include "../internal/compilation.h"
+#include "../public/constant_expression.h"
 #include "../public/value.h"
+#include "bytecode.h"
 
 namespace afc {
 namespace vm {
@@ -32,10 +34,20 @@ class IfExpression : public Expression {
     trampoline->Bounce(cond_.get(), [cond_copy, true_copy, false_copy](
                                         std::unique_ptr<Value> result,
                                         Trampoline* trampoline) {
-      (result->boolean ? true_copy : false_copy)->Evaluate(trampoline);
+      (result->boolean() ? true_copy : false_copy)->Evaluate(trampoline);
     });
   }
 
+  void CompileBytecode(BytecodeCompiler* compiler, size_t output) override {
+    compiler->Compile(cond_.get(), output);
+    size_t jump_to_false = compiler->Emit(Opcode::JUMP_IF, output, false);
+    compiler->Compile(true_case_.get(), output);
+    size_t jump_to_end = compiler->Emit(Opcode::JUMP);
+    compiler->SetJumpTarget(jump_to_false, compiler->next_instruction());
+    compiler->Compile(false_case_.get(), output);
+    compiler->SetJumpTarget(jump_to_end, compiler->next_instruction());
+  }
+
   std::unique_ptr<Expression> Clone() override {
     return std::make_unique<IfExpression>(cond_, true_case_, false_case_);
   }
@@ -71,6 +83,11 @@ std::unique_ptr<Expression> NewIfExpression(
     return nullptr;
   }
 
+  if (auto value = GetConstantValue(condition.get())) {
+    DVLOG(5) << "Dropping branch of conditional with constant condition.";
+    return value->boolean() ? std::move(true_case) : std::move(false_case);
+  }
+
   return std::make_unique<IfExpression>(
       std::move(condition), std::move(true_case), std::move(false_case));
 }
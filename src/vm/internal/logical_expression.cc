@@ -2,9 +2,11 @@
 
 #include <glog/logging.h>
 
+#include "../public/constant_expression.h"
 #include "../public/types.h"
 #include "../public/value.h"
 #include "../public/vm.h"
+#include "bytecode.h"
 
 namespace afc {
 namespace vm {
@@ -29,7 +31,7 @@ class LogicalExpression : public Expression {
                                               std::unique_ptr<Value> value,
                                               Trampoline* trampoline) {
       CHECK_EQ(VMType::VM_BOOLEAN, value->type.type);
-      if (value->boolean == identity) {
+      if (value->boolean() == identity) {
         expr_b_copy->Evaluate(trampoline);
       } else {
         trampoline->Continue(std::move(value));
@@ -37,6 +39,13 @@ class LogicalExpression : public Expression {
     });
   }
 
+  void CompileBytecode(BytecodeCompiler* compiler, size_t output) override {
+    compiler->Compile(expr_a_.get(), output);
+    size_t jump_to_end = compiler->Emit(Opcode::JUMP_IF, output, !identity_);
+    compiler->Compile(expr_b_.get(), output);
+    compiler->SetJumpTarget(jump_to_end, compiler->next_instruction());
+  }
+
   std::unique_ptr<Expression> Clone() override {
     return std::make_unique<LogicalExpression>(identity_, expr_a_, expr_b_);
   }
@@ -56,6 +65,9 @@ std::unique_ptr<Expression> NewLogicalExpression(
       b->type().type != VMType::VM_BOOLEAN) {
     return nullptr;
   }
+  if (auto value = GetConstantValue(a.get())) {
+    return value->boolean() == identity ? std::move(b) : std::move(a);
+  }
   return std::make_unique<LogicalExpression>(identity, std::move(a),
                                              std::move(b));
 }
@@ -1,7 +1,9 @@
 #include "negate_expression.h"
 
+#include "../public/constant_expression.h"
 #include "../public/value.h"
 #include "../public/vm.h"
+#include "bytecode.h"
 #include "compilation.h"
 
 namespace afc {
@@ -27,6 +29,12 @@ class NegateExpression : public Expression {
     });
   }
 
+  void CompileBytecode(BytecodeCompiler* compiler, size_t output) override {
+    compiler->Compile(expr_.get(), output);
+    compiler->Emit(Opcode::NEGATE, output,
+                   compiler->AddNegateOperator(negate_));
+  }
+
   std::unique_ptr<Expression> Clone() override {
     return std::make_unique<NegateExpression>(negate_, expr_->Clone());
   }
@@ -49,6 +57,11 @@ std::unique_ptr<Expression> NewNegateExpression(
                                   expr->type().ToString() + L"\"");
     return nullptr;
   }
+  if (auto value = GetConstantValue(expr.get())) {
+    auto output = std::make_unique<Value>(*value);
+    negate(output.get());
+    return NewConstantExpression(std::move(output));
+  }
   return std::make_unique<NegateExpression>(negate, std::move(expr));
 }
 
@@ -4,6 +4,7 @@
 
 #include "../public/value.h"
 #include "../public/vm.h"
+#include "bytecode.h"
 #include "compilation.h"
 
 namespace afc {
@@ -26,6 +27,11 @@ class ReturnExpression : public Expression {
                        });
   }
 
+  void CompileBytecode(BytecodeCompiler* compiler, size_t output) override {
+    compiler->Compile(expr_.get(), output);
+    compiler->Emit(Opcode::RETURN, output);
+  }
+
   std::unique_ptr<Expression> Clone() override {
     return std::make_unique<ReturnExpression>(expr_);
   }
@@ -125,8 +125,8 @@ void RegisterStringType(Environment* environment) {
                                         CHECK_EQ(args.size(), 1);
                                         CHECK_EQ(args[0]->type.type,
                                                  VMType::VM_INTEGER);
-                                        return Value::NewString(
-                                            std::to_wstring(args[0]->integer));
+                                        return Value::NewString(std::to_wstring(
+                                            args[0]->integer()));
                                       }));
 }
 
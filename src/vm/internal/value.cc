@@ -11,32 +11,32 @@ namespace vm {
 
 /* static */ std::unique_ptr<Value> Value::NewBool(bool value) {
   auto output = std::make_unique<Value>(VMType::Bool());
-  output->boolean = value;
+  output->set_boolean(value);
   return std::move(output);
 }
 
 /* static */ std::unique_ptr<Value> Value::NewInteger(int value) {
   auto output = std::make_unique<Value>(VMType::Integer());
-  output->integer = value;
+  output->set_integer(value);
   return std::move(output);
 }
 
 /* static */ std::unique_ptr<Value> Value::NewDouble(double value) {
   auto output = std::make_unique<Value>(VMType::Double());
-  output->double_value = value;
+  output->set_double_value(value);
   return std::move(output);
 }
 
 /* static */ std::unique_ptr<Value> Value::NewString(wstring value) {
   auto output = std::make_unique<Value>(VMType::String());
-  output->str = std::move(value);
+  output->set_str(std::move(value));
   return std::move(output);
 }
 
 /* static */ std::unique_ptr<Value> Value::NewObject(
     const wstring& name, const shared_ptr<void>& value) {
   auto output = std::make_unique<Value>(VMType::ObjectType(name));
-  output->user_value = value;
+  output->set_user_value(value);
   return std::move(output);
 }
 
@@ -44,7 +44,7 @@ namespace vm {
     std::vector<VMType> arguments, Value::Callback callback) {
   auto output = std::make_unique<Value>(VMType::FUNCTION);
   output->type.type_arguments = std::move(arguments);
-  output->callback = std::move(callback);
+  output->set_callback(std::move(callback));
   return std::move(output);
 }
 
@@ -57,12 +57,32 @@ namespace vm {
                      });
 }
 
+const wstring& Value::str() const {
+  static const wstring* empty = new wstring();
+  return payload_ == nullptr ? *empty
+                             : *static_cast<const wstring*>(payload_.get());
+}
+
+const Value::Callback& Value::callback() const {
+  static const Callback* empty = new Callback();
+  return payload_ == nullptr ? *empty
+                             : *static_cast<const Callback*>(payload_.get());
+}
+
+void Value::set_str(wstring value) {
+  payload_ = std::make_shared<wstring>(std::move(value));
+}
+
+void Value::set_callback(Callback callback) {
+  payload_ = std::make_shared<Callback>(std::move(callback));
+}
+
 std::ostream& operator<<(std::ostream& os, const Value& value) {
   os << "[" << value.type.ToString();
   if (value.type == VMType::Integer()) {
-    os << ": " << value.integer;
+    os << ": " << value.integer();
   } else if (value.type == VMType::String()) {
-    os << ": " << value.str;
+    os << ": " << value.str();
   }
   os << "]";
   return os;
@@ -5,6 +5,7 @@
 #include "../public/environment.h"
 #include "../public/value.h"
 #include "../public/vm.h"
+#include "bytecode.h"
 #include "compilation.h"
 
 namespace afc {
@@ -15,27 +16,33 @@ namespace {
 // TODO: Don't pass symbol by const reference.
 class VariableLookup : public Expression {
  public:
-  VariableLookup(const wstring& symbol, const VMType& type)
-      : symbol_(symbol), type_(type) {}
+  VariableLookup(const wstring& symbol, Environment::Slot slot,
+                 const VMType& type)
+      : symbol_(symbol), slot_(slot), type_(type) {}
 
   const VMType& type() { return type_; }
 
   void Evaluate(Trampoline* trampoline) {
     // TODO: Enable this logging.
     // DVLOG(5) << "Look up symbol: " << symbol_;
-    Value* result = trampoline->environment()->Lookup(symbol_);
-    CHECK(result != nullptr);
     CHECK(trampoline != nullptr);
+    Value* result = trampoline->environment()->Lookup(slot_);
+    CHECK(result != nullptr);
     DVLOG(5) << "Variable lookup: " << *result;
     trampoline->Continue(std::make_unique<Value>(*result));
   }
 
+  void CompileBytecode(BytecodeCompiler* compiler, size_t output) override {
+    compiler->Emit(Opcode::LOAD_SLOT, output, compiler->AddSlot(slot_));
+  }
+
   std::unique_ptr<Expression> Clone() override {
-    return std::make_unique<VariableLookup>(symbol_, type_);
+    return std::make_unique<VariableLookup>(symbol_, slot_, type_);
   }
 
  private:
   const wstring symbol_;
+  const Environment::Slot slot_;
   const VMType type_;
 };
 
@@ -43,12 +50,14 @@ class VariableLookup : public Expression {
 
 std::unique_ptr<Expression> NewVariableLookup(Compilation* compilation,
                                               const wstring& symbol) {
-  Value* result = compilation->environment->Lookup(symbol);
-  if (result == nullptr) {
+  Environment::Slot slot;
+  if (!compilation->environment->Resolve(symbol, &slot)) {
     compilation->AddError(L"Variable not found: \"" + symbol + L"\"");
     return nullptr;
   }
-  return std::make_unique<VariableLookup>(symbol, result->type);
+  Value* result = compilation->environment->Lookup(slot);
+  CHECK(result != nullptr);
+  return std::make_unique<VariableLookup>(symbol, slot, result->type);
 }
 
 }  // namespace vm
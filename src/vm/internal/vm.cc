@@ -18,6 +18,7 @@
 #include "append_expression.h"
 #include "assign_expression.h"
 #include "binary_operator.h"
+#include "bytecode.h"
 #include "compilation.h"
 #include "if_expression.h"
 #include "logical_expression.h"
@@ -70,6 +71,7 @@ void CompileStream(std::wistream& stream, Compilation* compilation,
 
 void CompileFile(const string& path, Compilation* compilation, void* parser) {
   VLOG(3) << "Compiling file: [" << path << "]";
+  compilation->files.push_back(path);
 
   std::wifstream infile(path);
   infile.imbue(std::locale(""));
@@ -289,7 +291,7 @@ void CompileLine(Compilation* compilation, void* parser, const wstring& str) {
           }
           token = DOUBLE;
           input = Value::NewDouble(value);
-          input->double_value = decimal;
+          input->set_double_value(decimal);
         } else {
           token = INTEGER;
           input = Value::NewInteger(decimal);
@@ -300,13 +302,13 @@ void CompileLine(Compilation* compilation, void* parser, const wstring& str) {
         token = STRING;
         input = std::make_unique<Value>(VMType::VM_STRING);
         pos++;
-        input->str = L"";
+        wstring contents;
         for (; pos < str.size(); pos++) {
           if (str.at(pos) == '"') {
             break;
           }
           if (str.at(pos) != '\\') {
-            input->str.push_back(str.at(pos));
+            contents.push_back(str.at(pos));
             ;
             continue;
           }
@@ -316,18 +318,19 @@ void CompileLine(Compilation* compilation, void* parser, const wstring& str) {
           }
           switch (str.at(pos)) {
             case 'n':
-              input->str.push_back('\n');
+              contents.push_back('\n');
               break;
             case 't':
-              input->str.push_back('\t');
+              contents.push_back('\t');
               break;
             case '"':
-              input->str.push_back('"');
+              contents.push_back('"');
               break;
             default:
-              input->str.push_back(str.at(pos));
+              contents.push_back(str.at(pos));
           }
         }
+        input->set_str(std::move(contents));
         if (pos == str.size()) {
           compilation->AddError(L"Missing terminating \" character.");
           return;
@@ -419,7 +422,7 @@ void CompileLine(Compilation* compilation, void* parser, const wstring& str) {
         } else {
           token = SYMBOL;
           input = std::make_unique<Value>(VMType::VM_SYMBOL);
-          input->str = symbol;
+          input->set_str(symbol);
         }
       } break;
 
@@ -452,7 +455,7 @@ void CompileLine(Compilation* compilation, void* parser, const wstring& str) {
       CHECK(input != nullptr) << "No input with token: " << token;
       CHECK(input->type == VMType::VM_SYMBOL ||
             input->type == VMType::VM_STRING);
-      compilation->last_token = input->str;
+      compilation->last_token = input->str();
     }
     Cpp(parser, token, input.release(), compilation);
   }
@@ -479,22 +482,40 @@ unique_ptr<Expression> ResultsFromCompilation(Compilation* compilation,
     }
     return nullptr;
   }
-  return std::move(compilation->expr);
+  if (compilation->expr == nullptr) {
+    return nullptr;
+  }
+  return NewBytecodeExpression(std::move(compilation->expr));
 }
 
 }  // namespace
 
+void Compilation::Define(
+    const wstring& symbol,
+    std::function<unique_ptr<Value>(Environment*)> value) {
+  CHECK(!definitions.empty());
+  environment->Define(symbol, value(environment));
+  definitions.back().push_back({symbol, std::move(value)});
+}
+
+unique_ptr<Expression> CompileFile(const string& path,
+                                   Compilation* compilation,
+                                   wstring* error_description) {
+  CHECK(compilation->environment != nullptr);
+  compilation->directory = CppDirname(path);
+  compilation->expr = nullptr;
+  compilation->return_types = {VMType::Void()};
+
+  CompileFile(path, compilation, GetParser(compilation).get());
+
+  return ResultsFromCompilation(compilation, error_description);
+}
+
 unique_ptr<Expression> CompileFile(const string& path, Environment* environment,
                                    wstring* error_description) {
   Compilation compilation;
-  compilation.directory = CppDirname(path);
-  compilation.expr = nullptr;
   compilation.environment = environment;
-  compilation.return_types = {VMType::Void()};
-
-  CompileFile(path, &compilation, GetParser(&compilation).get());
-
-  return ResultsFromCompilation(&compilation, error_description);
+  return CompileFile(path, &compilation, error_description);
 }
 
 unique_ptr<Expression> CompileString(const wstring& str,
@@ -529,6 +550,16 @@ void Trampoline::Enter(Expression* start_expression) {
   CHECK(expression_ == nullptr);
   CHECK(start_expression != nullptr);
   expression_ = start_expression;
+  Run();
+}
+
+void Trampoline::Enter(const std::function<void(Trampoline*)>& start) {
+  CHECK(expression_ == nullptr);
+  start(this);
+  Run();
+}
+
+void Trampoline::Run() {
   while (expression_) {
     DVLOG(7) << "Jumping in the evaluation trampoline...";
     Expression* current_expression = expression_;
@@ -2,8 +2,10 @@
 
 #include <glog/logging.h>
 
+#include "../public/constant_expression.h"
 #include "../public/value.h"
 #include "../public/vm.h"
+#include "bytecode.h"
 #include "compilation.h"
 
 namespace afc {
@@ -27,6 +29,17 @@ class WhileExpression : public Expression {
     Iterate(trampoline, condition_, body_);
   }
 
+  void CompileBytecode(BytecodeCompiler* compiler, size_t output) override {
+    size_t start = compiler->next_instruction();
+    compiler->Compile(condition_.get(), output);
+    size_t jump_to_end = compiler->Emit(Opcode::JUMP_IF, output, false);
+    compiler->Compile(body_.get(), output);
+    compiler->Emit(Opcode::JUMP, start);
+    compiler->SetJumpTarget(jump_to_end, compiler->next_instruction());
+    compiler->Emit(Opcode::LOAD_CONSTANT, output,
+                   compiler->AddConstant(Value::NewVoid()));
+  }
+
   std::unique_ptr<Expression> Clone() override {
     return std::make_unique<WhileExpression>(condition_, body_);
   }
@@ -38,7 +51,7 @@ class WhileExpression : public Expression {
     trampoline->Bounce(condition.get(), [condition, body](
                                             std::unique_ptr<Value> cond_value,
                                             Trampoline* trampoline) {
-      if (!cond_value->boolean) {
+      if (!cond_value->boolean()) {
         DVLOG(3) << "Iteration is done.";
         trampoline->Continue(Value::NewVoid());
         return;
@@ -71,6 +84,12 @@ std::unique_ptr<Expression> NewWhileExpression(
     return nullptr;
   }
 
+  if (auto value = GetConstantValue(condition.get())) {
+    if (!value->boolean()) {
+      return NewVoidExpression();
+    }
+  }
+
   return std::make_unique<WhileExpression>(std::move(condition),
                                            std::move(body));
 }
@@ -29,7 +29,7 @@ struct VMTypeMapper<void> {
 
 template <>
 struct VMTypeMapper<bool> {
-  static int get(Value* value) { return value->boolean; }
+  static bool get(Value* value) { return value->boolean(); }
 
   static Value::Ptr New(bool value) { return Value::NewBool(value); }
 
@@ -38,7 +38,7 @@ struct VMTypeMapper<bool> {
 
 template <>
 struct VMTypeMapper<int> {
-  static int get(Value* value) { return value->integer; }
+  static int get(Value* value) { return value->integer(); }
 
   static Value::Ptr New(int value) { return Value::NewInteger(value); }
 
@@ -47,7 +47,7 @@ struct VMTypeMapper<int> {
 
 template <>
 struct VMTypeMapper<double> {
-  static int get(Value* value) { return value->double_value; }
+  static double get(Value* value) { return value->double_value(); }
 
   static Value::Ptr New(double value) { return Value::NewDouble(value); }
 
@@ -56,7 +56,7 @@ struct VMTypeMapper<double> {
 
 template <>
 struct VMTypeMapper<wstring> {
-  static wstring get(Value* value) { return std::move(value->str); }
+  static const wstring& get(Value* value) { return value->str(); }
 
   static Value::Ptr New(wstring value) { return Value::NewString(value); }
 
@@ -148,10 +148,10 @@ Value::Ptr NewCallback(std::function<ReturnType(Args...)> callback) {
   callback_wrapper->type.type_arguments.push_back(
       VMTypeMapper<ReturnType>().vmtype);
   AddArgs<Args...>::Run(&callback_wrapper->type.type_arguments);
-  callback_wrapper->callback = [callback](vector<Value::Ptr> args,
-                                          Trampoline* trampoline) {
+  callback_wrapper->set_callback([callback](vector<Value::Ptr> args,
+                                            Trampoline* trampoline) {
     trampoline->Return(RunCallback<ReturnType, Args...>(callback, args));
-  };
+  });
   return std::move(callback_wrapper);
 }
 
@@ -0,0 +1,62 @@
+#ifndef __AFC_VM_PUBLIC_COMPILATION_CACHE_H__
+#define __AFC_VM_PUBLIC_COMPILATION_CACHE_H__
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace afc {
+namespace vm {
+
+using std::shared_ptr;
+using std::string;
+using std::wstring;
+
+class Environment;
+class Expression;
+
+// Retains the expressions compiled from files, so that evaluating the same file
+// many times (e.g., a hook evaluated for each buffer) only compiles it once.
+//
+// An entry is reused as long as none of the files read while compiling it
+// (including those it #includes) has been modified and the environment in
+// which it is evaluated has the same layout (the symbols that the compiled
+// expression resolved to slots) as the one in which it was compiled. On a hit,
+// the definitions that the compilation made are replayed in the environment:
+// the functions defined by the file are bound to it.
+class CompilationCache {
+ public:
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    // Entries dropped because a file they depend on was modified.
+    size_t invalidations = 0;
+  };
+
+  CompilationCache();
+  ~CompilationCache();
+
+  // Equivalent to CompileFile (in vm.h). The expression returned may be shared
+  // with other callers.
+  shared_ptr<Expression> CompileFile(const string& path,
+                                     Environment* environment,
+                                     wstring* error_description);
+
+  const Stats& stats() const { return stats_; }
+
+ private:
+  struct Entry;
+
+  // Returns nullptr if there's no valid entry.
+  Entry* Find(const string& path, Environment* environment);
+
+  std::map<string, std::list<std::unique_ptr<Entry>>> entries_;
+  Stats stats_;
+};
+
+}  // namespace vm
+}  // namespace afc
+
+#endif  // __AFC_VM_PUBLIC_COMPILATION_CACHE_H__
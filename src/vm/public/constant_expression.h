@@ -16,6 +16,11 @@ class Value;
 unique_ptr<Expression> NewVoidExpression();
 unique_ptr<Expression> NewConstantExpression(Value::Ptr value);
 
+// Returns the value of the expression if it was created through
+// NewConstantExpression (possibly as the result of folding constant
+// subexpressions during compilation) and nullptr otherwise.
+const Value* GetConstantValue(Expression* expression);
+
 }  // namespace vm
 }  // namespace afc
 
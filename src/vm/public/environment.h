@@ -4,12 +4,14 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace afc {
 namespace vm {
 
 using std::map;
 using std::unique_ptr;
+using std::vector;
 using std::wstring;
 
 class Value;
@@ -30,13 +32,36 @@ class Environment {
   const VMType* LookupType(const wstring& symbol);
   void DefineType(const wstring& name, unique_ptr<ObjectType> value);
 
+  // The location of a symbol relative to the environment in which it was
+  // resolved: the number of parent environments to walk up and the position of
+  // its value in that environment. Slots never change once assigned, so
+  // expressions can resolve their symbols during compilation and avoid looking
+  // them up by name (as long as they are evaluated in the same environment).
+  struct Slot {
+    size_t depth = 0;
+    size_t index = 0;
+  };
+
+  // Returns false if the symbol isn't defined.
+  bool Resolve(const wstring& symbol, Slot* output) const;
+
   Value* Lookup(const wstring& symbol);
+  // Returns nullptr if the slot isn't valid in this environment.
+  Value* Lookup(const Slot& slot);
   void Define(const wstring& symbol, unique_ptr<Value> value);
   void Assign(const wstring& symbol, unique_ptr<Value> value);
+  void Assign(const Slot& slot, unique_ptr<Value> value);
+
+  // Returns the symbols defined in this environment (excluding its parents) in
+  // the order in which they were defined, which determines their slots.
+  vector<wstring> symbols() const;
+  size_t size() const { return values_.size(); }
 
  private:
   map<wstring, unique_ptr<ObjectType>> object_types_;
-  map<wstring, unique_ptr<Value>> table_;
+  // Maps each symbol to its position in values_.
+  map<wstring, size_t> table_;
+  vector<unique_ptr<Value>> values_;
   Environment* parent_environment_;
 };
 
@@ -19,7 +19,11 @@ using std::vector;
 
 class Trampoline;
 
-struct Value {
+// A value in the VM. The scalars (booleans, integers and doubles) are stored
+// inline; all other payloads (strings, functions and objects) are immutable and
+// shared between all copies of the value, so copying a value never copies them.
+class Value {
+ public:
   using Ptr = std::unique_ptr<Value>;
 
   Value(const VMType::Type& t) : type(t) {}
@@ -41,12 +45,30 @@ struct Value {
       std::function<Ptr(std::vector<Ptr>)> callback);
   VMType type;
 
-  bool boolean;
-  int integer;
-  double double_value;
-  wstring str;
-  Callback callback;
-  shared_ptr<void> user_value;
+  bool boolean() const { return scalar_.boolean; }
+  int integer() const { return scalar_.integer; }
+  double double_value() const { return scalar_.double_value; }
+  const wstring& str() const;
+  const Callback& callback() const;
+  const shared_ptr<void>& user_value() const { return payload_; }
+
+  void set_boolean(bool value) { scalar_.boolean = value; }
+  void set_integer(int value) { scalar_.integer = value; }
+  void set_double_value(double value) { scalar_.double_value = value; }
+  void set_str(wstring value);
+  void set_callback(Callback callback);
+  void set_user_value(shared_ptr<void> value) { payload_ = std::move(value); }
+
+ private:
+  union {
+    bool boolean;
+    int integer;
+    double double_value;
+  } scalar_ = {false};
+
+  // A wstring (for strings), a Callback (for functions), or the value of an
+  // object.
+  shared_ptr<void> payload_;
 };
 
 std::ostream& operator<<(std::ostream& os, const Value& value);
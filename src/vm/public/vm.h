@@ -22,6 +22,7 @@ using std::unique_ptr;
 using std::vector;
 using std::wstring;
 
+class BytecodeCompiler;
 class Environment;
 class Evaluation;
 class VMType;
@@ -53,6 +54,10 @@ class Trampoline {
   // Must ensure it lives until return_continuation is called.
   void Enter(Expression* expression);
 
+  // Runs start (which must arrange for the same calls as Expression::Evaluate)
+  // followed by any expressions into which it bounces.
+  void Enter(const std::function<void(Trampoline*)>& start);
+
   // Saves the state (continuations ane environment) of the current trampoline
   // and returns a callback that can be used to restore it into a trampoline.
   std::function<void(Trampoline*)> Save();
@@ -80,6 +85,9 @@ class Trampoline {
   Continuation return_continuation_;
   Continuation continuation_;
 
+  // Evaluates expression_ until no expression bounces.
+  void Run();
+
   // Set by Bounce (and Enter), read by Enter.
   Expression* expression_ = nullptr;
 };
@@ -98,6 +106,11 @@ class Expression {
   // Must arrange for either Trampoline::Return, Trampoline::Continue, or
   // Trampoline::Bounce to be called (whether before or after returning).
   virtual void Evaluate(Trampoline* evaluation) = 0;
+
+  // Emits the instructions that evaluate this expression, leaving its value in
+  // register output. The default implementation evaluates the expression in
+  // the trampoline.
+  virtual void CompileBytecode(BytecodeCompiler* compiler, size_t output);
 };
 
 unique_ptr<Expression> CompileFile(const string& path, Environment* environment,